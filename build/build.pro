@@ -13,6 +13,8 @@ QMAKE_CXXFLAGS = -std=c++11
 #QMAKE_CXXFLAGS += -DGRAPHICS_DEBUG
 #QMAKE_CXXFLAGS += -DNORMALS_DEBUG
 #QMAKE_CXXFLAGS += -DMESSAGES_DEBUG
+#QMAKE_CXXFLAGS += -DMEMORY_DEBUG
+#QMAKE_CXXFLAGS += -DGLSTATE_DEBUG
 TEMPLATE = app
 TARGET = ../bin/main
 DEPENDPATH += .
@@ -26,6 +28,7 @@ INCLUDEPATH += /usr/include/bullet
 #LIBS += /usr/local/lib/libopencv_calib3d.so /usr/local/lib/libopencv_contrib.so /usr/local/lib/libopencv_core.so /usr/local/lib/libopencv_features2d.so /usr/local/lib/libopencv_flann.so /usr/local/lib/libopencv_gpu.so /usr/local/lib/libopencv_highgui.so /usr/local/lib/libopencv_imgproc.so /usr/local/lib/libopencv_legacy.so /usr/local/lib/libopencv_ml.so /usr/local/lib/libopencv_nonfree.so /usr/local/lib/libopencv_objdetect.so /usr/local/lib/libopencv_photo.so /usr/local/lib/libopencv_stitching.so /usr/local/lib/libopencv_ts.so /usr/local/lib/libopencv_video.so /usr/local/lib/libopencv_videostab.so
 
 CONFIG += warn_on
+CONFIG += thread
 CONFIG += debug
 # copy directory files into temp when compiling not just files
 CONFIG += copy_dir_files
@@ -38,6 +41,11 @@ SOURCES += ../src/debug/*.cpp
 SOURCES += ../src/objects/*.cpp
 SOURCES += ../src/glwrappers/*.cpp
 SOURCES += ../src/bulletwrappers/*.cpp
+SOURCES += ../src/physics/*.cpp
+SOURCES += ../src/memory/*.cpp
+SOURCES += ../src/render/*.cpp
+SOURCES += ../src/replay/*.cpp
+SOURCES += ../src/threading/*.cpp
 SOURCES += ../src/qt/*.cpp
 SOURCES += ../src/main.cpp
 
@@ -48,6 +56,11 @@ HEADERS += ../src/debug/*.hpp
 HEADERS += ../src/objects/*.hpp
 HEADERS += ../src/glwrappers/*.hpp
 HEADERS += ../src/bulletwrappers/*.hpp
+HEADERS += ../src/physics/*.hpp
+HEADERS += ../src/memory/*.hpp
+HEADERS += ../src/render/*.hpp
+HEADERS += ../src/replay/*.hpp
+HEADERS += ../src/threading/*.hpp
 HEADERS += ../src/qt/*.hpp
 HEADERS += ../src/interfaces/*.hpp
 
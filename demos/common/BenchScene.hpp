@@ -0,0 +1,92 @@
+#ifndef BENCHSCENE_HPP
+#define BENCHSCENE_HPP
+
+#include <btBulletDynamicsCommon.h>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// pucks of the benchmarks, a bit smaller than the game's
+const float WALL_HEIGHT = 0.1f;
+const float PUCK_RADIUS = 0.05f;
+const float PUCK_HEIGHT = 0.02f;
+
+// a box of four walls as one static triangle mesh, the table's walls are
+// loaded the same way. Perfectly elastic and without friction.
+struct Rink
+{
+    std::vector<btVector3>                      vertices;
+    std::vector<int>                            indices;
+    std::shared_ptr<btTriangleIndexVertexArray> mesh;
+    std::shared_ptr<btBvhTriangleMeshShape>     shape;
+    std::shared_ptr<btDefaultMotionState>       motionState;
+    std::shared_ptr<btRigidBody>                body;
+
+    void init(float halfWidth, float halfLength)
+    {
+        const float x[5] = { -halfWidth, halfWidth, halfWidth, -halfWidth, -halfWidth };
+        const float z[5] = { -halfLength, -halfLength, halfLength, halfLength, -halfLength };
+        for ( int i = 0; i < 4; ++i )
+        {
+            const int base = vertices.size();
+            vertices.push_back(btVector3(x[i], 0, z[i]));
+            vertices.push_back(btVector3(x[i + 1], 0, z[i + 1]));
+            vertices.push_back(btVector3(x[i + 1], WALL_HEIGHT, z[i + 1]));
+            vertices.push_back(btVector3(x[i], WALL_HEIGHT, z[i]));
+            const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+            for ( int j = 0; j < 6; ++j )
+                indices.push_back(base + quad[j]);
+        }
+
+        mesh = std::shared_ptr<btTriangleIndexVertexArray>(new btTriangleIndexVertexArray(
+                indices.size() / 3, &indices[0], 3 * sizeof(int),
+                vertices.size(), &vertices[0].x(), sizeof(btVector3)));
+        shape = std::shared_ptr<btBvhTriangleMeshShape>(new btBvhTriangleMeshShape(mesh.get(), true));
+        motionState = std::shared_ptr<btDefaultMotionState>(new btDefaultMotionState);
+
+        btRigidBody::btRigidBodyConstructionInfo info(0, motionState.get(), shape.get());
+        info.m_restitution = 1;
+        info.m_friction = 0;
+        body = std::shared_ptr<btRigidBody>(new btRigidBody(info));
+    }
+};
+
+// a puck set up like Puck::initPhysics
+struct TestPuck
+{
+    std::shared_ptr<btCylinderShape>      shape;
+    std::shared_ptr<btDefaultMotionState> motionState;
+    std::shared_ptr<btRigidBody>          body;
+
+    void init(float x, float z, float vx, float vz)
+    {
+        shape = std::shared_ptr<btCylinderShape>(new btCylinderShape(btVector3(PUCK_RADIUS, PUCK_HEIGHT / 2, PUCK_RADIUS)));
+        const btScalar mass = 0.1;
+        btVector3 inertia;
+        shape->calculateLocalInertia(mass, inertia);
+
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3(x, PUCK_HEIGHT / 2, z));
+        motionState = std::shared_ptr<btDefaultMotionState>(new btDefaultMotionState(transform));
+
+        btRigidBody::btRigidBodyConstructionInfo info(mass, motionState.get(), shape.get(), inertia);
+        info.m_restitution = 1;
+        info.m_friction = 0;
+        body = std::shared_ptr<btRigidBody>(new btRigidBody(info));
+        body->setActivationState(DISABLE_DEACTIVATION);
+        body->setLinearFactor(btVector3(1, 0, 1));
+        body->setAngularFactor(btVector3(0, 1, 0));
+        body->setLinearVelocity(btVector3(vx, 0, vz));
+        body->setCcdMotionThreshold(PUCK_RADIUS * 0.5);
+        body->setCcdSweptSphereRadius(PUCK_HEIGHT / 2 * 0.9);
+    }
+
+    bool isInside(float halfWidth, float halfLength) const
+    {
+        const btVector3& p = body->getCenterOfMassPosition();
+        return std::fabs(p.x()) < halfWidth && std::fabs(p.z()) < halfLength;
+    }
+};
+
+#endif // BENCHSCENE_HPP
@@ -0,0 +1,5 @@
+# physics sources the bench demos build with, include from the demo directory
+SOURCES = main.cc ../../src/bulletwrappers/PhysicsWorld.cpp ../../src/bulletwrappers/PhysicsState.cpp ../../src/bulletwrappers/PhysicsTaskScheduler.cpp ../../src/bulletwrappers/TransformBuffer.cpp ../../src/bulletwrappers/DiscBackend.cpp ../../src/physics/DiscWorld.cpp ../../src/threading/ThreadPool.cpp
+
+main: $(SOURCES) ../common/BenchScene.hpp ../common/physics.mk Makefile
+	g++ -std=c++11 -O2 -pthread $(SOURCES) `pkg-config bullet --cflags --libs`
@@ -0,0 +1,196 @@
+#include "../../src/bulletwrappers/PhysicsWorld.hpp"
+#include "../common/BenchScene.hpp"
+
+#include <btBulletDynamicsCommon.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// rink inside the walls and how long each run is
+const float RINK_HALF_WIDTH = 0.5f;
+const float RINK_HALF_LENGTH = 1.0f;
+const double TICK = 1.0 / 60.0;
+const double ACCURACY_SECONDS = 20.0;
+const double THROUGHPUT_SECONDS = 60.0;
+const int THROUGHPUT_PUCKS = 16;
+const double DETERMINISM_SECONDS = 10.0;
+
+const char* backendName(PhysicsWorld::Backend backend)
+{
+    return backend == PhysicsWorld::BULLET_BACKEND ? "bullet" : "discs ";
+}
+
+// where a puck bouncing perfectly between lo and hi is after moving p
+double fold(double p, double lo, double hi)
+{
+    const double length = hi - lo;
+    double q = std::fmod(p - lo, 2.0 * length);
+    if ( q < 0.0 )
+        q += 2.0 * length;
+    return lo + (q <= length ? q : 2.0 * length - q);
+}
+
+// one puck at speed against the exact path of a perfect bounce
+void runAccuracy(PhysicsWorld::Backend backend, float speed)
+{
+    PhysicsWorld world;
+    world.init(backend);
+    world.get()->setGravity(btVector3(0, -10, 0));
+
+    Rink rink;
+    rink.init(RINK_HALF_WIDTH, RINK_HALF_LENGTH);
+    world.addRigidBody(rink.body.get());
+
+    const float vx = speed * 0.6f;
+    const float vz = speed * 0.8f;
+    TestPuck puck;
+    puck.init(0, 0, vx, vz);
+    world.addRigidBody(puck.body.get());
+
+    double maxError = 0.0;
+    bool escaped = false;
+    const int ticks = static_cast<int>(ACCURACY_SECONDS / TICK);
+    for ( int i = 1; i <= ticks && !escaped; ++i )
+    {
+        world.tick(TICK);
+
+        const double t = i * TICK;
+        const double x = fold(vx * t, -RINK_HALF_WIDTH + PUCK_RADIUS, RINK_HALF_WIDTH - PUCK_RADIUS);
+        const double z = fold(vz * t, -RINK_HALF_LENGTH + PUCK_RADIUS, RINK_HALF_LENGTH - PUCK_RADIUS);
+        const btVector3& p = puck.body->getCenterOfMassPosition();
+        maxError = std::max(maxError, std::sqrt((p.x() - x) * (p.x() - x) + (p.z() - z) * (p.z() - z)));
+        escaped = !puck.isInside(RINK_HALF_WIDTH, RINK_HALF_LENGTH);
+    }
+
+    const btVector3 v = puck.body->getLinearVelocity();
+    std::cout << backendName(backend) << "  speed " << speed << " m/s:"
+              << "  max position error " << maxError << " m"
+              << "  speed kept " << 100.0 * v.length() / speed << "%"
+              << (escaped ? "  ESCAPED" : "") << std::endl;
+
+    world.removeRigidBody(puck.body.get());
+    world.removeRigidBody(rink.body.get());
+}
+
+// the same THROUGHPUT_PUCKS pucks every time, scattered over the rink
+void addPucks(PhysicsWorld& world, std::vector<TestPuck>& pucks)
+{
+    std::srand(1);
+    pucks.resize(THROUGHPUT_PUCKS);
+    for ( int i = 0; i < THROUGHPUT_PUCKS; ++i )
+    {
+        const float x = -0.3f + 0.2f * (i % 4);
+        const float z = -0.6f + 0.4f * (i / 4);
+        const float vx = (std::rand() % 200 - 100) * 0.05f;
+        const float vz = (std::rand() % 200 - 100) * 0.05f;
+        pucks[i].init(x, z, vx, vz);
+        world.addRigidBody(pucks[i].body.get());
+    }
+}
+
+// many pucks hitting each other and the walls, simulated seconds per second
+void runThroughput(PhysicsWorld::Backend backend)
+{
+    PhysicsWorld world;
+    world.init(backend);
+    world.get()->setGravity(btVector3(0, -10, 0));
+
+    Rink rink;
+    rink.init(RINK_HALF_WIDTH, RINK_HALF_LENGTH);
+    world.addRigidBody(rink.body.get());
+
+    std::vector<TestPuck> pucks;
+    addPucks(world, pucks);
+
+    const int ticks = static_cast<int>(THROUGHPUT_SECONDS / TICK);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < ticks; ++i )
+        world.tick(TICK);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int escaped = 0;
+    for ( int i = 0; i < THROUGHPUT_PUCKS; ++i )
+    {
+        if ( !pucks[i].isInside(RINK_HALF_WIDTH, RINK_HALF_LENGTH) )
+            ++escaped;
+        world.removeRigidBody(pucks[i].body.get());
+    }
+    world.removeRigidBody(rink.body.get());
+
+    std::cout << backendName(backend) << "  " << THROUGHPUT_PUCKS << " pucks:"
+              << "  " << 1000000.0 * seconds / ticks << " us per tick"
+              << "  " << THROUGHPUT_SECONDS / seconds << "x real time"
+              << "  escaped " << escaped << std::endl;
+}
+
+// deterministic discs fed steady frames and uneven frames of the same total
+// time have to end bit identical
+void runDeterminism()
+{
+    uint64_t hashes[2];
+    for ( int run = 0; run < 2; ++run )
+    {
+        PhysicsWorld world;
+        world.init(PhysicsWorld::DISC_BACKEND);
+        world.setDeterministic(true);
+        world.get()->setGravity(btVector3(0, -10, 0));
+
+        Rink rink;
+        rink.init(RINK_HALF_WIDTH, RINK_HALF_LENGTH);
+        world.addRigidBody(rink.body.get());
+
+        std::vector<TestPuck> pucks;
+        addPucks(world, pucks);
+
+        // the uneven frames are up to half a tick early or late, the last
+        // one catches up
+        std::srand(2);
+        const int ticks = static_cast<int>(DETERMINISM_SECONDS / TICK);
+        double elapsed = 0.0;
+        for ( int i = 1; i <= ticks; ++i )
+        {
+            double end = i * TICK;
+            if ( run == 1 && i < ticks )
+                end += TICK * ((std::rand() % 100) / 100.0 - 0.5);
+            world.tick(end - elapsed);
+            elapsed = end;
+        }
+
+        // half a step more, a rounding difference in the sums can't leave
+        // one run a step behind
+        world.tick(TICK / 2.0);
+        hashes[run] = world.getStateHash();
+
+        for ( int i = 0; i < THROUGHPUT_PUCKS; ++i )
+            world.removeRigidBody(pucks[i].body.get());
+        world.removeRigidBody(rink.body.get());
+    }
+
+    std::cout << "discs   steady and uneven frames: "
+              << (hashes[0] == hashes[1] ? "identical" : "DIFFER") << std::endl;
+}
+
+int main(int, char*[])
+{
+    const PhysicsWorld::Backend backends[2] = { PhysicsWorld::BULLET_BACKEND, PhysicsWorld::DISC_BACKEND };
+    const float speeds[3] = { 2.0f, 10.0f, 50.0f };
+
+    std::cout << "Accuracy, " << ACCURACY_SECONDS << " s against an exact bounce" << std::endl;
+    for ( int i = 0; i < 3; ++i )
+        for ( int j = 0; j < 2; ++j )
+            runAccuracy(backends[j], speeds[i]);
+
+    std::cout << "Throughput, " << THROUGHPUT_SECONDS << " s simulated" << std::endl;
+    for ( int j = 0; j < 2; ++j )
+        runThroughput(backends[j]);
+
+    std::cout << "Determinism, " << DETERMINISM_SECONDS << " s in fixed steps" << std::endl;
+    runDeterminism();
+
+    return 0;
+}
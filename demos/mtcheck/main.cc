@@ -0,0 +1,124 @@
+#include "../../src/bulletwrappers/PhysicsWorld.hpp"
+#include "../common/BenchScene.hpp"
+
+#include <btBulletDynamicsCommon.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// pucks start on a grid this far apart, the rink grows to fit them
+const float PUCK_SPACING = 0.15f;
+const double TICK = 1.0 / 60.0;
+const int TICKS = 600;
+
+struct Run
+{
+    std::vector<uint64_t>  hashes;      // after every tick
+    std::vector<btVector3> positions;   // after the last
+    double                 seconds;
+    bool                   multithreaded;
+};
+
+// the same scene for any number of threads, velocities from the same seed
+Run runScene(unsigned int threads, int pucks)
+{
+    Run run;
+
+    PhysicsWorld world;
+    world.init(PhysicsWorld::BULLET_BACKEND, threads);
+    world.get()->setGravity(btVector3(0, -10, 0));
+    run.multithreaded = world.isMultithreaded();
+
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(pucks))));
+    const float halfSize = side * PUCK_SPACING / 2 + PUCK_RADIUS;
+
+    Rink rink;
+    rink.init(halfSize, halfSize);
+    world.addRigidBody(rink.body.get());
+
+    std::srand(1);
+    std::vector<TestPuck> testPucks(pucks);
+    for ( int i = 0; i < pucks; ++i )
+    {
+        const float x = -halfSize + PUCK_RADIUS + PUCK_SPACING * (i % side + 0.5f);
+        const float z = -halfSize + PUCK_RADIUS + PUCK_SPACING * (i / side + 0.5f);
+        const float vx = (std::rand() % 200 - 100) * 0.02f;
+        const float vz = (std::rand() % 200 - 100) * 0.02f;
+        testPucks[i].init(x, z, vx, vz);
+        world.addRigidBody(testPucks[i].body.get());
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int i = 0; i < TICKS; ++i )
+    {
+        world.tick(TICK);
+        run.hashes.push_back(world.getStateHash());
+    }
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for ( int i = 0; i < pucks; ++i )
+    {
+        run.positions.push_back(testPucks[i].body->getCenterOfMassPosition());
+        world.removeRigidBody(testPucks[i].body.get());
+    }
+    world.removeRigidBody(rink.body.get());
+
+    return run;
+}
+
+// first tick the hashes differ and how far apart the pucks ended up
+void compare(const char* name, const Run& a, const Run& b)
+{
+    int firstDifference = -1;
+    for ( size_t i = 0; i < a.hashes.size() && firstDifference < 0; ++i )
+        if ( a.hashes[i] != b.hashes[i] )
+            firstDifference = i;
+
+    double maxDistance = 0.0;
+    for ( size_t i = 0; i < a.positions.size(); ++i )
+        maxDistance = std::max(maxDistance, static_cast<double>(a.positions[i].distance(b.positions[i])));
+
+    std::cout << name << ": ";
+    if ( firstDifference < 0 )
+        std::cout << "identical for all " << a.hashes.size() << " ticks" << std::endl;
+    else
+        std::cout << "diverged at tick " << firstDifference
+                  << ", pucks up to " << maxDistance << " m apart after " << a.hashes.size() << std::endl;
+}
+
+void report(const char* name, const Run& run)
+{
+    std::cout << name << ": " << 1000.0 * run.seconds / TICKS << " ms per tick" << std::endl;
+}
+
+// usage: main [threads [pucks]], threads 0 (the default) uses every core
+int main(int argc, char* argv[])
+{
+    const unsigned int threads = argc > 1 ? static_cast<unsigned int>(std::max(0, std::atoi(argv[1]))) : 0;
+    const int pucks = argc > 2 ? std::max(1, std::atoi(argv[2])) : 2000;
+
+    std::cout << pucks << " pucks, " << TICKS << " ticks" << std::endl;
+
+    const Run single = runScene(1, pucks);
+    report("single threaded", single);
+
+    const Run multi = runScene(threads, pucks);
+    if ( !multi.multithreaded )
+    {
+        std::cout << "Multithreaded world not available, nothing to compare" << std::endl;
+        return 1;
+    }
+    report("multithreaded  ", multi);
+    std::cout << "speedup " << single.seconds / multi.seconds << "x" << std::endl;
+
+    // the same threads twice shows whether the scheduling itself changes
+    // the result, apart from the different solver
+    const Run again = runScene(threads, pucks);
+    compare("single vs multithreaded", single, multi);
+    compare("multithreaded vs itself", multi, again);
+
+    return 0;
+}
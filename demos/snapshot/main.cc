@@ -0,0 +1,151 @@
+#include "../../src/bulletwrappers/PhysicsState.hpp"
+#include "../../src/bulletwrappers/PhysicsWorld.hpp"
+#include "../common/BenchScene.hpp"
+
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btSerializer.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+const float PUCK_SPACING = 0.15f;
+const double TICK = 1.0 / 60.0;
+
+// ticks before the snapshot and replayed after it
+const int WARMUP_TICKS = 120;
+const int CHECK_TICKS = 300;
+
+// repetitions of each timing
+const int REPEATS = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+// microseconds per call of f
+template <typename F>
+double measure(F f)
+{
+    const Clock::time_point start = Clock::now();
+    for ( int i = 0; i < REPEATS; ++i )
+        f();
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / REPEATS;
+}
+
+// usage: main [pucks [moving]], every moving-th puck is hit, the rest rest
+int main(int argc, char* argv[])
+{
+    const int pucks = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1000;
+    const int moving = argc > 2 ? std::max(1, std::atoi(argv[2])) : 4;
+
+    PhysicsWorld world;
+    world.init();
+    world.get()->setGravity(btVector3(0, -10, 0));
+
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(pucks))));
+    const float halfSize = side * PUCK_SPACING / 2 + PUCK_RADIUS;
+
+    Rink rink;
+    rink.init(halfSize, halfSize);
+    world.addRigidBody(rink.body.get());
+
+    std::srand(1);
+    std::vector<TestPuck> testPucks(pucks);
+    for ( int i = 0; i < pucks; ++i )
+    {
+        const float x = -halfSize + PUCK_RADIUS + PUCK_SPACING * (i % side + 0.5f);
+        const float z = -halfSize + PUCK_RADIUS + PUCK_SPACING * (i / side + 0.5f);
+        const bool hit = i % moving == 0;
+        const float vx = hit ? (std::rand() % 200 - 100) * 0.005f : 0.0f;
+        const float vz = hit ? (std::rand() % 200 - 100) * 0.005f : 0.0f;
+        testPucks[i].init(x, z, vx, vz);
+        world.addRigidBody(testPucks[i].body.get());
+    }
+
+    for ( int i = 0; i < WARMUP_TICKS; ++i )
+        world.tick(TICK);
+
+    std::cout << pucks << " pucks, 1 in " << moving << " moving" << std::endl;
+
+    // restoring the snapshot has to give the same ticks again
+    PhysicsState snapshot;
+    world.saveState(snapshot);
+
+    std::vector<uint64_t> hashes;
+    std::vector<PhysicsState> deltas(CHECK_TICKS);
+    size_t deltaBytes = 0;
+    for ( int i = 0; i < CHECK_TICKS; ++i )
+    {
+        world.tick(TICK);
+        hashes.push_back(world.getStateHash());
+        world.saveState(deltas[i], true);
+        deltaBytes += deltas[i].getSize();
+    }
+
+    if ( !world.restoreState(snapshot) )
+    {
+        std::cout << "Snapshot doesn't fit the world" << std::endl;
+        return 1;
+    }
+    int firstDifference = -1;
+    for ( int i = 0; i < CHECK_TICKS; ++i )
+    {
+        world.tick(TICK);
+        if ( firstDifference < 0 && world.getStateHash() != hashes[i] )
+            firstDifference = i;
+    }
+    if ( firstDifference < 0 )
+        std::cout << "restored: identical for all " << CHECK_TICKS << " ticks" << std::endl;
+    else
+        std::cout << "restored: diverged at tick " << firstDifference << std::endl;
+
+    // the snapshot and the deltas after it seek to any tick
+    const int seek = CHECK_TICKS / 2;
+    world.restoreState(snapshot);
+    for ( int i = 0; i <= seek; ++i )
+        world.restoreState(deltas[i]);
+    std::cout << "seek to tick " << seek << " through the deltas: "
+              << (world.getStateHash() == hashes[seek] ? "matches" : "differs") << std::endl;
+
+    std::cout << "whole snapshot " << snapshot.getSize() << " bytes, incremental "
+              << deltaBytes / CHECK_TICKS << " bytes on average" << std::endl;
+
+    // the same state over and over, nothing changes between the saves
+    world.restoreState(snapshot);
+    PhysicsState state;
+    const double saveTime = measure([&]() { world.saveState(state); });
+    const double restoreTime = measure([&]() { world.restoreState(snapshot); });
+
+    // an incremental save after each tick, the usual way to keep a history
+    world.saveState(state);
+    double incrementalTime = 0.0;
+    for ( int i = 0; i < REPEATS; ++i )
+    {
+        world.tick(TICK);
+        const Clock::time_point start = Clock::now();
+        world.saveState(state, true);
+        incrementalTime += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+    incrementalTime /= REPEATS;
+
+    // bullet's serializer also writes the shapes, what a snapshot needn't,
+    // and its buffer can only be read back by the world importer
+    int serializedSize = 0;
+    const double serializerTime = measure([&]() {
+        btDefaultSerializer serializer;
+        world.get()->serialize(&serializer);
+        serializedSize = serializer.getCurrentBufferSize();
+    });
+
+    std::cout << "saveState                 " << saveTime << " us" << std::endl;
+    std::cout << "saveState incremental     " << incrementalTime << " us" << std::endl;
+    std::cout << "restoreState              " << restoreTime << " us" << std::endl;
+    std::cout << "btDefaultSerializer       " << serializerTime << " us, " << serializedSize << " bytes" << std::endl;
+
+    for ( int i = 0; i < pucks; ++i )
+        world.removeRigidBody(testPucks[i].body.get());
+    world.removeRigidBody(rink.body.get());
+
+    return firstDifference < 0 ? 0 : 1;
+}
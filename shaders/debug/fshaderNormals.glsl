@@ -1,10 +0,0 @@
-#version 410
-
-// it doesn't get any simpler than this
-out vec4 out_color;
-
-void main()
-{
-    out_color = vec4(1.0, 0.0, 0.0, 1.0);    
-}
-
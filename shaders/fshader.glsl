@@ -1,9 +1,91 @@
 #version 410
 
+// Source of every variant (see ShaderPermutations.hpp), the features:
+//   TEXTURE_DIFFUSE  blend u_diffuseMap into the diffuse color
+//   INDIRECT         material from the draw data (see vshader.glsl)
+//   CLUSTERED        lights from LightClusters instead of the Lights block
+//   LIGHT_COUNT      loop over exactly this many lights of the Lights block
+//   DEPTH_ONLY       nothing, the pre-pass only writes depth
+//   WIREFRAME        mix in the edges from gshaderWireframe.glsl
+//   NORMALS          solid color for the lines of gshaderNormals.glsl
+
+#if defined(DEPTH_ONLY)
+
+// depth only, color writes are masked off during the pre-pass
+void main()
+{
+}
+
+#elif defined(NORMALS)
+
+// it doesn't get any simpler than this
+out vec4 out_color;
+
+void main()
+{
+    out_color = vec4(1.0, 0.0, 0.0, 1.0);
+}
+
+#else
+
 // fragment properties
 in vec3 f_normal;
 in vec3 f_position;
+#ifdef TEXTURE_DIFFUSE
+in vec2 f_uvCoord;
+#endif
+#ifdef WIREFRAME
+noperspective in vec3 f_coords;
+#endif
 
+#ifdef INDIRECT
+// material properties (from the draw data, see vshader.glsl)
+in MaterialData
+{
+    flat vec3  diffuse;
+    flat vec3  specular;
+    flat vec3  ambient;
+    flat float shininess;
+    flat float texBlend;
+} material;
+#else
+// material properties
+layout(std140) uniform Material
+{
+    uniform vec3  diffuse;
+    uniform vec3  specular;
+    uniform vec3  ambient;
+    uniform float shininess;
+    uniform float texBlend;
+} material;
+#endif
+
+#ifdef TEXTURE_DIFFUSE
+uniform sampler2D u_diffuseMap;
+
+// textured surfaces are never darker than this and have tighter highlights
+const float MIN_AMBIENT = 0.3;
+const float MIN_SHININESS = 18.0;
+#else
+const float MIN_AMBIENT = 0.0;
+const float MIN_SHININESS = 2.0;
+#endif
+
+// attenuation (constant, linear, quadratic)
+// attenuation = 1/(x + y*d + z*d*d)
+// Things are BRIGHTER the closer the coefficient is to 1
+const vec3 ATTENUATION_COEF = vec3(0.1, 0.0, 0.98);
+
+#ifdef CLUSTERED
+// clustered lights (see LightClusters.hpp)
+uniform usamplerBuffer u_clusterGrid;      // light offset and count per cluster
+uniform usamplerBuffer u_clusterIndices;   // light indices of every cluster
+uniform samplerBuffer  u_clusterLights;    // position and range, diffuse, specular, ambient
+uniform vec4           u_clusterViewport;  // x, y, width, height in pixels
+uniform vec2           u_clusterSlices;    // slice = log(depth) * x + y
+
+const ivec3 CLUSTER_DIM = ivec3(16, 9, 24);
+#else
 struct LightInfo
 {
     vec3 position;
@@ -12,50 +94,34 @@ struct LightInfo
     vec3 ambient;
 };
 
-// light properties
+// light properties, padded with black lights up to LIGHT_COUNT
 layout(std140) uniform Lights
 {
     uniform int count;
     uniform LightInfo info[8];
 } lights;
 
-// material properties
-layout(std140) uniform Material
-{
-    uniform vec3  diffuse;
-    uniform vec3  specular;
-    uniform vec3  ambient;
-    uniform float shininess;
-    uniform float texBlend;
-} material;
+// the forward lights are never attenuated by distance, untextured surfaces
+// are dimmed by the attenuation at distance 1
+#ifdef TEXTURE_DIFFUSE
+const float FORWARD_ATTENUATION = 1.0;
+#else
+const float FORWARD_ATTENUATION = 1.0 / (ATTENUATION_COEF.x + ATTENUATION_COEF.y + ATTENUATION_COEF.z);
+#endif
+#endif
 
 // output color
 out vec4 out_color;
 
-// attenuation (constant, linear, quadratic)
-// attenuation = 1/(x + y*d + z*d*d)
-// Things are BRIGHTER the closer the coefficient is to 1
-const vec3 ATTENUATION_COEF = vec3(0.1, 0.0, 0.98);
-
-vec3 computeLighting(int idx)
+// Blinn-Phong for one light, L is the direction to the light
+vec3 computeLighting(vec3 L, vec3 N, vec3 V, vec3 kd, vec3 id, vec3 is, vec3 ia)
 {
-    vec3 V = normalize(-f_position);
-    vec3 L = normalize(lights.info[idx].position - f_position);
-    vec3 N = normalize(f_normal);
     vec3 H = normalize(L + V);
 
-    vec3 kd = material.diffuse;
     vec3 ks = material.specular;
-    vec3 ka = material.ambient;
+    vec3 ka = max(material.ambient, MIN_AMBIENT);
     float a = material.shininess;
 
-    float dist = length(L);
-    float attenuation = clamp(0.0, 1.0, 1.0/(
-            ATTENUATION_COEF.x +
-            ATTENUATION_COEF.y * dist +
-            ATTENUATION_COEF.z * dist * dist
-    ));
-
     // remove specular highlight if light is behind face
     //if( dot(L, N) < 0.0 )
     //    ks = vec3(0.0, 0.0, 0.0);
@@ -63,19 +129,81 @@ vec3 computeLighting(int idx)
     float t = dot(L,N);
     ks *= max(t,0.0)/max(t,1e-10);
 
-    vec3 id = lights.info[idx].diffuse;
-    vec3 is = lights.info[idx].specular;
-    vec3 ia = lights.info[idx].ambient;
+    return ka*ia + kd*max(t,0)*id + ks*pow(max(dot(H,N),0.0),max(a,MIN_SHININESS))*is;
+}
 
-    vec3 Ip = ka*ia + kd*max(dot(L,N),0)*id + ks*pow(max(dot(H,N),0.0),max(a,2))*is;
-    
-    return Ip*attenuation;
+#ifdef CLUSTERED
+int clusterIndex()
+{
+    vec2 tile = (gl_FragCoord.xy - u_clusterViewport.xy) / u_clusterViewport.zw * vec2(CLUSTER_DIM.xy);
+    int slice = int(floor(log(-f_position.z) * u_clusterSlices.x + u_clusterSlices.y));
+    ivec3 cluster = clamp(ivec3(ivec2(tile), slice), ivec3(0), CLUSTER_DIM - 1);
+    return cluster.x + CLUSTER_DIM.x * (cluster.y + CLUSTER_DIM.y * cluster.z);
+}
+
+vec3 computeClusteredLighting(int light, vec3 N, vec3 V, vec3 kd)
+{
+    vec4 positionRange = texelFetch(u_clusterLights, light * 4);
+    vec3 id = texelFetch(u_clusterLights, light * 4 + 1).xyz;
+    vec3 is = texelFetch(u_clusterLights, light * 4 + 2).xyz;
+    vec3 ia = texelFetch(u_clusterLights, light * 4 + 3).xyz;
+
+    vec3 toLight = positionRange.xyz - f_position;
+    float dist = length(toLight);
+
+    // fade to 0 at the range the light was clustered with
+    float fade = clamp(1.0 - pow(dist / positionRange.w, 4.0), 0.0, 1.0);
+    float attenuation = fade * fade * clamp(1.0/(
+            ATTENUATION_COEF.x +
+            ATTENUATION_COEF.y * dist +
+            ATTENUATION_COEF.z * dist * dist
+    ), 0.0, 1.0);
+
+    return computeLighting(toLight / max(dist, 1e-5), N, V, kd, id, is, ia) * attenuation;
 }
+#endif
 
 void main()
 {
+    vec3 V = normalize(-f_position);
+    vec3 N = normalize(f_normal);
+
+#ifdef TEXTURE_DIFFUSE
+    // blend texture with diffuse color
+    vec4 texD = texture(u_diffuseMap, f_uvCoord);
+    vec3 kd = mix(material.diffuse, texD.xyz, material.texBlend * texD.w);
+#else
+    vec3 kd = material.diffuse;
+#endif
+
     vec3 finalColor = vec3(0.0, 0.0, 0.0);
+#ifdef CLUSTERED
+    uvec2 cluster = texelFetch(u_clusterGrid, clusterIndex()).xy;
+    for ( uint i = 0u; i < cluster.y; ++i )
+        finalColor += computeClusteredLighting(int(texelFetch(u_clusterIndices, int(cluster.x + i)).x), N, V, kd);
+#else
+#ifdef LIGHT_COUNT
+    // a constant bound, the loop can be unrolled
+    for ( int i = 0; i < LIGHT_COUNT; ++i )
+#else
     for ( int i = 0; i < lights.count; ++i )
-        finalColor = finalColor + computeLighting(i);
+#endif
+    {
+        vec3 L = normalize(lights.info[i].position - f_position);
+        finalColor += computeLighting(L, N, V, kd, lights.info[i].diffuse, lights.info[i].specular,
+                                      lights.info[i].ambient);
+    }
+    finalColor *= FORWARD_ATTENUATION;
+#endif
+
+#ifdef WIREFRAME
+    // determine mixing amount based on distance to closest edge
+    float d = min(f_coords[0], min(f_coords[1], f_coords[2]));
+    float I = exp2(-2.0*d*d);
+    finalColor = mix(finalColor, vec3(1.0, 1.0, 1.0), I);
+#endif
+
     out_color = vec4(finalColor, 1.0);
 }
+
+#endif
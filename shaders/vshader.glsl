@@ -1,8 +1,33 @@
 #version 410
 
+// Source of every variant (see ShaderPermutations.hpp), the features:
+//   TEXTURE_DIFFUSE  pass the uv coordinates on
+//   INDIRECT         matrices and material from the draw data
+//   DEPTH_ONLY       position only, for the depth pre-pass
+//   WIREFRAME        outputs go to gshaderWireframe.glsl
+//   NORMALS          untransformed outputs for gshaderNormals.glsl
+
 layout(location=0) in vec3 v_position;
+#ifndef DEPTH_ONLY
 layout(location=1) in vec3 v_normal;
+#endif
+#ifdef TEXTURE_DIFFUSE
+layout(location=2) in vec2 v_uvCoord;
+#endif
+
+#ifdef INDIRECT
+layout(location=6) in float v_drawId;   // baseInstance of the indirect draw
 
+// per draw records written by IndirectRenderer (IndirectDrawData)
+//   0-3   mvpMatrix
+//   4-7   mvMatrix
+//   8-11  normalMatrix = transpose(inverse(mvMatrix))
+//   12    diffuse, shininess
+//   13    specular, texBlend
+//   14    ambient
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 15;
+#else
 // normalMatrix = transpose(inverse(mvMatrix))
 layout(std140) uniform Matrices
 {
@@ -10,15 +35,87 @@ layout(std140) uniform Matrices
     uniform mat4 mvMatrix;
     uniform mat4 normalMatrix;
 } matrices;
+#endif
+
+// the geometry shader sits between this and the fragment shader
+#ifdef WIREFRAME
+#define f_position g_position
+#define f_normal   g_normal
+#define f_uvCoord  g_uvCoord
+#endif
 
+#if defined(NORMALS)
+out vec3 g_normal;
+#elif !defined(DEPTH_ONLY)
 out vec3 f_position;
 out vec3 f_normal;
+#ifdef TEXTURE_DIFFUSE
+out vec2 f_uvCoord;
+#endif
+#ifdef INDIRECT
+out MaterialData
+{
+    flat vec3  diffuse;
+    flat vec3  specular;
+    flat vec3  ambient;
+    flat float shininess;
+    flat float texBlend;
+} material;
+#endif
+#endif
+
+// the depth pre-pass and the lit passes test depth with GL_EQUAL, every
+// variant must compute the same position bit for bit
+invariant gl_Position;
+
+#ifdef INDIRECT
+mat4 fetchMatrix(int base)
+{
+    return mat4(texelFetch(u_drawData, base),
+                texelFetch(u_drawData, base + 1),
+                texelFetch(u_drawData, base + 2),
+                texelFetch(u_drawData, base + 3));
+}
+#endif
 
 void main()
 {
+#ifdef NORMALS
+    // gshaderNormals.glsl transforms both ends of each line
+    g_normal = normalize(v_normal);
+    gl_Position = vec4(v_position,1.0);
+#else
+#ifdef INDIRECT
+    int base = int(v_drawId) * DRAW_DATA_TEXELS;
+    mat4 mvpMatrix = fetchMatrix(base);
+#else
+    mat4 mvpMatrix = matrices.mvpMatrix;
+#endif
+    gl_Position = mvpMatrix * vec4(v_position,1.0);
+
+#ifndef DEPTH_ONLY
+#ifdef INDIRECT
+    mat4 mvMatrix = fetchMatrix(base + 4);
+    mat4 normalMatrix = fetchMatrix(base + 8);
+
+    vec4 diffuse = texelFetch(u_drawData, base + 12);
+    vec4 specular = texelFetch(u_drawData, base + 13);
+    material.diffuse = diffuse.xyz;
+    material.shininess = diffuse.w;
+    material.specular = specular.xyz;
+    material.texBlend = specular.w;
+    material.ambient = texelFetch(u_drawData, base + 14).xyz;
+#else
+    mat4 mvMatrix = matrices.mvMatrix;
+    mat4 normalMatrix = matrices.normalMatrix;
+#endif
+
     // we want the position and normal in view coordinates not projection
-    f_position = (matrices.mvMatrix * vec4(v_position,1.0)).xyz;
-    f_normal = normalize(matrices.normalMatrix * vec4(v_normal,1.0)).xyz;
-    gl_Position = matrices.mvpMatrix * vec4(v_position,1.0);
+    f_position = (mvMatrix * vec4(v_position,1.0)).xyz;
+    f_normal = normalize(normalMatrix * vec4(v_normal,1.0)).xyz;
+#ifdef TEXTURE_DIFFUSE
+    f_uvCoord = v_uvCoord;
+#endif
+#endif
+#endif
 }
-
@@ -0,0 +1,249 @@
+#include "DiscBackend.hpp"
+
+#include <bullet/btBulletDynamicsCommon.h>
+#include <bullet/btBulletCollisionCommon.h>
+
+#include <cmath>
+#include <iostream>
+
+// collects where the triangles of a mesh cross a horizontal plane
+class PlaneSlicer : public btTriangleCallback
+{
+public:
+    PlaneSlicer(DiscWorld& world, const btTransform& transform, float height, const DiscWorld::Segment& material) :
+        m_world(world),
+        m_transform(transform),
+        m_height(height),
+        m_material(material)
+    {}
+
+    virtual void processTriangle(btVector3* triangle, int, int)
+    {
+        btVector3 vertices[3];
+        for ( int i = 0; i < 3; ++i )
+            vertices[i] = m_transform(triangle[i]);
+
+        // a vertex on the plane counts as above, so an edge crosses when
+        // exactly one end is below
+        btVector3 crossings[2];
+        int count = 0;
+        for ( int i = 0; i < 3; ++i )
+        {
+            const btVector3& a = vertices[i];
+            const btVector3& b = vertices[(i + 1) % 3];
+            const btScalar ha = a.y() - m_height;
+            const btScalar hb = b.y() - m_height;
+            if ( (ha < 0) == (hb < 0) || count == 2 )
+                continue;
+            crossings[count++] = a + (b - a) * (ha / (ha - hb));
+        }
+        if ( count != 2 )
+            return;
+
+        DiscWorld::Segment segment = m_material;
+        segment.ax = crossings[0].x();
+        segment.az = crossings[0].z();
+        segment.bx = crossings[1].x();
+        segment.bz = crossings[1].z();
+        m_world.addSegment(segment);
+    }
+protected:
+    DiscWorld&         m_world;
+    btTransform        m_transform;
+    float              m_height;
+    DiscWorld::Segment m_material;
+};
+
+DiscBackend::DiscBackend() :
+    m_segmentsDirty(true),
+    m_warnedIgnored(false),
+    m_warnedSaturated(false)
+{}
+
+void DiscBackend::addBody(btRigidBody* body)
+{
+    const btCollisionShape* shape = body->getCollisionShape();
+
+    if ( body->isStaticObject() && shape->isConcave() )
+    {
+        m_walls.push_back(body);
+        m_segmentsDirty = true;
+        return;
+    }
+
+    if ( shape->getShapeType() == CYLINDER_SHAPE_PROXYTYPE && static_cast<const btCylinderShape*>(shape)->getUpAxis() == 1 )
+    {
+        const btCylinderShape* cylinder = static_cast<const btCylinderShape*>(shape);
+
+        DiscWorld::Disc disc;
+        disc.radius = cylinder->getRadius();
+        disc.invMass = body->getInvMass();
+        disc.invInertia = body->getInvInertiaDiagLocal().y();
+        disc.restitution = body->getRestitution();
+        disc.friction = body->getFriction();
+        disc.linearDamping = body->getLinearDamping();
+        disc.angularDamping = body->getAngularDamping();
+        disc.x = disc.z = disc.vx = disc.vz = disc.angle = disc.spin = 0.0f;
+
+        BodyDisc bodyDisc;
+        bodyDisc.body = body;
+        bodyDisc.disc = m_world.addDisc(disc);
+        bodyDisc.x = bodyDisc.z = bodyDisc.angle = 0.0f;
+        m_discs.push_back(bodyDisc);
+
+        // the first disc sets the height of the walls
+        if ( m_discs.size() == 1 )
+            m_segmentsDirty = true;
+        return;
+    }
+
+    if ( !m_warnedIgnored )
+    {
+        std::cout << "Warning: Disc physics only moves upright cylinders against static meshes, other bodies are ignored" << std::endl;
+        m_warnedIgnored = true;
+    }
+}
+
+void DiscBackend::removeBody(btRigidBody* body)
+{
+    for ( size_t i = 0; i < m_walls.size(); ++i )
+    {
+        if ( m_walls[i] == body )
+        {
+            m_walls.erase(m_walls.begin() + i);
+            m_segmentsDirty = true;
+            return;
+        }
+    }
+
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        if ( m_discs[i].body == body )
+        {
+            m_world.removeDisc(m_discs[i].disc);
+            m_discs.erase(m_discs.begin() + i);
+            if ( i == 0 )
+                m_segmentsDirty = true;
+            return;
+        }
+    }
+}
+
+void DiscBackend::setDeterministic(bool deterministic, double timeStep)
+{
+    m_world.setDeterministic(deterministic, timeStep);
+}
+
+void DiscBackend::tick(double dt)
+{
+    if ( m_discs.empty() )
+        return;
+
+    // walls are built once the discs are in, the table loads first
+    if ( m_segmentsDirty )
+    {
+        this->buildSegments(m_discs[0].body->getCenterOfMassPosition().y());
+        m_segmentsDirty = false;
+    }
+
+    this->readBodies();
+    m_world.tick(dt);
+    this->writeBodies();
+
+    if ( m_world.isSaturated() && !m_warnedSaturated )
+    {
+        std::cout << "Warning: Disc physics hit " << MAX_DISC_EVENTS << " collisions in one step" << std::endl;
+        m_warnedSaturated = true;
+    }
+}
+
+double DiscBackend::getRemainder() const
+{
+    return m_world.getRemainder();
+}
+
+void DiscBackend::setRemainder(double remainder)
+{
+    m_world.setRemainder(remainder);
+}
+
+const DiscWorld& DiscBackend::getWorld() const
+{
+    return m_world;
+}
+
+void DiscBackend::buildSegments(float height)
+{
+    m_world.clearSegments();
+
+    const btVector3 aabbMin(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    const btVector3 aabbMax(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+    for ( size_t i = 0; i < m_walls.size(); ++i )
+    {
+        btRigidBody* wall = m_walls[i];
+
+        DiscWorld::Segment material;
+        material.restitution = wall->getRestitution();
+        material.friction = wall->getFriction();
+
+        PlaneSlicer slicer(m_world, wall->getWorldTransform(), height, material);
+        static_cast<const btConcaveShape*>(wall->getCollisionShape())->processAllTriangles(&slicer, aabbMin, aabbMax);
+    }
+
+    if ( m_world.getSegmentCount() == 0 && !m_walls.empty() )
+        std::cout << "Warning: No walls cross the height of the discs" << std::endl;
+}
+
+void DiscBackend::readBodies()
+{
+    // the game may have moved or pushed a body since the last tick
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        const btRigidBody* body = m_discs[i].body;
+        DiscWorld::Disc& disc = m_world.getDisc(m_discs[i].disc);
+
+        const btTransform& transform = body->getCenterOfMassTransform();
+        disc.x = transform.getOrigin().x();
+        disc.z = transform.getOrigin().z();
+
+        // the angle doesn't survive the trip through the quaternion exactly,
+        // only read it back if the body was turned since writeBodies
+        btMatrix3x3 written;
+        written.setRotation(btQuaternion(btVector3(0, 1, 0), disc.angle));
+        if ( !(transform.getBasis() == written) )
+        {
+            const btQuaternion rotation = transform.getRotation();
+            disc.angle = 2.0f * std::atan2(rotation.y(), rotation.w());
+        }
+
+        m_discs[i].x = disc.x;
+        m_discs[i].z = disc.z;
+        m_discs[i].angle = disc.angle;
+
+        disc.vx = body->getLinearVelocity().x();
+        disc.vz = body->getLinearVelocity().z();
+        disc.spin = body->getAngularVelocity().y();
+    }
+}
+
+void DiscBackend::writeBodies()
+{
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        btRigidBody* body = m_discs[i].body;
+        const DiscWorld::Disc& disc = m_world.getDisc(m_discs[i].disc);
+
+        btTransform transform;
+        transform.setOrigin(btVector3(disc.x, body->getCenterOfMassPosition().y(), disc.z));
+        transform.setRotation(btQuaternion(btVector3(0, 1, 0), disc.angle));
+        body->setCenterOfMassTransform(transform);
+        body->setLinearVelocity(btVector3(disc.vx, 0, disc.vz));
+        body->setAngularVelocity(btVector3(0, disc.spin, 0));
+
+        // only moved bodies go to their motion state, like bullet's sleeping
+        // ones don't
+        const bool moved = disc.x != m_discs[i].x || disc.z != m_discs[i].z || disc.angle != m_discs[i].angle;
+        if ( moved && body->getMotionState() != nullptr )
+            body->getMotionState()->setWorldTransform(transform);
+    }
+}
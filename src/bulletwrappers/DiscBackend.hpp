@@ -0,0 +1,59 @@
+#ifndef DISCBACKEND_HPP
+#define DISCBACKEND_HPP
+
+#include "../physics/DiscWorld.hpp"
+
+#include <vector>
+
+class btRigidBody;
+
+// Steps the bodies of a PhysicsWorld with a DiscWorld instead of bullet.
+//
+// Upright cylinders (y axis) become discs and static triangle meshes become
+// walls: the segments where the mesh crosses the plane through the center
+// of the first disc. The bodies stay the handles of the game, every tick
+// reads their transforms and velocities, steps the discs and writes them
+// back, so anything set on a btRigidBody still takes effect. Motion along y
+// and rotation about anything but y are dropped, what the puck's linear and
+// angular factors already allow.
+class DiscBackend
+{
+public:
+    DiscBackend();
+
+    void addBody(btRigidBody* body);
+    void removeBody(btRigidBody* body);
+
+    // fixed steps of timeStep and no SIMD (see DiscWorld)
+    void setDeterministic(bool deterministic, double timeStep);
+
+    void tick(double dt);
+
+    // time not stepped yet (deterministic only, see DiscWorld)
+    double getRemainder() const;
+    void setRemainder(double remainder);
+
+    const DiscWorld& getWorld() const;
+protected:
+    struct BodyDisc
+    {
+        btRigidBody* body;
+        size_t       disc;
+        float        x, z, angle;   // as read before the step
+    };
+
+    // the segments of every wall at the height of the discs
+    void buildSegments(float height);
+
+    void readBodies();
+    void writeBodies();
+
+    DiscWorld                 m_world;
+    std::vector<BodyDisc>     m_discs;
+    std::vector<btRigidBody*> m_walls;
+    bool                      m_segmentsDirty;
+    bool                      m_warnedIgnored;
+    bool                      m_warnedSaturated;
+};
+
+#endif // DISCBACKEND_HPP
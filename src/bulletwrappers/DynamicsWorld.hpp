@@ -0,0 +1,42 @@
+#ifndef DYNAMICSWORLD_HPP
+#define DYNAMICSWORLD_HPP
+
+#include <bullet/LinearMath/btScalar.h>
+
+#include <utility>
+
+// The part of the last ticks that was too short for a step, which bullet
+// keeps protected in btDiscreteDynamicsWorld. A saved state has to carry it
+// for the next tick to step the same way.
+class LocalTimeWorld
+{
+public:
+    virtual ~LocalTimeWorld() {}
+
+    virtual btScalar getLocalTime() const = 0;
+    virtual void setLocalTime(btScalar localTime) = 0;
+};
+
+// btDiscreteDynamicsWorld or btDiscreteDynamicsWorldMt with its local time
+// exposed, constructed with the arguments of World
+template <typename World>
+class DynamicsWorld : public World, public LocalTimeWorld
+{
+public:
+    template <typename... Args>
+    explicit DynamicsWorld(Args&&... args) :
+        World(std::forward<Args>(args)...)
+    {}
+
+    virtual btScalar getLocalTime() const
+    {
+        return this->m_localTime;
+    }
+
+    virtual void setLocalTime(btScalar localTime)
+    {
+        this->m_localTime = localTime;
+    }
+};
+
+#endif // DYNAMICSWORLD_HPP
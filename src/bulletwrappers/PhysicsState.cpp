@@ -0,0 +1,76 @@
+#include "PhysicsState.hpp"
+
+#include <cstring>
+
+PhysicsState::PhysicsState()
+{}
+
+const void* PhysicsState::getData() const
+{
+    return m_data.empty() ? nullptr : &m_data[0];
+}
+
+size_t PhysicsState::getSize() const
+{
+    if ( m_data.empty() )
+        return 0;
+    const Header& header = this->getHeader();
+    return sizeof(Header) + header.bodyCount * sizeof(BodyState) + header.manifoldCount * sizeof(ManifoldState);
+}
+
+void PhysicsState::setData(const void* data, size_t size)
+{
+    m_data.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    if ( size > 0 )
+        std::memcpy(&m_data[0], data, size);
+}
+
+void PhysicsState::resize(size_t bodyCount, size_t manifoldCount)
+{
+    const bool fresh = m_data.empty();
+    const size_t size = sizeof(Header) + bodyCount * sizeof(BodyState) + manifoldCount * sizeof(ManifoldState);
+
+    // capacity is kept, saving every tick doesn't allocate
+    m_data.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    if ( fresh )
+        std::memset(&m_data[0], 0, sizeof(Header));
+
+    Header& header = this->getHeader();
+    header.bodyCount = bodyCount;
+    header.manifoldCount = manifoldCount;
+}
+
+bool PhysicsState::empty() const
+{
+    return m_data.empty();
+}
+
+PhysicsState::Header& PhysicsState::getHeader()
+{
+    return *reinterpret_cast<Header*>(&m_data[0]);
+}
+
+const PhysicsState::Header& PhysicsState::getHeader() const
+{
+    return *reinterpret_cast<const Header*>(&m_data[0]);
+}
+
+PhysicsState::BodyState* PhysicsState::getBodies()
+{
+    return reinterpret_cast<BodyState*>(reinterpret_cast<char*>(&m_data[0]) + sizeof(Header));
+}
+
+const PhysicsState::BodyState* PhysicsState::getBodies() const
+{
+    return reinterpret_cast<const BodyState*>(reinterpret_cast<const char*>(&m_data[0]) + sizeof(Header));
+}
+
+PhysicsState::ManifoldState* PhysicsState::getManifolds()
+{
+    return reinterpret_cast<ManifoldState*>(this->getBodies() + this->getHeader().bodyCount);
+}
+
+const PhysicsState::ManifoldState* PhysicsState::getManifolds() const
+{
+    return reinterpret_cast<const ManifoldState*>(this->getBodies() + this->getHeader().bodyCount);
+}
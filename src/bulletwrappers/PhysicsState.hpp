@@ -0,0 +1,107 @@
+#ifndef PHYSICSSTATE_HPP
+#define PHYSICSSTATE_HPP
+
+#include <bullet/LinearMath/btScalar.h>
+#include <bullet/LinearMath/btTransform.h>
+#include <bullet/LinearMath/btVector3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// contact points a bullet manifold holds (MANIFOLD_CACHE_SIZE)
+const int STATE_MANIFOLD_POINTS = 4;
+
+// A snapshot of a PhysicsWorld (see PhysicsWorld::saveState) in one flat
+// block of plain records: a header, the dynamic bodies, then the contact
+// manifolds. There are no pointers in it, the block can be copied with
+// memcpy, kept in a ring of snapshots or written to disk and handed back to
+// setData on the same scene.
+//
+// Bodies are identified by their index in the world's collision objects, so
+// a snapshot only fits a world with the same bodies added in the same order.
+// An incremental snapshot holds only the bodies that changed since the save
+// before it and is restored on top of that one.
+class PhysicsState
+{
+public:
+    struct Header
+    {
+        uint32_t objectCount;       // collision objects in the world
+        uint32_t bodyCount;         // records that follow
+        uint32_t manifoldCount;
+        uint32_t incremental;
+        double   remainder;         // time kept for the next tick
+    };
+
+    // what the integration and the motion states read back from a body
+    struct BodyState
+    {
+        btTransformData worldTransform;
+        btTransformData interpolationWorldTransform;
+        btVector3Data   linearVelocity;
+        btVector3Data   angularVelocity;
+        btVector3Data   interpolationLinearVelocity;
+        btVector3Data   interpolationAngularVelocity;
+        btScalar        deactivationTime;
+        btScalar        hitFraction;
+        int32_t         activationState;
+        uint32_t        index;      // in the world's collision objects
+    };
+
+    // what the solver warm starts from
+    struct ContactState
+    {
+        btVector3Data localPointA;
+        btVector3Data localPointB;
+        btVector3Data positionWorldOnA;
+        btVector3Data positionWorldOnB;
+        btVector3Data normalWorldOnB;
+        btVector3Data lateralFrictionDir1;
+        btVector3Data lateralFrictionDir2;
+        btScalar      distance;
+        btScalar      combinedFriction;
+        btScalar      combinedRollingFriction;
+        btScalar      combinedRestitution;
+        btScalar      appliedImpulse;
+        btScalar      appliedImpulseLateral1;
+        btScalar      appliedImpulseLateral2;
+        int32_t       partId0, partId1;
+        int32_t       index0, index1;
+        int32_t       lifeTime;
+    };
+
+    struct ManifoldState
+    {
+        uint32_t     body0;         // indices like BodyState::index
+        uint32_t     body1;
+        int32_t      pointCount;
+        ContactState points[STATE_MANIFOLD_POINTS];
+    };
+
+    PhysicsState();
+
+    // the whole snapshot as one block
+    const void* getData() const;
+    size_t getSize() const;
+    void setData(const void* data, size_t size);
+
+    // lay out room for the records, the header is kept and the records are
+    // left as they were
+    void resize(size_t bodyCount, size_t manifoldCount);
+
+    // a state that was never saved or set has no bodies and doesn't restore
+    bool empty() const;
+
+    Header& getHeader();
+    const Header& getHeader() const;
+    BodyState* getBodies();
+    const BodyState* getBodies() const;
+    ManifoldState* getManifolds();
+    const ManifoldState* getManifolds() const;
+protected:
+    // 8 byte words keep the doubles in the records aligned
+    std::vector<uint64_t> m_data;
+};
+
+#endif // PHYSICSSTATE_HPP
@@ -0,0 +1,102 @@
+#include "PhysicsTaskScheduler.hpp"
+
+#if BULLET_HAS_TASK_SCHEDULER
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+PhysicsTaskScheduler::PhysicsTaskScheduler() :
+    btITaskScheduler("PhysicsTaskScheduler"),
+    m_numThreads(1),
+    m_running(false),
+    m_loopCount(0)
+{}
+
+// a loop that does nothing, for isReachable
+class EmptyLoop : public btIParallelForBody
+{
+public:
+    virtual void forLoop(int, int) const {}
+};
+
+PhysicsTaskScheduler& PhysicsTaskScheduler::get()
+{
+    static PhysicsTaskScheduler scheduler;
+    return scheduler;
+}
+
+int PhysicsTaskScheduler::getMaxNumThreads() const
+{
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::min(cores, static_cast<int>(BT_MAX_THREAD_COUNT));
+}
+
+int PhysicsTaskScheduler::getNumThreadsUsed() const
+{
+    return m_numThreads;
+}
+
+void PhysicsTaskScheduler::setNumThreadsUsed(int numThreads)
+{
+    numThreads = std::max(1, std::min(numThreads, this->getMaxNumThreads()));
+    if ( numThreads == m_numThreads && m_pool )
+        return;
+
+    // the caller is the last thread, one worker means a pool of 2
+    m_numThreads = numThreads;
+    m_pool.reset();
+    if ( numThreads > 1 )
+        m_pool = std::unique_ptr<ThreadPool>(new ThreadPool(numThreads - 1));
+}
+
+void PhysicsTaskScheduler::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+    m_loopCount++;
+    if ( iEnd <= iBegin )
+        return;
+
+    // nested or nothing to spread over
+    if ( !m_pool || m_running.exchange(true) )
+    {
+        body.forLoop(iBegin, iEnd);
+        return;
+    }
+
+    m_pool->parallelFor(iEnd - iBegin, std::max(grainSize, 1), [&](size_t begin, size_t end) {
+        body.forLoop(iBegin + static_cast<int>(begin), iBegin + static_cast<int>(end));
+    });
+    m_running = false;
+}
+
+btScalar PhysicsTaskScheduler::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body)
+{
+    if ( iEnd <= iBegin )
+        return 0;
+
+    if ( !m_pool || m_running.exchange(true) )
+        return body.sumLoop(iBegin, iEnd);
+
+    // one slot per chunk, the pool starts chunks at multiples of grain
+    const size_t grain = std::max(grainSize, 1);
+    const size_t count = iEnd - iBegin;
+    std::vector<btScalar> sums((count + grain - 1) / grain, 0);
+    m_pool->parallelFor(count, grain, [&](size_t begin, size_t end) {
+        sums[begin / grain] = body.sumLoop(iBegin + static_cast<int>(begin), iBegin + static_cast<int>(end));
+    });
+    m_running = false;
+
+    btScalar sum = 0;
+    for ( size_t i = 0; i < sums.size(); ++i )
+        sum += sums[i];
+    return sum;
+}
+
+bool PhysicsTaskScheduler::isReachable()
+{
+    const unsigned int loopCount = m_loopCount;
+    btParallelFor(0, 2, 1, EmptyLoop());
+    return m_loopCount != loopCount;
+}
+
+#endif // BULLET_HAS_TASK_SCHEDULER
@@ -0,0 +1,61 @@
+#ifndef PHYSICSTASKSCHEDULER_HPP
+#define PHYSICSTASKSCHEDULER_HPP
+
+#include <bullet/LinearMath/btScalar.h>
+
+// btDiscreteDynamicsWorldMt and the task scheduler interface used here
+// came with bullet 2.88
+#define BULLET_HAS_TASK_SCHEDULER (BT_BULLET_VERSION >= 288)
+
+#if BULLET_HAS_TASK_SCHEDULER
+
+#include "../threading/ThreadPool.hpp"
+
+#include <bullet/LinearMath/btThreads.h>
+
+#include <atomic>
+#include <memory>
+
+// Runs bullet's parallel loops on a ThreadPool of our own, instead of
+// OpenMP or TBB which the system bullet may not be built with.
+//
+// The pool only runs one loop at a time, a loop started from inside
+// another one (the island solver calling into the solver) runs on the
+// thread that started it. parallelSum adds the chunks in order, so the sum
+// doesn't depend on which thread finished first.
+//
+// example:
+//   PhysicsTaskScheduler& scheduler = PhysicsTaskScheduler::get();
+//   scheduler.setNumThreadsUsed(4);
+//   btSetTaskScheduler(&scheduler);
+class PhysicsTaskScheduler : public btITaskScheduler
+{
+public:
+    PhysicsTaskScheduler();
+
+    // bullet keeps a pointer to the scheduler for good, so there is one
+    static PhysicsTaskScheduler& get();
+
+    virtual int getMaxNumThreads() const;
+    virtual int getNumThreadsUsed() const;
+
+    // restarts the pool with numThreads - 1 workers, call before the
+    // world is created
+    virtual void setNumThreadsUsed(int numThreads);
+
+    virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body);
+    virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body);
+
+    // false if btParallelFor doesn't call the scheduler set with
+    // btSetTaskScheduler, bullet then runs every loop on one thread
+    bool isReachable();
+protected:
+    std::unique_ptr<ThreadPool> m_pool;
+    int                         m_numThreads;
+    std::atomic<bool>           m_running;
+    std::atomic<unsigned int>   m_loopCount;    // parallelFor calls
+};
+
+#endif // BULLET_HAS_TASK_SCHEDULER
+
+#endif // PHYSICSTASKSCHEDULER_HPP
@@ -1,24 +1,68 @@
 #include "PhysicsWorld.hpp"
+#include "DiscBackend.hpp"
+#include "DynamicsWorld.hpp"
+#include "PhysicsState.hpp"
+#include "PhysicsTaskScheduler.hpp"
+#include "TransformBuffer.hpp"
 #include <bullet/btBulletDynamicsCommon.h>
 #include <bullet/btBulletCollisionCommon.h>
 
 #include <bullet/BulletCollision/CollisionDispatch/btCollisionDispatcher.h>
 
-PhysicsWorld::PhysicsWorld()
+#if BULLET_HAS_TASK_SCHEDULER
+#include <bullet/BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <bullet/BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+PhysicsWorld::PhysicsWorld() :
+    m_localTime(nullptr)
 {}
 
 PhysicsWorld::~PhysicsWorld()
 {
     // deallocate in reverse order (if not owned by anyone else)
+    m_savedState.reset();
+    m_transformBuffer.reset();
+    m_discs.reset();
+    m_localTime = nullptr;
     m_world.reset();
     m_solver.reset();
+    m_solverPool.reset();
     m_broadphase.reset();
     m_dispatcher.reset();
     m_configuration.reset();
 }
 
-void PhysicsWorld::init()
+void PhysicsWorld::init(Backend backend, unsigned int threads)
 {
+    m_transformBuffer = std::shared_ptr<TransformBuffer>(new TransformBuffer);
+    m_savedState = std::shared_ptr<PhysicsState>(new PhysicsState);
+
+    if ( threads == 0 )
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // the disc backend never steps the bullet world
+    if ( backend == DISC_BACKEND )
+        threads = 1;
+
+#if BULLET_HAS_TASK_SCHEDULER
+    if ( threads > 1 )
+    {
+        this->initMultithreaded(threads);
+        return;
+    }
+#else
+    if ( threads > 1 )
+        std::cout << "Warning: Multithreaded physics needs bullet 2.88, running on one thread" << std::endl;
+#endif
+
     // allocate all necessary for the world
     m_configuration = std::shared_ptr<btDefaultCollisionConfiguration>(new btDefaultCollisionConfiguration());
     m_dispatcher             = std::shared_ptr<btCollisionDispatcher>(new btCollisionDispatcher(m_configuration.get()));
@@ -26,30 +70,405 @@ void PhysicsWorld::init()
     m_solver                 = std::shared_ptr<btSequentialImpulseConstraintSolver>(new btSequentialImpulseConstraintSolver());
 
     // create physics world
-    m_world = std::shared_ptr<btDiscreteDynamicsWorld>(new btDiscreteDynamicsWorld(
+    DynamicsWorld<btDiscreteDynamicsWorld>* world = new DynamicsWorld<btDiscreteDynamicsWorld>(
+            m_dispatcher.get(),
+            m_broadphase.get(),
+            m_solver.get(),
+            m_configuration.get());
+    m_world = std::shared_ptr<btDiscreteDynamicsWorld>(world);
+    m_localTime = world;
+
+    if ( backend == DISC_BACKEND )
+        m_discs = std::shared_ptr<DiscBackend>(new DiscBackend);
+}
+
+void PhysicsWorld::initMultithreaded(unsigned int threads)
+{
+#if BULLET_HAS_TASK_SCHEDULER
+    // the scheduler has to be in place before the world sizes its solver
+    // pool, it is global to bullet
+    PhysicsTaskScheduler& scheduler = PhysicsTaskScheduler::get();
+    scheduler.setNumThreadsUsed(threads);
+    btSetTaskScheduler(&scheduler);
+
+    // a bullet built without BT_THREADSAFE runs its loops itself
+    if ( !scheduler.isReachable() )
+        std::cout << "Warning: Bullet was built without BT_THREADSAFE, physics runs on one thread" << std::endl;
+
+    // every thread allocates manifolds from the same pools, growing them
+    // mid step would serialize the narrowphase
+    btDefaultCollisionConstructionInfo constructionInfo;
+    constructionInfo.m_defaultMaxPersistentManifoldPoolSize = MT_MANIFOLD_POOL_SIZE;
+    constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = MT_ALGORITHM_POOL_SIZE;
+
+    m_configuration = std::shared_ptr<btDefaultCollisionConfiguration>(new btDefaultCollisionConfiguration(constructionInfo));
+    m_dispatcher             = std::shared_ptr<btCollisionDispatcher>(new btCollisionDispatcherMt(m_configuration.get(), MT_DISPATCH_GRAIN));
+    m_broadphase             = std::shared_ptr<btDbvtBroadphase>(new btDbvtBroadphase());
+
+    // islands are solved in parallel, one pooled solver per thread
+    m_solverPool             = std::shared_ptr<btConstraintSolverPoolMt>(new btConstraintSolverPoolMt(scheduler.getNumThreadsUsed()));
+    m_solver                 = std::shared_ptr<btSequentialImpulseConstraintSolver>(new btSequentialImpulseConstraintSolverMt());
+
+    DynamicsWorld<btDiscreteDynamicsWorldMt>* world = new DynamicsWorld<btDiscreteDynamicsWorldMt>(
             m_dispatcher.get(),
             m_broadphase.get(),
+            m_solverPool.get(),
             m_solver.get(),
-            m_configuration.get()));
+            m_configuration.get());
+    m_world = std::shared_ptr<btDiscreteDynamicsWorld>(world);
+    m_localTime = world;
+#else
+    (void)threads;
+#endif
+}
+
+const std::shared_ptr<TransformBuffer>& PhysicsWorld::getTransformBuffer() const
+{
+    return m_transformBuffer;
+}
+
+bool PhysicsWorld::isMultithreaded() const
+{
+    return m_solverPool.get() != nullptr;
+}
+
+uint64_t PhysicsWorld::getStateHash() const
+{
+    // FNV-1a over the raw floats, any difference at all changes it
+    uint64_t hash = 14695981039346656037ULL;
+    const auto add = [&hash](btScalar value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for ( size_t i = 0; i < sizeof(value); ++i )
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    };
+
+    const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+    for ( int i = 0; i < objects.size(); ++i )
+    {
+        const btRigidBody* body = btRigidBody::upcast(objects[i]);
+        if ( body == nullptr || body->isStaticObject() )
+            continue;
+
+        const btTransform& transform = body->getCenterOfMassTransform();
+        const btVector3 vectors[6] = {
+            transform.getBasis().getRow(0),
+            transform.getBasis().getRow(1),
+            transform.getBasis().getRow(2),
+            transform.getOrigin(),
+            body->getLinearVelocity(),
+            body->getAngularVelocity() };
+        for ( int j = 0; j < 6; ++j )
+        {
+            add(vectors[j].x());
+            add(vectors[j].y());
+            add(vectors[j].z());
+        }
+    }
+    return hash;
+}
+
+static void readBody(const btRigidBody* body, uint32_t index, PhysicsState::BodyState& state)
+{
+    body->getWorldTransform().serialize(state.worldTransform);
+    body->getInterpolationWorldTransform().serialize(state.interpolationWorldTransform);
+    body->getLinearVelocity().serialize(state.linearVelocity);
+    body->getAngularVelocity().serialize(state.angularVelocity);
+    body->getInterpolationLinearVelocity().serialize(state.interpolationLinearVelocity);
+    body->getInterpolationAngularVelocity().serialize(state.interpolationAngularVelocity);
+    state.deactivationTime = body->getDeactivationTime();
+    state.hitFraction = body->getHitFraction();
+    state.activationState = body->getActivationState();
+    state.index = index;
+}
+
+static void writeBody(btRigidBody* body, const PhysicsState::BodyState& state)
+{
+    btTransform transform;
+    btVector3 vector;
+
+    transform.deSerialize(state.worldTransform);
+    body->setWorldTransform(transform);
+    transform.deSerialize(state.interpolationWorldTransform);
+    body->setInterpolationWorldTransform(transform);
+
+    vector.deSerialize(state.linearVelocity);
+    body->setLinearVelocity(vector);
+    vector.deSerialize(state.angularVelocity);
+    body->setAngularVelocity(vector);
+    vector.deSerialize(state.interpolationLinearVelocity);
+    body->setInterpolationLinearVelocity(vector);
+    vector.deSerialize(state.interpolationAngularVelocity);
+    body->setInterpolationAngularVelocity(vector);
+
+    body->setDeactivationTime(state.deactivationTime);
+    body->setHitFraction(state.hitFraction);
+    body->forceActivationState(state.activationState);
+
+    // the inertia in world space follows the rotation
+    body->updateInertiaTensor();
+}
+
+static void readContact(const btManifoldPoint& point, PhysicsState::ContactState& state)
+{
+    point.m_localPointA.serialize(state.localPointA);
+    point.m_localPointB.serialize(state.localPointB);
+    point.m_positionWorldOnA.serialize(state.positionWorldOnA);
+    point.m_positionWorldOnB.serialize(state.positionWorldOnB);
+    point.m_normalWorldOnB.serialize(state.normalWorldOnB);
+    point.m_lateralFrictionDir1.serialize(state.lateralFrictionDir1);
+    point.m_lateralFrictionDir2.serialize(state.lateralFrictionDir2);
+    state.distance = point.m_distance1;
+    state.combinedFriction = point.m_combinedFriction;
+    state.combinedRollingFriction = point.m_combinedRollingFriction;
+    state.combinedRestitution = point.m_combinedRestitution;
+    state.appliedImpulse = point.m_appliedImpulse;
+    state.appliedImpulseLateral1 = point.m_appliedImpulseLateral1;
+    state.appliedImpulseLateral2 = point.m_appliedImpulseLateral2;
+    state.partId0 = point.m_partId0;
+    state.partId1 = point.m_partId1;
+    state.index0 = point.m_index0;
+    state.index1 = point.m_index1;
+    state.lifeTime = point.m_lifeTime;
+}
+
+static btManifoldPoint writeContact(const PhysicsState::ContactState& state)
+{
+    btVector3 localPointA, localPointB, normalWorldOnB;
+    localPointA.deSerialize(state.localPointA);
+    localPointB.deSerialize(state.localPointB);
+    normalWorldOnB.deSerialize(state.normalWorldOnB);
+
+    btManifoldPoint point(localPointA, localPointB, normalWorldOnB, state.distance);
+    point.m_positionWorldOnA.deSerialize(state.positionWorldOnA);
+    point.m_positionWorldOnB.deSerialize(state.positionWorldOnB);
+    point.m_lateralFrictionDir1.deSerialize(state.lateralFrictionDir1);
+    point.m_lateralFrictionDir2.deSerialize(state.lateralFrictionDir2);
+    point.m_combinedFriction = state.combinedFriction;
+    point.m_combinedRollingFriction = state.combinedRollingFriction;
+    point.m_combinedRestitution = state.combinedRestitution;
+    point.m_appliedImpulse = state.appliedImpulse;
+    point.m_appliedImpulseLateral1 = state.appliedImpulseLateral1;
+    point.m_appliedImpulseLateral2 = state.appliedImpulseLateral2;
+    point.m_partId0 = state.partId0;
+    point.m_partId1 = state.partId1;
+    point.m_index0 = state.index0;
+    point.m_index1 = state.index1;
+    point.m_lifeTime = state.lifeTime;
+    return point;
+}
+
+void PhysicsWorld::saveState(PhysicsState& state, bool incremental)
+{
+    const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+    const size_t objectCount = objects.size();
+
+    // the last save has the dynamic bodies in the same order, unless any
+    // were added or removed since
+    PhysicsState& saved = *m_savedState;
+    const bool compare = incremental && !saved.empty() && saved.getHeader().objectCount == objectCount;
+    const size_t savedCount = compare ? saved.getHeader().bodyCount : 0;
+    saved.resize(std::max(savedCount, objectCount), 0);
+    PhysicsState::BodyState* savedBodies = saved.getBodies();
+
+    // room for every body, the unchanged ones are left out
+    state.resize(objectCount, 0);
+    PhysicsState::BodyState* bodies = state.getBodies();
+    size_t bodyCount = 0;
+    size_t dynamicCount = 0;
+    for ( size_t i = 0; i < objectCount; ++i )
+    {
+        const btRigidBody* body = btRigidBody::upcast(objects[i]);
+        if ( body == nullptr || body->isStaticObject() )
+            continue;
+
+        PhysicsState::BodyState& record = bodies[bodyCount];
+        readBody(body, i, record);
+
+        const bool unchanged = dynamicCount < savedCount && savedBodies[dynamicCount].index == i &&
+                               std::memcmp(&savedBodies[dynamicCount], &record, sizeof(record)) == 0;
+        if ( !unchanged )
+        {
+            savedBodies[dynamicCount] = record;
+            ++bodyCount;
+        }
+        ++dynamicCount;
+    }
+    saved.resize(dynamicCount, 0);
+    saved.getHeader().objectCount = objectCount;
+
+    // the manifolds always go in whole, they change every step anyway
+    const int manifoldCount = m_dispatcher->getNumManifolds();
+    state.resize(bodyCount, manifoldCount);
+    PhysicsState::ManifoldState* manifolds = state.getManifolds();
+    size_t storedCount = 0;
+    for ( int i = 0; i < manifoldCount; ++i )
+    {
+        const btPersistentManifold* manifold = m_dispatcher->getManifoldByIndexInternal(i);
+        const int pointCount = std::min(manifold->getNumContacts(), STATE_MANIFOLD_POINTS);
+        if ( pointCount == 0 )
+            continue;
+
+        PhysicsState::ManifoldState& record = manifolds[storedCount++];
+        record.body0 = manifold->getBody0()->getWorldArrayIndex();
+        record.body1 = manifold->getBody1()->getWorldArrayIndex();
+        record.pointCount = pointCount;
+        for ( int j = 0; j < pointCount; ++j )
+            readContact(manifold->getContactPoint(j), record.points[j]);
+    }
+    state.resize(bodyCount, storedCount);
+
+    PhysicsState::Header& header = state.getHeader();
+    header.objectCount = objectCount;
+    header.incremental = compare ? 1 : 0;
+    header.remainder = m_discs ? m_discs->getRemainder() : static_cast<double>(m_localTime->getLocalTime());
+}
+
+bool PhysicsWorld::restoreState(const PhysicsState& state)
+{
+    const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+    const size_t objectCount = objects.size();
+    if ( state.empty() || state.getHeader().objectCount != objectCount )
+        return false;
+
+    // check everything before changing anything
+    const PhysicsState::Header& header = state.getHeader();
+    const PhysicsState::BodyState* bodies = state.getBodies();
+    const PhysicsState::ManifoldState* manifolds = state.getManifolds();
+    for ( uint32_t i = 0; i < header.bodyCount; ++i )
+    {
+        if ( bodies[i].index >= objectCount )
+            return false;
+        const btRigidBody* body = btRigidBody::upcast(objects[bodies[i].index]);
+        if ( body == nullptr || body->isStaticObject() )
+            return false;
+    }
+    for ( uint32_t i = 0; i < header.manifoldCount; ++i )
+        if ( manifolds[i].body0 >= objectCount || manifolds[i].body1 >= objectCount ||
+             manifolds[i].pointCount > STATE_MANIFOLD_POINTS )
+            return false;
+
+    for ( uint32_t i = 0; i < header.bodyCount; ++i )
+    {
+        btRigidBody* body = btRigidBody::upcast(objects[bodies[i].index]);
+        writeBody(body, bodies[i]);
+
+        // sleeping bodies don't update their bounds themselves
+        m_world->updateSingleAabb(body);
+
+        // drawn where it is until the next tick
+        if ( body->getMotionState() != nullptr )
+            body->getMotionState()->setWorldTransform(body->getInterpolationWorldTransform());
+    }
+
+    if ( m_discs )
+        m_discs->setRemainder(header.remainder);
+    else
+        m_localTime->setLocalTime(static_cast<btScalar>(header.remainder));
+
+    // the saved points go back into the manifolds of the same pairs, usually
+    // in the same order, every other manifold starts cold
+    const int manifoldCount = m_dispatcher->getNumManifolds();
+    for ( int i = 0; i < manifoldCount; ++i )
+        m_dispatcher->getManifoldByIndexInternal(i)->clearManifold();
+
+    int next = 0;
+    for ( uint32_t i = 0; i < header.manifoldCount && manifoldCount > 0; ++i )
+    {
+        const PhysicsState::ManifoldState& record = manifolds[i];
+        const btCollisionObject* body0 = objects[record.body0];
+        const btCollisionObject* body1 = objects[record.body1];
+
+        btPersistentManifold* manifold = nullptr;
+        for ( int tries = 0; tries < manifoldCount && manifold == nullptr; ++tries )
+        {
+            btPersistentManifold* candidate = m_dispatcher->getManifoldByIndexInternal(next);
+            if ( candidate->getBody0() == body0 && candidate->getBody1() == body1 )
+                manifold = candidate;
+            next = (next + 1) % manifoldCount;
+        }
+        if ( manifold == nullptr )
+            continue;
+
+        for ( int j = 0; j < record.pointCount; ++j )
+            manifold->addManifoldPoint(writeContact(record.points[j]));
+    }
+
+    // the world isn't what the last save saw any more
+    *m_savedState = PhysicsState();
+
+    return true;
+}
+
+void PhysicsWorld::setDeterministic(bool deterministic)
+{
+    if ( m_discs )
+        m_discs->setDeterministic(deterministic, BASE_TIME_STEP);
+}
+
+PhysicsWorld::Backend PhysicsWorld::getBackend() const
+{
+    return m_discs ? DISC_BACKEND : BULLET_BACKEND;
 }
 
 void PhysicsWorld::tick(double dt)
 {
-    m_world->stepSimulation(static_cast<btScalar>(dt));
+    if ( m_discs )
+    {
+        // collisions are exact, no substeps needed
+        m_discs->tick(dt);
+        return;
+    }
+
+    // bullet keeps the remainder of dt for the next tick and interpolates
+    // the motion states in between
+    const double timeStep = BASE_TIME_STEP / this->getSubdivision();
+    const int maxSteps = std::min(MAX_TICK_STEPS, static_cast<int>(std::ceil(dt / timeStep)) + 1);
+
+    m_world->stepSimulation(static_cast<btScalar>(dt), maxSteps, static_cast<btScalar>(timeStep));
+}
+
+int PhysicsWorld::getSubdivision() const
+{
+    int subdivision = 1;
+
+    const btCollisionObjectArray& objects = m_world->getCollisionObjectArray();
+    for ( int i = 0; i < objects.size(); ++i )
+    {
+        const btRigidBody* body = btRigidBody::upcast(objects[i]);
+        if ( body == nullptr || body->isStaticOrKinematicObject() || !body->isActive() )
+            continue;
+
+        btVector3 center;
+        btScalar radius;
+        body->getCollisionShape()->getBoundingSphere(center, radius);
+        if ( radius <= 0 )
+            continue;
+
+        const double travel = body->getLinearVelocity().length() * BASE_TIME_STEP;
+        const int pieces = static_cast<int>(std::ceil(travel / (SUBSTEP_TRAVEL_FRACTION * radius)));
+        subdivision = std::max(subdivision, std::min(pieces, MAX_SUBDIVISION));
+    }
+    return subdivision;
 }
 
 void PhysicsWorld::removeRigidBody(btRigidBody* body)
 {
+    if ( m_discs )
+        m_discs->removeBody(body);
     m_world->removeRigidBody(body);
 }
 
 void PhysicsWorld::addRigidBody(btRigidBody* body)
 {
     m_world->addRigidBody(body);
+    if ( m_discs )
+        m_discs->addBody(body);
 }
 
 void PhysicsWorld::addConstraint(btGeneric6DofConstraint* constraint)
 {
+    if ( m_discs )
+        std::cout << "Warning: Constraints are ignored by disc physics" << std::endl;
     m_world->addConstraint(constraint);
 }
 
@@ -1,6 +1,7 @@
 #ifndef PHYSICSWORLD_HPP
 #define PHYSICSWORLD_HPP
 
+#include <cstdint>
 #include <memory>
 
 class btDefaultCollisionConfiguration;
@@ -8,30 +9,101 @@ class btCollisionDispatcher;
 class btBroadphaseInterface;
 class btSequentialImpulseConstraintSolver;
 class btDiscreteDynamicsWorld;
+class btConstraintSolverPoolMt;
 class btRigidBody;
 class btGeneric6DofConstraint;
+class DiscBackend;
+class LocalTimeWorld;
+class PhysicsState;
+class TransformBuffer;
+
+// seconds of one step when nothing moves fast
+const double BASE_TIME_STEP = 1.0 / 60.0;
+
+// a step is split while a body would move more than this fraction of its
+// bounding radius in it
+const double SUBSTEP_TRAVEL_FRACTION = 0.5;
+
+// most pieces a base step is split into, and most steps a single tick takes
+const int MAX_SUBDIVISION = 8;
+const int MAX_TICK_STEPS = 32;
+
+// persistent manifolds and collision algorithms pooled up front by the
+// multithreaded world, the pools are shared by every thread
+const int MT_MANIFOLD_POOL_SIZE = 80000;
+const int MT_ALGORITHM_POOL_SIZE = 80000;
+
+// pairs each thread takes at a time in the multithreaded narrowphase
+const int MT_DISPATCH_GRAIN = 40;
 
 class PhysicsWorld
 {
 public:
+    enum Backend
+    {
+        BULLET_BACKEND,
+        DISC_BACKEND        // 2D discs against wall segments (see DiscBackend)
+    };
+
     PhysicsWorld();
     ~PhysicsWorld();
 
-    void init();
+    // the bodies always live in the bullet world, the disc backend only
+    // takes over the stepping. More than one thread builds
+    // btDiscreteDynamicsWorldMt on PhysicsTaskScheduler (bullet 2.88 and
+    // up, single threaded otherwise), 0 uses every core.
+    void init(Backend backend = BULLET_BACKEND, unsigned int threads = 1);
+
+    // disc backend only, bullet already steps in fixed steps
+    void setDeterministic(bool deterministic);
     
     void removeRigidBody(btRigidBody* body);
     void addRigidBody(btRigidBody* body);
     void addConstraint(btGeneric6DofConstraint* body);
     void removeConstraint(btGeneric6DofConstraint* constraint);
+
+    // advance dt seconds in fixed steps of BASE_TIME_STEP, divided further
+    // only for the ticks where a body is fast enough to need it (CCD catches
+    // what is still too fast)
     void tick(double dt);
     
     btDiscreteDynamicsWorld* get() { return m_world.get(); }
+    Backend getBackend() const;
+    bool isMultithreaded() const;
+
+    // where the motion states of moving bodies put their matrices
+    const std::shared_ptr<TransformBuffer>& getTransformBuffer() const;
+
+    // hash of the transforms and velocities of every body, equal hashes
+    // after the same ticks mean the runs didn't diverge
+    uint64_t getStateHash() const;
+
+    // copy every dynamic body, the contact points the solver warm starts
+    // from and the time kept for the next tick into state. Incremental
+    // keeps only the bodies that changed since the last save, the first save
+    // after init or a restore is always whole.
+    void saveState(PhysicsState& state, bool incremental = false);
+
+    // put a saved state back, an incremental one on top of the states it
+    // followed. False (and nothing changed) if it doesn't fit the bodies of
+    // this world. Contacts whose pair isn't overlapping any more start cold.
+    bool restoreState(const PhysicsState& state);
 protected:
+    void initMultithreaded(unsigned int threads);
+
+    // pieces each base step has to be split into for the fastest body
+    int getSubdivision() const;
+
     std::shared_ptr<btDefaultCollisionConfiguration>     m_configuration;
     std::shared_ptr<btCollisionDispatcher>               m_dispatcher;
     std::shared_ptr<btBroadphaseInterface>               m_broadphase;
     std::shared_ptr<btSequentialImpulseConstraintSolver> m_solver;
+    std::shared_ptr<btConstraintSolverPoolMt>            m_solverPool;     // multithreaded only
     std::shared_ptr<btDiscreteDynamicsWorld>             m_world;
+    LocalTimeWorld*                                      m_localTime;      // m_world, see DynamicsWorld
+    std::shared_ptr<DiscBackend>                         m_discs;
+    std::shared_ptr<TransformBuffer>                     m_transformBuffer;
+    std::shared_ptr<PhysicsState>                        m_savedState;     // whole, incremental saves compare with it
 };
 
 #endif // PHYSICSWORLD_HPP
@@ -0,0 +1,90 @@
+#include "TransformBuffer.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+TransformBuffer::TransformBuffer()
+{}
+
+size_t TransformBuffer::allocate(iPhysicsObject* owner)
+{
+    size_t slot;
+    if ( !m_free.empty() )
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        slot = m_matrices.size();
+        m_matrices.push_back(glm::mat4(1.0f));
+        m_localMatrices.push_back(glm::mat4(1.0f));
+        m_transforms.push_back(btTransform::getIdentity());
+        m_owners.push_back(nullptr);
+        m_dirtyFlags.push_back(false);
+    }
+
+    m_matrices[slot] = glm::mat4(1.0f);
+    m_localMatrices[slot] = glm::mat4(1.0f);
+    m_transforms[slot] = btTransform::getIdentity();
+    m_owners[slot] = owner;
+    return slot;
+}
+
+void TransformBuffer::release(size_t slot)
+{
+    // a dirty slot stays listed until the next clear, without an owner
+    m_owners[slot] = nullptr;
+    m_free.push_back(slot);
+}
+
+void TransformBuffer::setLocalMatrix(size_t slot, const glm::mat4& localMatrix)
+{
+    m_localMatrices[slot] = localMatrix;
+    this->write(slot, m_transforms[slot]);
+}
+
+void TransformBuffer::write(size_t slot, const btTransform& transform)
+{
+    m_transforms[slot] = transform;
+
+    btScalar matrix[16];
+    transform.getOpenGLMatrix(matrix);
+    m_matrices[slot] = glm::mat4(glm::make_mat4(matrix)) * m_localMatrices[slot];
+
+    this->markDirty(slot);
+}
+
+const glm::mat4& TransformBuffer::getMatrix(size_t slot) const
+{
+    return m_matrices[slot];
+}
+
+const btTransform& TransformBuffer::getTransform(size_t slot) const
+{
+    return m_transforms[slot];
+}
+
+iPhysicsObject* TransformBuffer::getOwner(size_t slot) const
+{
+    return m_owners[slot];
+}
+
+const std::vector<size_t>& TransformBuffer::getDirty() const
+{
+    return m_dirty;
+}
+
+void TransformBuffer::clearDirty()
+{
+    for ( size_t i = 0; i < m_dirty.size(); ++i )
+        m_dirtyFlags[m_dirty[i]] = false;
+    m_dirty.clear();
+}
+
+void TransformBuffer::markDirty(size_t slot)
+{
+    if ( m_dirtyFlags[slot] )
+        return;
+    m_dirtyFlags[slot] = true;
+    m_dirty.push_back(slot);
+}
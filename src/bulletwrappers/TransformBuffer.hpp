@@ -0,0 +1,59 @@
+#ifndef TRANSFORMBUFFER_HPP
+#define TRANSFORMBUFFER_HPP
+
+#include <bullet/LinearMath/btTransform.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class iPhysicsObject;
+
+// The model matrices of every moving body in one array, written by their
+// motion states (see TransformMotionState) when bullet moves them.
+//
+// A slot holds the body's transform times the object's local matrix, ready
+// to draw. Each write puts the slot on the dirty list once, so after a tick
+// only the owners of dirty slots have anything to update. Static bodies and
+// sleeping ones are never written and cost nothing.
+//
+// example:
+//   const std::vector<size_t>& moved = buffer.getDirty();
+//   for ( size_t i = 0; i < moved.size(); ++i )
+//       buffer.getOwner(moved[i])->updateTransform();
+//   buffer.clearDirty();
+class TransformBuffer
+{
+public:
+    TransformBuffer();
+
+    // returns the slot, owner is whoever reads the matrix when it changes
+    size_t allocate(iPhysicsObject* owner);
+    void release(size_t slot);
+
+    // applied to the right of the body transform (model space to body
+    // space), rewrites the slot with the last transform
+    void setLocalMatrix(size_t slot, const glm::mat4& localMatrix);
+
+    void write(size_t slot, const btTransform& transform);
+
+    const glm::mat4& getMatrix(size_t slot) const;
+    const btTransform& getTransform(size_t slot) const;
+    iPhysicsObject* getOwner(size_t slot) const;
+
+    // slots written since the last clearDirty, each once
+    const std::vector<size_t>& getDirty() const;
+    void clearDirty();
+protected:
+    void markDirty(size_t slot);
+
+    std::vector<glm::mat4>       m_matrices;
+    std::vector<glm::mat4>       m_localMatrices;
+    std::vector<btTransform>     m_transforms;
+    std::vector<iPhysicsObject*> m_owners;      // nullptr for a free slot
+    std::vector<bool>            m_dirtyFlags;
+    std::vector<size_t>          m_dirty;
+    std::vector<size_t>          m_free;
+};
+
+#endif // TRANSFORMBUFFER_HPP
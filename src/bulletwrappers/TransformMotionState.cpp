@@ -0,0 +1,33 @@
+#include "TransformMotionState.hpp"
+
+TransformMotionState::TransformMotionState(const std::shared_ptr<TransformBuffer>& buffer, iPhysicsObject* owner, const btTransform& transform) :
+    m_buffer(buffer),
+    m_slot(buffer->allocate(owner))
+{
+    m_buffer->write(m_slot, transform);
+}
+
+TransformMotionState::~TransformMotionState()
+{
+    m_buffer->release(m_slot);
+}
+
+void TransformMotionState::getWorldTransform(btTransform& transform) const
+{
+    transform = m_buffer->getTransform(m_slot);
+}
+
+void TransformMotionState::setWorldTransform(const btTransform& transform)
+{
+    m_buffer->write(m_slot, transform);
+}
+
+void TransformMotionState::setLocalMatrix(const glm::mat4& localMatrix)
+{
+    m_buffer->setLocalMatrix(m_slot, localMatrix);
+}
+
+const glm::mat4& TransformMotionState::getMatrix() const
+{
+    return m_buffer->getMatrix(m_slot);
+}
@@ -0,0 +1,32 @@
+#ifndef TRANSFORMMOTIONSTATE_HPP
+#define TRANSFORMMOTIONSTATE_HPP
+
+#include "TransformBuffer.hpp"
+
+#include <bullet/LinearMath/btMotionState.h>
+
+#include <memory>
+
+// Motion state that keeps its body's transform in a TransformBuffer slot.
+// Bullet only calls setWorldTransform for bodies that are awake after a
+// step, with the transform interpolated to the end of the tick.
+class TransformMotionState : public btMotionState
+{
+public:
+    TransformMotionState(const std::shared_ptr<TransformBuffer>& buffer, iPhysicsObject* owner, const btTransform& transform);
+    virtual ~TransformMotionState();
+
+    virtual void getWorldTransform(btTransform& transform) const;
+    virtual void setWorldTransform(const btTransform& transform);
+
+    // see TransformBuffer::setLocalMatrix
+    void setLocalMatrix(const glm::mat4& localMatrix);
+
+    // the transform times the local matrix
+    const glm::mat4& getMatrix() const;
+protected:
+    std::shared_ptr<TransformBuffer> m_buffer;
+    size_t                           m_slot;
+};
+
+#endif // TRANSFORMMOTIONSTATE_HPP
@@ -1,12 +1,30 @@
 #include "PhysicsDebug.hpp"
 
 #include <glm/glm.hpp>
+#include <iostream>
+
+// position (3) and color (3) per vertex, two vertices per line
+const GLsizei DEBUG_VERTEX_FLOATS = 6;
+const GLsizei DEBUG_LINE_FLOATS = DEBUG_VERTEX_FLOATS * 2;
 
 PhysicsDebug::PhysicsDebug() :
+    m_lines(nullptr),
+    m_lineCount(0),
+    m_droppedLines(0),
+    m_warnedDropped(false),
+    m_firstVertex(0),
+    m_numVertices(0),
     m_modelMatrix(1.0f)
 {
+    // created once, every endLines fills the next region
+    if ( !m_stream.init(MAX_DEBUG_LINES * DEBUG_LINE_FLOATS * sizeof(GLfloat)) )
+        std::cout << "Warning: Unable to create the physics debug line buffer" << std::endl;
+
+    // point the vertex locations and colors at the interleaved buffer
     m_vao = std::shared_ptr<GLVertexArray>(new GLVertexArray);
     m_vao->create(1);
+    m_vao->setAttribute(V_POSITION, m_stream.getBufferIdx(), 3, GL_FLOAT, sizeof(GLfloat)*DEBUG_VERTEX_FLOATS);
+    m_vao->setAttribute(V_COLOR, m_stream.getBufferIdx(), 3, GL_FLOAT, sizeof(GLfloat)*DEBUG_VERTEX_FLOATS, sizeof(GLfloat)*3);
 }
 
 PhysicsDebug::~PhysicsDebug()
@@ -19,47 +37,36 @@ const glm::mat4& PhysicsDebug::getModelMatrix()
 
 void PhysicsDebug::draw(DrawType type)
 {
-    if ( type == DrawType::DRAW_MATERIAL )
+    if ( type == DrawType::DRAW_MATERIAL && m_numVertices > 0 )
     {
         m_vao->bind();
-        glDrawArrays(GL_LINES, 0, m_numVertices);
-        m_vao->unbindAll();
+        glDrawArrays(GL_LINES, m_firstVertex, m_numVertices);
     }
 }
 
-void PhysicsDebug::loadToBuffer()
+void PhysicsDebug::beginLines()
 {
-    // attributes
-    GLAttribute vPosition(V_POSITION);
-    GLAttribute vColor(V_COLOR);
-
-    // initialize buffers
-    m_vertexBuffer = std::shared_ptr<GLBuffer>(new GLBuffer);
-    m_colorBuffer = std::shared_ptr<GLBuffer>(new GLBuffer);
-    m_vertexBuffer->generate(1);
-    m_colorBuffer->generate(1);
-
-    m_vao->bind();
-
-    // bind vertex locations
-    m_vertexBuffer->bind(GL_ARRAY_BUFFER);
-    m_vertexBuffer->setData(m_vertices.data(), m_vertices.size(), GL_DYNAMIC_DRAW);
-    vPosition.enable();
-    vPosition.loadBufferData(3, sizeof(glm::vec3));
-
-    // bind vertex colors
-    m_colorBuffer->bind(GL_ARRAY_BUFFER);
-    m_colorBuffer->setData(m_colors.data(), m_colors.size(), GL_DYNAMIC_DRAW);
-    vColor.enable();
-    vColor.loadBufferData(3, sizeof(glm::vec3));
+    m_lines = static_cast<GLfloat*>(m_stream.map());
+    m_lineCount = 0;
+    m_droppedLines = 0;
+}
 
-    m_vao->unbindAll();
+void PhysicsDebug::endLines()
+{
+    if ( m_lines == nullptr )
+        return;
 
-    m_numVertices = m_vertices.size();
+    const GLintptr offset = m_stream.unmap(m_lineCount * DEBUG_LINE_FLOATS * sizeof(GLfloat));
+    m_firstVertex = offset / (DEBUG_VERTEX_FLOATS * sizeof(GLfloat));
+    m_numVertices = m_lineCount * 2;
+    m_lines = nullptr;
 
-    // clear the vertices for the next time
-    m_vertices.clear();
-    m_colors.clear();
+    // a busy scene drops lines every frame, say so once
+    if ( m_droppedLines > 0 && !m_warnedDropped )
+    {
+        std::cout << "Warning: " << m_droppedLines << " physics debug lines over MAX_DEBUG_LINES dropped" << std::endl;
+        m_warnedDropped = true;
+    }
 }
 
 void PhysicsDebug::setUniforms(GLBuffer&, UniformType)
@@ -69,9 +76,27 @@ void PhysicsDebug::setUniforms(GLBuffer&, UniformType)
 
 void PhysicsDebug::drawLine(const btVector3& from, const btVector3& to, const btVector3& color)
 {
-    m_vertices.push_back(glm::vec3(from.x(), from.y(), from.z()));
-    m_vertices.push_back(glm::vec3(to.x(), to.y(), to.z()));
-    m_colors.push_back(glm::vec3(color.x(), color.y(), color.z()));
-    m_colors.push_back(glm::vec3(color.x(), color.y(), color.z()));
-}
+    if ( m_lines == nullptr )
+        return;
+    if ( m_lineCount >= MAX_DEBUG_LINES )
+    {
+        ++m_droppedLines;
+        return;
+    }
 
+    // written in order, the mapping may be write combined
+    GLfloat* line = m_lines + m_lineCount * DEBUG_LINE_FLOATS;
+    line[0]  = from.x();
+    line[1]  = from.y();
+    line[2]  = from.z();
+    line[3]  = color.x();
+    line[4]  = color.y();
+    line[5]  = color.z();
+    line[6]  = to.x();
+    line[7]  = to.y();
+    line[8]  = to.z();
+    line[9]  = color.x();
+    line[10] = color.y();
+    line[11] = color.z();
+    ++m_lineCount;
+}
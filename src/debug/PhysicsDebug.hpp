@@ -5,7 +5,19 @@
 #include "../interfaces/iGLRenderable.hpp"
 #include "../glwrappers/GLVertexArray.hpp"
 #include "../glwrappers/GLAttribute.hpp"
+#include "../render/StreamBuffer.hpp"
 
+// lines one debugDrawWorld can draw, the rest are dropped
+const GLsizei MAX_DEBUG_LINES = 1 << 16;
+
+// Collects the lines of btIDebugDraw straight into a StreamBuffer region,
+// position and color interleaved, and draws them with one glDrawArrays.
+//
+//   debug.beginLines();
+//   world->debugDrawWorld();
+//   debug.endLines();
+//   ...
+//   debug.draw();     // in every viewport, until the next beginLines
 class PhysicsDebug : public btIDebugDraw, public iGLRenderable
 {
 public:
@@ -17,8 +29,11 @@ public:
     void draw(DrawType type = DRAW_MATERIAL);
     void setUniforms(GLBuffer &ubo, UniformType type = MATERIALS);
 
+    // drawLine only records between these
+    void beginLines();
+    void endLines();
+
     // overloaded pure virtual from btIDebugDraw
-    void loadToBuffer();
     void drawLine(const btVector3& from,const btVector3& to,const btVector3& color);
 
     void drawContactPoint(const btVector3&,const btVector3&,btScalar,int,const btVector3&) {}
@@ -33,18 +48,21 @@ public:
     //void draw3dText(const btVector3& location,const char* textString) {}
     //void setDebugMode(int debugMode) {}
 protected:
-    GLsizei                         m_numVertices;
-    
-    std::shared_ptr<GLBuffer>       m_vertexBuffer;
-    std::shared_ptr<GLBuffer>       m_colorBuffer;
+    StreamBuffer                    m_stream;
     std::shared_ptr<GLVertexArray>  m_vao;
 
-    std::vector<glm::vec3>          m_vertices;
-    std::vector<glm::vec3>          m_colors;
+    // region being written, null outside beginLines/endLines
+    GLfloat*                        m_lines;
+    GLsizei                         m_lineCount;
+    GLsizei                         m_droppedLines;
+    bool                            m_warnedDropped;
+
+    // what draw draws
+    GLint                           m_firstVertex;
+    GLsizei                         m_numVertices;
     
     // always identity
     glm::mat4                       m_modelMatrix;
 };
 
 #endif // DEBUGDRAW_HPP
-
@@ -29,6 +29,12 @@ public:
         glDisableVertexAttribArray(m_attribute);
     }
 
+    // advance once per divisor instances instead of once per vertex (0)
+    void setDivisor(GLuint divisor)
+    {
+        glVertexAttribDivisor(m_attribute, divisor);
+    }
+
     void loadBufferData(int count, unsigned long step, unsigned long offset = 0, GLenum type = GL_FLOAT, GLboolean normalize = GL_FALSE)
     {
         glVertexAttribPointer(m_attribute, count, type, normalize, step, reinterpret_cast<void*>(offset));
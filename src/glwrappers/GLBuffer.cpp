@@ -1,4 +1,5 @@
 #include "GLBuffer.hpp"
+#include "GLState.hpp"
 
 GLBuffer::GLBuffer() :
     m_buffers(),
@@ -13,7 +14,10 @@ GLBuffer::~GLBuffer()
     {
         GLuint *buffers = new GLuint[m_bufferCount];
         for ( GLsizei i = 0U; i < m_bufferCount; ++i )
+        {
             buffers[i] = m_buffers[i];
+            GLState::forgetBuffer(buffers[i]);
+        }
         glDeleteBuffers(m_bufferCount, buffers);
         delete [] buffers;
     }
@@ -29,7 +33,10 @@ bool GLBuffer::generate(GLsizei n)
     GLuint *buffers = new GLuint[n];
     GLenum *targets = new GLenum[n];
     bool   *dataSet = new bool[n];
-    glGenBuffers(n, buffers);
+    if ( GLState::hasDirectStateAccess() )
+        glCreateBuffers(n, buffers);
+    else
+        glGenBuffers(n, buffers);
 
     // check results
     if ( *buffers == 0 )
@@ -52,7 +59,10 @@ bool GLBuffer::generate(GLsizei n)
     {
         GLuint *temp_buffers = new GLuint[m_bufferCount];
         for ( GLsizei i = 0U; i < m_bufferCount; ++i )
+        {
             temp_buffers[i] = m_buffers[i];
+            GLState::forgetBuffer(temp_buffers[i]);
+        }
         glDeleteBuffers(m_bufferCount, temp_buffers);
         delete [] temp_buffers;
     }
@@ -68,11 +78,83 @@ bool GLBuffer::generate(GLsizei n)
 
 bool GLBuffer::setEmpty(GLsizeiptr sizei, GLenum usage, GLsizei idx)
 {
-    if ( m_buffers != nullptr && m_bufferCount > idx && m_targets[idx] != GL_NONE )
+    return this->uploadData(NULL, sizei, usage, idx);
+}
+
+bool GLBuffer::setStorage(GLsizeiptr size, GLbitfield flags, GLsizei idx)
+{
+    if ( m_buffers == nullptr || m_bufferCount <= idx )
+        return false;
+
+    if ( GLState::hasDirectStateAccess() )
     {
-        glBufferData(m_targets[idx], sizei, NULL, usage);
-        m_dataSet[idx] = true;
-        return true;
+        glNamedBufferStorage(m_buffers[idx], size, NULL, flags);
+    }
+    else
+    {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[idx]);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+    }
+    m_dataSet[idx] = true;
+    return true;
+}
+
+void* GLBuffer::mapRange(GLintptr offset, GLsizeiptr bytes, GLbitfield access, GLsizei idx)
+{
+    if ( m_buffers == nullptr || m_bufferCount <= idx || !m_dataSet[idx] )
+        return nullptr;
+
+    if ( GLState::hasDirectStateAccess() )
+        return glMapNamedBufferRange(m_buffers[idx], offset, bytes, access);
+
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[idx]);
+    return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, bytes, access);
+}
+
+bool GLBuffer::unmap(GLsizei idx)
+{
+    if ( m_buffers == nullptr || m_bufferCount <= idx )
+        return false;
+
+    if ( GLState::hasDirectStateAccess() )
+        return glUnmapNamedBuffer(m_buffers[idx]) == GL_TRUE;
+
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[idx]);
+    return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+}
+
+bool GLBuffer::uploadData(const void* data, GLsizeiptr bytes, GLenum usage, GLsizei idx)
+{
+    if ( m_buffers == nullptr || m_bufferCount <= idx )
+        return false;
+
+    if ( GLState::hasDirectStateAccess() )
+    {
+        glNamedBufferData(m_buffers[idx], bytes, data, usage);
+    }
+    else
+    {
+        // nothing is drawn from the copy target so binding it is harmless
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[idx]);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, usage);
+    }
+    m_dataSet[idx] = true;
+    return true;
+}
+
+bool GLBuffer::uploadSubData(const void* data, GLintptr offset, GLsizeiptr bytes, GLsizei idx)
+{
+    if ( m_buffers == nullptr || m_bufferCount <= idx || !m_dataSet[idx] )
+        return false;
+
+    if ( GLState::hasDirectStateAccess() )
+    {
+        glNamedBufferSubData(m_buffers[idx], offset, bytes, data);
+    }
+    else
+    {
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[idx]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
     }
     return true;
 }
@@ -81,7 +163,7 @@ void GLBuffer::bind(GLenum target, GLsizei idx)
 {
     if ( m_buffers != nullptr && m_bufferCount > idx )
     {
-        glBindBuffer(target, m_buffers[idx]);
+        GLState::bindBuffer(target, m_buffers[idx]);
         m_targets[idx] = target;
     }
 }
@@ -90,12 +172,20 @@ void GLBuffer::bindBase(GLuint index, GLsizei idx)
 {
     if ( m_buffers != nullptr && m_bufferCount > idx && m_targets[idx] != GL_NONE )
     {
-        glBindBufferBase(m_targets[idx], index, m_buffers[idx]);
+        GLState::bindBufferBase(m_targets[idx], index, m_buffers[idx]);
+    }
+}
+
+void GLBuffer::bindRange(GLuint index, GLintptr offset, GLsizeiptr size, GLsizei idx)
+{
+    if ( m_buffers != nullptr && m_bufferCount > idx && m_targets[idx] != GL_NONE )
+    {
+        GLState::bindBufferRange(m_targets[idx], index, m_buffers[idx], offset, size);
     }
 }
 
 void GLBuffer::unbindBuffers(GLenum target)
 {
-    glBindBuffer(target, 0);
+    GLState::bindBuffer(target, 0);
 }
 
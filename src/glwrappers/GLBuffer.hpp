@@ -17,6 +17,10 @@ public:
 
     // Generate new buffers, the size of n. This must be called before
     //   binding.
+    //
+    // The data functions edit the buffer directly when direct state access
+    // is available, otherwise through GL_COPY_WRITE_BUFFER. Either way the
+    // buffer doesn't need to be bound and no other binding is disturbed.
     bool generate(GLsizei n = 1);
 
     // Bind a buffer object
@@ -38,36 +42,37 @@ public:
     // must be called after bind in order to get correct target
     void bindBase(GLuint index, GLsizei idx = 0);
 
+    // bind size bytes starting at offset to the indexed binding point
+    void bindRange(GLuint index, GLintptr offset, GLsizeiptr size, GLsizei idx = 0);
+
     // size in bytes
     bool setEmpty(GLsizeiptr size, GLenum usage = GL_STATIC_DRAW, GLsizei idx = 0);
 
+    // allocate immutable storage (OpenGL 4.4 or ARB_buffer_storage), flags
+    // are the GL_MAP_*_BIT and GL_DYNAMIC_STORAGE_BIT allowed later
+    bool setStorage(GLsizeiptr size, GLbitfield flags, GLsizei idx = 0);
+
+    // map bytes starting at offset, null on failure. A persistent mapping
+    // (GL_MAP_PERSISTENT_BIT) stays valid while the buffer is used for
+    // drawing, until unmap or the buffer is deleted.
+    void* mapRange(GLintptr offset, GLsizeiptr bytes, GLbitfield access, GLsizei idx = 0);
+    bool unmap(GLsizei idx = 0);
+
     template <typename T>
     bool setSubData(const T* data, GLintptr offset = 0, GLsizei size = 1, GLsizei idx = 0)
     {
-        if ( m_buffers != nullptr && m_bufferCount > idx && m_dataSet[idx] )
-        {
-            glBufferSubData(m_targets[idx], offset, sizeof(T)*size, reinterpret_cast<const void*>(data)); 
-            return true;
-        }
-        return false;
+        return this->uploadSubData(reinterpret_cast<const void*>(data), offset, sizeof(T)*size, idx);
     }
 
     // set the data
     template <typename T>
     bool setData(const T* data, GLsizei size = 1, GLenum usage = GL_STATIC_DRAW, GLsizei idx = 0)
     {
-        if ( m_buffers != nullptr && m_bufferCount > idx && m_targets[idx] != GL_NONE )
-        {
-            glBufferData(m_targets[idx], sizeof(T)*size, reinterpret_cast<const void*>(data), usage);
-            m_dataSet[idx] = true;
-            return true;
-        }
-
-        // not initialized or not bound
-        return false;
+        return this->uploadData(reinterpret_cast<const void*>(data), sizeof(T)*size, usage, idx);
     }
 
-    // unbind buffers
+    // unbind buffers, only needed when the next gl call would otherwise use
+    // the bound buffer (eg. client side pointers)
     // target: One of the GLenum buffers (see GLBuffer::bind)
     static void unbindBuffers(GLenum target);
 
@@ -78,6 +83,9 @@ public:
         else return 0;
     }
 protected:
+    bool uploadData(const void* data, GLsizeiptr bytes, GLenum usage, GLsizei idx);
+    bool uploadSubData(const void* data, GLintptr offset, GLsizeiptr bytes, GLsizei idx);
+
     boost::shared_array<GLuint> m_buffers;
     boost::shared_array<GLenum> m_targets;
     boost::shared_array<bool>   m_dataSet;
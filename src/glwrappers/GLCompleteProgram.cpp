@@ -2,46 +2,66 @@
 
 #include "GLShader.hpp"
 
+#include <fstream>
+#include <sstream>
+
 GLCompleteProgram::GLCompleteProgram() : GLProgram() {}
 
+// read a whole file, false if it can't be opened
+static bool readSource(const char* filename, std::string& source, std::string& err)
+{
+    std::ifstream fin(filename, std::ios::binary);
+    if ( !fin.good() )
+    {
+        std::ostringstream sout;
+        sout << "Unable to open file \"" << filename << "\"";
+        err = sout.str();
+        return false;
+    }
+
+    std::ostringstream sout;
+    sout << fin.rdbuf();
+    source = sout.str();
+    return true;
+}
+
 bool GLCompleteProgram::loadAndLink(const char* vshaderFile, const char* fshaderFile, const char* gshaderFile)
 {
-    GLShader vshader;
-    GLShader gshader;
-    GLShader fshader;
+    const char* files[] = {vshaderFile, gshaderFile, fshaderFile};
+    const GLenum types[] = {GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER};
+    GLShader shaders[3];
 
     this->init();
 
-    // compile shaders
-    if ( !vshader.compileFromFile(vshaderFile, GL_VERTEX_SHADER) )
-    {
-        m_err = vshader.getLastError();
-        return false;
-    }
-    if ( gshaderFile != nullptr )
+    // start every compile and the link before checking any of them, the
+    // driver can work on them in parallel
+    for ( int i = 0; i < 3; ++i )
     {
-        if ( !gshader.compileFromFile(gshaderFile, GL_GEOMETRY_SHADER) )
+        if ( files[i] == nullptr )
+            continue;
+
+        std::string source;
+        if ( !readSource(files[i], source, m_err) )
+            return false;
+        if ( !shaders[i].submit(source, types[i], files[i]) )
         {
-            m_err = vshader.getLastError();
+            m_err = shaders[i].getLastError();
             return false;
         }
+        if ( !this->attachShader(shaders[i]) )
+            return false;
     }
-    if ( !fshader.compileFromFile(fshaderFile, GL_FRAGMENT_SHADER) )
-    {
-        m_err = fshader.getLastError();
-        return false;
-    }
+    this->submitLink();
 
-    // attach shaders
-    if ( !this->attachShader(vshader) )
-        return false;
-    if ( gshaderFile != nullptr )
-        if ( !this->attachShader(gshader) )
+    // a failed compile explains a failed link better
+    for ( int i = 0; i < 3; ++i )
+    {
+        if ( files[i] != nullptr && !shaders[i].finish() )
+        {
+            m_err = shaders[i].getLastError();
             return false;
-    if ( !this->attachShader(fshader) )
-        return false;
+        }
+    }
 
-    // link program
-    return this->link();
+    return this->finishLink();
 }
-
@@ -0,0 +1,118 @@
+#include "GLFramebuffer.hpp"
+
+GLFramebuffer::GLFramebuffer() :
+    m_targets(),
+    m_count(0)
+{}
+
+GLFramebuffer::~GLFramebuffer()
+{
+    this->clean();
+}
+
+void GLFramebuffer::clean()
+{
+    if ( m_targets == nullptr || m_targets.use_count() > 1 )
+        return;
+
+    for ( GLsizei i = 0; i < m_count; ++i )
+    {
+        glDeleteFramebuffers(1, &m_targets[i].framebuffer);
+        glDeleteRenderbuffers(1, &m_targets[i].color);
+        glDeleteRenderbuffers(1, &m_targets[i].depth);
+    }
+}
+
+bool GLFramebuffer::generate(GLsizei n)
+{
+    if ( n <= 0 )
+        return false;
+
+    Target *targets = new Target[n];
+    for ( GLsizei i = 0; i < n; ++i )
+    {
+        glGenFramebuffers(1, &targets[i].framebuffer);
+        glGenRenderbuffers(1, &targets[i].color);
+        glGenRenderbuffers(1, &targets[i].depth);
+        targets[i].width = 0;
+        targets[i].height = 0;
+    }
+
+    if ( targets[0].framebuffer == 0 )
+    {
+        delete [] targets;
+        return false;
+    }
+
+    this->clean();
+    m_targets = boost::shared_array<Target>(targets);
+    m_count = n;
+
+    return true;
+}
+
+bool GLFramebuffer::setSize(GLsizei width, GLsizei height, GLsizei idx)
+{
+    if ( m_targets == nullptr || idx >= m_count || width <= 0 || height <= 0 )
+        return false;
+
+    Target& target = m_targets[idx];
+    glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    target.width = width;
+    target.height = height;
+    return complete;
+}
+
+GLsizei GLFramebuffer::getWidth(GLsizei idx) const
+{
+    if ( m_targets != nullptr && idx < m_count )
+        return m_targets[idx].width;
+    return 0;
+}
+
+GLsizei GLFramebuffer::getHeight(GLsizei idx) const
+{
+    if ( m_targets != nullptr && idx < m_count )
+        return m_targets[idx].height;
+    return 0;
+}
+
+void GLFramebuffer::bind(GLenum target, GLsizei idx)
+{
+    if ( m_targets != nullptr && idx < m_count )
+        glBindFramebuffer(target, m_targets[idx].framebuffer);
+}
+
+void GLFramebuffer::unbindFramebuffers(GLenum target)
+{
+    glBindFramebuffer(target, 0);
+}
+
+void GLFramebuffer::blit(const GLint* source, const GLint* destination, GLsizei idx, GLenum filter)
+{
+    if ( m_targets == nullptr || idx >= m_count )
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_targets[idx].framebuffer);
+    glBlitFramebuffer(source[0], source[1], source[0] + source[2], source[1] + source[3],
+                      destination[0], destination[1], destination[0] + destination[2], destination[1] + destination[3],
+                      GL_COLOR_BUFFER_BIT, filter);
+}
+
+GLuint GLFramebuffer::getFramebufferIdx(GLsizei idx) const
+{
+    if ( m_targets != nullptr && idx < m_count )
+        return m_targets[idx].framebuffer;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef GLFRAMEBUFFER_HPP
+#define GLFRAMEBUFFER_HPP
+
+#include <GL/glew.h>
+#include <boost/shared_array.hpp>
+
+// Framebuffer objects with an RGBA8 color and a 24 bit depth renderbuffer
+// each, for drawing offscreen and blitting the result to the window.
+class GLFramebuffer
+{
+public:
+    GLFramebuffer();
+
+    // deleted if this holds the last copy
+    ~GLFramebuffer();
+
+    bool generate(GLsizei n = 1);
+
+    // (re)allocate the renderbuffers of framebuffer idx, false if the
+    // framebuffer isn't complete afterwards
+    bool setSize(GLsizei width, GLsizei height, GLsizei idx = 0);
+
+    GLsizei getWidth(GLsizei idx = 0) const;
+    GLsizei getHeight(GLsizei idx = 0) const;
+
+    // target is GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER
+    void bind(GLenum target, GLsizei idx = 0);
+    static void unbindFramebuffers(GLenum target = GL_FRAMEBUFFER);
+
+    // copy the color of the source rectangle (x, y, width, height) of
+    // framebuffer idx into the destination rectangle of the bound draw
+    // framebuffer, scaling with filter if the sizes differ
+    void blit(const GLint* source, const GLint* destination, GLsizei idx = 0, GLenum filter = GL_LINEAR);
+
+    GLuint getFramebufferIdx(GLsizei idx = 0) const;
+protected:
+    void clean();
+
+    struct Target
+    {
+        GLuint  framebuffer;
+        GLuint  color;
+        GLuint  depth;
+        GLsizei width;
+        GLsizei height;
+    };
+
+    boost::shared_array<Target> m_targets;
+    GLsizei                     m_count;
+};
+
+#endif // GLFRAMEBUFFER_HPP
@@ -0,0 +1,29 @@
+#ifndef GLHASH_HPP
+#define GLHASH_HPP
+
+#include <GL/glew.h>
+#include <string>
+#include <type_traits>
+
+// 32 bit FNV-1a hash used to look up uniforms, blocks and attributes by name.
+// glHash is constexpr so names known at build time can be hashed by the
+// compiler, use GL_HASH("name") to force that.
+const GLuint GL_HASH_BASIS = 2166136261u;
+const GLuint GL_HASH_PRIME = 16777619u;
+
+constexpr GLuint glHash(const char* str, GLuint hash = GL_HASH_BASIS)
+{
+    return *str == '\0' ? hash : glHash(str + 1, (hash ^ static_cast<GLuint>(static_cast<unsigned char>(*str))) * GL_HASH_PRIME);
+}
+
+inline GLuint glHash(const std::basic_string<GLchar>& str)
+{
+    GLuint hash = GL_HASH_BASIS;
+    for ( size_t i = 0; i < str.size(); ++i )
+        hash = (hash ^ static_cast<GLuint>(static_cast<unsigned char>(str[i]))) * GL_HASH_PRIME;
+    return hash;
+}
+
+#define GL_HASH(str) (std::integral_constant<GLuint, glHash(str)>::value)
+
+#endif // GLHASH_HPP
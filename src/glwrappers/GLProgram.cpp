@@ -1,29 +1,34 @@
 #include "GLProgram.hpp"
 
 #include "GLShader.hpp"
+#include "GLState.hpp"
 
+#include <algorithm>
+#include <iostream>
 #include <sstream>
-#include <stdexcept>
 
 #define CHECK_INIT if ( m_program == nullptr ) { m_err = "Program not initialized"; return false; }
 
 GLProgram::GLProgram() :
     m_program(nullptr),
     m_err(""),
-    m_attributes(nullptr),
-    m_uniforms(nullptr),
-    m_linked(false)
+    m_reflection(nullptr),
+    m_linked(false),
+    m_linkPending(false)
 {}
 
 GLProgram::~GLProgram()
 {
     if ( m_program != nullptr && m_program.use_count() == 1 )
+    {
+        GLState::forgetProgram(*m_program);
         glDeleteProgram(*m_program);
+    }
 }
     
 bool GLProgram::bindAttributeLocation(const GLstring& name, GLuint location)
 {
-    if ( m_program == nullptr || m_attributes == nullptr )
+    if ( m_program == nullptr )
     {
         m_err = "Program must be initialized before binding attribute locations";
         return false;
@@ -46,10 +51,8 @@ bool GLProgram::bindAttributeLocation(const GLstring& name, GLuint location)
         }
     }
 
+    // the attribute shows up in the lookup table once the program is linked
     glBindAttribLocation(*m_program, location, name.c_str());
-   
-    // add attribute to the map for lookup
-    m_attributes->insert(std::pair<GLstring,GLint>(name,static_cast<GLint>(location)));
 
     return true;
 }
@@ -57,13 +60,16 @@ bool GLProgram::bindAttributeLocation(const GLstring& name, GLuint location)
 GLProgram& GLProgram::operator=(const GLProgram &rhs)
 {
     if ( m_program != nullptr && m_program.use_count() == 1 )
+    {
+        GLState::forgetProgram(*m_program);
         glDeleteProgram(*m_program);
+    }
 
     m_err = rhs.m_err;
     m_program = rhs.m_program;
-    m_attributes = rhs.m_attributes;
-    m_uniforms = rhs.m_uniforms;
+    m_reflection = rhs.m_reflection;
     m_linked = rhs.m_linked;
+    m_linkPending = rhs.m_linkPending;
 
     return *this;
 }
@@ -71,14 +77,18 @@ GLProgram& GLProgram::operator=(const GLProgram &rhs)
 void GLProgram::init()
 {
     if ( m_program != nullptr && m_program.use_count() == 1 )
+    {
+        GLState::forgetProgram(*m_program);
         glDeleteProgram(*m_program);
+    }
 
     // create the program
     m_program = std::shared_ptr<GLuint>(new GLuint);
     *m_program = glCreateProgram();
 
-    m_attributes = std::shared_ptr<StringMap>(new StringMap());
-    m_uniforms = std::shared_ptr<StringMap>(new StringMap());
+    m_reflection = std::shared_ptr<Reflection>(new Reflection());
+    m_linked = false;
+    m_linkPending = false;
 }
 
 bool GLProgram::attachShader(const GLShader &shader)
@@ -140,16 +150,47 @@ bool GLProgram::detachShader(const GLShader &shader)
 }
 
 bool GLProgram::link()
+{
+    return this->submitLink() && this->finishLink();
+}
+
+bool GLProgram::submitLink()
+{
+    CHECK_INIT
+
+    // link program, the result is checked by finishLink
+    glLinkProgram(*m_program);
+    m_linkPending = true;
+
+    return true;
+}
+
+bool GLProgram::isLinkReady() const
+{
+    if ( !m_linkPending || m_program == nullptr || !GLState::hasParallelShaderCompile() )
+        return true;
+
+    GLint done = GL_TRUE;
+    glGetProgramiv(*m_program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool GLProgram::finishLink()
 {
     CHECK_INIT
 
+    if ( !m_linkPending )
+    {
+        if ( !m_linked )
+            m_err = "Program was never linked";
+        return m_linked;
+    }
+    m_linkPending = false;
+
     GLint linkStatus;
     GLint linkLogSize;
     GLchar *linkLog;
 
-    // link program
-    glLinkProgram(*m_program);
-
     // check status
     glGetProgramiv(*m_program, GL_LINK_STATUS, &linkStatus);
     if ( linkStatus != GL_TRUE )
@@ -169,9 +210,148 @@ bool GLProgram::link()
     }
 
     m_linked = true;
+
+    // build the lookup tables now so nothing has to be queried later
+    this->reflect();
+
     return true;
 }
 
+void GLProgram::reflect()
+{
+    Reflection &reflection = *m_reflection;
+    reflection.uniforms.clear();
+    reflection.blocks.clear();
+    reflection.attributes.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    GLsizei length = 0;
+    std::vector<GLchar> name;
+
+    // uniforms (including the members of uniform blocks)
+    glGetProgramiv(*m_program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(*m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    if ( count > 0 )
+    {
+        std::vector<GLuint> indices(count);
+        std::vector<GLint> types(count), sizes(count), offsets(count), blockIndices(count);
+        for ( GLint i = 0; i < count; ++i )
+            indices[i] = i;
+
+        // query everything at once instead of per uniform
+        glGetActiveUniformsiv(*m_program, count, indices.data(), GL_UNIFORM_TYPE, types.data());
+        glGetActiveUniformsiv(*m_program, count, indices.data(), GL_UNIFORM_SIZE, sizes.data());
+        glGetActiveUniformsiv(*m_program, count, indices.data(), GL_UNIFORM_OFFSET, offsets.data());
+        glGetActiveUniformsiv(*m_program, count, indices.data(), GL_UNIFORM_BLOCK_INDEX, blockIndices.data());
+
+        name.resize(maxLength + 1);
+        for ( GLint i = 0; i < count; ++i )
+        {
+            glGetActiveUniformName(*m_program, indices[i], maxLength + 1, &length, name.data());
+
+            ResourceInfo info;
+            info.name = GLstring(name.data(), length);
+            info.hash = glHash(info.name);
+            info.type = static_cast<GLenum>(types[i]);
+            info.size = sizes[i];
+            info.offset = offsets[i];
+            info.blockIndex = blockIndices[i];
+
+            // block members don't have locations
+            info.location = info.blockIndex == -1 ? glGetUniformLocation(*m_program, name.data()) : -1;
+            reflection.uniforms.push_back(info);
+
+            // arrays are reported as "name[0]", also allow looking them up by "name"
+            if ( info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0 )
+            {
+                info.name.erase(info.name.size() - 3);
+                info.hash = glHash(info.name);
+                reflection.uniforms.push_back(info);
+
+                // and the other elements by "name[j]", resolved here so no name
+                // is ever looked up while drawing (block members have no
+                // locations, only offsets)
+                const GLstring base = info.name;
+                const GLint size = info.size;
+                for ( GLint j = 1; info.blockIndex == -1 && j < size; ++j )
+                {
+                    std::ostringstream sout;
+                    sout << base << "[" << j << "]";
+                    info.name = sout.str();
+                    info.hash = glHash(info.name);
+                    info.size = size - j;
+                    info.location = glGetUniformLocation(*m_program, info.name.c_str());
+                    reflection.uniforms.push_back(info);
+                }
+            }
+        }
+    }
+
+    // uniform blocks
+    count = maxLength = 0;
+    glGetProgramiv(*m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(*m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for ( GLint i = 0; i < count; ++i )
+    {
+        glGetActiveUniformBlockName(*m_program, i, maxLength + 1, &length, name.data());
+
+        ResourceInfo info;
+        info.name = GLstring(name.data(), length);
+        info.hash = glHash(info.name);
+        info.location = i;
+        info.type = GL_NONE;
+        info.offset = -1;
+        info.blockIndex = i;
+        glGetActiveUniformBlockiv(*m_program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &info.size);
+        reflection.blocks.push_back(info);
+    }
+
+    // attributes
+    count = maxLength = 0;
+    glGetProgramiv(*m_program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(*m_program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    name.resize(maxLength + 1);
+    for ( GLint i = 0; i < count; ++i )
+    {
+        ResourceInfo info;
+        glGetActiveAttrib(*m_program, i, maxLength + 1, &length, &info.size, &info.type, name.data());
+        info.name = GLstring(name.data(), length);
+        info.hash = glHash(info.name);
+        info.location = glGetAttribLocation(*m_program, name.data());
+        info.offset = -1;
+        info.blockIndex = -1;
+        reflection.attributes.push_back(info);
+    }
+
+    sortTable(reflection.uniforms);
+    sortTable(reflection.blocks);
+    sortTable(reflection.attributes);
+}
+
+void GLProgram::sortTable(std::vector<ResourceInfo>& table)
+{
+    std::sort(table.begin(), table.end(),
+        [](const ResourceInfo& a, const ResourceInfo& b) { return a.hash < b.hash; });
+
+    // two names with the same hash would make one of them unreachable
+    for ( size_t i = 1; i < table.size(); ++i )
+        if ( table[i].hash == table[i-1].hash )
+            std::cout << "Warning: \"" << table[i].name << "\" and \"" << table[i-1].name
+                      << "\" have the same hash, only one can be looked up" << std::endl;
+}
+
+const GLProgram::ResourceInfo* GLProgram::find(const std::vector<ResourceInfo>& table, GLuint hash)
+{
+    std::vector<ResourceInfo>::const_iterator it = std::lower_bound(table.begin(), table.end(), hash,
+        [](const ResourceInfo& info, GLuint value) { return info.hash < value; });
+
+    if ( it != table.end() && it->hash == hash )
+        return &(*it);
+    return nullptr;
+}
+
 const std::string& GLProgram::getLastError() const
 {
     return m_err;
@@ -179,12 +359,27 @@ const std::string& GLProgram::getLastError() const
 
 void GLProgram::use()
 {
-    glUseProgram(m_program == nullptr ? 0 : *m_program);
+    GLState::useProgram(m_program == nullptr ? 0 : *m_program);
 }
 
 void GLProgram::resetUsed()
 {
-    glUseProgram(0);
+    GLState::useProgram(0);
+}
+    
+const GLProgram::ResourceInfo* GLProgram::findUniform(GLuint hash) const
+{
+    return m_reflection == nullptr ? nullptr : find(m_reflection->uniforms, hash);
+}
+
+const GLProgram::ResourceInfo* GLProgram::findUniformBlock(GLuint hash) const
+{
+    return m_reflection == nullptr ? nullptr : find(m_reflection->blocks, hash);
+}
+
+const GLProgram::ResourceInfo* GLProgram::findAttribute(GLuint hash) const
+{
+    return m_reflection == nullptr ? nullptr : find(m_reflection->attributes, hash);
 }
     
 GLint GLProgram::getUniformLocation(const GLstring& name)
@@ -195,23 +390,21 @@ GLint GLProgram::getUniformLocation(const GLstring& name)
         return -1;
     }
 
-    GLint loc;
-
-    try {
-        loc = m_uniforms->at(name);
-    } catch ( const std::out_of_range &e ) {
-        loc = glGetUniformLocation(*m_program, name.c_str());
-        if ( loc == -1 )
-        {
-            std::ostringstream sout;
-            sout << "Could not get location of uniform \"" << name << "\"";
-            m_err = sout.str();
-            return -1;
-        }
-
-        m_uniforms->insert(std::pair<GLstring,GLint>(name,loc));
+    const ResourceInfo* info = this->findUniform(glHash(name));
+    if ( info == nullptr || info->name != name )
+    {
+        std::ostringstream sout;
+        sout << "Could not get location of uniform \"" << name << "\"";
+        m_err = sout.str();
+        return -1;
     }
-    return loc;
+    return info->location;
+}
+
+GLint GLProgram::getUniformLocation(GLuint hash) const
+{
+    const ResourceInfo* info = this->findUniform(hash);
+    return info == nullptr ? -1 : info->location;
 }
 
 GLint GLProgram::getAttributeLocation(const GLstring& name)
@@ -222,23 +415,74 @@ GLint GLProgram::getAttributeLocation(const GLstring& name)
         return -1;
     }
 
-    GLint loc;
+    const ResourceInfo* info = this->findAttribute(glHash(name));
+    if ( info == nullptr || info->name != name )
+    {
+        std::ostringstream sout;
+        sout << "Could not get location of attribute \"" << name << "\"";
+        m_err = sout.str();
+        return -1;
+    }
+    return info->location;
+}
 
-    try {
-        loc = m_attributes->at(name);
-    } catch ( const std::out_of_range &e ) {
-        loc = glGetAttribLocation(*m_program, name.c_str());
-        if ( loc == -1 )
-        {
-            std::ostringstream sout;
-            sout << "Could not get location of attribute \"" << name << "\"";
-            m_err = sout.str();
-            return -1;
-        }
+GLint GLProgram::getAttributeLocation(GLuint hash) const
+{
+    const ResourceInfo* info = this->findAttribute(hash);
+    return info == nullptr ? -1 : info->location;
+}
 
-        m_attributes->insert(std::pair<GLstring,GLint>(name,loc));
+GLuint GLProgram::getUniformBlockIndex(const GLstring& name)
+{
+    if ( m_program == nullptr )
+    {
+        m_err = "Program not initialized";
+        return GL_INVALID_INDEX;
+    }
+
+    const ResourceInfo* info = this->findUniformBlock(glHash(name));
+    if ( info == nullptr || info->name != name )
+    {
+        std::ostringstream sout;
+        sout << "Could not find uniform block \"" << name << "\"";
+        m_err = sout.str();
+        return GL_INVALID_INDEX;
     }
-    return loc;
+    return static_cast<GLuint>(info->location);
+}
+
+GLuint GLProgram::getUniformBlockIndex(GLuint hash) const
+{
+    const ResourceInfo* info = this->findUniformBlock(hash);
+    return info == nullptr ? GL_INVALID_INDEX : static_cast<GLuint>(info->location);
+}
+
+bool GLProgram::bindUniformBlock(const GLstring& name, GLuint binding)
+{
+    GLuint blockIdx = this->getUniformBlockIndex(name);
+    if ( blockIdx == GL_INVALID_INDEX )
+        return false;
+
+    glUniformBlockBinding(*m_program, blockIdx, binding);
+    return true;
+}
+
+const std::vector<GLProgram::ResourceInfo>& GLProgram::getUniforms() const
+{
+    static const std::vector<ResourceInfo> empty;
+    return m_reflection == nullptr ? empty : m_reflection->uniforms;
+}
+
+const std::vector<GLProgram::ResourceInfo>& GLProgram::getUniformBlocks() const
+{
+    static const std::vector<ResourceInfo> empty;
+    return m_reflection == nullptr ? empty : m_reflection->blocks;
+}
+
+const std::vector<GLProgram::ResourceInfo>& GLProgram::getAttributes() const
+{
+    static const std::vector<ResourceInfo> empty;
+    return m_reflection == nullptr ? empty : m_reflection->attributes;
 }
 
 GLuint GLProgram::getProgramIdx() const
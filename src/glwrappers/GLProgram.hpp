@@ -4,15 +4,29 @@
 #include <GL/glew.h>
 #include <memory>
 #include <string>
-#include <map>
 #include <vector>
 
+#include "GLHash.hpp"
+
 class GLShader;
 
 class GLProgram
 {
 public:
     typedef std::basic_string<GLchar> GLstring;
+
+    // An active uniform, uniform block or attribute found when the program was
+    // linked. Pointers to these stay valid until the program is linked again.
+    struct ResourceInfo
+    {
+        GLuint   hash;        // glHash(name)
+        GLint    location;    // location for uniforms/attributes, block index for blocks
+        GLenum   type;        // GL_FLOAT_VEC3, ... (GL_NONE for blocks)
+        GLint    size;        // array size, data size in bytes for blocks
+        GLint    offset;      // offset inside the block for block members, otherwise -1
+        GLint    blockIndex;  // block the uniform belongs to, otherwise -1
+        GLstring name;
+    };
     
     GLProgram();
 
@@ -31,10 +45,17 @@ public:
     // bind attribute locations must be done before linking
     bool bindAttributeLocation(const GLstring& name, GLuint location);
 
-    // link the program.
+    // link the program and build the tables of active uniforms, uniform
+    // blocks and attributes.
     // returns false on failure. To get error log use getLastError()
     bool link();
 
+    // link() in steps so many programs can link at once (see GLShader::submit).
+    // The shaders may still be compiling when submitLink is called.
+    bool submitLink();
+    bool isLinkReady() const;
+    bool finishLink();
+
     // returns a string describing the most recent error
     const std::string& getLastError() const;
 
@@ -44,25 +65,57 @@ public:
     // calls glUseProgram(0)
     static void resetUsed();
 
+    // Lookups into the tables built by link(). The hash versions never compare
+    // strings or touch OpenGL, use them with GL_HASH("name") in frame code.
+    // Array uniforms can be found as "name", "name[0]" and by element
+    // ("name[2]"), block members and struct fields as GL reports them.
+    const ResourceInfo* findUniform(GLuint hash) const;
+    const ResourceInfo* findUniformBlock(GLuint hash) const;
+    const ResourceInfo* findAttribute(GLuint hash) const;
+
     // query the shader for the uniform location
     GLint getUniformLocation(const GLstring& name);
+    GLint getUniformLocation(GLuint hash) const;
 
     // query the shader for the attribute location
     GLint getAttributeLocation(const GLstring& name);
+    GLint getAttributeLocation(GLuint hash) const;
+
+    // returns GL_INVALID_INDEX if the block isn't active
+    GLuint getUniformBlockIndex(const GLstring& name);
+    GLuint getUniformBlockIndex(GLuint hash) const;
+
+    // binds the named uniform block to a binding point (UB_MATRICES, ...)
+    bool bindUniformBlock(const GLstring& name, GLuint binding);
+
+    // the full tables (sorted by hash)
+    const std::vector<ResourceInfo>& getUniforms() const;
+    const std::vector<ResourceInfo>& getUniformBlocks() const;
+    const std::vector<ResourceInfo>& getAttributes() const;
 
     // shouldn't really be used
     GLuint getProgramIdx() const;
 protected:
-    typedef std::map<GLstring,GLint> StringMap;
+    struct Reflection
+    {
+        std::vector<ResourceInfo> uniforms;
+        std::vector<ResourceInfo> blocks;
+        std::vector<ResourceInfo> attributes;
+    };
+
+    // fill m_reflection from the linked program
+    void reflect();
+
+    static const ResourceInfo* find(const std::vector<ResourceInfo>& table, GLuint hash);
+    static void sortTable(std::vector<ResourceInfo>& table);
 
     std::shared_ptr<GLuint> m_program;
     std::string m_err;
 
-    std::shared_ptr<StringMap> m_attributes;
-    std::shared_ptr<StringMap> m_uniforms;
+    std::shared_ptr<Reflection> m_reflection;
 
     bool m_linked;
+    bool m_linkPending;
 };
 
 #endif // GLPROGRAM_HPP
-
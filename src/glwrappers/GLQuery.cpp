@@ -0,0 +1,90 @@
+#include "GLQuery.hpp"
+
+GLQuery::GLQuery() :
+    m_queries(),
+    m_issued(),
+    m_count(0)
+{}
+
+GLQuery::~GLQuery()
+{
+    this->clean();
+}
+
+void GLQuery::clean()
+{
+    if ( m_queries != nullptr && m_queries.use_count() <= 1 )
+        glDeleteQueries(m_count, m_queries.get());
+}
+
+bool GLQuery::generate(GLsizei n)
+{
+    if ( n <= 0 )
+        return false;
+
+    GLuint *queries = new GLuint[n];
+    bool   *issued = new bool[n];
+    glGenQueries(n, queries);
+    if ( *queries == 0 )
+    {
+        delete [] queries;
+        delete [] issued;
+        return false;
+    }
+
+    for ( GLsizei i = 0; i < n; ++i )
+        issued[i] = false;
+
+    this->clean();
+    m_queries = boost::shared_array<GLuint>(queries);
+    m_issued = boost::shared_array<bool>(issued);
+    m_count = n;
+
+    return true;
+}
+
+void GLQuery::begin(GLenum target, GLsizei idx)
+{
+    if ( m_queries != nullptr && idx < m_count )
+    {
+        glBeginQuery(target, m_queries[idx]);
+        m_issued[idx] = true;
+    }
+}
+
+void GLQuery::end(GLenum target)
+{
+    glEndQuery(target);
+}
+
+bool GLQuery::isIssued(GLsizei idx) const
+{
+    return m_queries != nullptr && idx < m_count && m_issued[idx];
+}
+
+bool GLQuery::isAvailable(GLsizei idx) const
+{
+    if ( !this->isIssued(idx) )
+        return false;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(m_queries[idx], GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+GLuint64 GLQuery::getResult(GLsizei idx) const
+{
+    if ( !this->isIssued(idx) )
+        return 0;
+
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(m_queries[idx], GL_QUERY_RESULT, &result);
+    return result;
+}
+
+GLuint GLQuery::getQueryIdx(GLsizei idx) const
+{
+    if ( m_queries != nullptr && idx < m_count )
+        return m_queries[idx];
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef GLQUERY_HPP
+#define GLQUERY_HPP
+
+#include <GL/glew.h>
+#include <boost/shared_array.hpp>
+
+// Query objects (GL_SAMPLES_PASSED, GL_TIME_ELAPSED, ...). Results arrive a
+// frame or two late, poll isAvailable before getResult so nothing waits on
+// the GPU.
+class GLQuery
+{
+public:
+    GLQuery();
+
+    // deleted if this holds the last copy
+    ~GLQuery();
+
+    bool generate(GLsizei n = 1);
+
+    // only one query per target can be active at a time
+    void begin(GLenum target, GLsizei idx = 0);
+    static void end(GLenum target);
+
+    // true if query idx has been issued at least once
+    bool isIssued(GLsizei idx = 0) const;
+
+    // true if the result of the last begin/end of idx is ready
+    bool isAvailable(GLsizei idx = 0) const;
+
+    // waits for the result if it isn't available
+    GLuint64 getResult(GLsizei idx = 0) const;
+
+    GLuint getQueryIdx(GLsizei idx = 0) const;
+protected:
+    void clean();
+
+    boost::shared_array<GLuint> m_queries;
+    boost::shared_array<bool>   m_issued;
+    GLsizei                     m_count;
+};
+
+#endif // GLQUERY_HPP
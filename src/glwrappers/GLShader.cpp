@@ -1,12 +1,16 @@
 #include "GLShader.hpp"
 
+#include "GLState.hpp"
+
 #include <sstream>
 #include <fstream>
 
 GLShader::GLShader() :
     m_err(""),
     m_shader(nullptr),
-    m_type(GL_SHADER_TYPE)
+    m_type(GL_SHADER_TYPE),
+    m_name(""),
+    m_pending(false)
 {}
 
 GLShader::~GLShader()
@@ -19,13 +23,6 @@ GLShader::~GLShader()
 
 bool GLShader::compileFromFile(const char* filename, GLenum shaderType)
 {
-    GLuint shader;
-    GLchar *shaderSource;
-    GLchar *shaderLog;
-    GLint shaderSourceSize;
-    GLint shaderStatus;
-    GLint shaderLogSize;
-
     // open the file
     std::ifstream fin(filename, std::ios::binary);
     if ( !fin.good() )
@@ -37,16 +34,22 @@ bool GLShader::compileFromFile(const char* filename, GLenum shaderType)
     }
 
     // read file
-    fin.seekg( 0, std::ios::end );
-    shaderSourceSize = fin.tellg();
-    fin.seekg( 0, std::ios::beg );
-    
-    shaderSource = new GLchar[shaderSourceSize];
-    fin.read( shaderSource, shaderSourceSize );
+    std::ostringstream source;
+    source << fin.rdbuf();
     fin.close();
 
+    return this->compileFromSource(source.str(), shaderType, filename);
+}
+
+bool GLShader::compileFromSource(const std::string& source, GLenum shaderType, const char* name)
+{
+    return this->submit(source, shaderType, name) && this->finish();
+}
+
+bool GLShader::submit(const std::string& source, GLenum shaderType, const char* name)
+{
     // create the shader
-    shader = glCreateShader(shaderType);
+    GLuint shader = glCreateShader(shaderType);
     if ( shader == 0 )
     {
         m_err = "Invalid shader type";
@@ -54,36 +57,72 @@ bool GLShader::compileFromFile(const char* filename, GLenum shaderType)
     }
     
     // load source
-    glShaderSource(shader, 1, const_cast<const GLchar**>(&shaderSource), &shaderSourceSize);
-    delete [] shaderSource;
+    const GLchar* shaderSource = source.c_str();
+    const GLint shaderSourceSize = source.size();
+    glShaderSource(shader, 1, &shaderSource, &shaderSourceSize);
 
-    // compile shader
+    // compile shader, the result is checked by finish
     glCompileShader(shader);
-    
+
+    // initialize the class variable
+    if ( m_shader != nullptr && m_shader.use_count() <= 1 )
+        glDeleteShader(*m_shader);
+    m_shader = std::shared_ptr<GLuint>(new GLuint);
+    *m_shader = shader;
+    m_type = shaderType;
+    m_name = name;
+    m_pending = true;
+    m_err = "";
+
+    return true;
+}
+
+bool GLShader::isReady() const
+{
+    if ( !m_pending || m_shader == nullptr || !GLState::hasParallelShaderCompile() )
+        return true;
+
+    GLint done = GL_TRUE;
+    glGetShaderiv(*m_shader, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool GLShader::finish()
+{
+    // a failed compile keeps its log in m_err
+    if ( m_shader == nullptr )
+    {
+        if ( m_err.empty() )
+            m_err = "Shader not initialized";
+        return false;
+    }
+    if ( !m_pending )
+        return true;
+    m_pending = false;
+
     // check compile status
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderStatus);
+    GLint shaderStatus;
+    glGetShaderiv(*m_shader, GL_COMPILE_STATUS, &shaderStatus);
     if ( shaderStatus != GL_TRUE )
     {
         std::ostringstream sout;
 
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &shaderLogSize);
-        shaderLog = new GLchar[shaderLogSize];
-        glGetShaderInfoLog(shader, shaderLogSize, nullptr, shaderLog);
+        GLint shaderLogSize;
+        glGetShaderiv(*m_shader, GL_INFO_LOG_LENGTH, &shaderLogSize);
+        GLchar *shaderLog = new GLchar[shaderLogSize];
+        glGetShaderInfoLog(*m_shader, shaderLogSize, nullptr, shaderLog);
 
-        sout << "Failed to compile \"" << filename << '\"' << std::endl
+        sout << "Failed to compile \"" << m_name << '\"' << std::endl
              << shaderLog;
         m_err = sout.str();
 
-        glDeleteShader(shader);
+        delete [] shaderLog;
+        if ( m_shader.use_count() <= 1 )
+            glDeleteShader(*m_shader);
+        m_shader = nullptr;
         return false;
     }
 
-    // initialize the class variable
-    if ( m_shader != nullptr && m_shader.use_count() <= 1 )
-        glDeleteShader(*m_shader);
-    m_shader = std::shared_ptr<GLuint>(new GLuint);
-    *m_shader = shader;
-
     return true;
 }
 
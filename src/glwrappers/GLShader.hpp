@@ -22,6 +22,17 @@ public:
     // returns false on failure. To get error log use getCompileErrors()
     bool compileFromFile(const char* filename, GLenum shaderType);
 
+    // same as compileFromFile, name is only used in error messages
+    bool compileFromSource(const std::string& source, GLenum shaderType, const char* name = "source");
+
+    // compileFromSource in two steps so many shaders can compile at once.
+    // submit starts the compile, finish waits for it and checks the result,
+    // isReady tells if finish would have to wait (see
+    // GLState::hasParallelShaderCompile).
+    bool submit(const std::string& source, GLenum shaderType, const char* name = "source");
+    bool isReady() const;
+    bool finish();
+
     // get error strings with this if compileFromFile fails
     const std::string& getLastError() const;
     
@@ -31,6 +42,10 @@ protected:
     std::shared_ptr<GLuint> m_shader;
     GLenum m_type;
 
+    // submitted and not checked yet
+    std::string m_name;
+    bool m_pending;
+
     friend class GLProgram;
 };
 
@@ -0,0 +1,347 @@
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef GLSTATE_DEBUG
+    #include <iostream>
+#endif
+
+namespace
+{
+    // value of a binding that isn't known (the next bind is always issued)
+    const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    const GLenum BUFFER_TARGETS[] = {
+        GL_ARRAY_BUFFER, GL_ATOMIC_COUNTER_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+        GL_DISPATCH_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_ELEMENT_ARRAY_BUFFER,
+        GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_SHADER_STORAGE_BUFFER,
+        GL_TEXTURE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER, GL_UNIFORM_BUFFER
+    };
+    const int BUFFER_TARGET_COUNT = sizeof(BUFFER_TARGETS)/sizeof(GLenum);
+
+    const GLenum INDEXED_TARGETS[] = {
+        GL_ATOMIC_COUNTER_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER, GL_UNIFORM_BUFFER
+    };
+    const int INDEXED_TARGET_COUNT = sizeof(INDEXED_TARGETS)/sizeof(GLenum);
+    const GLuint MAX_INDEXED = 32;
+
+    const GLenum TEXTURE_TARGETS[] = {
+        GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY,
+        GL_TEXTURE_RECTANGLE, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BUFFER,
+        GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE_ARRAY
+    };
+    const int TEXTURE_TARGET_COUNT = sizeof(TEXTURE_TARGETS)/sizeof(GLenum);
+    const GLuint MAX_TEXTURE_UNITS = 32;
+
+    struct IndexedBinding
+    {
+        GLuint     buffer;
+        GLintptr   offset;
+        GLsizeiptr size;    // -1 for glBindBufferBase
+    };
+
+    struct State
+    {
+        GLuint         program;
+        GLuint         vao;
+        GLuint         buffers[BUFFER_TARGET_COUNT];
+        IndexedBinding indexed[INDEXED_TARGET_COUNT][MAX_INDEXED];
+        GLenum         activeUnit;
+        GLuint         textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    };
+
+    State              g_state;
+    GLState::Counters  g_counters;
+    GLState::Counters  g_frameCounters;
+    bool               g_initialized = false;
+
+    // -1 until checked for the current context
+    int                g_directStateAccess = -1;
+    int                g_parallelShaderCompile = -1;
+    GLint              g_uniformBufferAlignment = -1;
+
+    template <typename T, int N>
+    int findTarget(const T (&targets)[N], GLenum target)
+    {
+        for ( int i = 0; i < N; ++i )
+            if ( targets[i] == target )
+                return i;
+        return -1;
+    }
+
+    State& state()
+    {
+        if ( !g_initialized )
+            GLState::invalidate();
+        return g_state;
+    }
+
+    // returns true if the call has to be issued and counts it
+    inline bool update(GLuint& current, GLuint value, GLState::CallType type)
+    {
+        if ( current == value )
+        {
+            g_counters.elided[type]++;
+            return false;
+        }
+        current = value;
+        g_counters.issued[type]++;
+        return true;
+    }
+
+    inline void issue(GLState::CallType type)
+    {
+        g_counters.issued[type]++;
+    }
+}
+
+unsigned int GLState::Counters::totalIssued() const
+{
+    unsigned int total = 0;
+    for ( int i = 0; i < CALL_TYPE_COUNT; ++i )
+        total += issued[i];
+    return total;
+}
+
+unsigned int GLState::Counters::totalElided() const
+{
+    unsigned int total = 0;
+    for ( int i = 0; i < CALL_TYPE_COUNT; ++i )
+        total += elided[i];
+    return total;
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if ( update(state().program, program, CALL_PROGRAM) )
+        glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    State& s = state();
+    if ( update(s.vao, vao, CALL_VERTEX_ARRAY) )
+    {
+        glBindVertexArray(vao);
+        s.buffers[findTarget(BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    const int t = findTarget(BUFFER_TARGETS, target);
+    if ( t < 0 )
+    {
+        issue(CALL_BUFFER);
+        glBindBuffer(target, buffer);
+    }
+    else if ( update(state().buffers[t], buffer, CALL_BUFFER) )
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    GLState::bindBufferRange(target, index, buffer, 0, -1);
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    State& s = state();
+    const int t = findTarget(INDEXED_TARGETS, target);
+    if ( t >= 0 && index < MAX_INDEXED )
+    {
+        IndexedBinding& binding = s.indexed[t][index];
+        if ( binding.buffer == buffer && binding.offset == offset && binding.size == size )
+        {
+            g_counters.elided[CALL_BUFFER_INDEXED]++;
+
+            // the generic binding may have moved on since
+            GLState::bindBuffer(target, buffer);
+            return;
+        }
+        binding.buffer = buffer;
+        binding.offset = offset;
+        binding.size = size;
+    }
+
+    issue(CALL_BUFFER_INDEXED);
+    if ( size < 0 )
+        glBindBufferBase(target, index, buffer);
+    else
+        glBindBufferRange(target, index, buffer, offset, size);
+
+    const int g = findTarget(BUFFER_TARGETS, target);
+    if ( g >= 0 )
+        s.buffers[g] = buffer;
+}
+
+void GLState::activeTexture(GLenum unit)
+{
+    if ( update(state().activeUnit, unit, CALL_ACTIVE_TEXTURE) )
+        glActiveTexture(unit);
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+    State& s = state();
+    const GLuint unit = s.activeUnit - GL_TEXTURE0;
+    const int t = findTarget(TEXTURE_TARGETS, target);
+    if ( s.activeUnit == UNKNOWN || unit >= MAX_TEXTURE_UNITS || t < 0 )
+    {
+        issue(CALL_TEXTURE);
+        glBindTexture(target, texture);
+    }
+    else if ( update(s.textures[unit][t], texture, CALL_TEXTURE) )
+    {
+        glBindTexture(target, texture);
+    }
+}
+
+void GLState::forgetProgram(GLuint program)
+{
+    // a deleted program stays in use until something else is used
+    if ( state().program == program )
+        g_state.program = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(GLuint vao)
+{
+    State& s = state();
+    if ( s.vao == vao )
+    {
+        s.vao = 0;
+        s.buffers[findTarget(BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+}
+
+void GLState::forgetBuffer(GLuint buffer)
+{
+    State& s = state();
+    for ( int i = 0; i < BUFFER_TARGET_COUNT; ++i )
+        if ( s.buffers[i] == buffer )
+            s.buffers[i] = 0;
+    for ( int i = 0; i < INDEXED_TARGET_COUNT; ++i )
+        for ( GLuint j = 0; j < MAX_INDEXED; ++j )
+            if ( s.indexed[i][j].buffer == buffer )
+                s.indexed[i][j].buffer = UNKNOWN;
+}
+
+void GLState::forgetTexture(GLuint texture)
+{
+    State& s = state();
+    for ( GLuint i = 0; i < MAX_TEXTURE_UNITS; ++i )
+        for ( int j = 0; j < TEXTURE_TARGET_COUNT; ++j )
+            if ( s.textures[i][j] == texture )
+                s.textures[i][j] = 0;
+}
+
+void GLState::invalidate()
+{
+    g_state.program = UNKNOWN;
+    g_state.vao = UNKNOWN;
+    g_state.activeUnit = UNKNOWN;
+    for ( int i = 0; i < BUFFER_TARGET_COUNT; ++i )
+        g_state.buffers[i] = UNKNOWN;
+    for ( int i = 0; i < INDEXED_TARGET_COUNT; ++i )
+        for ( GLuint j = 0; j < MAX_INDEXED; ++j )
+            g_state.indexed[i][j].buffer = UNKNOWN;
+    for ( GLuint i = 0; i < MAX_TEXTURE_UNITS; ++i )
+        for ( int j = 0; j < TEXTURE_TARGET_COUNT; ++j )
+            g_state.textures[i][j] = UNKNOWN;
+    g_initialized = true;
+    g_directStateAccess = -1;
+    g_parallelShaderCompile = -1;
+    g_uniformBufferAlignment = -1;
+}
+
+GLuint GLState::getVertexArray()
+{
+    return state().vao == UNKNOWN ? 0 : g_state.vao;
+}
+
+bool GLState::hasDirectStateAccess()
+{
+    if ( g_directStateAccess < 0 )
+        g_directStateAccess = (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access) ? 1 : 0;
+    return g_directStateAccess == 1;
+}
+
+void GLState::setDirectStateAccess(bool enable)
+{
+    g_directStateAccess = enable && (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access) ? 1 : 0;
+}
+
+bool GLState::hasParallelShaderCompile()
+{
+    if ( g_parallelShaderCompile < 0 )
+    {
+        // let the driver use as many threads as it likes
+        g_parallelShaderCompile = 1;
+        if ( GLEW_KHR_parallel_shader_compile )
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if ( GLEW_ARB_parallel_shader_compile )
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        else
+            g_parallelShaderCompile = 0;
+    }
+    return g_parallelShaderCompile == 1;
+}
+
+size_t GLState::getUniformBlockStride(size_t blockSize)
+{
+    if ( g_uniformBufferAlignment < 0 )
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        g_uniformBufferAlignment = std::max(alignment, 16);
+    }
+    const size_t alignment = g_uniformBufferAlignment;
+    return ((blockSize + alignment - 1) / alignment) * alignment;
+}
+
+bool GLState::waitFence(GLsync fence)
+{
+    // flush so the fence can signal at all, then wait in 100 ms steps
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+    while ( result == GL_TIMEOUT_EXPIRED )
+        result = glClientWaitSync(fence, 0, 100000000);
+
+    glDeleteSync(fence);
+    return result != GL_WAIT_FAILED;
+}
+
+const GLState::Counters& GLState::getCounters()
+{
+    return g_counters;
+}
+
+const GLState::Counters& GLState::getFrameCounters()
+{
+    return g_frameCounters;
+}
+
+void GLState::endFrame()
+{
+#ifdef GLSTATE_DEBUG
+    static const char* NAMES[CALL_TYPE_COUNT] = {
+        "program", "vao", "buffer", "buffer base", "active tex", "texture"
+    };
+
+    // only report when the counts change to keep the output readable
+    if ( std::memcmp(&g_counters, &g_frameCounters, sizeof(Counters)) != 0 )
+    {
+        std::cout << "GLState: " << g_counters.totalIssued() << " issued, "
+                  << g_counters.totalElided() << " elided (";
+        for ( int i = 0; i < CALL_TYPE_COUNT; ++i )
+            std::cout << (i == 0 ? "" : ", ") << NAMES[i] << ' '
+                      << g_counters.issued[i] << '/' << g_counters.elided[i];
+        std::cout << ')' << std::endl;
+    }
+#endif
+
+    g_frameCounters = g_counters;
+    std::memset(&g_counters, 0, sizeof(Counters));
+}
@@ -0,0 +1,98 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+
+// Shadow copy of the binding state of the current context. The glwrappers
+// classes bind through here so a bind that matches what is already bound is
+// skipped. Anything that changes bindings behind its back (another library,
+// raw gl calls) must be followed by invalidate().
+//
+// Only one context is tracked, everything must be called from the thread that
+// owns it.
+//
+// Define GLSTATE_DEBUG to report the issued/elided counts each frame.
+class GLState
+{
+public:
+    enum CallType {
+        CALL_PROGRAM        = 0,
+        CALL_VERTEX_ARRAY   = 1,
+        CALL_BUFFER         = 2,
+        CALL_BUFFER_INDEXED = 3,
+        CALL_ACTIVE_TEXTURE = 4,
+        CALL_TEXTURE        = 5,
+        CALL_TYPE_COUNT     = 6
+    };
+
+    // number of bind calls sent to OpenGL and skipped, per CallType
+    struct Counters
+    {
+        unsigned int issued[CALL_TYPE_COUNT];
+        unsigned int elided[CALL_TYPE_COUNT];
+
+        unsigned int totalIssued() const;
+        unsigned int totalElided() const;
+    };
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vao);
+
+    // GL_ELEMENT_ARRAY_BUFFER is part of the vertex array state so it is
+    // forgotten whenever the vertex array changes
+    static void bindBuffer(GLenum target, GLuint buffer);
+
+    // also sets the generic binding of target, like OpenGL does
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // unit is GL_TEXTURE0 + n
+    static void activeTexture(GLenum unit);
+
+    // binds to the active texture unit
+    static void bindTexture(GLenum target, GLuint texture);
+
+    // call before deleting objects, OpenGL reverts their bindings to 0 (names
+    // can be reused by the next glGen*)
+    static void forgetProgram(GLuint program);
+    static void forgetVertexArray(GLuint vao);
+    static void forgetBuffer(GLuint buffer);
+    static void forgetTexture(GLuint texture);
+
+    // mark everything as unknown so the next bind of each kind is issued
+    static void invalidate();
+
+    // the vertex array bound now, 0 if unknown
+    static GLuint getVertexArray();
+
+    // true if the wrappers can edit objects without binding them (OpenGL 4.5
+    // or ARB_direct_state_access). Can be turned off to test the fallback.
+    static bool hasDirectStateAccess();
+    static void setDirectStateAccess(bool enable);
+
+    // true if shaders compile and programs link on driver threads
+    // (KHR/ARB_parallel_shader_compile) so GL_COMPLETION_STATUS_KHR can be
+    // polled instead of waiting on the result. The first call also sets the
+    // driver's compiler thread count, make it before compiling anything.
+    static bool hasParallelShaderCompile();
+
+    // bytes from one uniform block to the next when several share a buffer,
+    // blockSize rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so each one
+    // can be bound with bindBufferRange
+    static size_t getUniformBlockStride(size_t blockSize);
+
+    // block until fence signaled, then delete it, false if the wait failed
+    static bool waitFence(GLsync fence);
+
+    // counters since the last endFrame()
+    static const Counters& getCounters();
+
+    // counters of the last complete frame
+    static const Counters& getFrameCounters();
+
+    // call once at the end of the frame
+    static void endFrame();
+};
+
+#endif // GLSTATE_HPP
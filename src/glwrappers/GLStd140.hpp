@@ -0,0 +1,143 @@
+#ifndef GLSTD140_HPP
+#define GLSTD140_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <iostream>
+
+#include "GLProgram.hpp"
+
+// Alignment and size of types in the std140 and std430 block layouts. Mirror
+// structs declare their members with STD140(type)/STD430(type) (or
+// STD140_ARRAY(type, name, count) for arrays) so the C++ compiler inserts the
+// same padding OpenGL does:
+//
+//   struct MaterialBlock
+//   {
+//       STD140(glm::vec3) diffuse;     // offset 0
+//       STD140(glm::vec3) specular;    // offset 16
+//       STD140(GLfloat)   shininess;   // offset 28
+//   };
+//
+// Types without a layout (glm::mat3, bool, ...) fail to compile. Structs and
+// arrays of structs should themselves be built from STD140 members.
+
+constexpr size_t glLayoutRound(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// structs are rounded up to the alignment of a vec4 in std140
+template <typename T>
+struct GLStd140
+{
+    static_assert(sizeof(T) % 16 == 0, "std140 structs must be a multiple of 16 bytes, declare them alignas(16)");
+    static const size_t alignment = 16;
+    static const size_t size = sizeof(T);
+};
+
+// structs use the largest alignment of their members in std430
+template <typename T>
+struct GLStd430
+{
+    static const size_t alignment = alignof(T);
+    static const size_t size = sizeof(T);
+};
+
+#define GL_LAYOUT_BASIC(TYPE, ALIGN, SIZE) \
+    template <> struct GLStd140<TYPE> { static const size_t alignment = ALIGN; static const size_t size = SIZE; }; \
+    template <> struct GLStd430<TYPE> { static const size_t alignment = ALIGN; static const size_t size = SIZE; };
+
+GL_LAYOUT_BASIC(GLint,      4,  4)
+GL_LAYOUT_BASIC(GLuint,     4,  4)
+GL_LAYOUT_BASIC(GLfloat,    4,  4)
+GL_LAYOUT_BASIC(glm::ivec2, 8,  8)
+GL_LAYOUT_BASIC(glm::uvec2, 8,  8)
+GL_LAYOUT_BASIC(glm::vec2,  8,  8)
+GL_LAYOUT_BASIC(glm::ivec3, 16, 12)
+GL_LAYOUT_BASIC(glm::uvec3, 16, 12)
+GL_LAYOUT_BASIC(glm::vec3,  16, 12)
+GL_LAYOUT_BASIC(glm::ivec4, 16, 16)
+GL_LAYOUT_BASIC(glm::uvec4, 16, 16)
+GL_LAYOUT_BASIC(glm::vec4,  16, 16)
+GL_LAYOUT_BASIC(glm::mat4,  16, 64)
+
+#undef GL_LAYOUT_BASIC
+
+// std140 arrays: every element starts on a 16 byte boundary
+template <typename T, size_t N>
+struct GLStd140<T[N]>
+{
+    static_assert(sizeof(T) % 16 == 0, "std140 array elements must be padded to 16 bytes (use glm::vec4, glm::ivec4 or an alignas(16) struct)");
+    static const size_t alignment = 16;
+    static const size_t size = sizeof(T) * N;
+};
+
+// std430 arrays: elements are packed at their own alignment
+template <typename T, size_t N>
+struct GLStd430<T[N]>
+{
+    static_assert(sizeof(T) % GLStd430<T>::alignment == 0, "std430 array element size must be a multiple of its alignment");
+    static const size_t alignment = GLStd430<T>::alignment;
+    static const size_t size = sizeof(T) * N;
+};
+
+#define STD140(TYPE) alignas(GLStd140<TYPE>::alignment) TYPE
+#define STD430(TYPE) alignas(GLStd430<TYPE>::alignment) TYPE
+#define STD140_ARRAY(TYPE, NAME, N) alignas(GLStd140<TYPE[N]>::alignment) TYPE NAME[N]
+#define STD430_ARRAY(TYPE, NAME, N) alignas(GLStd430<TYPE[N]>::alignment) TYPE NAME[N]
+
+// Compile time check that MEMBER directly follows PREV following the layout
+// rules, use it for each member after the first to catch hand written padding
+// or a missing STD140()
+#define GL_STD140_FOLLOWS(STRUCT, MEMBER, PREV) \
+    static_assert(offsetof(STRUCT, MEMBER) == glLayoutRound(offsetof(STRUCT, PREV) + GLStd140<decltype(STRUCT::PREV)>::size, \
+                                                            GLStd140<decltype(STRUCT::MEMBER)>::alignment), \
+                  #STRUCT "::" #MEMBER " is not at its std140 offset")
+
+#define GL_STD430_FOLLOWS(STRUCT, MEMBER, PREV) \
+    static_assert(offsetof(STRUCT, MEMBER) == glLayoutRound(offsetof(STRUCT, PREV) + GLStd430<decltype(STRUCT::PREV)>::size, \
+                                                            GLStd430<decltype(STRUCT::MEMBER)>::alignment), \
+                  #STRUCT "::" #MEMBER " is not at its std430 offset")
+
+// a block member and where the mirror struct expects it
+struct GLBlockMember
+{
+    const char* name;   // as reported by OpenGL (eg "Lights.info[0].position")
+    GLint       offset;
+};
+
+// Compare the offsets OpenGL assigned to the members of a block with the C++
+// mirror struct. Members that aren't active in the program are skipped.
+// Returns false and prints the mismatches if any differ.
+template <size_t N>
+bool glValidateBlockLayout(const GLProgram& program, const char* blockName, const GLBlockMember (&members)[N], size_t structSize)
+{
+    const GLProgram::ResourceInfo* block = program.findUniformBlock(glHash(blockName));
+    if ( block == nullptr )
+        return true;
+
+    bool valid = true;
+    if ( static_cast<size_t>(block->size) > glLayoutRound(structSize, 16) )
+    {
+        std::cout << "Warning: uniform block " << blockName << " is " << block->size
+                  << " bytes but the mirror struct is only " << structSize << std::endl;
+        valid = false;
+    }
+
+    for ( size_t i = 0; i < N; ++i )
+    {
+        const GLProgram::ResourceInfo* info = program.findUniform(glHash(members[i].name));
+        if ( info != nullptr && info->offset != members[i].offset )
+        {
+            std::cout << "Warning: " << members[i].name << " is at offset " << info->offset
+                      << " but the mirror struct has it at " << members[i].offset << std::endl;
+            valid = false;
+        }
+    }
+
+    return valid;
+}
+
+#endif // GLSTD140_HPP
@@ -1,8 +1,26 @@
 #include "GLTexture.hpp"
+#include "GLState.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <IL/il.h>
 
+namespace
+{
+    // immutable storage needs a sized internal format
+    GLenum sizedFormat(GLenum internalFormat)
+    {
+        switch ( internalFormat )
+        {
+            case GL_RGBA: return GL_RGBA8;
+            case GL_RGB:  return GL_RGB8;
+            case GL_RG:   return GL_RG8;
+            case GL_RED:  return GL_R8;
+            default:      return internalFormat;
+        }
+    }
+}
+
 GLTexture::GLTexture() :
     m_texCount(nullptr),
     m_texParameters()
@@ -31,14 +49,17 @@ void GLTexture::clean()
     {
         GLuint *textures = new GLuint[*m_texCount];
         for ( GLsizei i = 0; i < *m_texCount; ++i )
+        {
             textures[i] = m_texParameters[i].textureId;
+            GLState::forgetTexture(textures[i]);
+        }
 
         glDeleteTextures( *m_texCount, textures );
         delete [] textures;
     }
 }
 
-bool GLTexture::generate(GLsizei n)
+bool GLTexture::generate(GLsizei n, GLenum target)
 {
     if ( n > 0 )
     {
@@ -48,11 +69,14 @@ bool GLTexture::generate(GLsizei n)
         m_texParameters = boost::shared_array<TexParameters>(new TexParameters[n]);
       
         GLuint *textures = new GLuint[n];
-        glGenTextures(n, textures);
+        if ( target != GL_NONE && GLState::hasDirectStateAccess() )
+            glCreateTextures(target, n, textures);
+        else
+            glGenTextures(n, textures);
         for ( GLsizei i = 0; i < n; ++i )
         {
             m_texParameters[i].textureId = textures[i];
-            m_texParameters[i].target = GL_NONE;
+            m_texParameters[i].target = target;
         }
         
         // This line! OMG so many problems because it was forgotten!
@@ -68,29 +92,131 @@ void GLTexture::bind(GLenum target, GLsizei idx)
 {
     if ( m_texParameters != nullptr && idx < *m_texCount )
     {
-        glBindTexture(target, m_texParameters[idx].textureId);
+        GLState::bindTexture(target, m_texParameters[idx].textureId);
         m_texParameters[idx].target = target;
     }
 }
 
 void GLTexture::unbindTextures(GLenum target)
 {
-    glBindTexture(target, 0);
+    GLState::bindTexture(target, 0);
+}
+
+void GLTexture::setActiveUnit(GLenum unit)
+{
+    GLState::activeTexture(unit);
+}
+
+bool GLTexture::bindForEdit(GLenum target, GLsizei idx)
+{
+    if ( m_texParameters == nullptr || idx >= *m_texCount )
+        return false;
+    this->bind(target, idx);
+    return true;
 }
 
-void GLTexture::setSampling(GLenum target, GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT)
+void GLTexture::setSampling(GLenum target, GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT, GLsizei idx)
 {
+    if ( GLState::hasDirectStateAccess() && m_texParameters != nullptr && idx < *m_texCount )
+    {
+        const GLuint texture = m_texParameters[idx].textureId;
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrapS);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrapT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, magFilter);
+        return;
+    }
+
+    this->bindForEdit(target, idx);
     glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapS);
     glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapT);
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
 }
 
-void GLTexture::generateMipMap(GLenum target)
+void GLTexture::generateMipMap(GLenum target, GLsizei idx)
 {
+    if ( GLState::hasDirectStateAccess() && m_texParameters != nullptr && idx < *m_texCount )
+    {
+        glGenerateTextureMipmap(m_texParameters[idx].textureId);
+        return;
+    }
+
+    this->bindForEdit(target, idx);
     glGenerateMipmap(target);
 }
 
+void GLTexture::setBuffer(GLenum internalFormat, GLuint buffer, GLsizei idx)
+{
+    if ( GLState::hasDirectStateAccess() && m_texParameters != nullptr && idx < *m_texCount )
+    {
+        glTextureBuffer(m_texParameters[idx].textureId, internalFormat, buffer);
+        return;
+    }
+
+    this->bindForEdit(GL_TEXTURE_BUFFER, idx);
+    glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+}
+
+bool GLTexture::setStorage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei idx)
+{
+    if ( m_texParameters == nullptr || idx >= *m_texCount )
+        return false;
+
+    TexParameters& params = m_texParameters[idx];
+    if ( params.target == GL_NONE )
+        params.target = GL_TEXTURE_2D;
+    params.dimensions = glm::vec3(width, height, 1);
+    params.internalFormat = internalFormat;
+
+    if ( GLState::hasDirectStateAccess() )
+    {
+        glTextureStorage2D(params.textureId, levels, internalFormat, width, height);
+    }
+    else if ( GLEW_ARB_texture_storage )
+    {
+        this->bindForEdit(params.target, idx);
+        glTexStorage2D(params.target, levels, internalFormat, width, height);
+    }
+    else
+    {
+        // mutable storage, one level at a time
+        this->bindForEdit(params.target, idx);
+        for ( GLint level = 0; level < levels; ++level )
+        {
+            glTexImage2D(params.target, level, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        glTexParameteri(params.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+    return true;
+}
+
+bool GLTexture::uploadSubImage2D(const void* data, GLsizei width, GLsizei height, GLenum format, GLenum type, GLint lod, GLsizei idx)
+{
+    if ( m_texParameters == nullptr || idx >= *m_texCount || m_texParameters[idx].target == GL_NONE )
+        return false;
+
+    if ( GLState::hasDirectStateAccess() )
+    {
+        glTextureSubImage2D(m_texParameters[idx].textureId, lod, 0, 0, width, height, format, type, data);
+    }
+    else
+    {
+        this->bindForEdit(m_texParameters[idx].target, idx);
+        glTexSubImage2D(m_texParameters[idx].target, lod, 0, 0, width, height, format, type, data);
+    }
+    return true;
+}
+
+GLuint GLTexture::getTextureIdx(GLsizei idx) const
+{
+    if ( m_texParameters != nullptr && idx < *m_texCount )
+        return m_texParameters[idx].textureId;
+    return 0;
+}
+
 bool GLTexture::loadImageData(const char* filename, GLsizei idx, GLenum internalFormat, GLint lod)
 {
     bool retVal = false;
@@ -105,8 +231,21 @@ bool GLTexture::loadImageData(const char* filename, GLsizei idx, GLenum internal
         GLenum format = static_cast<GLenum>(ilGetInteger(IL_IMAGE_FORMAT));
         GLsizei dims[] = {width, height, depth};
 
-        // set the data to the texture
-        retVal = this->setData(data, dims, idx, type, format, internalFormat, lod);
+        // set the data to the texture, 2D textures get immutable storage for
+        // the full mip chain so the upload doesn't need a bind
+        if ( lod == 0 && depth <= 1 && m_texParameters != nullptr && idx < *m_texCount &&
+             m_texParameters[idx].target == GL_TEXTURE_2D && GLState::hasDirectStateAccess() )
+        {
+            GLsizei levels = 1;
+            for ( GLsizei size = std::max(width, height); size > 1; size /= 2 )
+                levels++;
+            retVal = this->setStorage2D(levels, sizedFormat(internalFormat), width, height, idx) &&
+                     this->setSubImage2D(data, width, height, format, type, 0, idx);
+        }
+        else
+        {
+            retVal = this->setData(data, dims, idx, type, format, internalFormat, lod);
+        }
 
         // clean up
         ilClearImage();
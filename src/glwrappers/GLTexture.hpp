@@ -38,7 +38,9 @@ public:
     }
 #endif
 
-    bool generate(GLsizei n = 1);
+    // If target is given the textures are created for it up front, with direct
+    // state access they can then be filled without ever being bound.
+    bool generate(GLsizei n = 1, GLenum target = GL_NONE);
 
     // Supported values for target
     // (1D)
@@ -72,16 +74,42 @@ public:
     //     width, height if dims=TEX_2D, and width if dims=TEX_1D
     // Data starts at lower left corner of back image and goes left to right, bottom to
     //     top, back to front.
+    //
+    // Binds the texture to its target on the active unit first.
     template <typename T>
     bool setData(const T* data, const GLsizei* dimVals, GLsizei idx = 0, GLenum type = GL_UNSIGNED_BYTE, GLenum format = GL_RGB, GLint internalFormat = GL_RGBA, GLint lod = 0 );
 
+    // allocate immutable storage for all levels of a 2D texture, fill it
+    // with setSubImage2D. internalFormat must be sized (ex. GL_RGBA8).
+    bool setStorage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei idx = 0);
+
+    template <typename T>
+    bool setSubImage2D(const T* data, GLsizei width, GLsizei height, GLenum format = GL_RGB, GLenum type = GL_UNSIGNED_BYTE, GLint lod = 0, GLsizei idx = 0)
+    {
+        return this->uploadSubImage2D(reinterpret_cast<const void*>(data), width, height, format, type, lod, idx);
+    }
+
     bool loadImageData(const char* filename, GLsizei idx = 0, GLenum internaFormat = GL_RGBA, GLint lod = 0);
-    void setSampling(GLenum target, GLenum minFilter = GL_NEAREST, GLenum magFilter = GL_NEAREST, GLenum wrapS = GL_WRAP_BORDER, GLenum wrapT = GL_WRAP_BORDER);
-    void generateMipMap(GLenum target);
+    // these edit texture idx directly with direct state access and bind it
+    // on the active unit otherwise
+    void setSampling(GLenum target, GLenum minFilter = GL_NEAREST, GLenum magFilter = GL_NEAREST, GLenum wrapS = GL_WRAP_BORDER, GLenum wrapT = GL_WRAP_BORDER, GLsizei idx = 0);
+    void generateMipMap(GLenum target, GLsizei idx = 0);
+
+    // use a buffer's data store as the texel array of a GL_TEXTURE_BUFFER
+    void setBuffer(GLenum internalFormat, GLuint buffer, GLsizei idx = 0);
+
+    GLuint getTextureIdx(GLsizei idx = 0) const;
 
     static void unbindTextures(GLenum target);
+
+    // select the texture unit bind() applies to (GL_TEXTURE0 + n)
+    static void setActiveUnit(GLenum unit);
 protected:
     void clean();
+    bool uploadSubImage2D(const void* data, GLsizei width, GLsizei height, GLenum format, GLenum type, GLint lod, GLsizei idx);
+
+    // bind for the non direct state access paths
+    bool bindForEdit(GLenum target, GLsizei idx);
 
     struct TexParameters
     {
@@ -104,6 +132,7 @@ bool GLTexture::setData(const T* data, const GLsizei* dimVals, GLsizei idx, GLen
 {
     if ( m_texParameters != nullptr && idx < *m_texCount && m_texParameters[idx].target != GL_NONE )
     {
+        this->bindForEdit(m_texParameters[idx].target, idx);
         switch(m_texParameters[idx].target)
         {
             case GL_TEXTURE_1D:
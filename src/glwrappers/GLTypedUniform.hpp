@@ -0,0 +1,82 @@
+#ifndef GLTYPEDUNIFORM_HPP
+#define GLTYPEDUNIFORM_HPP
+
+#include <GL/glew.h>
+#include <cstring>
+#include <string>
+
+#include "GLProgram.hpp"
+#include "GLUniformTraits.hpp"
+
+// Uniform of a known type T (array of N values). The value is stored inline
+// and the glProgramUniform* function is picked at compile time through
+// GLUniformTraits<T>. Nothing is sent to OpenGL if the value didn't change
+// since the last upload.
+//
+// example:
+//   GLTypedUniform<glm::mat4> projection;
+//   projection.init(program, "u_projectionMatrix");
+//   projection.set(projectionMatrix);
+template <typename T, GLsizei N = 1>
+class GLTypedUniform
+{
+public:
+    GLTypedUniform() :
+        m_program(0),
+        m_location(-1),
+        m_transpose(GL_FALSE),
+        m_uploaded(false),
+        m_values()
+    {}
+
+    // must be called before set, returns false if the uniform isn't active
+    bool init(GLProgram& program, const std::basic_string<GLchar>& name, GLboolean transpose = GL_FALSE)
+    {
+        m_location = program.getUniformLocation(name);
+        if ( m_location == -1 )
+            return false;
+        m_program = program.getProgramIdx();
+        m_transpose = transpose;
+        m_uploaded = false;
+        return true;
+    }
+
+    // set the value (the first one for arrays) and upload it if it changed
+    void set(const T& value)
+    {
+        if ( m_uploaded && std::memcmp(&m_values[0], &value, sizeof(T)) == 0 )
+            return;
+        m_values[0] = value;
+        this->upload();
+    }
+
+    // set all N values and upload them if any changed
+    void setArray(const T* values)
+    {
+        if ( m_uploaded && std::memcmp(m_values, values, sizeof(m_values)) == 0 )
+            return;
+        std::memcpy(m_values, values, sizeof(m_values));
+        this->upload();
+    }
+
+    // force the stored values to OpenGL (eg if the program was relinked)
+    void upload()
+    {
+        if ( m_location == -1 )
+            return;
+        GLUniformTraits<T>::set(m_program, m_location, N, m_transpose, m_values);
+        m_uploaded = true;
+    }
+
+    const T& get(GLsizei idx = 0) const { return m_values[idx]; }
+    GLint getLocation() const { return m_location; }
+    bool isInitialized() const { return m_location != -1; }
+protected:
+    GLuint    m_program;
+    GLint     m_location;
+    GLboolean m_transpose;
+    bool      m_uploaded;
+    T         m_values[N];
+};
+
+#endif // GLTYPEDUNIFORM_HPP
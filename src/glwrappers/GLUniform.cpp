@@ -1,5 +1,52 @@
 #include "GLUniform.hpp"
-    
+#include "GLUniformTraits.hpp"
+
+namespace
+{
+    typedef void (*SetFunc)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const void* data);
+
+    template <typename T>
+    void setUniformData(GLuint program, GLint location, GLsizei count, GLboolean transpose, const void* data)
+    {
+        GLUniformTraits<T>::set(program, location, count, transpose, static_cast<const T*>(data));
+    }
+
+    // indexed by GLUniformType, must be in the same order as the enum. The non
+    // array types use the same functions with a count of 1.
+    const SetFunc SET_FUNCS[] = {
+        // INT_V, UINT_V, FLOAT_V, DOUBLE_V
+        &setUniformData<GLint>, &setUniformData<GLuint>, &setUniformData<GLfloat>, &setUniformData<GLdouble>,
+        // VEC2UI_V, VEC3UI_V, VEC4UI_V
+        &setUniformData<glm::uvec2>, &setUniformData<glm::uvec3>, &setUniformData<glm::uvec4>,
+        // VEC2I_V, VEC3I_V, VEC4I_V
+        &setUniformData<glm::ivec2>, &setUniformData<glm::ivec3>, &setUniformData<glm::ivec4>,
+        // VEC2F_V, VEC3F_V, VEC4F_V
+        &setUniformData<glm::vec2>, &setUniformData<glm::vec3>, &setUniformData<glm::vec4>,
+        // VEC2D_V, VEC3D_V, VEC4D_V
+        &setUniformData<glm::dvec2>, &setUniformData<glm::dvec3>, &setUniformData<glm::dvec4>,
+        // INT, UINT, FLOAT, DOUBLE
+        &setUniformData<GLint>, &setUniformData<GLuint>, &setUniformData<GLfloat>, &setUniformData<GLdouble>,
+        // VEC2UI, VEC3UI, VEC4UI
+        &setUniformData<glm::uvec2>, &setUniformData<glm::uvec3>, &setUniformData<glm::uvec4>,
+        // VEC2I, VEC3I, VEC4I
+        &setUniformData<glm::ivec2>, &setUniformData<glm::ivec3>, &setUniformData<glm::ivec4>,
+        // VEC2F, VEC3F, VEC4F
+        &setUniformData<glm::vec2>, &setUniformData<glm::vec3>, &setUniformData<glm::vec4>,
+        // VEC2D, VEC3D, VEC4D
+        &setUniformData<glm::dvec2>, &setUniformData<glm::dvec3>, &setUniformData<glm::dvec4>,
+        // MAT2F, MAT3F, MAT4F, MAT2X3F, MAT3X2F, MAT2X4F, MAT4X2F, MAT3X4F, MAT4X3F
+        &setUniformData<glm::mat2>, &setUniformData<glm::mat3>, &setUniformData<glm::mat4>,
+        &setUniformData<glm::mat2x3>, &setUniformData<glm::mat3x2>, &setUniformData<glm::mat2x4>,
+        &setUniformData<glm::mat4x2>, &setUniformData<glm::mat3x4>, &setUniformData<glm::mat4x3>,
+        // MAT2D, MAT3D, MAT4D, MAT2X3D, MAT3X2D, MAT2X4D, MAT4X2D, MAT3X4D, MAT4X3D
+        &setUniformData<glm::dmat2>, &setUniformData<glm::dmat3>, &setUniformData<glm::dmat4>,
+        &setUniformData<glm::dmat2x3>, &setUniformData<glm::dmat3x2>, &setUniformData<glm::dmat2x4>,
+        &setUniformData<glm::dmat4x2>, &setUniformData<glm::dmat3x4>, &setUniformData<glm::dmat4x3>
+    };
+
+    static_assert(sizeof(SET_FUNCS)/sizeof(SetFunc) == MAT4X3D + 1, "SET_FUNCS doesn't match GLUniformType");
+}
+
 GLUniform::GLUniform() :
     m_type(),
     m_program(),
@@ -7,9 +54,11 @@ GLUniform::GLUniform() :
     m_transpose(false),
     m_count(0),
     m_size(1),
+    m_capacity(INLINE_SIZE),
     m_isInitialized(false),
+    m_dirty(false),
     m_name(""),
-    m_data(nullptr)
+    m_data(m_inline)
 {}
 
 GLUniform::GLUniform(GLProgram program, const std::basic_string<GLchar>& name, GLUniformType type) : GLUniform()
@@ -24,29 +73,27 @@ GLUniform::GLUniform(const GLUniform &rhs) :
     m_transpose(rhs.m_transpose),
     m_count(rhs.m_count),
     m_size(rhs.m_size),
+    m_capacity(INLINE_SIZE),
     m_isInitialized(rhs.m_isInitialized),
-    m_name(rhs.m_name)
+    m_dirty(rhs.m_dirty),
+    m_name(rhs.m_name),
+    m_data(m_inline)
 {
-    if ( rhs.m_data == nullptr )
-    {
-        m_data = rhs.m_data;
-    }
-    else
-    {
-        m_data = new char[m_count*m_size];
-        for ( int i = 0; i < m_count*m_size; ++i )
-            m_data[i] = rhs.m_data[i];
-    }
+    this->reserve(m_count*m_size);
+    std::memcpy(m_data, rhs.m_data, m_count*m_size);
 }
 
 GLUniform::~GLUniform()
 {
-    if ( m_data != nullptr )
+    if ( m_data != m_inline )
         delete [] m_data;
 }
 
 GLUniform& GLUniform::operator=(const GLUniform& rhs)
 {
+    if ( this == &rhs )
+        return *this;
+
     m_type = rhs.m_type;
     m_program = rhs.m_program;
     m_uniform = rhs.m_uniform;
@@ -54,327 +101,46 @@ GLUniform& GLUniform::operator=(const GLUniform& rhs)
     m_count = rhs.m_count;
     m_size = rhs.m_size;
     m_isInitialized = rhs.m_isInitialized;
+    m_dirty = rhs.m_dirty;
     m_name = rhs.m_name;
 
-    if ( m_data != nullptr )
-        delete [] m_data;
-
-    if ( rhs.m_data == nullptr )
-    {
-        m_data = rhs.m_data;
-    }
-    else
-    {
-        m_data = new char[m_count*m_size];
-        for ( int i = 0; i < m_count*m_size; ++i )
-            m_data[i] = rhs.m_data[i];
-    }
+    this->reserve(m_count*m_size);
+    std::memcpy(m_data, rhs.m_data, m_count*m_size);
 
     return *this;
 }
 
+void GLUniform::reserve(int size)
+{
+    if ( size <= m_capacity )
+        return;
+
+    if ( m_data != m_inline )
+        delete [] m_data;
+    m_data = new char[size];
+    m_capacity = size;
+}
+
 bool GLUniform::init(GLProgram program, const std::basic_string<GLchar>& name, GLUniformType type)
 {
-    m_uniform = glGetUniformLocation(program.getProgramIdx(), name.c_str());
+    m_uniform = program.getUniformLocation(name);
     if ( m_uniform == -1 )
         return false;
     m_program = program;
     m_type = type;
+    m_name = name;
     m_isInitialized = true;
+
+    // new location, whatever is loaded has to be sent again
+    m_dirty = m_count > 0;
     return true;
 }
 
 void GLUniform::set()
 {
-    switch (m_type)
-    {
-        case INT_V:
-        {
-            glProgramUniform1iv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case UINT_V:
-        {
-            glProgramUniform1uiv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLuint*>(m_data));
-            break;
-        }
-        case FLOAT_V:
-        {
-            glProgramUniform1fv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case DOUBLE_V:
-        {
-            glProgramUniform1dv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case VEC2UI_V:
-        {
-            glProgramUniform2uiv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLuint*>(m_data));
-            break;
-        }
-        case VEC3UI_V:
-        {
-            glProgramUniform3uiv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLuint*>(m_data));
-            break;
-        }
-        case VEC4UI_V:
-        {
-            glProgramUniform4uiv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLuint*>(m_data));
-            break;
-        }
-        case VEC2I_V:
-        {
-            glProgramUniform2iv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case VEC3I_V:
-        {
-            glProgramUniform3iv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case VEC4I_V:
-        {
-            glProgramUniform4iv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case VEC2F_V:
-        {
-            glProgramUniform2fv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case VEC3F_V:
-        {
-            glProgramUniform3fv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case VEC4F_V:
-        {
-            glProgramUniform4fv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case VEC2D_V:
-        {
-            glProgramUniform2dv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case VEC3D_V:
-        {
-            glProgramUniform3dv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case VEC4D_V:
-        {
-            glProgramUniform4dv(m_program.getProgramIdx(), m_uniform, m_count, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case INT:
-        {
-            glProgramUniform1i(m_program.getProgramIdx(), m_uniform, *reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case UINT:
-        {
-            glProgramUniform1ui(m_program.getProgramIdx(), m_uniform, *reinterpret_cast<const GLint*>(m_data));
-            break;
-        }
-        case FLOAT:
-        {
-            glProgramUniform1f(m_program.getProgramIdx(), m_uniform, *reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case DOUBLE:
-        {
-            glProgramUniform1d(m_program.getProgramIdx(), m_uniform, *reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case VEC2UI:
-        {
-            glProgramUniform2ui(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLuint*>(m_data),
-                    *reinterpret_cast<const GLuint*>(m_data+sizeof(GLuint)));
-            break;
-        }
-        case VEC3UI:
-        {
-            glProgramUniform3ui(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLuint*>(m_data),
-                    *reinterpret_cast<const GLuint*>(m_data+sizeof(GLuint)),
-                    *reinterpret_cast<const GLuint*>(m_data+2*sizeof(GLuint)));
-            break;
-        }
-        case VEC4UI:
-        {
-            glProgramUniform4ui(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLuint*>(m_data),
-                    *reinterpret_cast<const GLuint*>(m_data+sizeof(GLuint)),
-                    *reinterpret_cast<const GLuint*>(m_data+2*sizeof(GLuint)),
-                    *reinterpret_cast<const GLuint*>(m_data+3*sizeof(GLuint)));
-            break;
-        }
-        case VEC2I:
-        {
-            glProgramUniform2i(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLint*>(m_data),
-                    *reinterpret_cast<const GLint*>(m_data+sizeof(GLint)));
-            break;
-        }
-        case VEC3I:
-        {
-            glProgramUniform3i(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLint*>(m_data),
-                    *reinterpret_cast<const GLint*>(m_data+sizeof(GLint)),
-                    *reinterpret_cast<const GLint*>(m_data+2*sizeof(GLint)));
-            break;
-        }
-        case VEC4I:
-        {
-            glProgramUniform4i(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLint*>(m_data),
-                    *reinterpret_cast<const GLint*>(m_data+sizeof(GLint)),
-                    *reinterpret_cast<const GLint*>(m_data+2*sizeof(GLint)),
-                    *reinterpret_cast<const GLint*>(m_data+3*sizeof(GLint)));
-            break;
-        }
-        case VEC2F:
-        {
-            glProgramUniform2f(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLfloat*>(m_data),
-                    *reinterpret_cast<const GLfloat*>(m_data+sizeof(GLfloat)));
-            break;
-        }
-        case VEC3F:
-        {
-            glProgramUniform3f(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLfloat*>(m_data),
-                    *reinterpret_cast<const GLfloat*>(m_data+sizeof(GLfloat)),
-                    *reinterpret_cast<const GLfloat*>(m_data+2*sizeof(GLfloat)));
-            break;
-        }
-        case VEC4F:
-        {
-            glProgramUniform4f(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLfloat*>(m_data),
-                    *reinterpret_cast<const GLfloat*>(m_data+sizeof(GLfloat)),
-                    *reinterpret_cast<const GLfloat*>(m_data+2*sizeof(GLfloat)),
-                    *reinterpret_cast<const GLfloat*>(m_data+3*sizeof(GLfloat)));
-            break;
-        }
-        case VEC2D:
-        {
-            glProgramUniform2d(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLdouble*>(m_data),
-                    *reinterpret_cast<const GLdouble*>(m_data+sizeof(GLdouble)));
-            break;
-        }
-        case VEC3D:
-        {
-            glProgramUniform3d(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLdouble*>(m_data),
-                    *reinterpret_cast<const GLdouble*>(m_data+sizeof(GLdouble)),
-                    *reinterpret_cast<const GLdouble*>(m_data+2*sizeof(GLdouble)));
-            break;
-        }
-        case VEC4D:
-        {
-            glProgramUniform4d(m_program.getProgramIdx(), m_uniform,
-                    *reinterpret_cast<const GLdouble*>(m_data),
-                    *reinterpret_cast<const GLdouble*>(m_data+sizeof(GLdouble)),
-                    *reinterpret_cast<const GLdouble*>(m_data+2*sizeof(GLdouble)),
-                    *reinterpret_cast<const GLdouble*>(m_data+3*sizeof(GLdouble)));
-            break;
-        }
-        case MAT2F:
-        {
-            glProgramUniformMatrix2fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT3F:
-        {
-            glProgramUniformMatrix3fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT4F:
-        {
-            glProgramUniformMatrix4fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT2X3F:
-        {
-            glProgramUniformMatrix2x3fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT3X2F:
-        {
-            glProgramUniformMatrix3x2fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT2X4F:
-        {
-            glProgramUniformMatrix2x4fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT4X2F:
-        {
-            glProgramUniformMatrix4x2fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT3X4F:
-        {
-            glProgramUniformMatrix3x4fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT4X3F:
-        {
-            glProgramUniformMatrix4x3fv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLfloat*>(m_data));
-            break;
-        }
-        case MAT2D:
-        {
-            glProgramUniformMatrix2dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT3D:
-        {
-            glProgramUniformMatrix3dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT4D:
-        {
-            glProgramUniformMatrix4dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT2X3D:
-        {
-            glProgramUniformMatrix2x3dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT3X2D:
-        {
-            glProgramUniformMatrix3x2dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT2X4D:
-        {
-            glProgramUniformMatrix2x4dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT4X2D:
-        {
-            glProgramUniformMatrix4x2dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-        case MAT3X4D:
-        {
-            glProgramUniformMatrix3x4dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;    
-        }
-        case MAT4X3D:
-        {
-            glProgramUniformMatrix4x3dv(m_program.getProgramIdx(), m_uniform, m_count, m_transpose, reinterpret_cast<const GLdouble*>(m_data));
-            break;
-        }
-    }
-}
-
+    if ( !m_dirty || !m_isInitialized )
+        return;
 
+    SET_FUNCS[m_type](m_program.getProgramIdx(), m_uniform, m_count, m_transpose, m_data);
+    m_dirty = false;
+}
@@ -3,6 +3,7 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <cstring>
 
 #include "GLProgram.hpp"
 
@@ -22,10 +23,16 @@ enum GLUniformType {
     MAT2D, MAT3D, MAT4D, MAT2X3D, MAT3X2D, MAT2X4D, MAT4X2D, MAT3X4D, MAT4X3D
 };
 
-// example if T is glm::mat4 then setFunc should be glProgramUniform4f
+// Runtime typed uniform, kept for code that picks the type at runtime. Prefer
+// GLTypedUniform<T> (GLTypedUniform.hpp) when the type is known at compile time.
+//
+// Values up to INLINE_SIZE bytes are stored inside the object. set() only
+// calls OpenGL if loadData changed something since the last upload.
 class GLUniform
 {
 public:
+    static const int INLINE_SIZE = 64;  // enough for a glm::mat4
+
     GLUniform();
     GLUniform(GLProgram program, const std::basic_string<GLchar>& name, GLUniformType type);
     GLUniform(const GLUniform &rhs);
@@ -39,35 +46,36 @@ public:
     template <typename T>
     void loadData(const T &data, GLint count = 1, GLboolean transpose = GL_FALSE)
     {
-        if ( m_data != nullptr )
-            delete [] m_data;
+        const int bytes = count*sizeof(T);
+
+        // nothing to do if it's the same as what is already stored
+        if ( m_size == sizeof(T) && m_count == count && m_transpose == transpose
+             && std::memcmp(m_data, &data, bytes) == 0 )
+            return;
 
+        this->reserve(bytes);
         m_size = sizeof(T);
         m_count = count;
         m_transpose = transpose;
-
-        m_data = new char[count*m_size];
-
-        // copy data
-        const char *dataPtr = reinterpret_cast<const char*>(&data);
-        for ( int i = 0; i < m_count*m_size; ++i )
-            m_data[i] = dataPtr[i];
+        std::memcpy(m_data, &data, bytes);
+        m_dirty = true;
     }
 
     // use to get the data array or data
     template <typename T>
     const T* getDataArray() const
     {
-        return reinterpret_cast<T*>(m_data);
+        return reinterpret_cast<const T*>(m_data);
     }
     
     template <typename T>
     const T& getData() const
     {
-        return *reinterpret_cast<T*>(m_data);
+        return *reinterpret_cast<const T*>(m_data);
     }
 
-    // call this to load uniform into opengl
+    // call this to load uniform into opengl, does nothing if the data hasn't
+    // changed since the last call
     void set();
 
     // accessors
@@ -92,17 +100,22 @@ public:
     }
 
 protected:
+    // make sure m_data can hold size bytes (contents are not kept)
+    void reserve(int size);
+
     GLUniformType             m_type;
     GLProgram                 m_program;
     GLint                     m_uniform;
     GLboolean                 m_transpose;
     GLint                     m_count;
     int                       m_size;
+    int                       m_capacity;
     bool                      m_isInitialized;
+    bool                      m_dirty;
 
     std::basic_string<GLchar> m_name;
-    char*                     m_data;
+    char*                     m_data;       // points to m_inline or the heap
+    alignas(16) char          m_inline[INLINE_SIZE];
 };
 
 #endif // GLUNIFORM_HPP
-
@@ -0,0 +1,77 @@
+#ifndef GLUNIFORMTRAITS_HPP
+#define GLUNIFORMTRAITS_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Maps a C++ type to the glProgramUniform* function that uploads it. Only the
+// types below are specialized, anything else fails to compile.
+//
+// set(program, location, count, transpose, data) uploads count values
+template <typename T>
+struct GLUniformTraits;
+
+#define GLUNIFORM_VECTOR_TRAITS(TYPE, ELEMENT, FUNC) \
+    template <> \
+    struct GLUniformTraits<TYPE> \
+    { \
+        typedef ELEMENT element_type; \
+        static const bool is_matrix = false; \
+        static void set(GLuint program, GLint location, GLsizei count, GLboolean, const TYPE* data) \
+        { \
+            FUNC(program, location, count, reinterpret_cast<const ELEMENT*>(data)); \
+        } \
+    };
+
+#define GLUNIFORM_MATRIX_TRAITS(TYPE, ELEMENT, FUNC) \
+    template <> \
+    struct GLUniformTraits<TYPE> \
+    { \
+        typedef ELEMENT element_type; \
+        static const bool is_matrix = true; \
+        static void set(GLuint program, GLint location, GLsizei count, GLboolean transpose, const TYPE* data) \
+        { \
+            FUNC(program, location, count, transpose, reinterpret_cast<const ELEMENT*>(data)); \
+        } \
+    };
+
+GLUNIFORM_VECTOR_TRAITS(GLint, GLint, glProgramUniform1iv)
+GLUNIFORM_VECTOR_TRAITS(GLuint, GLuint, glProgramUniform1uiv)
+GLUNIFORM_VECTOR_TRAITS(GLfloat, GLfloat, glProgramUniform1fv)
+GLUNIFORM_VECTOR_TRAITS(GLdouble, GLdouble, glProgramUniform1dv)
+GLUNIFORM_VECTOR_TRAITS(glm::ivec2, GLint, glProgramUniform2iv)
+GLUNIFORM_VECTOR_TRAITS(glm::ivec3, GLint, glProgramUniform3iv)
+GLUNIFORM_VECTOR_TRAITS(glm::ivec4, GLint, glProgramUniform4iv)
+GLUNIFORM_VECTOR_TRAITS(glm::uvec2, GLuint, glProgramUniform2uiv)
+GLUNIFORM_VECTOR_TRAITS(glm::uvec3, GLuint, glProgramUniform3uiv)
+GLUNIFORM_VECTOR_TRAITS(glm::uvec4, GLuint, glProgramUniform4uiv)
+GLUNIFORM_VECTOR_TRAITS(glm::vec2, GLfloat, glProgramUniform2fv)
+GLUNIFORM_VECTOR_TRAITS(glm::vec3, GLfloat, glProgramUniform3fv)
+GLUNIFORM_VECTOR_TRAITS(glm::vec4, GLfloat, glProgramUniform4fv)
+GLUNIFORM_VECTOR_TRAITS(glm::dvec2, GLdouble, glProgramUniform2dv)
+GLUNIFORM_VECTOR_TRAITS(glm::dvec3, GLdouble, glProgramUniform3dv)
+GLUNIFORM_VECTOR_TRAITS(glm::dvec4, GLdouble, glProgramUniform4dv)
+
+GLUNIFORM_MATRIX_TRAITS(glm::mat2, GLfloat, glProgramUniformMatrix2fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat3, GLfloat, glProgramUniformMatrix3fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat4, GLfloat, glProgramUniformMatrix4fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat2x3, GLfloat, glProgramUniformMatrix2x3fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat3x2, GLfloat, glProgramUniformMatrix3x2fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat2x4, GLfloat, glProgramUniformMatrix2x4fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat4x2, GLfloat, glProgramUniformMatrix4x2fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat3x4, GLfloat, glProgramUniformMatrix3x4fv)
+GLUNIFORM_MATRIX_TRAITS(glm::mat4x3, GLfloat, glProgramUniformMatrix4x3fv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat2, GLdouble, glProgramUniformMatrix2dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat3, GLdouble, glProgramUniformMatrix3dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat4, GLdouble, glProgramUniformMatrix4dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat2x3, GLdouble, glProgramUniformMatrix2x3dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat3x2, GLdouble, glProgramUniformMatrix3x2dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat2x4, GLdouble, glProgramUniformMatrix2x4dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat4x2, GLdouble, glProgramUniformMatrix4x2dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat3x4, GLdouble, glProgramUniformMatrix3x4dv)
+GLUNIFORM_MATRIX_TRAITS(glm::dmat4x3, GLdouble, glProgramUniformMatrix4x3dv)
+
+#undef GLUNIFORM_VECTOR_TRAITS
+#undef GLUNIFORM_MATRIX_TRAITS
+
+#endif // GLUNIFORMTRAITS_HPP
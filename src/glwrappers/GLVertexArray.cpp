@@ -1,4 +1,5 @@
 #include "GLVertexArray.hpp"
+#include "GLState.hpp"
 
 GLVertexArray::GLVertexArray() :
     m_vao(),
@@ -16,7 +17,10 @@ void GLVertexArray::create(GLsizei count)
     GLuint *vao = new GLuint[count];
     
     // create new vertex array object
-    glGenVertexArrays(count, vao);
+    if ( GLState::hasDirectStateAccess() )
+        glCreateVertexArrays(count, vao);
+    else
+        glGenVertexArrays(count, vao);
     
     // copy values to member variables
     m_count = count;
@@ -26,12 +30,63 @@ void GLVertexArray::create(GLsizei count)
 void GLVertexArray::bind(int idx)
 {
     if ( m_vao != nullptr )
-        glBindVertexArray(m_vao[idx]);
+        GLState::bindVertexArray(m_vao[idx]);
 }
 
 void GLVertexArray::unbindAll()
 {
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
+}
+
+void GLVertexArray::setAttribute(GLuint location, GLuint buffer, GLint size, GLenum type, GLsizei stride,
+                                 GLintptr offset, GLuint divisor, int idx)
+{
+    if ( m_vao == nullptr || idx >= m_count )
+        return;
+
+    const GLuint vao = m_vao[idx];
+    if ( GLState::hasDirectStateAccess() )
+    {
+        // one buffer binding point per attribute
+        glEnableVertexArrayAttrib(vao, location);
+        glVertexArrayAttribFormat(vao, location, size, type, GL_FALSE, 0);
+        glVertexArrayVertexBuffer(vao, location, buffer, offset, stride);
+        glVertexArrayAttribBinding(vao, location, location);
+        glVertexArrayBindingDivisor(vao, location, divisor);
+        return;
+    }
+
+    const GLuint previous = GLState::getVertexArray();
+    GLState::bindVertexArray(vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, size, type, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offset));
+    glVertexAttribDivisor(location, divisor);
+    GLState::bindVertexArray(previous);
+}
+
+void GLVertexArray::setElementBuffer(GLuint buffer, int idx)
+{
+    if ( m_vao == nullptr || idx >= m_count )
+        return;
+
+    if ( GLState::hasDirectStateAccess() )
+    {
+        glVertexArrayElementBuffer(m_vao[idx], buffer);
+        return;
+    }
+
+    const GLuint previous = GLState::getVertexArray();
+    GLState::bindVertexArray(m_vao[idx]);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    GLState::bindVertexArray(previous);
+}
+
+GLuint GLVertexArray::getVertexArrayIdx(int idx) const
+{
+    if ( m_vao == nullptr || idx >= m_count )
+        return 0;
+    return m_vao[idx];
 }
 
 void GLVertexArray::removeBeforeDelete()
@@ -42,13 +97,17 @@ void GLVertexArray::removeBeforeDelete()
         {
             GLuint *vao = new GLuint[m_count];
             for ( GLsizei i = 0; i < m_count; ++i )
+            {
                 vao[i] = m_vao[i];
+                GLState::forgetVertexArray(vao[i]);
+            }
             glDeleteVertexArrays(m_count, vao);
             delete [] vao;
         }
         else
         {
             GLuint vao = m_vao[0];
+            GLState::forgetVertexArray(vao);
             glDeleteVertexArrays(m_count, &vao);
         }
     }
@@ -13,6 +13,16 @@ public:
     void create(GLsizei count = 1);
     void bind(int idx = 0);
     static void unbindAll();
+
+    // Describe a float attribute read from buffer and the element buffer of
+    // vertex array idx. With direct state access the vertex array is edited
+    // without being bound, otherwise it is bound for the edit and the
+    // previous one bound again.
+    void setAttribute(GLuint location, GLuint buffer, GLint size, GLenum type, GLsizei stride,
+                      GLintptr offset = 0, GLuint divisor = 0, int idx = 0);
+    void setElementBuffer(GLuint buffer, int idx = 0);
+
+    GLuint getVertexArrayIdx(int idx = 0) const;
 protected:
     void removeBeforeDelete();
 
@@ -3,6 +3,7 @@
 
 #include <glm/glm.hpp>
 #include "../glwrappers/GLBuffer.hpp"
+#include "../glwrappers/GLStd140.hpp"
 
 const unsigned int TEXTURE_DIFFUSE  = 0x1;
 const unsigned int TEXTURE_SPECULAR = 0x2;
@@ -15,6 +16,7 @@ const GLuint V_UVCOORD  = 2;
 const GLuint V_TANGENT  = 3;
 const GLuint V_BINORMAL = 4;
 const GLuint V_COLOR    = 5;
+const GLuint V_DRAW_ID  = 6;    // per instance, see IndirectRenderer
 
 const unsigned int TEXTURE_TYPES[] = {TEXTURE_DIFFUSE, TEXTURE_SPECULAR, TEXTURE_BUMP};
 
@@ -24,6 +26,8 @@ const unsigned int TEXTURE_TYPES[] = {TEXTURE_DIFFUSE, TEXTURE_SPECULAR, TEXTURE
 //    B : Bump map          (0x4)
 // MATERIAL
 //    Just material properties (no textures)
+// DEPTH
+//    Positions of everything visible, for the depth pre-pass
 enum DrawType {
     DRAW_MATERIAL       = 0x0,
     DRAW_TEXTURE_D      = TEXTURE_DIFFUSE,
@@ -32,7 +36,8 @@ enum DrawType {
     DRAW_TEXTURE_B      = TEXTURE_BUMP,
     DRAW_TEXTURE_DB     = TEXTURE_DIFFUSE | TEXTURE_BUMP,
     DRAW_TEXTURE_SB     = TEXTURE_SPECULAR | TEXTURE_BUMP,
-    DRAW_TEXTURE_DSB    = TEXTURE_DIFFUSE | TEXTURE_SPECULAR | TEXTURE_BUMP
+    DRAW_TEXTURE_DSB    = TEXTURE_DIFFUSE | TEXTURE_SPECULAR | TEXTURE_BUMP,
+    DRAW_DEPTH          = 0x100
 };
 
 enum UniformType {
@@ -45,44 +50,53 @@ const GLuint UB_MATRICES = 1;
 const GLuint UB_LIGHT    = 2;
 const GLuint UB_MATERIAL = 3;
 
-// uniform block offsets based on layout(std140)
-const GLintptr MAT_MVP_OFFSET     = 0;
-const GLintptr MAT_MV_OFFSET      = sizeof(glm::mat4);
-const GLintptr MAT_NORMAL_OFFSET  = sizeof(glm::mat4)*2;
-const GLsizeiptr MAT_BUFFER_SIZE  = sizeof(glm::mat4)*3;
+// max number of lights in the Lights block
+const int LIGHT_ARRAY_SIZE = 8;
 
-/*
-struct LightInfo
+// C++ mirrors of the layout(std140) uniform blocks in the shaders, each block
+// is uploaded in one piece from these
+struct MatricesBlock
 {
-    vec3 position;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 ambient;
+    STD140(glm::mat4) mvpMatrix;
+    STD140(glm::mat4) mvMatrix;
+    STD140(glm::mat4) normalMatrix;
 };
+GL_STD140_FOLLOWS(MatricesBlock, mvMatrix, mvpMatrix);
+GL_STD140_FOLLOWS(MatricesBlock, normalMatrix, mvMatrix);
 
-// light properties
-layout(std140) uniform Lights
+// struct LightInfo in the shaders
+struct alignas(16) LightBlockInfo
 {
-    uniform int count;
-    uniform LightInfo info[8];
-} lights;
-*/
-const GLintptr LIGHT_COUNT_OFFSET          = 0;
-const GLintptr LIGHT_ARRAY_OFFSET          = sizeof(glm::vec4);
-const GLintptr LIGHT_ARRAY_POSITION_OFFSET = 0;
-const GLintptr LIGHT_ARRAY_DIFFUSE_OFFSET  = sizeof(glm::vec4);
-const GLintptr LIGHT_ARRAY_SPECULAR_OFFSET = sizeof(glm::vec4)*2;
-const GLintptr LIGHT_ARRAY_AMBIENT_OFFSET  = sizeof(glm::vec4)*3;
-const GLintptr LIGHT_ARRAY_STEP            = sizeof(glm::vec4)*4;
-const int LIGHT_ARRAY_SIZE                 = 8; // max number of lights
-const GLsizeiptr LIGHT_BUFFER_SIZE         = LIGHT_ARRAY_OFFSET + LIGHT_ARRAY_STEP * LIGHT_ARRAY_SIZE;
-
-const GLintptr MATERIAL_DIFFUSE_OFFSET   = 0;
-const GLintptr MATERIAL_SPECULAR_OFFSET  = sizeof(glm::vec4);
-const GLintptr MATERIAL_AMBIENT_OFFSET   = sizeof(glm::vec4)*2;
-const GLintptr MATERIAL_SHININESS_OFFSET = sizeof(GLfloat)*11;
-const GLintptr MATERIAL_TEXBLEND_OFFSET  = sizeof(GLfloat)*12;
-const GLsizeiptr MATERIAL_BUFFER_SIZE    = sizeof(GLfloat)*13;
+    STD140(glm::vec3) position;
+    STD140(glm::vec3) diffuse;
+    STD140(glm::vec3) specular;
+    STD140(glm::vec3) ambient;
+};
+GL_STD140_FOLLOWS(LightBlockInfo, diffuse, position);
+GL_STD140_FOLLOWS(LightBlockInfo, specular, diffuse);
+GL_STD140_FOLLOWS(LightBlockInfo, ambient, specular);
+
+struct LightsBlock
+{
+    STD140(GLint) count;
+    STD140_ARRAY(LightBlockInfo, info, LIGHT_ARRAY_SIZE);
+};
+GL_STD140_FOLLOWS(LightsBlock, info, count);
+
+struct MaterialBlock
+{
+    STD140(glm::vec3) diffuse;
+    STD140(glm::vec3) specular;
+    STD140(glm::vec3) ambient;
+    STD140(GLfloat)   shininess;
+    STD140(GLfloat)   texBlend;
+};
+GL_STD140_FOLLOWS(MaterialBlock, specular, diffuse);
+GL_STD140_FOLLOWS(MaterialBlock, ambient, specular);
+GL_STD140_FOLLOWS(MaterialBlock, shininess, ambient);
+GL_STD140_FOLLOWS(MaterialBlock, texBlend, shininess);
+
+class IndirectRenderer;
 
 class iGLRenderable
 {
@@ -94,6 +108,16 @@ public:
     virtual const glm::mat4& getModelMatrix() = 0;
     virtual void draw(DrawType type = DRAW_MATERIAL) = 0;
     virtual void setUniforms(GLBuffer &ubo, UniformType type = MATERIALS) = 0;
+
+    // queue every mesh with the indirect renderer instead of drawing it,
+    // matrices are the model's in the current view. Returns false if not
+    // supported, draw() is used instead.
+    virtual bool submit(IndirectRenderer&, const MatricesBlock&) { return false; }
+
+    // pick the detail level the following draws and submits use, from the
+    // model's matrices in the current view. pixelScale is the pixels a unit
+    // covers at distance 1 (projection[1][1] * viewport height / 2).
+    virtual void selectLod(const MatricesBlock&, float) {}
 };
 
 #endif // IGLRENDERABLE_HPP
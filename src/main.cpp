@@ -4,8 +4,12 @@
 #include <QDesktopWidget>
 #include <QPoint>
 #include "qt/MainApp.hpp"
+#include "replay/HeadlessReplay.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include <IL/il.h>
 
 int main(int argc, char *argv[])
@@ -13,8 +17,65 @@ int main(int argc, char *argv[])
     // initialize devil
     ilInit();
 
+    // --benchmark runs without vsync and reports the frame pacing,
+    // --physics-threads n steps bullet on n threads (0 for every core),
+    // --disc-physics steps the puck as a 2D disc against the table walls
+    // instead (see DiscBackend),
+    // --record file saves the ticks of the session and --replay file runs
+    // them again, without a window with --headless
+    bool benchmark = false;
+    unsigned int physicsThreads = 1;
+    PhysicsWorld::Backend physicsBackend = PhysicsWorld::BULLET_BACKEND;
+    std::string recordFilename;
+    std::string replayFilename;
+    bool headless = false;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( std::string(argv[i]) == "--benchmark" )
+            benchmark = true;
+        else if ( std::string(argv[i]) == "--physics-threads" && i + 1 < argc )
+            physicsThreads = static_cast<unsigned int>(std::max(0, std::atoi(argv[++i])));
+        else if ( std::string(argv[i]) == "--disc-physics" )
+            physicsBackend = PhysicsWorld::DISC_BACKEND;
+        else if ( std::string(argv[i]) == "--record" && i + 1 < argc )
+            recordFilename = argv[++i];
+        else if ( std::string(argv[i]) == "--replay" && i + 1 < argc )
+            replayFilename = argv[++i];
+        else if ( std::string(argv[i]) == "--headless" )
+            headless = true;
+    }
+
+    // physics only, as fast as it goes. 1 if the run diverged.
+    if ( headless )
+    {
+        Recording recording;
+        HeadlessReplay replay;
+        if ( replayFilename.empty() )
+        {
+            std::cout << "Error: --headless needs --replay file" << std::endl;
+            return -1;
+        }
+        if ( !recording.load(replayFilename) )
+        {
+            std::cout << "Error: " << recording.getLastError() << std::endl;
+            return -1;
+        }
+        if ( !replay.run(recording) )
+        {
+            std::cout << "Error: " << replay.getLastError() << std::endl;
+            return -1;
+        }
+        replay.printReport();
+        return replay.matched() ? 0 : 1;
+    }
+
     QApplication app(argc, argv);
-    MainApp mainApp;
+
+    MainApp mainApp(benchmark, physicsThreads, physicsBackend);
+    if ( !replayFilename.empty() && !mainApp.replayFrom(replayFilename) )
+        return -1;
+    if ( replayFilename.empty() && !recordFilename.empty() && !mainApp.recordTo(recordFilename) )
+        return -1;
    
     // determine which screen the mouse is on
     QPoint mousePos = QCursor::pos();
@@ -30,10 +91,12 @@ int main(int argc, char *argv[])
     mainApp.resize(screenGeometry.width()*0.80, screenGeometry.height()*0.90);
     mainApp.show();
 
+    // initializeGL runs on the render thread, a failure quits the event loop
+    mainApp.startRendering();
+    const int result = app.exec();
+    mainApp.stopRendering();
+
     // check if initialization succeeded
-    if ( mainApp.good() )
-        return app.exec();
-    else
-        return -1;
+    return mainApp.good() ? result : -1;
 }
 
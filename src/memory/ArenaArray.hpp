@@ -0,0 +1,73 @@
+#ifndef ARENAARRAY_HPP
+#define ARENAARRAY_HPP
+
+#include "LinearArena.hpp"
+
+#include <type_traits>
+
+// Growable array of plain values (copied with memcpy) that lives in a LinearArena.
+// When the arena is reset the array silently starts over empty, so it can be
+// kept as a member and filled again every frame without touching the heap.
+template <typename T>
+class ArenaArray
+{
+    static_assert(std::is_trivially_destructible<T>::value, "ArenaArray never runs destructors");
+public:
+    ArenaArray(LinearArena& arena, size_t reserve = 0) :
+        m_arena(&arena),
+        m_data(nullptr),
+        m_size(0),
+        m_capacity(0),
+        m_generation(arena.getGeneration())
+    {
+        if ( reserve > 0 )
+            this->reserve(reserve);
+    }
+
+    void push_back(const T& value)
+    {
+        this->checkGeneration();
+        if ( m_size == m_capacity )
+            this->reserve(m_capacity == 0 ? 64 : m_capacity * 2);
+        m_data[m_size++] = value;
+    }
+
+    void reserve(size_t capacity)
+    {
+        this->checkGeneration();
+        if ( capacity <= m_capacity )
+            return;
+        m_data = static_cast<T*>(m_arena->reallocate(m_data, sizeof(T)*m_size, sizeof(T)*capacity, alignof(T) > LinearArena::DEFAULT_ALIGNMENT ? alignof(T) : LinearArena::DEFAULT_ALIGNMENT));
+        m_capacity = capacity;
+    }
+
+    // keeps the storage (until the arena resets)
+    void clear() { m_size = 0; }
+
+    const T* data() const { return this->isStale() ? nullptr : m_data; }
+    size_t size() const { return this->isStale() ? 0 : m_size; }
+    bool empty() const { return this->size() == 0; }
+
+    T& operator[](size_t idx) { return m_data[idx]; }
+    const T& operator[](size_t idx) const { return m_data[idx]; }
+protected:
+    bool isStale() const { return m_generation != m_arena->getGeneration(); }
+
+    void checkGeneration()
+    {
+        if ( this->isStale() )
+        {
+            m_data = nullptr;
+            m_size = m_capacity = 0;
+            m_generation = m_arena->getGeneration();
+        }
+    }
+
+    LinearArena* m_arena;
+    T*           m_data;
+    size_t       m_size;
+    size_t       m_capacity;
+    unsigned int m_generation;
+};
+
+#endif // ARENAARRAY_HPP
@@ -0,0 +1,111 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#ifdef MEMORY_DEBUG
+    #include <atomic>
+    #include <cstdlib>
+    #include <iostream>
+    #include <new>
+#endif
+
+namespace
+{
+    std::mutex                 g_registryMutex;
+    std::vector<LinearArena*>  g_registry;
+
+    // registers the thread's arena while the thread is alive
+    struct ThreadArena
+    {
+        ThreadArena() : arena(FRAME_ARENA_SIZE)
+        {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            g_registry.push_back(&arena);
+        }
+
+        ~ThreadArena()
+        {
+            std::lock_guard<std::mutex> lock(g_registryMutex);
+            g_registry.erase(std::remove(g_registry.begin(), g_registry.end(), &arena), g_registry.end());
+        }
+
+        LinearArena arena;
+    };
+}
+
+#ifdef MEMORY_DEBUG
+// count every heap allocation so the frame report can show if any slipped through
+static std::atomic<unsigned long> g_heapAllocations(0);
+
+void* operator new(std::size_t size)
+{
+    g_heapAllocations++;
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if ( ptr == nullptr )
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+LinearArena& FrameArena::get()
+{
+    static thread_local ThreadArena threadArena;
+    return threadArena.arena;
+}
+
+LinearArena& FrameArena::scratch()
+{
+    static LinearArena scratchArena(SCRATCH_ARENA_SIZE);
+    return scratchArena;
+}
+
+void FrameArena::endFrame()
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+
+#ifdef MEMORY_DEBUG
+    static size_t reportedPeak = 0;
+    static unsigned long frame = 0;
+
+    size_t peak = 0;
+    for ( size_t i = 0; i < g_registry.size(); ++i )
+        peak += g_registry[i]->getPeak();
+
+    const unsigned long allocations = g_heapAllocations.exchange(0);
+
+    // only report when something changed to keep the output readable
+    if ( peak > reportedPeak || allocations > 0 )
+    {
+        std::cout << "FrameArena: frame " << frame
+                  << " peak " << peak << " bytes over " << g_registry.size() << " arena(s), "
+                  << allocations << " heap allocation(s)" << std::endl;
+        reportedPeak = std::max(reportedPeak, peak);
+    }
+    frame++;
+#endif
+
+    for ( size_t i = 0; i < g_registry.size(); ++i )
+        g_registry[i]->reset();
+
+#ifdef MEMORY_DEBUG
+    // don't count the report itself against the next frame
+    g_heapAllocations = 0;
+#endif
+}
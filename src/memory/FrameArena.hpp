@@ -0,0 +1,31 @@
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+
+#include "LinearArena.hpp"
+
+const size_t FRAME_ARENA_SIZE   = 1 << 20;   // 1 MiB per thread
+const size_t SCRATCH_ARENA_SIZE = 4 << 20;   // 4 MiB for loading
+
+// Arenas for transient data.
+//
+// get() returns an arena owned by the calling thread, everything allocated
+// from it is released by endFrame(). scratch() is meant for load time
+// temporaries, wrap uses in an ArenaScope so it is rewound afterwards (the
+// outermost scope also frees what overflowed the block).
+//
+// Define MEMORY_DEBUG to report peak arena use and heap allocations per frame.
+class FrameArena
+{
+public:
+    // frame arena for the calling thread (created on first use)
+    static LinearArena& get();
+
+    // load time scratch arena, only use from the thread doing the loading
+    static LinearArena& scratch();
+
+    // reset every thread's frame arena. Call once at the end of the frame
+    // while no other thread is allocating from its arena.
+    static void endFrame();
+};
+
+#endif // FRAMEARENA_HPP
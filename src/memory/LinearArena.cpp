@@ -0,0 +1,130 @@
+#include "LinearArena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// alignment must be a power of two
+static inline uintptr_t alignUp(uintptr_t value, size_t alignment)
+{
+    return (value + (alignment - 1)) & ~static_cast<uintptr_t>(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t capacity) :
+    m_base(nullptr),
+    m_capacity(0),
+    m_offset(0),
+    m_lastOffset(0),
+    m_peak(0),
+    m_overflowBytes(0),
+    m_generation(0)
+{
+    if ( capacity > 0 )
+    {
+        m_base = static_cast<char*>(std::malloc(capacity));
+        if ( m_base != nullptr )
+            m_capacity = capacity;
+    }
+}
+
+LinearArena::~LinearArena()
+{
+    for ( size_t i = 0; i < m_overflow.size(); ++i )
+        std::free(m_overflow[i]);
+    std::free(m_base);
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+    if ( m_base != nullptr )
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(m_base);
+        const size_t aligned = alignUp(base + m_offset, alignment) - base;
+
+        if ( aligned + size <= m_capacity )
+        {
+            m_lastOffset = aligned;
+            m_offset = aligned + size;
+            if ( this->getUsed() > m_peak )
+                m_peak = this->getUsed();
+            return m_base + aligned;
+        }
+    }
+
+    return this->allocateOverflow(size, alignment);
+}
+
+void* LinearArena::allocateOverflow(size_t size, size_t alignment)
+{
+    char* chunk = static_cast<char*>(std::malloc(size + alignment));
+    if ( chunk == nullptr )
+        return nullptr;
+
+    m_overflow.push_back(chunk);
+    m_overflowBytes += size;
+    if ( this->getUsed() > m_peak )
+        m_peak = this->getUsed();
+
+    return reinterpret_cast<void*>(alignUp(reinterpret_cast<uintptr_t>(chunk), alignment));
+}
+
+void* LinearArena::reallocate(void* ptr, size_t oldSize, size_t newSize, size_t alignment)
+{
+    // extend in place if this was the last thing allocated from the block
+    if ( ptr != nullptr && m_lastOffset < m_offset && ptr == m_base + m_lastOffset
+         && m_lastOffset + newSize <= m_capacity )
+    {
+        m_offset = m_lastOffset + newSize;
+        if ( this->getUsed() > m_peak )
+            m_peak = this->getUsed();
+        return ptr;
+    }
+
+    void* newPtr = this->allocate(newSize, alignment);
+    if ( newPtr != nullptr && ptr != nullptr )
+        std::memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    return newPtr;
+}
+
+void LinearArena::rewind(size_t marker)
+{
+    // nothing is left in use, free the overflow chunks as well
+    if ( marker == 0 )
+    {
+        this->reset();
+        return;
+    }
+
+    if ( marker <= m_offset )
+    {
+        m_offset = marker;
+        m_lastOffset = marker;
+    }
+}
+
+void LinearArena::reset()
+{
+    const bool overflowed = !m_overflow.empty();
+
+    for ( size_t i = 0; i < m_overflow.size(); ++i )
+        std::free(m_overflow[i]);
+    m_overflow.clear();
+
+    // grow so the next frame with the same usage fits in the block
+    if ( overflowed )
+    {
+        const size_t capacity = m_peak + m_peak / 2;
+        char* base = static_cast<char*>(std::malloc(capacity));
+        if ( base != nullptr )
+        {
+            std::free(m_base);
+            m_base = base;
+            m_capacity = capacity;
+        }
+    }
+
+    m_offset = 0;
+    m_lastOffset = 0;
+    m_overflowBytes = 0;
+    m_generation++;
+}
@@ -0,0 +1,81 @@
+#ifndef LINEARARENA_HPP
+#define LINEARARENA_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator, allocations are only released all at once by reset() (or
+// rewind() back to a marker). Nothing is constructed or destructed so only
+// use it for trivially destructible data.
+//
+// If the block runs out the allocation is served from an overflow chunk on
+// the heap, the next reset() then grows the block to the peak usage so that
+// in steady state there are no heap allocations at all.
+class LinearArena
+{
+public:
+    static const size_t DEFAULT_ALIGNMENT = 16;
+
+    LinearArena(size_t capacity = 0);
+    ~LinearArena();
+
+    // returns nullptr only if the heap is out of memory
+    void* allocate(size_t size, size_t alignment = DEFAULT_ALIGNMENT);
+
+    template <typename T>
+    T* allocate(size_t count = 1)
+    {
+        return static_cast<T*>(this->allocate(sizeof(T)*count, alignof(T) > DEFAULT_ALIGNMENT ? alignof(T) : DEFAULT_ALIGNMENT));
+    }
+
+    // grows the allocation in place if ptr was the most recent allocation,
+    // otherwise a new allocation is made and oldSize bytes are copied over
+    void* reallocate(void* ptr, size_t oldSize, size_t newSize, size_t alignment = DEFAULT_ALIGNMENT);
+
+    // markers only apply to the main block, overflow chunks are held until
+    // reset(), rewinding to 0 (the outermost ArenaScope) is a reset()
+    size_t getMarker() const { return m_offset; }
+    void rewind(size_t marker);
+
+    // release everything, invalidates all pointers returned by allocate
+    void reset();
+
+    // incremented on every reset() so containers can detect stale storage
+    unsigned int getGeneration() const { return m_generation; }
+
+    size_t getUsed() const { return m_offset + m_overflowBytes; }
+    size_t getCapacity() const { return m_capacity; }
+    size_t getPeak() const { return m_peak; }
+protected:
+    // not copyable
+    LinearArena(const LinearArena&);
+    LinearArena& operator=(const LinearArena&);
+
+    void* allocateOverflow(size_t size, size_t alignment);
+
+    char*              m_base;
+    size_t             m_capacity;
+    size_t             m_offset;
+    size_t             m_lastOffset;    // start of the most recent allocation
+    size_t             m_peak;
+    size_t             m_overflowBytes;
+    unsigned int       m_generation;
+
+    std::vector<char*> m_overflow;
+};
+
+// rewinds the arena to where it was when the scope was entered
+class ArenaScope
+{
+public:
+    ArenaScope(LinearArena& arena) : m_arena(arena), m_marker(arena.getMarker()) {}
+    ~ArenaScope() { m_arena.rewind(m_marker); }
+protected:
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+
+    LinearArena& m_arena;
+    size_t       m_marker;
+};
+
+#endif // LINEARARENA_HPP
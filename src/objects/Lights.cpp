@@ -1,9 +1,21 @@
 #include "Lights.hpp"
+#include "../glwrappers/GLState.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 Lights::Lights(int maxLights) :
     m_lightCount(0),
     m_lights(maxLights),
-    m_idxMap(maxLights, INVALID_INDEX)
+    m_idxMap(maxLights, INVALID_INDEX),
+    m_viewStride(0),
+    m_activeCount(0),
+    m_dirty(true),
+    m_version(0)
 {
     for ( int i = 0; i < maxLights; ++i )
         m_availableIdx.push(i);
@@ -21,6 +33,7 @@ int Lights::addLight(const LightInfo& light)
         m_lights[m_lightCount] = light;
         m_idxMap[idx] = m_lightCount;
         m_lightCount++;
+        this->setChanged();
         return idx;
     }
 
@@ -32,6 +45,7 @@ bool Lights::setLightInfo(const LightInfo& light, size_t idx)
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
         m_lights[m_idxMap[idx]] = light;
+        this->setChanged();
         return true;
     }
     return false;
@@ -42,6 +56,7 @@ bool Lights::setPosition(const glm::vec3 &position, size_t idx)
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
         m_lights[m_idxMap[idx]].position = position;
+        this->setChanged();
         return true;
     }
     return false; 
@@ -52,6 +67,7 @@ bool Lights::setDiffuse(const glm::vec3 &diffuse, size_t idx)
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
         m_lights[m_idxMap[idx]].diffuse = diffuse;
+        this->setChanged();
         return true;
     }
     return false; 
@@ -62,6 +78,7 @@ bool Lights::setSpecular(const glm::vec3 &specular, size_t idx)
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
         m_lights[m_idxMap[idx]].specular = specular;
+        this->setChanged();
         return true;
     }
     return false; 
@@ -72,16 +89,33 @@ bool Lights::setAmbient(const glm::vec3 &ambient, size_t idx)
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
         m_lights[m_idxMap[idx]].ambient = ambient;
+        this->setChanged();
         return true;
     }
     return false; 
 }
 
+unsigned int Lights::getVersion() const
+{
+    return m_version;
+}
+
+void Lights::setChanged()
+{
+    m_dirty = true;
+    ++m_version;
+}
+
 int Lights::getLightCount() const
 {
     return m_lightCount;
 }
 
+const LightInfo* Lights::getLights() const
+{
+    return m_lights.data();
+}
+
 bool Lights::getLightInfo(LightInfo& info, size_t idx) const
 {
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
@@ -103,62 +137,129 @@ bool Lights::removeLight(size_t idx)
 {
     if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
     {
-        m_lights.erase(m_lights.begin() + m_idxMap[idx]);
-        m_lights.resize(m_lights.size()+1);
+        // move the last light into the hole so the others keep their place
+        const int hole = m_idxMap[idx];
+        const int last = m_lightCount - 1;
+        if ( hole != last )
+        {
+            m_lights[hole] = m_lights[last];
+            std::replace(m_idxMap.begin(), m_idxMap.end(), last, hole);
+        }
         m_idxMap[idx] = INVALID_INDEX;
         m_availableIdx.push(idx);
         m_lightCount--;
+        this->setChanged();
         return true;
     }
     return false;
 }
 
-void Lights::loadCount(GLBuffer& buffer, int bufferIdx)
+int Lights::getActiveCount() const
 {
-    buffer.bind(GL_UNIFORM_BUFFER, bufferIdx);
-    buffer.setSubData(&m_lightCount, LIGHT_COUNT_OFFSET, 1, bufferIdx);
-    GLBuffer::unbindBuffers(GL_UNIFORM_BUFFER);
+    return m_activeCount;
 }
 
-bool Lights::loadLight(GLBuffer& buffer, int bufferIdx, const glm::mat4& viewMatrix, size_t idx)
+bool Lights::isDark(const LightInfo& info)
 {
-    if ( idx < m_idxMap.size() && m_idxMap[idx] != INVALID_INDEX )
-    {
-        LightInfo& info = m_lights[m_idxMap[idx]];
-
-        // compute light position in view coordinates
-        glm::vec3 position = (viewMatrix * glm::vec4(info.position, 1.0)).xyz();
-
-        // set buffer data
-        buffer.bind(GL_UNIFORM_BUFFER, bufferIdx);
-        buffer.setSubData(&position, LIGHT_ARRAY_OFFSET + m_idxMap[idx] * LIGHT_ARRAY_STEP + LIGHT_ARRAY_POSITION_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.diffuse, LIGHT_ARRAY_OFFSET + m_idxMap[idx] * LIGHT_ARRAY_STEP + LIGHT_ARRAY_DIFFUSE_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.specular, LIGHT_ARRAY_OFFSET + m_idxMap[idx] * LIGHT_ARRAY_STEP + LIGHT_ARRAY_SPECULAR_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.ambient, LIGHT_ARRAY_OFFSET + m_idxMap[idx] * LIGHT_ARRAY_STEP + LIGHT_ARRAY_AMBIENT_OFFSET, 1, bufferIdx);
-        GLBuffer::unbindBuffers(GL_UNIFORM_BUFFER);
-        
-        return true;
-    }
-    return false;
+    const glm::vec3 zero(0.0f);
+    return info.diffuse == zero && info.specular == zero && info.ambient == zero;
 }
 
-void Lights::load(GLBuffer& buffer, int bufferIdx, const glm::mat4& viewMatrix)
+void Lights::upload(GLBuffer& buffer, int bufferIdx, const glm::mat4* viewMatrices, size_t viewCount)
 {
-    buffer.bind(GL_UNIFORM_BUFFER, bufferIdx);
-    buffer.setSubData(&m_lightCount, LIGHT_COUNT_OFFSET, 1, bufferIdx);
-    for ( size_t i = 0; i < m_lights.size(); ++i )
+    if ( viewCount == 0 )
+        return;
+
+    // a moved camera changes every position
+    if ( m_viewMatrices.size() != viewCount ||
+         std::memcmp(m_viewMatrices.data(), viewMatrices, sizeof(glm::mat4)*viewCount) != 0 )
     {
-        LightInfo& info = m_lights[i];
+        m_viewMatrices.assign(viewMatrices, viewMatrices + viewCount);
+        m_dirty = true;
+    }
+    if ( !m_dirty )
+        return;
 
-        // compute light position in view coordinates
-        glm::vec3 position = (viewMatrix * glm::vec4(info.position, 1.0)).xyz();
+    // each block must start on a multiple of the offset alignment to be bound
+    // with bindRange
+    bool resized = false;
+    if ( m_viewStride == 0 )
+        m_viewStride = GLState::getUniformBlockStride(sizeof(LightsBlock));
+    if ( m_image.size() != viewCount * m_viewStride / sizeof(glm::vec4) )
+    {
+        m_image.assign(viewCount * m_viewStride / sizeof(glm::vec4), glm::vec4(0.0f));
+        resized = true;
+    }
 
-        // set buffer data
-        buffer.setSubData(&position, LIGHT_ARRAY_OFFSET + i * LIGHT_ARRAY_STEP + LIGHT_ARRAY_POSITION_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.diffuse, LIGHT_ARRAY_OFFSET + i * LIGHT_ARRAY_STEP + LIGHT_ARRAY_DIFFUSE_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.specular, LIGHT_ARRAY_OFFSET + i * LIGHT_ARRAY_STEP + LIGHT_ARRAY_SPECULAR_OFFSET, 1, bufferIdx);
-        buffer.setSubData(&info.ambient, LIGHT_ARRAY_OFFSET + i * LIGHT_ARRAY_STEP + LIGHT_ARRAY_AMBIENT_OFFSET, 1, bufferIdx);
+    // compact the lights so the shaders don't loop over dark ones, the
+    // colors are the same in every view
+    m_activePositions.clear();
+    LightsBlock* first = reinterpret_cast<LightsBlock*>(m_image.data());
+    for ( GLint i = 0; i < m_lightCount && i < LIGHT_ARRAY_SIZE; ++i )
+    {
+        const LightInfo& info = m_lights[i];
+        if ( isDark(info) )
+            continue;
+        LightBlockInfo& block = first->info[m_activePositions.size()];
+        block.diffuse = info.diffuse;
+        block.specular = info.specular;
+        block.ambient = info.ambient;
+        m_activePositions.push_back(info.position);
     }
-    GLBuffer::unbindBuffers(GL_UNIFORM_BUFFER);
+    m_activeCount = m_activePositions.size();
+    first->count = m_activeCount;
+
+    // shader variants with a constant light count loop over a few more, they
+    // have to be black
+    LightBlockInfo black;
+    black.position = black.diffuse = black.specular = black.ambient = glm::vec3(0.0f);
+    std::fill(first->info + m_activeCount, first->info + LIGHT_ARRAY_SIZE, black);
+
+    for ( size_t view = 0; view < viewCount; ++view )
+    {
+        LightsBlock* block = reinterpret_cast<LightsBlock*>(reinterpret_cast<char*>(first) + view * m_viewStride);
+        if ( view > 0 )
+        {
+            block->count = m_activeCount;
+            std::memcpy(block->info, first->info, sizeof(LightBlockInfo) * LIGHT_ARRAY_SIZE);
+        }
+        transformPositions(viewMatrices[view], m_activePositions.data(), block->info, m_activeCount);
+    }
+
+    if ( resized )
+        buffer.setData(m_image.data(), m_image.size(), GL_DYNAMIC_DRAW, bufferIdx);
+    else
+        buffer.setSubData(m_image.data(), 0, m_image.size(), bufferIdx);
+    m_dirty = false;
 }
 
+void Lights::bindView(GLBuffer& buffer, int bufferIdx, size_t view, GLuint bindingPoint)
+{
+    if ( view < m_viewMatrices.size() )
+        buffer.bindRange(bindingPoint, view * m_viewStride, sizeof(LightsBlock), bufferIdx);
+}
+
+void Lights::transformPositions(const glm::mat4& viewMatrix, const glm::vec3* positions,
+                                LightBlockInfo* blocks, size_t count)
+{
+#ifdef __SSE__
+    // columns of the matrix, each position is x*c0 + y*c1 + z*c2 + c3
+    const float* m = &viewMatrix[0][0];
+    const __m128 c0 = _mm_loadu_ps(m);
+    const __m128 c1 = _mm_loadu_ps(m + 4);
+    const __m128 c2 = _mm_loadu_ps(m + 8);
+    const __m128 c3 = _mm_loadu_ps(m + 12);
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const glm::vec3& p = positions[i];
+        const __m128 xy = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y)));
+        const __m128 zw = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3);
+
+        // std140 pads position to 16 bytes, the w lands in the padding
+        _mm_storeu_ps(&blocks[i].position.x, _mm_add_ps(xy, zw));
+    }
+#else
+    for ( size_t i = 0; i < count; ++i )
+        blocks[i].position = (viewMatrix * glm::vec4(positions[i], 1.0f)).xyz();
+#endif
+}
@@ -34,19 +34,51 @@ public:
     bool setAmbient(const glm::vec3 &ambient, size_t idx);
 
     int getLightCount() const;
+
+    // the getLightCount() lights, in no particular order
+    const LightInfo* getLights() const;
     bool getLightInfo(LightInfo& info, size_t idx) const;
     bool lightExists(size_t idx) const;
 
     bool removeLight(size_t idx);
 
-    void loadCount(GLBuffer& ubo, int uboIdx);
-    bool loadLight(GLBuffer& ubo, int uboIdx, const glm::mat4& viewMatrix, size_t idx);
-    void load(GLBuffer& buffer, int uboIdx, const glm::mat4& viewMatrix);
+    // number of lights the shaders loop over, dark lights are left out
+    int getActiveCount() const;
+
+    // bumped whenever a light is added, removed or changed
+    unsigned int getVersion() const;
+
+    // Build one Lights block per view with the positions in view space and
+    // send them all in one upload. Only lights that aren't dark are written
+    // and the count is set to match. Nothing is sent if no light and no view
+    // changed since the last upload. The buffer must have been bound to
+    // GL_UNIFORM_BUFFER once, it is resized as needed.
+    void upload(GLBuffer& ubo, int uboIdx, const glm::mat4* viewMatrices, size_t viewCount);
+
+    // bind the block of view to bindingPoint
+    void bindView(GLBuffer& ubo, int uboIdx, size_t view, GLuint bindingPoint);
 protected:
+    void setChanged();
+
+    static bool isDark(const LightInfo& info);
+
+    // positions of count lights to view space, written to the blocks
+    static void transformPositions(const glm::mat4& viewMatrix, const glm::vec3* positions,
+                                   LightBlockInfo* blocks, size_t count);
+
     GLint m_lightCount;
     std::vector<LightInfo> m_lights;
     std::queue<size_t>     m_availableIdx;
     std::vector<int>       m_idxMap;
+
+    // std140 image of the buffer, one block every m_viewStride bytes
+    std::vector<glm::vec4> m_image;
+    std::vector<glm::mat4> m_viewMatrices;
+    std::vector<glm::vec3> m_activePositions;
+    GLsizeiptr             m_viewStride;
+    GLint                  m_activeCount;
+    bool                   m_dirty;
+    unsigned int           m_version;
 };
 
 #endif // LIGHTS_HPP
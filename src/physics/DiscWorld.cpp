@@ -0,0 +1,546 @@
+#include "DiscWorld.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// slower than this along the normal a contact is resting, not an impact
+// (keeps a disc sliding along a wall from colliding with it every event)
+const float DISC_REST_SPEED = 1.0e-4f;
+
+DiscWorld::DiscWorld() :
+    m_deterministic(false),
+    m_timeStep(1.0 / 60.0),
+    m_accumulator(0.0),
+    m_saturated(false)
+{}
+
+size_t DiscWorld::addDisc(const Disc& disc)
+{
+    // reuse the slot of a removed disc
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        if ( m_removed[i] )
+        {
+            m_discs[i] = disc;
+            m_removed[i] = false;
+            return i;
+        }
+    }
+
+    m_discs.push_back(disc);
+    m_removed.push_back(false);
+    return m_discs.size() - 1;
+}
+
+void DiscWorld::removeDisc(size_t idx)
+{
+    if ( idx < m_removed.size() )
+        m_removed[idx] = true;
+}
+
+DiscWorld::Disc& DiscWorld::getDisc(size_t idx)
+{
+    return m_discs[idx];
+}
+
+const DiscWorld::Disc& DiscWorld::getDisc(size_t idx) const
+{
+    return m_discs[idx];
+}
+
+void DiscWorld::addSegment(const Segment& segment)
+{
+    const float ex = segment.bx - segment.ax;
+    const float ez = segment.bz - segment.az;
+    const float length2 = ex * ex + ez * ez;
+
+    // a point is no wall
+    if ( length2 <= 0.0f )
+        return;
+
+    // drop the padding, it is rebuilt below
+    m_ax.resize(m_segments.size());
+    m_az.resize(m_segments.size());
+    m_ex.resize(m_segments.size());
+    m_ez.resize(m_segments.size());
+    m_invLength2.resize(m_segments.size());
+    m_length.resize(m_segments.size());
+
+    m_segments.push_back(segment);
+    m_ax.push_back(segment.ax);
+    m_az.push_back(segment.az);
+    m_ex.push_back(ex);
+    m_ez.push_back(ez);
+    m_invLength2.push_back(1.0f / length2);
+    m_length.push_back(std::sqrt(length2));
+
+    // pad with copies of the last segment, a copy never wins over the
+    // original since ties go to the lower index
+    while ( m_ax.size() % 4 != 0 )
+    {
+        m_ax.push_back(m_ax.back());
+        m_az.push_back(m_az.back());
+        m_ex.push_back(m_ex.back());
+        m_ez.push_back(m_ez.back());
+        m_invLength2.push_back(m_invLength2.back());
+        m_length.push_back(m_length.back());
+    }
+}
+
+void DiscWorld::clearSegments()
+{
+    m_segments.clear();
+    m_ax.clear();
+    m_az.clear();
+    m_ex.clear();
+    m_ez.clear();
+    m_invLength2.clear();
+    m_length.clear();
+}
+
+size_t DiscWorld::getSegmentCount() const
+{
+    return m_segments.size();
+}
+
+void DiscWorld::setDeterministic(bool deterministic, double timeStep)
+{
+    m_deterministic = deterministic;
+    m_timeStep = timeStep;
+    m_accumulator = 0.0;
+}
+
+void DiscWorld::tick(double dt)
+{
+    m_saturated = false;
+
+    if ( !m_deterministic )
+    {
+        // exact impacts make any step size as good as any other
+        if ( dt > 0.0 )
+            this->step(static_cast<float>(dt));
+        return;
+    }
+
+    m_accumulator += dt;
+    while ( m_accumulator >= m_timeStep )
+    {
+        this->step(static_cast<float>(m_timeStep));
+        m_accumulator -= m_timeStep;
+    }
+}
+
+double DiscWorld::getRemainder() const
+{
+    return m_accumulator;
+}
+
+void DiscWorld::setRemainder(double remainder)
+{
+    m_accumulator = remainder;
+}
+
+bool DiscWorld::isSaturated() const
+{
+    return m_saturated;
+}
+
+void DiscWorld::step(float dt)
+{
+    // damping once for the whole step, same as bullet
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        Disc& disc = m_discs[i];
+        if ( m_removed[i] )
+            continue;
+        const float linear = std::pow(1.0f - disc.linearDamping, dt);
+        const float angular = std::pow(1.0f - disc.angularDamping, dt);
+        disc.vx *= linear;
+        disc.vz *= linear;
+        disc.spin *= angular;
+    }
+
+    float remaining = dt;
+    int events = 0;
+    while ( remaining > 0.0f )
+    {
+        if ( events == MAX_DISC_EVENTS )
+        {
+            this->advance(remaining);
+            m_saturated = true;
+            break;
+        }
+
+        const Contact contact = this->findContact(remaining);
+        if ( contact.type == CONTACT_NONE )
+        {
+            this->advance(remaining);
+            break;
+        }
+
+        this->advance(contact.time);
+        this->resolve(contact);
+        remaining -= contact.time;
+        ++events;
+    }
+
+    // keep the angles small so they don't lose precision
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+        m_discs[i].angle = std::remainder(m_discs[i].angle, static_cast<float>(2.0 * M_PI));
+}
+
+DiscWorld::Contact DiscWorld::findContact(float maxTime) const
+{
+    Contact contact;
+    contact.type = CONTACT_NONE;
+    contact.time = maxTime;
+    contact.disc = 0;
+    contact.other = 0;
+
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        if ( m_removed[i] )
+            continue;
+        const Disc& disc = m_discs[i];
+
+        // walls only stop discs that move
+        if ( disc.invMass > 0.0f && !m_segments.empty() )
+        {
+            size_t segment = 0;
+            const float time = this->findSegmentTime(disc, contact.time, segment);
+            if ( time < contact.time )
+            {
+                contact.type = CONTACT_SEGMENT;
+                contact.time = time;
+                contact.disc = i;
+                contact.other = segment;
+            }
+        }
+
+        for ( size_t j = i + 1; j < m_discs.size(); ++j )
+        {
+            const Disc& other = m_discs[j];
+            if ( m_removed[j] || (disc.invMass <= 0.0f && other.invMass <= 0.0f) )
+                continue;
+
+            const float qx = other.x - disc.x;
+            const float qz = other.z - disc.z;
+            const float vx = other.vx - disc.vx;
+            const float vz = other.vz - disc.vz;
+            const float r = disc.radius + other.radius;
+
+            const float b = qx * vx + qz * vz;
+            if ( b >= -DISC_REST_SPEED * r )
+                continue;
+
+            const float c = qx * qx + qz * qz - r * r;
+            const float a = vx * vx + vz * vz;
+            const float discriminant = b * b - a * c;
+            if ( discriminant < 0.0f )
+                continue;
+
+            // the smaller root, written so it can't cancel
+            const float time = c <= 0.0f ? 0.0f : c / (-b + std::sqrt(discriminant));
+            if ( time < contact.time )
+            {
+                contact.type = CONTACT_DISC;
+                contact.time = time;
+                contact.disc = i;
+                contact.other = j;
+            }
+        }
+    }
+    return contact;
+}
+
+float DiscWorld::findSegmentTime(const Disc& disc, float maxTime, size_t& segment) const
+{
+#ifdef __SSE2__
+    if ( !m_deterministic )
+        return this->findSegmentTimeSse(disc, maxTime, segment);
+#endif
+    return this->findSegmentTimeScalar(disc, maxTime, segment);
+}
+
+float DiscWorld::findSegmentTimeScalar(const Disc& disc, float maxTime, size_t& segment) const
+{
+    // the disc hits a segment when its center hits the capsule of radius r
+    // around it: one of the two sides or one of the two end circles
+    const float r = disc.radius;
+    const float rest = -DISC_REST_SPEED * r;
+    const float vv = disc.vx * disc.vx + disc.vz * disc.vz;
+
+    float best = maxTime;
+    for ( size_t i = 0; i < m_segments.size(); ++i )
+    {
+        const float px = disc.x - m_ax[i];
+        const float pz = disc.z - m_az[i];
+        const float ex = m_ex[i];
+        const float ez = m_ez[i];
+
+        // side facing the disc, n is the normal scaled by |e|
+        float d = px * ez - pz * ex;
+        float vn = disc.vx * ez - disc.vz * ex;
+        if ( d < 0.0f )
+        {
+            d = -d;
+            vn = -vn;
+        }
+        if ( vn < -DISC_REST_SPEED * m_length[i] )
+        {
+            const float time = std::max((d - r * m_length[i]) / -vn, 0.0f);
+            const float u = ((px + disc.vx * time) * ex + (pz + disc.vz * time) * ez) * m_invLength2[i];
+            if ( u >= 0.0f && u <= 1.0f && time < best )
+            {
+                best = time;
+                segment = i;
+            }
+        }
+
+        // end circles
+        for ( int end = 0; end < 2; ++end )
+        {
+            const float qx = end == 0 ? px : px - ex;
+            const float qz = end == 0 ? pz : pz - ez;
+            const float b = qx * disc.vx + qz * disc.vz;
+            const float c = qx * qx + qz * qz - r * r;
+            const float discriminant = b * b - vv * c;
+            if ( b >= rest || discriminant < 0.0f )
+                continue;
+
+            const float time = c <= 0.0f ? 0.0f : c / (-b + std::sqrt(discriminant));
+            if ( time < best )
+            {
+                best = time;
+                segment = i;
+            }
+        }
+    }
+    return best;
+}
+
+#ifdef __SSE2__
+float DiscWorld::findSegmentTimeSse(const Disc& disc, float maxTime, size_t& segment) const
+{
+    // same tests as the scalar version, one segment per lane
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 x = _mm_set1_ps(disc.x);
+    const __m128 z = _mm_set1_ps(disc.z);
+    const __m128 vx = _mm_set1_ps(disc.vx);
+    const __m128 vz = _mm_set1_ps(disc.vz);
+    const __m128 r = _mm_set1_ps(disc.radius);
+    const __m128 r2 = _mm_mul_ps(r, r);
+    const __m128 rest = _mm_set1_ps(-DISC_REST_SPEED * disc.radius);
+    const __m128 restSpeed = _mm_set1_ps(-DISC_REST_SPEED);
+    const __m128 vv = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vz, vz));
+
+    __m128 best = _mm_set1_ps(maxTime);
+    __m128i bestIdx = _mm_setzero_si128();
+    __m128i idx = _mm_set_epi32(3, 2, 1, 0);
+    const __m128i four = _mm_set1_epi32(4);
+
+    for ( size_t i = 0; i < m_ax.size(); i += 4 )
+    {
+        const __m128 px = _mm_sub_ps(x, _mm_loadu_ps(&m_ax[i]));
+        const __m128 pz = _mm_sub_ps(z, _mm_loadu_ps(&m_az[i]));
+        const __m128 ex = _mm_loadu_ps(&m_ex[i]);
+        const __m128 ez = _mm_loadu_ps(&m_ez[i]);
+        const __m128 invLength2 = _mm_loadu_ps(&m_invLength2[i]);
+        const __m128 length = _mm_loadu_ps(&m_length[i]);
+
+        // side facing the disc, flipped where d < 0
+        __m128 d = _mm_sub_ps(_mm_mul_ps(px, ez), _mm_mul_ps(pz, ex));
+        __m128 vn = _mm_sub_ps(_mm_mul_ps(vx, ez), _mm_mul_ps(vz, ex));
+        const __m128 flip = _mm_and_ps(_mm_cmplt_ps(d, zero), signBit);
+        d = _mm_xor_ps(d, flip);
+        vn = _mm_xor_ps(vn, flip);
+
+        // max returns zero for the nan of a lane with vn == 0, masked below
+        const __m128 sideTime = _mm_max_ps(
+                _mm_div_ps(_mm_sub_ps(d, _mm_mul_ps(r, length)), _mm_xor_ps(vn, signBit)), zero);
+        const __m128 u = _mm_mul_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_add_ps(px, _mm_mul_ps(vx, sideTime)), ex),
+                _mm_mul_ps(_mm_add_ps(pz, _mm_mul_ps(vz, sideTime)), ez)), invLength2);
+        const __m128 sideHit = _mm_and_ps(
+                _mm_cmplt_ps(vn, _mm_mul_ps(restSpeed, length)),
+                _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        __m128 time = _mm_or_ps(_mm_and_ps(sideHit, sideTime), _mm_andnot_ps(sideHit, best));
+
+        // end circles
+        for ( int end = 0; end < 2; ++end )
+        {
+            const __m128 qx = end == 0 ? px : _mm_sub_ps(px, ex);
+            const __m128 qz = end == 0 ? pz : _mm_sub_ps(pz, ez);
+            const __m128 b = _mm_add_ps(_mm_mul_ps(qx, vx), _mm_mul_ps(qz, vz));
+            const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qz, qz)), r2);
+            const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(vv, c));
+            const __m128 hit = _mm_and_ps(_mm_cmplt_ps(b, rest), _mm_cmpge_ps(discriminant, zero));
+
+            const __m128 root = _mm_div_ps(c, _mm_sub_ps(_mm_sqrt_ps(_mm_max_ps(discriminant, zero)), b));
+            const __m128 inside = _mm_cmple_ps(c, zero);
+            const __m128 endTime = _mm_andnot_ps(inside, root);
+            time = _mm_min_ps(time, _mm_or_ps(_mm_and_ps(hit, endTime), _mm_andnot_ps(hit, best)));
+        }
+
+        // strictly earlier only, ties keep the lower index
+        const __m128 earlier = _mm_cmplt_ps(time, best);
+        best = _mm_or_ps(_mm_and_ps(earlier, time), _mm_andnot_ps(earlier, best));
+        const __m128i earlierIdx = _mm_castps_si128(earlier);
+        bestIdx = _mm_or_si128(_mm_and_si128(earlierIdx, idx), _mm_andnot_si128(earlierIdx, bestIdx));
+        idx = _mm_add_epi32(idx, four);
+    }
+
+    float times[4];
+    int indices[4];
+    _mm_storeu_ps(times, best);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestIdx);
+
+    float result = maxTime;
+    size_t found = m_ax.size();
+    for ( int lane = 0; lane < 4; ++lane )
+    {
+        const size_t laneIdx = static_cast<size_t>(indices[lane]);
+        if ( times[lane] < result || (times[lane] == result && found < m_ax.size() && laneIdx < found) )
+        {
+            result = times[lane];
+            found = laneIdx;
+        }
+    }
+
+    // a padding copy stands for the last segment
+    if ( found < m_ax.size() )
+        segment = std::min(found, m_segments.size() - 1);
+    return result;
+}
+#endif
+
+void DiscWorld::advance(float dt)
+{
+    if ( dt <= 0.0f )
+        return;
+
+    for ( size_t i = 0; i < m_discs.size(); ++i )
+    {
+        Disc& disc = m_discs[i];
+        if ( m_removed[i] )
+            continue;
+        disc.x += disc.vx * dt;
+        disc.z += disc.vz * dt;
+        disc.angle += disc.spin * dt;
+    }
+}
+
+void DiscWorld::resolve(const Contact& contact)
+{
+    Disc& disc = m_discs[contact.disc];
+
+    if ( contact.type == CONTACT_DISC )
+    {
+        Disc& other = m_discs[contact.other];
+        float nx = other.x - disc.x;
+        float nz = other.z - disc.z;
+        const float length = std::sqrt(nx * nx + nz * nz);
+        if ( length <= 0.0f )
+            return;
+        nx /= length;
+        nz /= length;
+
+        this->applyImpulse(disc, &other, nx, nz, disc.radius, other.radius,
+                disc.restitution * other.restitution, disc.friction * other.friction);
+        return;
+    }
+
+    // normal towards the closest point of the segment
+    const size_t i = contact.other;
+    const float px = disc.x - m_ax[i];
+    const float pz = disc.z - m_az[i];
+    const float u = std::min(std::max((px * m_ex[i] + pz * m_ez[i]) * m_invLength2[i], 0.0f), 1.0f);
+    float nx = m_ex[i] * u - px;
+    float nz = m_ez[i] * u - pz;
+    float length = std::sqrt(nx * nx + nz * nz);
+    if ( length <= 0.0f )
+    {
+        // center on the wall, push back the way it came
+        nx = disc.vx;
+        nz = disc.vz;
+        length = std::sqrt(nx * nx + nz * nz);
+        if ( length <= 0.0f )
+            return;
+    }
+    nx /= length;
+    nz /= length;
+
+    const Segment& segment = m_segments[i];
+    this->applyImpulse(disc, nullptr, nx, nz, disc.radius, 0.0f,
+            disc.restitution * segment.restitution, disc.friction * segment.friction);
+}
+
+void DiscWorld::applyImpulse(Disc& a, Disc* b, float nx, float nz, float ra, float rb, float restitution, float friction)
+{
+    const float invMassA = a.invMass;
+    const float invMassB = b != nullptr ? b->invMass : 0.0f;
+    const float invInertiaA = a.invInertia;
+    const float invInertiaB = b != nullptr ? b->invInertia : 0.0f;
+
+    // contact point relative to each center, spin about y moves a point at
+    // (x, z) with spin * (z, -x)
+    const float rax = nx * ra;
+    const float raz = nz * ra;
+    const float rbx = -nx * rb;
+    const float rbz = -nz * rb;
+
+    float relX = -(a.vx + a.spin * raz);
+    float relZ = -(a.vz - a.spin * rax);
+    if ( b != nullptr )
+    {
+        relX += b->vx + b->spin * rbz;
+        relZ += b->vz - b->spin * rbx;
+    }
+
+    const float vn = relX * nx + relZ * nz;
+    const float invMass = invMassA + invMassB;
+    if ( vn >= 0.0f || invMass <= 0.0f )
+        return;
+
+    // normal impulse on b, the contact offsets are along n so they don't
+    // turn either disc
+    const float j = -(1.0f + restitution) * vn / invMass;
+
+    a.vx -= nx * j * invMassA;
+    a.vz -= nz * j * invMassA;
+    if ( b != nullptr )
+    {
+        b->vx += nx * j * invMassB;
+        b->vz += nz * j * invMassB;
+    }
+
+    // friction against the sliding at the contact, at most friction * j
+    float tx = relX - vn * nx;
+    float tz = relZ - vn * nz;
+    const float slide = std::sqrt(tx * tx + tz * tz);
+    if ( slide <= 0.0f || friction <= 0.0f )
+        return;
+    tx /= slide;
+    tz /= slide;
+
+    const float k = invMass + ra * ra * invInertiaA + rb * rb * invInertiaB;
+    const float jt = std::min(slide / k, friction * j);
+
+    // a is pushed along the sliding, b against it
+    a.vx += tx * jt * invMassA;
+    a.vz += tz * jt * invMassA;
+    a.spin += invInertiaA * (raz * tx - rax * tz) * jt;
+    if ( b != nullptr )
+    {
+        b->vx -= tx * jt * invMassB;
+        b->vz -= tz * jt * invMassB;
+        b->spin -= invInertiaB * (rbz * tx - rbx * tz) * jt;
+    }
+}
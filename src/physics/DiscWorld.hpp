@@ -0,0 +1,130 @@
+#ifndef DISCWORLD_HPP
+#define DISCWORLD_HPP
+
+#include <cstddef>
+#include <vector>
+
+// most collisions resolved in one step, the rest of the step is only
+// integrated (a disc wedged into a corner can't stall the tick)
+const int MAX_DISC_EVENTS = 256;
+
+// Event driven physics of discs sliding in a plane, walls are line segments.
+//
+// A step advances everything to the earliest time of impact, resolves that
+// one contact with an impulse and repeats for what is left of the step. The
+// impacts are solved exactly from the positions and velocities, a disc never
+// passes through a wall or another disc no matter how fast it is or how
+// long the step.
+//
+// The plane is x and z of the 3D world (the table), the discs spin about y.
+// Segments are tested four at a time with SSE when it is available.
+//
+// In deterministic mode the world only advances in fixed steps and uses the
+// scalar code, the same inputs give bit identical results whatever the
+// frame times or the machine.
+class DiscWorld
+{
+public:
+    struct Disc
+    {
+        float x, z;         // center
+        float vx, vz;       // linear velocity
+        float angle;        // about y, radians
+        float spin;         // angular velocity about y
+        float radius;
+        float invMass;      // 0 for a disc that doesn't move when hit
+        float invInertia;
+        float restitution;
+        float friction;
+        float linearDamping;    // fraction of the velocity lost per second
+        float angularDamping;
+    };
+
+    struct Segment
+    {
+        float ax, az;
+        float bx, bz;
+        float restitution;
+        float friction;
+    };
+
+    DiscWorld();
+
+    // returns the index of the disc, stays valid until it is removed
+    size_t addDisc(const Disc& disc);
+    void removeDisc(size_t idx);
+    Disc& getDisc(size_t idx);
+    const Disc& getDisc(size_t idx) const;
+
+    void addSegment(const Segment& segment);
+    void clearSegments();
+    size_t getSegmentCount() const;
+
+    void setDeterministic(bool deterministic, double timeStep);
+
+    // advance dt seconds, in deterministic mode whole time steps only and
+    // the remainder is kept for the next call
+    void tick(double dt);
+
+    // the time kept for the next call, saved with the discs to restore a
+    // deterministic world exactly
+    double getRemainder() const;
+    void setRemainder(double remainder);
+
+    // whether a step of the last tick ran out of MAX_DISC_EVENTS
+    bool isSaturated() const;
+protected:
+    enum ContactType
+    {
+        CONTACT_NONE,
+        CONTACT_SEGMENT,
+        CONTACT_DISC
+    };
+
+    struct Contact
+    {
+        ContactType type;
+        float time;
+        size_t disc;
+        size_t other;       // segment or disc
+    };
+
+    void step(float dt);
+
+    // earliest contact within maxTime over everything
+    Contact findContact(float maxTime) const;
+
+    // earliest time disc hits one of the segments, maxTime if it doesn't
+    float findSegmentTime(const Disc& disc, float maxTime, size_t& segment) const;
+    float findSegmentTimeScalar(const Disc& disc, float maxTime, size_t& segment) const;
+#ifdef __SSE2__
+    float findSegmentTimeSse(const Disc& disc, float maxTime, size_t& segment) const;
+#endif
+
+    void advance(float dt);
+    void resolve(const Contact& contact);
+
+    // impulse between a and b (b is a wall when it is null) along the unit
+    // normal from a to b, ra and rb are the distances of the contact point
+    // from the centers
+    void applyImpulse(Disc& a, Disc* b, float nx, float nz, float ra, float rb, float restitution, float friction);
+
+    std::vector<Disc>   m_discs;
+    std::vector<bool>   m_removed;
+
+    // segments as structure of arrays, padded to a multiple of 4 with
+    // copies of the last one
+    std::vector<float>  m_ax, m_az;
+    std::vector<float>  m_ex, m_ez;     // b - a
+    std::vector<float>  m_invLength2;   // 1 / |b - a|^2
+    std::vector<float>  m_length;       // |b - a|
+    std::vector<Segment> m_segments;
+
+    bool                m_deterministic;
+    double              m_timeStep;
+    double              m_accumulator;
+
+    bool                m_saturated;
+};
+
+#endif // DISCWORLD_HPP
@@ -0,0 +1,70 @@
+#include "InputQueue.hpp"
+
+#include <iostream>
+
+InputQueue::InputQueue(size_t capacity) :
+    m_events(capacity),
+    m_warnedFull(false)
+{}
+
+void InputQueue::pushKey(bool press, int key)
+{
+    this->push(press ? InputEvent::KEY_PRESS : InputEvent::KEY_RELEASE, key);
+}
+
+void InputQueue::pushMouseMove(float dx, float dy)
+{
+    this->push(InputEvent::MOUSE_MOVE, 0, dx, dy);
+}
+
+void InputQueue::pushSelectCamera(int camera)
+{
+    this->push(InputEvent::SELECT_CAMERA, camera);
+}
+
+void InputQueue::pushResize(int width, int height)
+{
+    this->push(InputEvent::RESIZE, 0, 0.0f, 0.0f, width, height);
+}
+
+void InputQueue::take(std::vector<InputEvent>& events)
+{
+    events.clear();
+
+    InputEvent event;
+    while ( m_events.pop(event) )
+    {
+        // merge with the move before if nothing came between them
+        if ( event.type == InputEvent::MOUSE_MOVE && !events.empty() && events.back().type == InputEvent::MOUSE_MOVE )
+        {
+            events.back().dx += event.dx;
+            events.back().dy += event.dy;
+            continue;
+        }
+        events.push_back(event);
+    }
+}
+
+bool InputQueue::empty() const
+{
+    return m_events.empty();
+}
+
+void InputQueue::push(InputEvent::Type type, int key, float dx, float dy, int width, int height)
+{
+    InputEvent event;
+    event.type = type;
+    event.key = key;
+    event.dx = dx;
+    event.dy = dy;
+    event.width = width;
+    event.height = height;
+    event.time = FramePacer::Clock::now();
+
+    // only if the render thread stopped taking them
+    if ( !m_events.push(event) && !m_warnedFull )
+    {
+        std::cout << "Warning: Input queue full, events dropped" << std::endl;
+        m_warnedFull = true;
+    }
+}
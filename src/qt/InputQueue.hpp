@@ -0,0 +1,60 @@
+#ifndef INPUTQUEUE_HPP
+#define INPUTQUEUE_HPP
+
+#include "../render/FramePacer.hpp"
+#include "../threading/SpscQueue.hpp"
+
+#include <vector>
+
+// one key, mouse or window event, stamped when it arrived
+struct InputEvent
+{
+    enum Type
+    {
+        KEY_PRESS,
+        KEY_RELEASE,
+        MOUSE_MOVE,
+        SELECT_CAMERA,
+        RESIZE
+    };
+
+    Type  type;
+    int   key;      // Qt::Key of KEY_PRESS and KEY_RELEASE, camera of SELECT_CAMERA
+    float dx;       // MOUSE_MOVE rotation in degrees
+    float dy;
+    int   width;    // RESIZE
+    int   height;
+    FramePacer::Clock::time_point time;
+};
+
+// Hands the input from the GUI thread to the render thread, the event
+// handlers only record what happened. The render thread takes everything at
+// once each tick and applies it before the simulation steps, nothing renders
+// because of an event.
+//
+// The push functions are for the GUI thread only and take for the render
+// thread only (see SpscQueue). Mouse moves in a row are merged into one with
+// the time of the first, a fast mouse then costs one camera update per tick
+// no matter how many events Qt sends.
+class InputQueue
+{
+public:
+    explicit InputQueue(size_t capacity = 4096);
+
+    void pushKey(bool press, int key);
+    void pushMouseMove(float dx, float dy);
+    void pushSelectCamera(int camera);
+    void pushResize(int width, int height);
+
+    // move the queued events into events (cleared first), oldest first
+    void take(std::vector<InputEvent>& events);
+
+    bool empty() const;
+protected:
+    void push(InputEvent::Type type, int key = 0, float dx = 0.0f, float dy = 0.0f, int width = 0, int height = 0);
+
+    SpscQueue<InputEvent> m_events;
+    bool                  m_warnedFull;     // GUI thread
+};
+
+#endif // INPUTQUEUE_HPP
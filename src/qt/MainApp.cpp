@@ -2,8 +2,11 @@
 
 #include "MainApp.hpp"
 
+#include "../bulletwrappers/TransformBuffer.hpp"
 #include "../glwrappers/GLShader.hpp"
+#include "../glwrappers/GLState.hpp"
 #include "../glwrappers/GLUniform.hpp"
+#include "../memory/FrameArena.hpp"
 #include "../shapes/Puck.hpp"
 #include "../shapes/Table.hpp"
 
@@ -12,8 +15,9 @@
 #include <QApplication>
 #include <QKeyEvent>
 #include <QMouseEvent>
-#include <QTimer>
 #include <QCursor>
+#include <QCloseEvent>
+#include <QPaintEvent>
 #include <QResizeEvent>
 
 // glm
@@ -23,7 +27,10 @@
 #include <glm/ext.hpp>
 
 // c++ libraries
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
 
 const unsigned char MOVE_FORWARD  = 0x01;
 const unsigned char MOVE_BACKWARD = 0x02;
@@ -36,8 +43,20 @@ const unsigned char ROTATE_CW     = 0x80;
 
 #define CHECKERR err = glGetError(); if ( err != GL_NO_ERROR ) { if ( err == GL_INVALID_OPERATION ) std::cout << "Error: INVALID_OPERATION Line " << __LINE__ << std::endl; else if (err == GL_INVALID_VALUE) std::cout << "Error: INVALID_VALUE Line " << __LINE__ << std::endl; else std::cout << "Error: Line " << __LINE__ << std::endl; }
 
-const float FPS = 60.0f;
-const unsigned int TICK_RATE = 1000 * (1.0/FPS);
+// frames the GPU may have queued before the next one waits (see FramePacer)
+const int MAX_FRAMES_IN_FLIGHT = 2;
+
+// frames between the reports of the benchmark mode
+const size_t BENCHMARK_REPORT_FRAMES = 1000;
+
+// GPU time both viewports together may take before their resolution drops,
+// leaves room for the rest of a 60 Hz frame
+const double RESOLUTION_BUDGET_MS = 10.0;
+
+// camera movement per second while a key is held, what 0.02 units and 1
+// degree per 60 Hz tick used to be
+const float CAMERA_SPEED = 1.2f;
+const float CAMERA_ROLL_SPEED = 60.0f;
 
 const float FOV_DEG = 45.0f;
 const float FIELD_NEAR = 0.01f;
@@ -76,20 +95,232 @@ void printUniformOffsets(GLuint program, GLuint uniformBlock)
     delete [] indices;
 }
 
-MainApp::MainApp(QWidget *parent) :
-    QGLWidget(QGLFormat(QGL::DoubleBuffer | QGL::DepthBuffer), parent),
+// the vertex shader doesn't look at the lighting bits
+const unsigned int VERTEX_FEATURES = SHADER_TEXTURE_DIFFUSE | SHADER_INDIRECT | SHADER_DEPTH_ONLY |
+                                     SHADER_WIREFRAME | SHADER_NORMALS;
+
+// added to the key of every lit variant
+#ifdef GRAPHICS_DEBUG
+const unsigned int DEBUG_FEATURES = SHADER_WIREFRAME;
+#else
+const unsigned int DEBUG_FEATURES = 0;
+#endif
+
+#ifdef PHYSICS_DEBUG
+// bind the uniform blocks shared between programs to their binding points
+static void bindUniformBlocks(GLProgram& program, bool lighting = true)
+{
+    if ( !program.bindUniformBlock("Matrices", UB_MATRICES) )
+        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
+
+    if ( !lighting )
+        return;
+
+    if ( !program.bindUniformBlock("Lights", UB_LIGHT) )
+        std::cout << "Warning: Unable to find uniform block Lights" << std::endl;
+    if ( !program.bindUniformBlock("Material", UB_MATERIAL) )
+        std::cout << "Warning: Unable to find uniform block Material" << std::endl;
+}
+#endif
+
+// offsets of the uniform block members as laid out by the mirror structs
+static const GLBlockMember MATRICES_MEMBERS[] = {
+    {"Matrices.mvpMatrix",    offsetof(MatricesBlock, mvpMatrix)},
+    {"Matrices.mvMatrix",     offsetof(MatricesBlock, mvMatrix)},
+    {"Matrices.normalMatrix", offsetof(MatricesBlock, normalMatrix)}
+};
+
+static const GLBlockMember LIGHTS_MEMBERS[] = {
+    {"Lights.count",            offsetof(LightsBlock, count)},
+    {"Lights.info[0].position", offsetof(LightsBlock, info) + offsetof(LightBlockInfo, position)},
+    {"Lights.info[0].diffuse",  offsetof(LightsBlock, info) + offsetof(LightBlockInfo, diffuse)},
+    {"Lights.info[0].specular", offsetof(LightsBlock, info) + offsetof(LightBlockInfo, specular)},
+    {"Lights.info[0].ambient",  offsetof(LightsBlock, info) + offsetof(LightBlockInfo, ambient)},
+    {"Lights.info[1].position", offsetof(LightsBlock, info) + sizeof(LightBlockInfo)}
+};
+
+static const GLBlockMember MATERIAL_MEMBERS[] = {
+    {"Material.diffuse",   offsetof(MaterialBlock, diffuse)},
+    {"Material.specular",  offsetof(MaterialBlock, specular)},
+    {"Material.ambient",   offsetof(MaterialBlock, ambient)},
+    {"Material.shininess", offsetof(MaterialBlock, shininess)},
+    {"Material.texBlend",  offsetof(MaterialBlock, texBlend)}
+};
+
+// check the driver agrees with the mirror structs, blocks the program
+// doesn't use are skipped
+static bool validateUniformBlocks(const GLProgram& program)
+{
+    bool valid = glValidateBlockLayout(program, "Matrices", MATRICES_MEMBERS, sizeof(MatricesBlock));
+    valid = glValidateBlockLayout(program, "Lights", LIGHTS_MEMBERS, sizeof(LightsBlock)) && valid;
+    valid = glValidateBlockLayout(program, "Material", MATERIAL_MEMBERS, sizeof(MaterialBlock)) && valid;
+    return valid;
+}
+
+// keys of both lit passes with features, for every light bucket or clustered
+static std::vector<unsigned int> getLitKeys(unsigned int features, bool clustered)
+{
+    std::vector<unsigned int> keys;
+    for ( int count = 0; count <= LIGHT_ARRAY_SIZE; ++count )
+    {
+        const unsigned int lighting = clustered ? SHADER_CLUSTERED : ShaderPermutations::getLightBucket(count);
+        const unsigned int key = features | DEBUG_FEATURES | lighting;
+        if ( std::find(keys.begin(), keys.end(), key) == keys.end() )
+        {
+            keys.push_back(key);
+            keys.push_back(key | SHADER_TEXTURE_DIFFUSE);
+        }
+    }
+    return keys;
+}
+
+// every variant initializeGL waits for, submitted in one batch so the driver
+// can compile them all at once (see ShaderPermutations::submit)
+static std::vector<unsigned int> getStartupKeys()
+{
+    std::vector<unsigned int> keys = getLitKeys(0, false);
+#if !defined(GRAPHICS_DEBUG) && !defined(NORMALS_DEBUG)
+    // same keys as initIndirect, initClustered and initDepthPrepass
+    std::vector<unsigned int> features(1, 0);
+    if ( GeometryPool::isSupported() )
+        features.push_back(SHADER_INDIRECT);
+
+    for ( size_t i = 0; i < features.size(); ++i )
+    {
+        const std::vector<unsigned int> clustered = getLitKeys(features[i], true);
+        keys.insert(keys.end(), clustered.begin(), clustered.end());
+        keys.push_back(features[i] | SHADER_DEPTH_ONLY);
+        if ( features[i] != 0 )
+        {
+            const std::vector<unsigned int> forward = getLitKeys(features[i], false);
+            keys.insert(keys.end(), forward.begin(), forward.end());
+        }
+    }
+#endif
+    return keys;
+}
+
+// vsync sets the frame rate, unless benchmarking
+static QGLFormat getFormat(bool benchmark)
+{
+    QGLFormat format(QGL::DoubleBuffer | QGL::DepthBuffer);
+    format.setSwapInterval(benchmark ? 0 : 1);
+    return format;
+}
+
+MainApp::MainApp(bool benchmark, unsigned int physicsThreads, PhysicsWorld::Backend physicsBackend, QWidget *parent) :
+    QGLWidget(getFormat(benchmark), parent),
     m_good(true),
+    m_clustered(false),
+    m_depthPrepassAvailable(false),
+    m_depthPrepass(false),
+    m_shadedFragments(),
+    m_frameParity(0),
+    m_dynamicResolution(false),
+    m_lodPixelScale(std::numeric_limits<float>::max()),
+    m_lodEnabled(true),
+    m_drawViewport(0.0f),
     m_camera{Camera(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), CameraMode::CAMERA_Y_LOCK_VERT),
              Camera(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), CameraMode::CAMERA_Y_LOCK_VERT)},
+    m_lights(MAX_CLUSTERED_LIGHTS),
+    m_pacer(MAX_FRAMES_IN_FLIGHT),
+    m_benchmark(benchmark),
+    m_physicsThreads(physicsThreads),
+    m_physicsBackend(physicsBackend),
+    m_viewportWidth(0),
+    m_viewportHeight(0),
     m_keyFlags(0),
+    m_replaying(false),
+    m_replayTick(0),
+    m_replayMismatches(0),
+    m_replayFirstMismatch(0),
     m_ignoreNextMovement(false),
     m_mouseEnable(false),
     m_cameraSelect(0)
 {
     this->setCursor(QCursor(Qt::CrossCursor));
-    connect(&m_timer,SIGNAL(timeout()),this,SLOT(timerTick()));
-    m_timer.start(TICK_RATE);
-    m_time.start();
+
+    // paintGL swaps itself so the frame can be fenced right after
+    this->setAutoBufferSwap(false);
+}
+
+MainApp::~MainApp()
+{
+    this->stopRendering();
+
+    // the GL objects of the members are deleted with the context current
+    this->makeCurrent();
+}
+
+void MainApp::startRendering()
+{
+    if ( m_renderThread.isRunning() )
+        return;
+
+    // the size the window has now, later ones come from resizeEvent
+    m_input.pushResize(this->width(), this->height());
+
+    // a context can only be current in the thread owning it
+    this->doneCurrent();
+    this->context()->moveToThread(&m_renderThread);
+
+    // a new frame as soon as the last one was swapped, the swap blocks until
+    // the display is ready for it and the pacer keeps the queue short
+    m_renderThread.startLoop([this]() { return this->renderInit(); },
+                             [this]() { this->renderFrame(); },
+                             [this]() { this->renderExit(); });
+}
+
+void MainApp::stopRendering()
+{
+    if ( m_renderThread.isRunning() )
+        m_renderThread.stopLoop();
+
+    // everything up to the last tick drawn
+    if ( m_recording != nullptr && !m_replaying && !m_recordFilename.empty() )
+    {
+        if ( m_recording->save(m_recordFilename) )
+            std::cout << "Recorded " << m_recording->getTickCount() << " ticks to " << m_recordFilename << std::endl;
+        else
+            std::cout << "Warning: " << m_recording->getLastError() << std::endl;
+        m_recordFilename.clear();
+    }
+}
+
+bool MainApp::recordTo(const std::string& filename)
+{
+    m_recording = std::shared_ptr<Recording>(new Recording);
+    m_recordFilename = filename;
+    m_replaying = false;
+
+    // fail now rather than after the match
+    std::ofstream fout(filename, std::ios::binary);
+    if ( !fout.good() )
+    {
+        std::cout << "Error: Unable to open file \"" << filename << "\"" << std::endl;
+        m_recording.reset();
+        return false;
+    }
+    return true;
+}
+
+bool MainApp::replayFrom(const std::string& filename)
+{
+    m_recording = std::shared_ptr<Recording>(new Recording);
+    m_recordFilename.clear();
+    m_replaying = true;
+    m_replayTick = m_replayMismatches = 0;
+
+    if ( !m_recording->load(filename) )
+    {
+        std::cout << "Error: " << m_recording->getLastError() << std::endl;
+        m_recording.reset();
+        m_replaying = false;
+        return false;
+    }
+    if ( m_recording->getBuildConfig() != Recording::currentBuildConfig() )
+        std::cout << "Warning: Recorded by a different build (" << m_recording->getBuildConfig() << ")" << std::endl;
+    return true;
 }
 
 void MainApp::reportError(const QString& error)
@@ -98,8 +329,40 @@ void MainApp::reportError(const QString& error)
     qerr << "Error: " << error << endl;
     m_good = false;
 
-    // won't work in initializeGL because main loop has not been entered yet
-    qApp->quit();
+    // runs once the GUI thread gets to its event loop
+    QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+}
+
+bool MainApp::renderInit()
+{
+    this->makeCurrent();
+    this->initializeGL();
+    return m_good;
+}
+
+void MainApp::renderExit()
+{
+    // give the context back to the GUI thread for the destructor
+    this->doneCurrent();
+    this->context()->moveToThread(qApp->thread());
+}
+
+void MainApp::paintEvent(QPaintEvent *)
+{
+    // the render thread draws continuously, nothing to do on expose
+}
+
+void MainApp::resizeEvent(QResizeEvent *event)
+{
+    // resizeGL runs on the render thread with the next frame
+    m_input.pushResize(event->size().width(), event->size().height());
+}
+
+void MainApp::closeEvent(QCloseEvent *event)
+{
+    // stop drawing before the window goes away
+    this->stopRendering();
+    event->accept();
 }
 
 void MainApp::initializeGL()
@@ -108,6 +371,12 @@ void MainApp::initializeGL()
     GLenum err = glewInit();
     if ( err != GLEW_OK )
         return reportError(QString::fromUtf8(reinterpret_cast<const char*>(glewGetErrorString(err))));
+
+    // nothing is known about the new context
+    GLState::invalidate();
+
+    // hand the driver its compiler threads before the first batch is submitted
+    GLState::hasParallelShaderCompile();
  
     // set some basic opengl flags
     glEnable(GL_DEPTH_TEST);  // Enables Depth Testing
@@ -117,70 +386,53 @@ void MainApp::initializeGL()
     glShadeModel(GL_SMOOTH);  // Enables Smooth Color Shading
     glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
 
-    // load shader programs
-    if ( !m_glProgramMaterial.loadAndLink("shaders/vshader.glsl", "shaders/fshader.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramMaterial.getLastError().c_str()));
-    if ( !m_glProgramTexD.loadAndLink("shaders/vshaderTexD.glsl", "shaders/fshaderTexD.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramTexD.getLastError().c_str()));
-
-    // set texture to sample from GL_TEXTURE0
-    GLUniform::setUniform(m_glProgramTexD, "u_diffuseMap", INT, 0);
-
-    // get the uniform locations TODO make this in a class
-    GLuint uMatrices = glGetUniformBlockIndex(m_glProgramMaterial.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-
-    GLuint uLights = glGetUniformBlockIndex(m_glProgramMaterial.getProgramIdx(), "Lights");
-    if ( uLights == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Lights" << std::endl;
-
-    GLuint uMaterial = glGetUniformBlockIndex(m_glProgramMaterial.getProgramIdx(), "Material");
-    if ( uMaterial == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Material" << std::endl;
-
-    // bind uniform blocks to indices TODO make this in a class
-    glUniformBlockBinding(m_glProgramMaterial.getProgramIdx(), uMatrices, UB_MATRICES);
-    glUniformBlockBinding(m_glProgramMaterial.getProgramIdx(), uLights, UB_LIGHT);
-    glUniformBlockBinding(m_glProgramMaterial.getProgramIdx(), uMaterial, UB_MATERIAL);
-    
-    // same for other program
-    uMatrices = glGetUniformBlockIndex(m_glProgramTexD.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-    uLights = glGetUniformBlockIndex(m_glProgramTexD.getProgramIdx(), "Lights");
-    if ( uLights == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Lights" << std::endl;
-    uMaterial = glGetUniformBlockIndex(m_glProgramTexD.getProgramIdx(), "Material");
-    if ( uMaterial == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Material" << std::endl;
- 
-    glUniformBlockBinding(m_glProgramTexD.getProgramIdx(), uMatrices, UB_MATRICES);
-    glUniformBlockBinding(m_glProgramTexD.getProgramIdx(), uLights, UB_LIGHT);
-    glUniformBlockBinding(m_glProgramTexD.getProgramIdx(), uMaterial, UB_MATERIAL);
+    // every program is a variant of the same sources (see ShaderPermutations)
+    if ( !m_shaders.addStage(GL_VERTEX_SHADER, "shaders/vshader.glsl", VERTEX_FEATURES) ||
+         !m_shaders.addStage(GL_FRAGMENT_SHADER, "shaders/fshader.glsl") ||
+         !m_shaders.addStage(GL_GEOMETRY_SHADER, "shaders/debug/gshaderWireframe.glsl",
+                             SHADER_TEXTURE_DIFFUSE | SHADER_WIREFRAME, SHADER_WIREFRAME) ||
+         !m_shaders.addStage(GL_GEOMETRY_SHADER, "shaders/debug/gshaderNormals.glsl", SHADER_NORMALS, SHADER_NORMALS) )
+        return reportError(QString::fromUtf8(m_shaders.getLastError().c_str()));
+    m_shaders.setInitializer([this](GLProgram& program, unsigned int key) { return this->initProgram(program, key); });
+
+    // start all the compiles before waiting for any of them. The light count
+    // can change any frame, have every bucket ready.
+    m_shaders.submit(getStartupKeys());
+    if ( !m_shaders.wait(getLitKeys(0, false)) )
+        return reportError(QString::fromUtf8(m_shaders.getLastError().c_str()));
 
     m_glUniformMatrixBuffer.generate(1);
     m_glUniformLightsBuffer.generate(1);
     m_glUniformMaterialBuffer.generate(1);
+    m_glUniformTransformBuffer.generate(1);
 
     m_glUniformMatrixBuffer.bind(GL_UNIFORM_BUFFER);
-    m_glUniformMatrixBuffer.setEmpty(MAT_BUFFER_SIZE, GL_DYNAMIC_DRAW);
+    m_glUniformMatrixBuffer.setEmpty(sizeof(MatricesBlock), GL_DYNAMIC_DRAW);
+    // sized by Lights::upload, one block per viewport
     m_glUniformLightsBuffer.bind(GL_UNIFORM_BUFFER);
-    m_glUniformLightsBuffer.setEmpty(LIGHT_BUFFER_SIZE, GL_DYNAMIC_DRAW);
+    // sized by TransformStage::upload, one block per target and viewport
+    m_glUniformTransformBuffer.bind(GL_UNIFORM_BUFFER);
     m_glUniformMaterialBuffer.bind(GL_UNIFORM_BUFFER);
-    m_glUniformMaterialBuffer.setEmpty(MATERIAL_BUFFER_SIZE, GL_DYNAMIC_DRAW);
+    m_glUniformMaterialBuffer.setEmpty(sizeof(MaterialBlock), GL_DYNAMIC_DRAW);
 
     m_glUniformMatrixBuffer.bindBase(UB_MATRICES);
-    m_glUniformLightsBuffer.bindBase(UB_LIGHT);
     m_glUniformMaterialBuffer.bindBase(UB_MATERIAL);
    
     GLBuffer::unbindBuffers(GL_UNIFORM_BUFFER);
 
-    // initialize physics
-    m_physics.init();
+    // initialize physics, a replay runs the way it was recorded
+    if ( m_replaying )
+        m_physics.init(m_recording->getBackend(), m_recording->getThreads());
+    else
+        m_physics.init(m_physicsBackend, m_physicsThreads);
+
+    // meshes go into one pool if they can be drawn with multi draw indirect
+    if ( this->initIndirect() )
+        m_geometryPool = std::shared_ptr<GeometryPool>(new GeometryPool);
 
     // initialize table
     std::shared_ptr<Table> table = std::shared_ptr<Table>(new Table);
+    table->setGeometryPool(m_geometryPool);
     if ( !table->init(m_physics, glm::vec3(0.0f, 0.0f, 0.0f)) )
         return reportError("Unable to load table");
     table->setUniforms(m_glUniformMaterialBuffer, MATERIALS);
@@ -189,12 +441,44 @@ void MainApp::initializeGL()
 
     // initialize puck
     std::shared_ptr<Puck> puck = std::shared_ptr<Puck>(new Puck);
+    puck->setGeometryPool(m_geometryPool);
     if ( !puck->init(m_physics, glm::vec3(0.0f, 0.0f, 0.0f), 0.1f) )
         return reportError("Unable to load puck");
     puck->setUniforms(m_glUniformMaterialBuffer, MATERIALS);
     m_renderTargets.push_back(std::shared_ptr<iGLRenderable>(puck));
     m_physicsTargets.push_back(std::shared_ptr<iPhysicsObject>(puck));
 
+    // the scene as bullet got it, enough to replay without a window
+    if ( m_recording != nullptr && !m_replaying )
+    {
+        m_recording->setConfig(m_physics.getBackend(), m_physicsThreads);
+        m_recording->addStaticMesh(table->getPhysicsParams());
+        m_recording->addCylinder(puck->getPhysicsParams());
+    }
+
+    if ( m_geometryPool != nullptr )
+    {
+        m_indirectRenderer = std::shared_ptr<IndirectRenderer>(new IndirectRenderer);
+        if ( !m_geometryPool->upload() || !m_indirectRenderer->init(m_geometryPool) )
+            return reportError("Unable to create the indirect renderer");
+    }
+
+    // hundreds of lights need clustered lighting, forward only sees the first
+    // LIGHT_ARRAY_SIZE
+    if ( !this->initClustered() )
+        std::cout << "Clustered lighting unavailable" << std::endl;
+
+    if ( this->initDepthPrepass() )
+        m_fragmentQueries.generate(4);
+    else
+        std::cout << "Depth pre-pass unavailable" << std::endl;
+
+    // sized by resizeGL
+    if ( this->initResolutionScaler() )
+        m_dynamicResolution = true;
+    else
+        std::cout << "Dynamic resolution unavailable" << std::endl;
+
     // TODO temporary just to show physics works
     //puck->setVelocity(glm::vec3(1.2f,0.0f,2.0f));
 
@@ -233,86 +517,28 @@ void MainApp::initializeGL()
         glm::vec3(0.0f, 0.0f, 0.0f)});
     m_lights.setLightInfo(lightInfo1, 1);
 
-#ifdef GRAPHICS_DEBUG
-    std::cout << "Loading Wireframe Debug Program" << std::endl;
-
-    // load programs
-    if ( !m_glProgramWireframe.loadAndLink("./shaders/debug/vshaderWireframe.glsl", "./shaders/debug/fshaderWireframe.glsl", "./shaders/debug/gshaderWireframe.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramWireframe.getLastError().c_str()));
-    if ( !m_glProgramTexDWireframe.loadAndLink("./shaders/debug/vshaderTexDWireframe.glsl", "./shaders/debug/fshaderTexDWireframe.glsl", "./shaders/debug/gshaderTexDWireframe.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramTexDWireframe.getLastError().c_str()));
-
-    // get and bind uniform block locations
-    uMatrices = glGetUniformBlockIndex(m_glProgramWireframe.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-    uLights = glGetUniformBlockIndex(m_glProgramWireframe.getProgramIdx(), "Lights");
-    if ( uLights == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Lights" << std::endl;
-    uMaterial = glGetUniformBlockIndex(m_glProgramWireframe.getProgramIdx(), "Material");
-    if ( uMaterial == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Material" << std::endl;
-    
-    glUniformBlockBinding(m_glProgramWireframe.getProgramIdx(), uMatrices, UB_MATRICES);
-    glUniformBlockBinding(m_glProgramWireframe.getProgramIdx(), uLights, UB_LIGHT);
-    glUniformBlockBinding(m_glProgramWireframe.getProgramIdx(), uMaterial, UB_MATERIAL);
-
-    uMatrices = glGetUniformBlockIndex(m_glProgramTexDWireframe.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-    uLights = glGetUniformBlockIndex(m_glProgramTexDWireframe.getProgramIdx(), "Lights");
-    if ( uLights == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Lights" << std::endl;
-    uMaterial = glGetUniformBlockIndex(m_glProgramTexDWireframe.getProgramIdx(), "Material");
-    if ( uMaterial == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Material" << std::endl;
-    
-    glUniformBlockBinding(m_glProgramTexDWireframe.getProgramIdx(), uMatrices, UB_MATRICES);
-    glUniformBlockBinding(m_glProgramTexDWireframe.getProgramIdx(), uLights, UB_LIGHT);
-    glUniformBlockBinding(m_glProgramTexDWireframe.getProgramIdx(), uMaterial, UB_MATERIAL);
-
-    // find window size uniform for the wireframe 
-    m_winSizeWireframe.init(m_glProgramWireframe, "u_windowSize", VEC2F);
-    m_winSizeWireframe.loadData(glm::vec2(this->width()/4.0f, this->height()/2.0f));
-    m_winSizeWireframe.set();
-    m_winSizeTexDWireframe.init(m_glProgramTexDWireframe, "u_windowSize", VEC2F);
-    m_winSizeTexDWireframe.loadData(glm::vec2(this->width()/4.0f, this->height()/2.0f));
-    m_winSizeTexDWireframe.set();
-
-    // set texture to sample from GL_TEXTURE0
-    GLUniform diffuseMapWireframe;
-    diffuseMapWireframe.init(m_glProgramTexDWireframe, "u_diffuseMap", INT);
-    diffuseMapWireframe.loadData(0);
-    diffuseMapWireframe.set();
-#endif
-
+    // the debug programs build while the first frames are drawn, paintGL
+    // picks them up once they're done
 #ifdef NORMALS_DEBUG
     std::cout << "Loading Normals Debug OpenGL Program" << std::endl;
 
-    if ( !m_glProgramNormals.loadAndLink("./shaders/debug/vshaderNormals.glsl", "./shaders/debug/fshaderNormals.glsl", "./shaders/debug/gshaderNormals.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramNormals.getLastError().c_str()));
-
-    // get and bind uniform block locations
-    uMatrices = glGetUniformBlockIndex(m_glProgramNormals.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-    glUniformBlockBinding(m_glProgramNormals.getProgramIdx(), uMatrices, UB_MATRICES);
-
-    // get the location projection matrix uniform
-    m_uniformProjection.init(m_glProgramNormals, "u_projectionMatrix", MAT4F);
+    // also finds the projection matrix uniform (see initProgram)
+    m_shaders.submit(std::vector<unsigned int>(1, SHADER_NORMALS));
 #endif
     
 #ifdef PHYSICS_DEBUG
     std::cout << "Loading Physics Debug OpenGL Program" << std::endl;
 
-    if ( !m_glProgramDebug.loadAndLink("./shaders/debug/vshaderPassthrough.glsl", "./shaders/debug/fshaderPassthrough.glsl") )
-        return reportError(QString::fromUtf8(m_glProgramDebug.getLastError().c_str()));
+    if ( !m_debugShaders.addStage(GL_VERTEX_SHADER, "shaders/debug/vshaderPassthrough.glsl") ||
+         !m_debugShaders.addStage(GL_FRAGMENT_SHADER, "shaders/debug/fshaderPassthrough.glsl") )
+        return reportError(QString::fromUtf8(m_debugShaders.getLastError().c_str()));
 
     // get and bind uniform block locations
-    uMatrices = glGetUniformBlockIndex(m_glProgramDebug.getProgramIdx(), "Matrices");
-    if ( uMatrices == GL_INVALID_INDEX )
-        std::cout << "Warning: Unable to find uniform block Matrices" << std::endl;
-    glUniformBlockBinding(m_glProgramDebug.getProgramIdx(), uMatrices, UB_MATRICES);
+    m_debugShaders.setInitializer([](GLProgram& program, unsigned int) {
+        bindUniformBlocks(program, false);
+        return true;
+    });
+    m_debugShaders.submit(std::vector<unsigned int>(1, 0));
   
     // tell physics world to use debug drawer
     m_physicsDebug = std::shared_ptr<PhysicsDebug>(new PhysicsDebug);
@@ -321,30 +547,338 @@ void MainApp::initializeGL()
 }
 
 void MainApp::updatePhysicsObjects()
+{
+    // only what bullet moved since the last frame, the table and sleeping
+    // bodies are never on the list
+    TransformBuffer& transformBuffer = *m_physics.getTransformBuffer();
+    const std::vector<size_t>& moved = transformBuffer.getDirty();
+    for ( size_t i = 0; i < moved.size(); ++i )
+    {
+        iPhysicsObject* owner = transformBuffer.getOwner(moved[i]);
+        if ( owner != nullptr )
+            owner->updateTransform();
+    }
+    transformBuffer.clearDirty();
+
+#ifdef PHYSICS_DEBUG
+    // the lines of this tick, drawn as they are in both viewports
+    m_physicsDebug->beginLines();
+    m_physics.get()->debugDrawWorld();
+    m_physicsDebug->endLines();
+#endif
+
+    // the matrices of every target in both views, the model matrices don't
+    // change again this frame
+    const glm::mat4 viewMatrices[] = {m_camera[0].getViewMatrix(), m_camera[1].getViewMatrix()};
+    m_transforms.clear();
+    for ( RenderList::iterator i = m_renderTargets.begin(); i != m_renderTargets.end(); ++i )
+        m_transforms.add((*i)->getModelMatrix());
+    m_transforms.compute(m_projectionMatrix, viewMatrices, 2);
+    m_transforms.upload(m_glUniformTransformBuffer);
+}
+
+void MainApp::drawPhysicsDebug(size_t view)
 {
 #ifdef PHYSICS_DEBUG 
-    static int player = 0;
+    // nothing to draw with until the program is built
+    GLProgram* program = m_debugShaders.get(0, false);
+    if ( program == nullptr )
+        return;
 
     // model matrix is always identity
-    const glm::mat4 mvpMatrix = m_projectionMatrix * m_camera[player].getViewMatrix();
-
-    // every other time this is called it toggles between players
-    player = (player + 1)%2;
+    const glm::mat4 mvpMatrix = m_projectionMatrix * m_camera[view].getViewMatrix();
+    m_glUniformMatrixBuffer.setSubData(&mvpMatrix, offsetof(MatricesBlock, mvpMatrix));
+    m_glUniformMatrixBuffer.bindBase(UB_MATRICES);
 
-    m_glUniformMatrixBuffer.bind(GL_UNIFORM_BUFFER);
-    m_glUniformMatrixBuffer.setSubData(&mvpMatrix, MAT_MVP_OFFSET); 
+    program->use();
 
-    m_glProgramDebug.use();
-    
-    m_physics.get()->debugDrawWorld();
-    m_physicsDebug->loadToBuffer();
+    // collected by updatePhysicsObjects
     m_physicsDebug->draw();
+#else
+    (void)view;
+#endif
+}
+
+void MainApp::drawTarget(size_t idx, size_t view, DrawType type)
+{
+    // matrices computed by updatePhysicsObjects
+    m_transforms.bind(m_glUniformTransformBuffer, 0, view, idx, UB_MATRICES);
+
+    m_renderTargets[idx]->selectLod(m_transforms.getMatrices(view, idx), m_lodPixelScale);
+    m_renderTargets[idx]->draw(type);
+}
+
+void MainApp::drawTargets(size_t view, DrawType type)
+{
+    for ( size_t i = 0; i < m_renderTargets.size(); ++i )
+        this->drawTarget(i, view, type);
+}
+
+void MainApp::submitIndirect(size_t view)
+{
+    m_fallbackTargets.clear();
+    m_indirectRenderer->begin();
+    for ( size_t i = 0; i < m_renderTargets.size(); ++i )
+    {
+        const MatricesBlock& matrices = m_transforms.getMatrices(view, i);
+        m_renderTargets[i]->selectLod(matrices, m_lodPixelScale);
+        if ( !m_renderTargets[i]->submit(*m_indirectRenderer, matrices) )
+            m_fallbackTargets.push_back(i);
+    }
+    m_indirectRenderer->upload();
+}
+
+void MainApp::drawIndirect(size_t view)
+{
+    const DrawType types[] = {DRAW_MATERIAL, DRAW_TEXTURE_D};
+    for ( int i = 0; i < 2; ++i )
+        if ( this->useProgram(this->getProgramKey(types[i], true)) )
+            m_indirectRenderer->draw(types[i]);
+
+    // anything that couldn't be submitted is drawn the regular way
+    if ( m_fallbackTargets.empty() )
+        return;
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        if ( !this->useProgram(this->getProgramKey(types[i], false)) )
+            continue;
+        for ( size_t j = 0; j < m_fallbackTargets.size(); ++j )
+            this->drawTarget(m_fallbackTargets[j], view, types[i]);
+    }
+}
+
+void MainApp::drawDepth(size_t view)
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    if ( m_indirectRenderer != nullptr )
+    {
+        if ( this->useProgram(this->getProgramKey(DRAW_DEPTH, true)) )
+            m_indirectRenderer->drawDepth();
+
+        if ( !m_fallbackTargets.empty() && this->useProgram(this->getProgramKey(DRAW_DEPTH, false)) )
+            for ( size_t i = 0; i < m_fallbackTargets.size(); ++i )
+                this->drawTarget(m_fallbackTargets[i], view, DRAW_DEPTH);
+    }
+    else if ( this->useProgram(this->getProgramKey(DRAW_DEPTH, false)) )
+    {
+        this->drawTargets(view, DRAW_DEPTH);
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // the lit passes compute the same depth (invariant gl_Position), so only
+    // the nearest fragment of each pixel passes
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+}
+
+bool MainApp::initDepthPrepass()
+{
+#if defined(GRAPHICS_DEBUG) || defined(NORMALS_DEBUG)
+    // the debug shaders don't share the depth of the pre-pass
+    return false;
+#else
+    std::vector<unsigned int> keys(1, SHADER_DEPTH_ONLY);
+    if ( m_indirectRenderer != nullptr )
+        keys.push_back(SHADER_DEPTH_ONLY | SHADER_INDIRECT);
+
+    if ( !m_shaders.wait(keys) )
+    {
+        std::cout << "Warning: " << m_shaders.getLastError() << std::endl;
+        return false;
+    }
+
+    m_depthPrepassAvailable = true;
+    return true;
+#endif
+}
+
+void MainApp::printShadedFragments() const
+{
+    for ( int screenIdx = 0; screenIdx < 2; ++screenIdx )
+    {
+        const GLuint64 without = m_shadedFragments[0][screenIdx];
+        const GLuint64 with = m_shadedFragments[1][screenIdx];
+        std::cout << "Viewport " << screenIdx << ": " << without << " fragments shaded without pre-pass, "
+                  << with << " with";
+        if ( without > 0 && with > 0 )
+            std::cout << " (" << (without > with ? without - with : 0) << " saved, "
+                      << 100.0 * (1.0 - double(with) / double(without)) << "%)";
+        std::cout << std::endl;
+    }
+}
+
+bool MainApp::initResolutionScaler()
+{
+#ifdef NORMALS_DEBUG
+    // the normals pass draws over the lit one, clearing the viewport between
+    // them would lose it
+    return false;
+#else
+    m_resolutionScaler = std::shared_ptr<ResolutionScaler>(new ResolutionScaler(RESOLUTION_BUDGET_MS));
+    if ( !m_resolutionScaler->init(2) )
+    {
+        m_resolutionScaler = nullptr;
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool MainApp::initIndirect()
+{
+#if defined(GRAPHICS_DEBUG) || defined(NORMALS_DEBUG)
+    // the debug geometry shaders don't pass the draw data on
+    return false;
+#else
+    if ( !GeometryPool::isSupported() )
+        return false;
+
+    if ( !m_shaders.wait(getLitKeys(SHADER_INDIRECT, false)) )
+    {
+        std::cout << "Warning: " << m_shaders.getLastError() << std::endl;
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool MainApp::initClustered()
+{
+#if defined(GRAPHICS_DEBUG) || defined(NORMALS_DEBUG)
+    // the debug shaders do their own lighting
+    return false;
+#else
+    m_lightClusters = std::shared_ptr<LightClusters>(new LightClusters);
+    if ( !m_lightClusters->init(2) )
+    {
+        m_lightClusters = nullptr;
+        return false;
+    }
+
+    // pooled meshes can only be drawn by the indirect variants
+    std::vector<unsigned int> keys = getLitKeys(0, true);
+    if ( m_indirectRenderer != nullptr )
+    {
+        const std::vector<unsigned int> indirect = getLitKeys(SHADER_INDIRECT, true);
+        keys.insert(keys.end(), indirect.begin(), indirect.end());
+    }
+
+    if ( !m_shaders.wait(keys) )
+    {
+        std::cout << "Warning: " << m_shaders.getLastError() << std::endl;
+        m_lightClusters = nullptr;
+        return false;
+    }
+    return true;
+#endif
+}
+
+unsigned int MainApp::getProgramKey(DrawType type, bool indirect) const
+{
+    unsigned int key = indirect ? SHADER_INDIRECT : 0;
+    if ( type == DRAW_DEPTH )
+        return key | SHADER_DEPTH_ONLY;
+
+    key |= DEBUG_FEATURES | (type & SHADER_TEXTURE_DIFFUSE);
+    if ( m_clustered )
+        key |= SHADER_CLUSTERED;
+    else
+        key |= ShaderPermutations::getLightBucket(m_lights.getActiveCount());
+    return key;
+}
+
+bool MainApp::useProgram(unsigned int key)
+{
+    // a variant that isn't built yet is skipped, not waited for
+    GLProgram* program = m_shaders.get(key, false);
+    if ( program == nullptr )
+        return false;
+
+    program->use();
+#ifdef GRAPHICS_DEBUG
+    if ( (key & SHADER_WIREFRAME) != 0 )
+        m_uniformWindowSize[key].set(glm::vec2(m_drawViewport.z/2.0f, m_drawViewport.w/2.0f));
+#endif
+    return true;
+}
+
+bool MainApp::initProgram(GLProgram& program, unsigned int key)
+{
+    // variants leave out the blocks they don't use
+    const char* blocks[] = {"Matrices", "Lights", "Material"};
+    const GLuint bindings[] = {UB_MATRICES, UB_LIGHT, UB_MATERIAL};
+    for ( int i = 0; i < 3; ++i )
+        if ( program.getUniformBlockIndex(glHash(blocks[i])) != GL_INVALID_INDEX )
+            program.bindUniformBlock(blocks[i], bindings[i]);
+
+    // set texture to sample from GL_TEXTURE0
+    if ( (key & SHADER_TEXTURE_DIFFUSE) != 0 )
+        GLUniform::setUniform(program, "u_diffuseMap", INT, 0);
+    if ( (key & SHADER_INDIRECT) != 0 )
+        GLUniform::setUniform(program, "u_drawData", INT, DRAW_DATA_UNIT);
+    if ( (key & SHADER_CLUSTERED) != 0 && (m_lightClusters == nullptr || !m_lightClusters->addProgram(program)) )
+        return false;
+
+#ifdef NORMALS_DEBUG
+    // get the location projection matrix uniform
+    if ( (key & SHADER_NORMALS) != 0 )
+        m_uniformProjection.init(program, "u_projectionMatrix");
+#endif
 
-    GLProgram::resetUsed();
+#ifdef GRAPHICS_DEBUG
+    // each wireframe variant keeps its own location and last value
+    if ( (key & SHADER_WIREFRAME) != 0 )
+        m_uniformWindowSize[key].init(program, "u_windowSize");
 #endif
 
-    for ( PhysicsList::iterator i = m_physicsTargets.begin(); i != m_physicsTargets.end(); ++i )
-        (*i)->updateTransform();
+    if ( !validateUniformBlocks(program) )
+    {
+        std::cout << "Warning: Uniform block layout doesn't match the std140 mirror structs" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void MainApp::setLightGrid(bool enable)
+{
+    // dim lights so each one only reaches its part of the arena
+    const int GRID_SIZE = 16;
+    const float GRID_EXTENT = 4.0f;
+    const float GRID_HEIGHT = 0.5f;
+
+    if ( !enable )
+    {
+        for ( size_t i = 0; i < m_lightGrid.size(); ++i )
+            m_lights.removeLight(m_lightGrid[i]);
+        m_lightGrid.clear();
+        return;
+    }
+    if ( !m_lightGrid.empty() )
+        return;
+
+    for ( int z = 0; z < GRID_SIZE; ++z )
+    {
+        for ( int x = 0; x < GRID_SIZE; ++x )
+        {
+            // cycle through a few hues
+            const int hue = (x + z) % 3;
+            const glm::vec3 color(hue == 0 ? 0.06f : 0.02f, hue == 1 ? 0.06f : 0.02f, hue == 2 ? 0.06f : 0.02f);
+            const LightInfo light({
+                glm::vec3(GRID_EXTENT * (2.0f * x / (GRID_SIZE - 1) - 1.0f), GRID_HEIGHT,
+                          GRID_EXTENT * (2.0f * z / (GRID_SIZE - 1) - 1.0f)),
+                color,
+                color * 0.5f,
+                glm::vec3(0.0f, 0.0f, 0.0f)});
+
+            const int idx = m_lights.addLight(light);
+            if ( idx == INVALID_INDEX )
+                return;
+            m_lightGrid.push_back(idx);
+        }
+    }
 }
 
 void MainApp::paintGL()
@@ -352,109 +886,247 @@ void MainApp::paintGL()
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // pick up the programs that finished building in the background
+    if ( m_shaders.getPendingCount() > 0 && !m_shaders.update() )
+        std::cout << "Warning: " << m_shaders.getLastError() << std::endl;
+#ifdef PHYSICS_DEBUG
+    if ( m_debugShaders.getPendingCount() > 0 && !m_debugShaders.update() )
+        std::cout << "Warning: " << m_debugShaders.getLastError() << std::endl;
+#endif
+
+    // lights of both viewports in one upload, skipped if nothing moved
+    const glm::mat4 viewMatrices[] = {m_camera[0].getViewMatrix(), m_camera[1].getViewMatrix()};
+    m_lights.upload(m_glUniformLightsBuffer, 0, viewMatrices, 2);
+
+    // update physics objects
+    this->updatePhysicsObjects();
+
 #ifdef NORMALS_DEBUG
     if ( m_uniformProjection.isInitialized() )
-    {
-        m_uniformProjection.loadData(m_projectionMatrix);
-        m_uniformProjection.set();
-    }
+        m_uniformProjection.set(m_projectionMatrix);
     for ( int pass = 0; pass < 2; ++pass )
     {
 #endif
     for ( int screenIdx = 0; screenIdx < 2; ++screenIdx )
     {
-        // enable only half the screen
-        glViewport(screenIdx * this->width()/2.0, 0.0, this->width()/2.0, this->height());
+        // enable only half the screen, or draw offscreen at a lower
+        // resolution and scale it up into that half afterwards
+        const glm::vec4 screenViewport(screenIdx * m_viewportWidth/2.0f, 0.0f, m_viewportWidth/2.0f, m_viewportHeight);
+        glm::vec4 viewport = screenViewport;
+        if ( m_dynamicResolution )
+            viewport = m_resolutionScaler->begin(screenIdx);
+        else
+            glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+        m_drawViewport = viewport;
+
+        // detail levels follow the pixels actually drawn
+        m_lodPixelScale = m_lodEnabled ? m_projectionMatrix[1][1] * viewport.w / 2.0f : std::numeric_limits<float>::max();
     
         // get the view matrix
         const glm::mat4 &viewMatrix = m_camera[screenIdx].getViewMatrix();
    
         // set lights
-        m_lights.load(m_glUniformLightsBuffer, 0, viewMatrix);
-
-        // update physics objects
-        this->updatePhysicsObjects();
-
-        // Render non-textured targets
-#ifdef NORMALS_DEBUG
-        if ( pass == 0 )
+        if ( m_clustered )
         {
-#endif
-#ifdef GRAPHICS_DEBUG
-        m_glProgramWireframe.use();
-        m_winSizeWireframe.loadData(glm::vec2(this->width()/4.0f, this->height()/2.0f));
-        m_winSizeWireframe.set();
-#else
-        m_glProgramMaterial.use();
-#endif
-#ifdef NORMALS_DEBUG
+            // rebuilt only if a light or the camera changed
+            m_lightClusters->build(screenIdx, m_lights, viewMatrix, m_projectionMatrix, FIELD_NEAR, FIELD_FAR, viewport);
+            m_lightClusters->bind(screenIdx);
         }
         else
         {
-            m_glProgramNormals.use();
+            m_lights.bindView(m_glUniformLightsBuffer, 0, screenIdx, UB_LIGHT);
         }
-#endif
-        for ( RenderList::iterator i = m_renderTargets.begin(); i != m_renderTargets.end(); ++i )
+
+        this->drawPhysicsDebug(screenIdx);
+
+        if ( m_indirectRenderer != nullptr )
+            this->submitIndirect(screenIdx);
+
+        if ( m_depthPrepass )
+            this->drawDepth(screenIdx);
+
+        // count the fragments the lit passes shade, the query of the same
+        // viewport two frames back should be done by now. If it isn't this
+        // frame isn't counted, restarting it would lose its result.
+        const int queryIdx = m_frameParity * 2 + screenIdx;
+        bool countFragments = !m_fragmentQueries.isIssued(queryIdx);
+        if ( !countFragments && m_fragmentQueries.isAvailable(queryIdx) )
+        {
+            m_shadedFragments[m_fragmentQueryPrepass[queryIdx]][screenIdx] = m_fragmentQueries.getResult(queryIdx);
+            countFragments = true;
+        }
+        if ( countFragments )
         {
-            // set model uniforms
-            const glm::mat4& modelMatrix = (*i)->getModelMatrix();
-            const glm::mat4  modelViewMatrix = viewMatrix * modelMatrix;
-            const glm::mat4  mvpMatrix = m_projectionMatrix * modelViewMatrix;
-            const glm::mat4  normalMatrix = glm::transpose(glm::inverse(modelViewMatrix));
-
-            m_glUniformMatrixBuffer.bind(GL_UNIFORM_BUFFER);
-            m_glUniformMatrixBuffer.setSubData(&mvpMatrix, MAT_MVP_OFFSET); 
-            m_glUniformMatrixBuffer.setSubData(&modelViewMatrix, MAT_MV_OFFSET); 
-            m_glUniformMatrixBuffer.setSubData(&normalMatrix, MAT_NORMAL_OFFSET); 
-
-            (*i)->draw(DRAW_MATERIAL);
+            m_fragmentQueries.begin(GL_SAMPLES_PASSED, queryIdx);
+            m_fragmentQueryPrepass[queryIdx] = m_depthPrepass;
         }
 
-#ifdef NORMALS_DEBUG
-        if ( pass == 0 )
+        // everything in one multi draw per program
+        if ( m_indirectRenderer != nullptr )
         {
-#endif
-#ifdef GRAPHICS_DEBUG
-        m_glProgramTexDWireframe.use();
-        m_winSizeTexDWireframe.loadData(glm::vec2(this->width()/4.0f, this->height()/2.0f));
-        m_winSizeTexDWireframe.set();
+            this->drawIndirect(screenIdx);
+        }
+        else
+        {
+            // Render non-textured targets, then textured
+            const DrawType types[] = {DRAW_MATERIAL, DRAW_TEXTURE_D};
+            for ( int i = 0; i < 2; ++i )
+            {
+#ifdef NORMALS_DEBUG
+                // the second pass draws the normals over the first
+                const unsigned int key = pass == 0 ? this->getProgramKey(types[i], false) : SHADER_NORMALS;
 #else
-        m_glProgramTexD.use();
+                const unsigned int key = this->getProgramKey(types[i], false);
 #endif
-#ifdef NORMALS_DEBUG
+                if ( this->useProgram(key) )
+                    this->drawTargets(screenIdx, types[i]);
+            }
         }
-        else
+
+        if ( countFragments )
+            GLQuery::end(GL_SAMPLES_PASSED);
+
+        if ( m_depthPrepass )
         {
-            m_glProgramNormals.use();
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
         }
-#endif
-        for ( RenderList::iterator i = m_renderTargets.begin(); i != m_renderTargets.end(); ++i )
+
+        if ( m_dynamicResolution )
         {
-            // set model uniforms
-            const glm::mat4& modelMatrix = (*i)->getModelMatrix();
-            const glm::mat4  modelViewMatrix = viewMatrix * modelMatrix;
-            const glm::mat4  mvpMatrix = m_projectionMatrix * modelViewMatrix;
-            const glm::mat4  normalMatrix = glm::transpose(glm::inverse(modelViewMatrix));
-
-            m_glUniformMatrixBuffer.bind(GL_UNIFORM_BUFFER);
-            m_glUniformMatrixBuffer.setSubData(&mvpMatrix, MAT_MVP_OFFSET); 
-            m_glUniformMatrixBuffer.setSubData(&modelViewMatrix, MAT_MV_OFFSET); 
-            m_glUniformMatrixBuffer.setSubData(&normalMatrix, MAT_NORMAL_OFFSET); 
-
-            (*i)->draw(DRAW_TEXTURE_D);
+            m_resolutionScaler->end();
+            m_resolutionScaler->present(screenIdx, screenViewport);
         }
     }
 #ifdef NORMALS_DEBUG
     }
 #endif
+    m_frameParity = 1 - m_frameParity;
+
+    this->swapBuffers();
+    m_pacer.endFrame();
 
-    GLProgram::resetUsed();
+    // everything allocated for this frame is released here
+    FrameArena::endFrame();
+    GLState::endFrame();
 }
 
 void MainApp::keyPressEvent(QKeyEvent *event)
 {
     if ( event->isAutoRepeat() ) return;
-    
+
+    // applied by the next tick
+    m_input.pushKey(true, event->key());
+}
+
+void MainApp::keyReleaseEvent(QKeyEvent *event)
+{
+    if ( event->isAutoRepeat() ) return;
+
+    m_input.pushKey(false, event->key());
+}
+
+void MainApp::applyInput()
+{
+    m_input.take(m_inputEvents);
+    m_tickEvents.clear();
+    for ( size_t i = 0; i < m_inputEvents.size(); ++i )
+    {
+        const InputEvent& event = m_inputEvents[i];
+
+        // the window is the only thing a replay still takes from the user,
+        // and it has nothing to do with the simulation
+        if ( event.type != InputEvent::RESIZE )
+        {
+            if ( m_replaying )
+                continue;
+
+            Recording::Event recorded;
+            recorded.type = event.type;
+            recorded.key = event.key;
+            recorded.dx = event.dx;
+            recorded.dy = event.dy;
+            m_tickEvents.push_back(recorded);
+        }
+
+        this->applyEvent(event);
+
+        // shown by the frame this tick draws
+        m_pacer.addInput(event.time);
+    }
+
+    if ( m_replaying && m_replayTick < m_recording->getTickCount() )
+    {
+        const Recording::Tick& tick = m_recording->getTick(m_replayTick);
+        for ( uint32_t i = 0; i < tick.eventCount; ++i )
+        {
+            const Recording::Event& recorded = m_recording->getEvent(tick.firstEvent + i);
+            InputEvent event;
+            event.type = static_cast<InputEvent::Type>(recorded.type);
+            event.key = recorded.key;
+            event.dx = recorded.dx;
+            event.dy = recorded.dy;
+            event.width = event.height = 0;
+            this->applyEvent(event);
+        }
+    }
+}
+
+void MainApp::applyEvent(const InputEvent& event)
+{
+    if ( event.type == InputEvent::KEY_PRESS )
+        this->applyKeyPress(event.key);
+    else if ( event.type == InputEvent::KEY_RELEASE )
+        this->applyKeyRelease(event.key);
+    else if ( event.type == InputEvent::SELECT_CAMERA )
+        m_cameraSelect = event.key;
+    else if ( event.type == InputEvent::RESIZE )
+    {
+        m_viewportWidth = event.width;
+        m_viewportHeight = event.height;
+        this->resizeGL(event.width, event.height);
+    }
+    else
+    {
+        m_camera[m_cameraSelect].rotateVert(event.dy);
+        m_camera[m_cameraSelect].rotateHoriz(event.dx);
+    }
+}
+
+void MainApp::recordTick(double dt)
+{
+    const uint64_t hash = m_physics.getStateHash();
+    if ( !m_replaying )
+    {
+        m_recording->addTick(dt, m_tickEvents, hash);
+        return;
+    }
+
+    const size_t tickCount = m_recording->getTickCount();
+    if ( m_replayTick >= tickCount )
+        return;
+
+    if ( hash != m_recording->getTick(m_replayTick).stateHash )
+    {
+        if ( m_replayMismatches == 0 )
+            m_replayFirstMismatch = m_replayTick;
+        ++m_replayMismatches;
+    }
+
+    if ( ++m_replayTick == tickCount )
+    {
+        std::cout << "Replayed " << tickCount << " ticks, ";
+        if ( m_replayMismatches == 0 )
+            std::cout << "every state hash matched" << std::endl;
+        else
+            std::cout << m_replayMismatches << " state hashes differ, diverged at tick " << m_replayFirstMismatch << std::endl;
+        m_pacer.printReport();
+        QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+    }
+}
+
+void MainApp::applyKeyPress(int key)
+{
     const glm::vec3 position = m_camera[m_cameraSelect].getTranslation()[3].xyz();
     const LightInfo light({
         position * -1.0f,
@@ -468,79 +1140,107 @@ void MainApp::keyPressEvent(QKeyEvent *event)
         glm::vec3(0.0f, 0.0f, 0.0f),
         glm::vec3(0.0f, 0.0f, 0.0f)});
 
-    if ( event->key() == Qt::Key_W )
+    if ( key == Qt::Key_W )
         m_keyFlags |= MOVE_FORWARD;
-    else if ( event->key() == Qt::Key_S )
+    else if ( key == Qt::Key_S )
         m_keyFlags |= MOVE_BACKWARD;
-    else if ( event->key() == Qt::Key_A )
+    else if ( key == Qt::Key_A )
         m_keyFlags |= MOVE_LEFT;
-    else if ( event->key() == Qt::Key_D )
+    else if ( key == Qt::Key_D )
         m_keyFlags |= MOVE_RIGHT;
-    else if ( event->key() == Qt::Key_Space )
+    else if ( key == Qt::Key_Space )
         m_keyFlags |= MOVE_UP;
-    else if ( event->key() == Qt::Key_Control )
+    else if ( key == Qt::Key_Control )
         m_keyFlags |= MOVE_DOWN;
-    else if ( event->key() == Qt::Key_Q )
+    else if ( key == Qt::Key_Q )
         m_keyFlags |= ROTATE_CCW;
-    else if ( event->key() == Qt::Key_E )
+    else if ( key == Qt::Key_E )
         m_keyFlags |= ROTATE_CW;
-    else if ( event->key() == Qt::Key_Escape )
-        qApp->quit();
-    else if ( event->key() == Qt::Key_1 )
+    else if ( key == Qt::Key_Escape )
+        QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+    else if ( key == Qt::Key_L && m_lightClusters != nullptr )
+        m_clustered = !m_clustered;
+    else if ( key == Qt::Key_P && m_depthPrepassAvailable )
+    {
+        m_depthPrepass = !m_depthPrepass;
+        std::cout << "Depth pre-pass " << (m_depthPrepass ? "on" : "off") << std::endl;
+        this->printShadedFragments();
+    }
+    else if ( key == Qt::Key_K )
+        this->setLightGrid(m_lightGrid.empty());
+    else if ( key == Qt::Key_O )
+    {
+        m_lodEnabled = !m_lodEnabled;
+        std::cout << "Mesh detail levels " << (m_lodEnabled ? "on" : "off") << std::endl;
+    }
+    else if ( key == Qt::Key_R && m_resolutionScaler != nullptr )
+    {
+        m_dynamicResolution = !m_dynamicResolution;
+        std::cout << "Dynamic resolution " << (m_dynamicResolution ? "on" : "off") << ", scale "
+                  << m_resolutionScaler->getScale(0) << " / " << m_resolutionScaler->getScale(1) << ", GPU "
+                  << m_resolutionScaler->getGpuTime(0) << " / " << m_resolutionScaler->getGpuTime(1) << " ms" << std::endl;
+    }
+    else if ( key == Qt::Key_F )
+    {
+        m_pacer.printReport();
+        m_pacer.resetReport();
+    }
+    else if ( key == Qt::Key_I )
+    {
+        m_pacer.setMeasureLatency(!m_pacer.isMeasuringLatency());
+        std::cout << "Input latency measuring " << (m_pacer.isMeasuringLatency() ? "on" : "off") << std::endl;
+    }
+    else if ( key == Qt::Key_1 )
         m_lights.setLightInfo(light, 0);
-    else if ( event->key() == Qt::Key_2 )
+    else if ( key == Qt::Key_2 )
         m_lights.setLightInfo(light, 1);
-    else if ( event->key() == Qt::Key_3 )
+    else if ( key == Qt::Key_3 )
         m_lights.setLightInfo(light, 2);
-    else if ( event->key() == Qt::Key_4 )
+    else if ( key == Qt::Key_4 )
         m_lights.setLightInfo(light, 3);
-    else if ( event->key() == Qt::Key_5 )
+    else if ( key == Qt::Key_5 )
         m_lights.setLightInfo(light, 4);
-    else if ( event->key() == Qt::Key_6 )
+    else if ( key == Qt::Key_6 )
         m_lights.setLightInfo(light, 5);
-    else if ( event->key() == Qt::Key_7 )
+    else if ( key == Qt::Key_7 )
         m_lights.setLightInfo(light, 6);
-    else if ( event->key() == Qt::Key_8 )
+    else if ( key == Qt::Key_8 )
         m_lights.setLightInfo(light, 7);
-    else if ( event->key() == Qt::Key_Exclam )
+    else if ( key == Qt::Key_Exclam )
         m_lights.setLightInfo(dark, 0);
-    else if ( event->key() == Qt::Key_At )
+    else if ( key == Qt::Key_At )
         m_lights.setLightInfo(dark, 1);
-    else if ( event->key() == Qt::Key_NumberSign )
+    else if ( key == Qt::Key_NumberSign )
         m_lights.setLightInfo(dark, 2);
-    else if ( event->key() == Qt::Key_Dollar )
+    else if ( key == Qt::Key_Dollar )
         m_lights.setLightInfo(dark, 3);
-    else if ( event->key() == Qt::Key_Percent )
+    else if ( key == Qt::Key_Percent )
         m_lights.setLightInfo(dark, 4);
-    else if ( event->key() == Qt::Key_AsciiCircum )
+    else if ( key == Qt::Key_AsciiCircum )
         m_lights.setLightInfo(dark, 5);
-    else if ( event->key() == Qt::Key_Ampersand )
+    else if ( key == Qt::Key_Ampersand )
         m_lights.setLightInfo(dark, 6);
-    else if ( event->key() == Qt::Key_Asterisk )
+    else if ( key == Qt::Key_Asterisk )
         m_lights.setLightInfo(dark, 7);
-    
-    this->repaint();
 }
 
-void MainApp::keyReleaseEvent(QKeyEvent *event)
+void MainApp::applyKeyRelease(int key)
 {
-    if ( event->isAutoRepeat() ) return;
-    
-    if ( event->key() == Qt::Key_W )
+    if ( key == Qt::Key_W )
         m_keyFlags &= (MOVE_FORWARD ^ 0xff);        
-    else if ( event->key() == Qt::Key_S )
+    else if ( key == Qt::Key_S )
         m_keyFlags &= (MOVE_BACKWARD ^ 0xff);       
-    else if ( event->key() == Qt::Key_A )
+    else if ( key == Qt::Key_A )
         m_keyFlags &= (MOVE_LEFT ^ 0xff);        
-    else if ( event->key() == Qt::Key_D )
+    else if ( key == Qt::Key_D )
         m_keyFlags &= (MOVE_RIGHT ^ 0xff);
-    else if ( event->key() == Qt::Key_Space )
+    else if ( key == Qt::Key_Space )
         m_keyFlags &= (MOVE_UP ^ 0xff);
-    else if ( event->key() == Qt::Key_Control )
+    else if ( key == Qt::Key_Control )
         m_keyFlags &= (MOVE_DOWN ^ 0xff);
-    else if ( event->key() == Qt::Key_Q )
+    else if ( key == Qt::Key_Q )
         m_keyFlags &= (ROTATE_CCW ^ 0xff);
-    else if ( event->key() == Qt::Key_E )
+    else if ( key == Qt::Key_E )
         m_keyFlags &= (ROTATE_CW ^ 0xff);
 }
 
@@ -552,28 +1252,31 @@ void MainApp::mouseMoveEvent(QMouseEvent * event)
     GLfloat thetaVert = 2 * (m_cursorPosition.y() - event->globalY()) * (FOV_DEG / this->height());
     GLfloat thetaHoriz = 2 * (m_cursorPosition.x() - event->globalX()) * (FOV_DEG / this->width());
 
-    m_camera[m_cameraSelect].rotateVert(thetaVert);
-    m_camera[m_cameraSelect].rotateHoriz(thetaHoriz);
+    m_input.pushMouseMove(thetaHoriz, thetaVert);
 
     QCursor::setPos(m_cursorPosition);
-
-    this->repaint();
 }
 
 void MainApp::resizeGL(int width, int height)
 {
     m_projectionMatrix = glm::perspective(FOV_DEG, float(width/2.0)/float(height), FIELD_NEAR, FIELD_FAR); 
+
+    // offscreen targets the size of a viewport, kept while minimized
+    if ( m_resolutionScaler != nullptr && width >= 2 && height > 0 && !m_resolutionScaler->resize(width/2, height) )
+    {
+        std::cout << "Warning: Unable to allocate the dynamic resolution framebuffers" << std::endl;
+        m_resolutionScaler = nullptr;
+        m_dynamicResolution = false;
+    }
 }
 
 void MainApp::mousePressEvent(QMouseEvent * event)
 {
     if ( (event->buttons() & Qt::LeftButton) != 0 )
     {
-        // select camera where mouse was clicked
-        if (event->pos().x() > this->width()/2.0)
-            m_cameraSelect = 1;
-        else
-            m_cameraSelect = 0;
+        // select camera where mouse was clicked, the moves after it rotate
+        // that one
+        m_input.pushSelectCamera(event->pos().x() > this->width()/2.0 ? 1 : 0);
 
         m_mouseEnable = true;
         m_cursorPosition = event->globalPos();
@@ -590,32 +1293,51 @@ void MainApp::mouseReleaseEvent(QMouseEvent * event)
     }
 }
 
-void MainApp::timerTick()
+void MainApp::renderFrame()
 {
+    // wait until the GPU is at most MAX_FRAMES_IN_FLIGHT behind, dt is the
+    // time since the last frame in seconds
+    double dt = m_pacer.beginFrame();
+
+    // everything that came in since the last tick
+    this->applyInput();
+
+    // a replay steps the recorded times whatever the frames take now
+    if ( m_replaying && m_replayTick < m_recording->getTickCount() )
+        dt = m_recording->getTick(m_replayTick).dt;
+
     // physics tick
-    double dt = 1000.0 * m_time.elapsed();
-    m_time.restart();
-    m_physics.tick(dt); 
+    m_physics.tick(dt);
+    if ( m_recording != nullptr )
+        this->recordTick(dt);
     
-    // update camera
+    // update camera, the speeds are per second
+    const float move = CAMERA_SPEED * dt;
+    const float roll = CAMERA_ROLL_SPEED * dt;
     if ( (m_keyFlags & MOVE_FORWARD) )
-        m_camera[m_cameraSelect].moveStraight(0.02f);
+        m_camera[m_cameraSelect].moveStraight(move);
     if ( (m_keyFlags & MOVE_BACKWARD) )
-        m_camera[m_cameraSelect].moveStraight(-0.02f);
+        m_camera[m_cameraSelect].moveStraight(-move);
     if ( (m_keyFlags & MOVE_LEFT) )
-        m_camera[m_cameraSelect].moveHoriz(-0.02f);
+        m_camera[m_cameraSelect].moveHoriz(-move);
     if ( (m_keyFlags & MOVE_RIGHT) )
-        m_camera[m_cameraSelect].moveHoriz(0.02f);
+        m_camera[m_cameraSelect].moveHoriz(move);
     if ( (m_keyFlags & MOVE_UP) )
-        m_camera[m_cameraSelect].moveVert(0.02f);
+        m_camera[m_cameraSelect].moveVert(move);
     if ( (m_keyFlags & MOVE_DOWN) )
-        m_camera[m_cameraSelect].moveVert(-0.02f);
+        m_camera[m_cameraSelect].moveVert(-move);
     if ( (m_keyFlags & ROTATE_CCW) )
-        m_camera[m_cameraSelect].rotateStraight(1.f);
+        m_camera[m_cameraSelect].rotateStraight(roll);
     if ( (m_keyFlags & ROTATE_CW) )
-        m_camera[m_cameraSelect].rotateStraight(-1.f);
+        m_camera[m_cameraSelect].rotateStraight(-roll);
+
+    this->paintGL();
 
-    this->repaint();
+    if ( m_benchmark && m_pacer.getFrameCount() >= BENCHMARK_REPORT_FRAMES )
+    {
+        m_pacer.printReport();
+        m_pacer.resetReport();
+    }
 }
 
 bool MainApp::good() const
@@ -2,23 +2,36 @@
 #define MAINAPP_HPP
 
 // need to be included first
-#include "../glwrappers/GLCompleteProgram.hpp"
 #include "../glwrappers/GLBuffer.hpp"
+#include "../glwrappers/GLQuery.hpp"
 #include "../glwrappers/GLUniform.hpp"
+#include "../glwrappers/GLTypedUniform.hpp"
 #include "../objects/Camera.hpp"
 #include "../objects/Lights.hpp"
 #include "../interfaces/iGLRenderable.hpp"
 #include "../interfaces/iPhysicsObject.hpp"
 #include "../bulletwrappers/PhysicsWorld.hpp"
+#include "../render/GeometryPool.hpp"
+#include "../render/FramePacer.hpp"
+#include "../render/IndirectRenderer.hpp"
+#include "../render/LightClusters.hpp"
+#include "../render/ResolutionScaler.hpp"
+#include "../render/ShaderPermutations.hpp"
+#include "../render/TransformStage.hpp"
+#include "../replay/Recording.hpp"
 #include "../shapes/Puck.hpp"
+#include "InputQueue.hpp"
+#include "RenderThread.hpp"
 
 #ifdef PHYSICS_DEBUG
     #include "../debug/PhysicsDebug.hpp"
 #endif
 
 #include <QGLWidget>
-#include <QTimer>
-#include <QTime>
+
+#include <atomic>
+#include <map>
+#include <string>
 
 class QKeyEvent;
 
@@ -26,25 +39,117 @@ class MainApp : public QGLWidget
 {
     Q_OBJECT
 public:
-    MainApp(QWidget *parent = nullptr);
+    // benchmark turns vsync off and prints a frame pacing report every
+    // BENCHMARK_REPORT_FRAMES frames. physicsThreads over 1 steps bullet
+    // with the multithreaded world, 0 on every core. physicsBackend is
+    // what a new session steps with, a replay uses the recorded one.
+    explicit MainApp(bool benchmark = false, unsigned int physicsThreads = 1,
+                     PhysicsWorld::Backend physicsBackend = PhysicsWorld::BULLET_BACKEND, QWidget *parent = nullptr);
+
+    // stops the render thread
+    ~MainApp();
+
+    // hand the context to the render thread and start drawing, after show
+    void startRendering();
+
+    // join the render thread and take the context back, nothing is drawn
+    // afterwards
+    void stopRendering();
 
     // check if initializeGL succeeded
     bool good() const;
-public slots:
-    void timerTick();
+
+    // before startRendering. Record every tick into filename, saved by
+    // stopRendering, or replay the ticks of a recording with the recorded
+    // physics configuration and quit after the last one. Live input is
+    // ignored while replaying.
+    bool recordTo(const std::string& filename);
+    bool replayFrom(const std::string& filename);
 protected:
     typedef std::vector<std::shared_ptr<iGLRenderable>> RenderList;
     typedef std::vector<std::shared_ptr<iPhysicsObject>> PhysicsList;
 
-    // exits the program
+    // exits the program, from any thread
     void reportError(const QString& error);
 
+    // the render thread's loop (see RenderThread)
+    bool renderInit();
+    void renderFrame();
+    void renderExit();
+
     void initializeGL();
     void paintGL();
+
+    // the render thread draws and resizes, the GUI thread must not touch the
+    // context
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void closeEvent(QCloseEvent *event);
+
     void keyPressEvent(QKeyEvent *event);
     void keyReleaseEvent(QKeyEvent *event);
+
+    // the queued input, once per tick before the simulation steps
+    void applyInput();
+    void applyEvent(const InputEvent& event);
+    void applyKeyPress(int key);
+    void applyKeyRelease(int key);
+
+    // sync the targets with physics and compute their matrices for both
+    // views, once per frame. Also collects the physics debug lines.
     void updatePhysicsObjects();
 
+    // the physics debug lines of a view (PHYSICS_DEBUG only)
+    void drawPhysicsDebug(size_t view);
+
+    // draw targets one at a time with the program in use, idx is the target's
+    // index in m_renderTargets and m_transforms
+    void drawTargets(size_t view, DrawType type);
+    void drawTarget(size_t idx, size_t view, DrawType type);
+
+    // send the view to the indirect renderer, whatever it can't take goes to
+    // m_fallbackTargets
+    void submitIndirect(size_t view);
+
+    // draw the view through the indirect renderer (after submitIndirect)
+    void drawIndirect(size_t view);
+
+    // fill the depth buffer only and leave the depth test at GL_EQUAL for the
+    // lit passes
+    void drawDepth(size_t view);
+
+    // load the depth pre-pass programs, false if unsupported
+    bool initDepthPrepass();
+
+    // print the fragments shaded per viewport with and without the pre-pass
+    void printShadedFragments() const;
+
+    // set up dynamic resolution, false if unsupported
+    bool initResolutionScaler();
+
+    // compile the multi draw indirect variants, false if unsupported
+    bool initIndirect();
+
+    // compile the clustered lighting variants (after initIndirect), false if
+    // unsupported
+    bool initClustered();
+
+    // the variant drawing type with the current lighting, indirect for the
+    // pooled meshes
+    unsigned int getProgramKey(DrawType type, bool indirect) const;
+
+    // use the variant of key, false if it doesn't compile
+    bool useProgram(unsigned int key);
+
+    // uniform blocks and samplers of a new variant
+    bool initProgram(GLProgram& program, unsigned int key);
+
+    // add or remove the grid of lights over the arena
+    void setLightGrid(bool enable);
+
+    // add the tick to the recording, or check it against the replayed one
+    void recordTick(double dt);
+
     void mouseMoveEvent(QMouseEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
@@ -52,14 +157,54 @@ protected:
     void resizeGL(int width, int height);
 
     // set in initializeGL if failure occurs
-    bool                   m_good;
+    std::atomic<bool>      m_good;
+
+    // every program but the physics debug one
+    ShaderPermutations     m_shaders;
 
-    GLCompleteProgram      m_glProgramMaterial;
-    GLCompleteProgram      m_glProgramTexD;
     GLBuffer               m_glUniformMatrixBuffer;
     GLBuffer               m_glUniformLightsBuffer;
     GLBuffer               m_glUniformMaterialBuffer;
 
+    // Matrices blocks of every target in both views, bound per draw
+    TransformStage         m_transforms;
+    GLBuffer               m_glUniformTransformBuffer;
+
+    // multi draw indirect path (null when unsupported or debugging shaders)
+    std::shared_ptr<GeometryPool>     m_geometryPool;
+    std::shared_ptr<IndirectRenderer> m_indirectRenderer;
+    std::vector<size_t>    m_fallbackTargets;   // indices in m_renderTargets
+
+    // clustered lighting (null when unsupported or debugging shaders)
+    std::shared_ptr<LightClusters> m_lightClusters;
+    bool                   m_clustered;
+    std::vector<int>       m_lightGrid;    // light indices
+
+    // depth pre-pass, the lit passes then only shade the visible fragments
+    bool                   m_depthPrepassAvailable;
+    bool                   m_depthPrepass;
+
+    // GL_SAMPLES_PASSED of the lit passes, a query per viewport for each of
+    // the last two frames so the results are read without waiting
+    GLQuery                m_fragmentQueries;
+    bool                   m_fragmentQueryPrepass[4];  // mode of each query
+    GLuint64               m_shadedFragments[2][2];    // [pre-pass][viewport]
+    int                    m_frameParity;
+
+    // viewports drawn offscreen at a scale that fits the GPU budget (null
+    // when unsupported or debugging normals)
+    std::shared_ptr<ResolutionScaler> m_resolutionScaler;
+    bool                   m_dynamicResolution;
+
+    // pixels a unit covers at distance 1 in the viewport being drawn, the
+    // targets pick their detail level from it (huge with levels turned off)
+    float                  m_lodPixelScale;
+    bool                   m_lodEnabled;
+
+    // the viewport being drawn, the offscreen one when the resolution is
+    // scaled (GRAPHICS_DEBUG wireframes are sized from it)
+    glm::vec4              m_drawViewport;
+
     glm::mat4              m_projectionMatrix;
     Camera                 m_camera[2];    // stores/manipulates view matrix
 
@@ -68,32 +213,52 @@ protected:
     RenderList             m_renderTargets;
     PhysicsList            m_physicsTargets;
 
-    QTimer                 m_timer;
-    QTime                  m_time;
+    // draws the frames, paced by the swap (see FramePacer)
+    RenderThread           m_renderThread;
+    FramePacer             m_pacer;
+    bool                   m_benchmark;
+    unsigned int           m_physicsThreads;
+    PhysicsWorld::Backend  m_physicsBackend;
+
+    // size of the window as the render thread last heard of it (RESIZE)
+    int                    m_viewportWidth;
+    int                    m_viewportHeight;
+
+    // filled by the event handlers on the GUI thread, emptied by applyInput
+    // on the render thread
+    InputQueue             m_input;
+    std::vector<InputEvent> m_inputEvents;
     unsigned char          m_keyFlags;
+
+    // null unless recording or replaying, the render thread's while it
+    // runs. m_tickEvents is the input applied this tick.
+    std::shared_ptr<Recording> m_recording;
+    std::string            m_recordFilename;
+    std::vector<Recording::Event> m_tickEvents;
+    bool                   m_replaying;
+    size_t                 m_replayTick;
+    size_t                 m_replayMismatches;
+    size_t                 m_replayFirstMismatch;
+
+    // GUI thread only
     QPoint                 m_cursorPosition;
     bool                   m_ignoreNextMovement;
     bool                   m_mouseEnable;
     
     PhysicsWorld           m_physics;
    
-    int                    m_cameraSelect;
+    int                    m_cameraSelect;  // render thread, see SELECT_CAMERA
 
-#ifdef GRAPHICS_DEBUG
-    GLCompleteProgram      m_glProgramTexDWireframe;
-    GLCompleteProgram      m_glProgramWireframe;
-    
-    GLUniform              m_winSizeWireframe;
-    GLUniform              m_winSizeTexDWireframe;
+#ifdef NORMALS_DEBUG
+    GLTypedUniform<glm::mat4> m_uniformProjection;
 #endif
 
-#ifdef NORMALS_DEBUG
-    GLCompleteProgram      m_glProgramNormals;
-    GLUniform              m_uniformProjection;
+#ifdef GRAPHICS_DEBUG
+    std::map<unsigned int, GLTypedUniform<glm::vec2>> m_uniformWindowSize;  // by variant key
 #endif
 
 #ifdef PHYSICS_DEBUG
-    GLCompleteProgram      m_glProgramDebug;
+    ShaderPermutations     m_debugShaders;  // passthrough, a single variant
     std::shared_ptr<PhysicsDebug> m_physicsDebug; 
 #endif
 };
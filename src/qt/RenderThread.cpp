@@ -0,0 +1,34 @@
+#include "RenderThread.hpp"
+
+RenderThread::RenderThread() :
+    m_stop(false)
+{}
+
+void RenderThread::startLoop(const InitFunction& init, const Function& frame, const Function& exit)
+{
+    m_init = init;
+    m_frame = frame;
+    m_exit = exit;
+    m_stop = false;
+    this->start();
+}
+
+void RenderThread::stopLoop()
+{
+    m_stop = true;
+    this->wait();
+}
+
+bool RenderThread::isStopping() const
+{
+    return m_stop;
+}
+
+void RenderThread::run()
+{
+    if ( m_init() )
+        while ( !m_stop )
+            m_frame();
+
+    m_exit();
+}
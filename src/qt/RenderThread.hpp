@@ -0,0 +1,40 @@
+#ifndef RENDERTHREAD_HPP
+#define RENDERTHREAD_HPP
+
+#include <QThread>
+
+#include <atomic>
+#include <functional>
+
+// Runs the frames on their own thread so nothing the GUI thread does (event
+// handling, window moves, dialogs) delays a frame.
+//
+// The owner moves its GL context to the thread before startLoop, init makes
+// it current there, frame is called back to back until stopLoop and exit
+// hands the context back. All three run on the render thread.
+class RenderThread : public QThread
+{
+public:
+    typedef std::function<bool()> InitFunction;
+    typedef std::function<void()> Function;
+
+    RenderThread();
+
+    // the thread must not be running, frame isn't called if init fails
+    void startLoop(const InitFunction& init, const Function& frame, const Function& exit);
+
+    // finish the current frame, run exit and join, from any other thread
+    void stopLoop();
+
+    // true once stopLoop was called
+    bool isStopping() const;
+protected:
+    void run();
+
+    InitFunction      m_init;
+    Function          m_frame;
+    Function          m_exit;
+    std::atomic<bool> m_stop;
+};
+
+#endif // RENDERTHREAD_HPP
@@ -0,0 +1,216 @@
+#include "FramePacer.hpp"
+#include "../glwrappers/GLState.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+// histogram buckets in ms, everything past the last one lands in it
+const double BUCKET_WIDTH = 0.5;
+const size_t BUCKET_COUNT = 100;
+
+// widest bar of printHistogram
+const int BAR_WIDTH = 40;
+
+// an interval this much longer than the median is a missed refresh
+const double HITCH_FACTOR = 1.5;
+
+// record a sample in ms
+static void addSample(std::vector<unsigned int>& buckets, double ms)
+{
+    const size_t bucket = static_cast<size_t>(ms / BUCKET_WIDTH);
+    ++buckets[std::min(bucket, buckets.size() - 1)];
+}
+
+FramePacer::FramePacer(int maxFramesInFlight) :
+    m_maxFramesInFlight(maxFramesInFlight),
+    m_started(false),
+    m_intervals(BUCKET_COUNT, 0),
+    m_waits(BUCKET_COUNT, 0),
+    m_latencies(BUCKET_COUNT, 0),
+    m_intervalSum(0.0),
+    m_intervalMax(0.0),
+    m_waitSum(0.0),
+    m_frameCount(0),
+    m_measureLatency(false),
+    m_latencySum(0.0),
+    m_latencyMax(0.0),
+    m_latencyCount(0)
+{}
+
+FramePacer::~FramePacer()
+{
+    this->clean();
+}
+
+double FramePacer::beginFrame()
+{
+    // the fence wait is the latency the cap saves, keep it apart from the
+    // interval
+    const Clock::time_point waitStart = Clock::now();
+    while ( m_maxFramesInFlight > 0 && m_fences.size() >= static_cast<size_t>(m_maxFramesInFlight) )
+        this->waitOldest();
+    const Clock::time_point now = Clock::now();
+
+    if ( !m_started )
+    {
+        m_started = true;
+        m_lastBegin = now;
+        return 0.0;
+    }
+
+    const double interval = std::chrono::duration<double, std::milli>(now - m_lastBegin).count();
+    const double wait = std::chrono::duration<double, std::milli>(now - waitStart).count();
+    m_lastBegin = now;
+
+    addSample(m_intervals, interval);
+    addSample(m_waits, wait);
+    m_intervalSum += interval;
+    m_intervalMax = std::max(m_intervalMax, interval);
+    m_waitSum += wait;
+    ++m_frameCount;
+
+    return interval / 1000.0;
+}
+
+void FramePacer::endFrame()
+{
+    // the frame showing the inputs was just handed to the display
+    if ( !m_frameInputs.empty() )
+    {
+        const Clock::time_point now = Clock::now();
+        for ( size_t i = 0; i < m_frameInputs.size(); ++i )
+        {
+            const double latency = std::chrono::duration<double, std::milli>(now - m_frameInputs[i]).count();
+            addSample(m_latencies, latency);
+            m_latencySum += latency;
+            m_latencyMax = std::max(m_latencyMax, latency);
+            ++m_latencyCount;
+        }
+        m_frameInputs.clear();
+    }
+
+    if ( m_maxFramesInFlight <= 0 )
+        return;
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if ( fence != 0 )
+        m_fences.push_back(fence);
+}
+
+void FramePacer::addInput(Clock::time_point stamp)
+{
+    if ( m_measureLatency )
+        m_frameInputs.push_back(stamp);
+}
+
+void FramePacer::setMeasureLatency(bool measure)
+{
+    m_measureLatency = measure;
+    if ( !measure )
+        m_frameInputs.clear();
+}
+
+bool FramePacer::isMeasuringLatency() const
+{
+    return m_measureLatency;
+}
+
+void FramePacer::printReport(std::ostream& out) const
+{
+    if ( m_frameCount == 0 )
+    {
+        out << "No frames paced yet" << std::endl;
+        return;
+    }
+
+    const double median = getPercentile(m_intervals, 0.5);
+    size_t hitches = 0;
+    for ( size_t i = 0; i < m_intervals.size(); ++i )
+        if ( (i + 0.5) * BUCKET_WIDTH > median * HITCH_FACTOR )
+            hitches += m_intervals[i];
+
+    const double mean = m_intervalSum / m_frameCount;
+    out << std::fixed << std::setprecision(2)
+        << m_frameCount << " frames, " << 1000.0 / mean << " fps, interval mean " << mean << " ms, median "
+        << median << " ms, 99% " << getPercentile(m_intervals, 0.99) << " ms, max " << m_intervalMax << " ms" << std::endl
+        << hitches << " frames over " << HITCH_FACTOR << "x the median, mean fence wait "
+        << m_waitSum / m_frameCount << " ms (" << m_maxFramesInFlight << " frames in flight)" << std::endl;
+    if ( m_latencyCount > 0 )
+        out << m_latencyCount << " inputs, input to swap mean " << m_latencySum / m_latencyCount << " ms, 99% "
+            << getPercentile(m_latencies, 0.99) << " ms, max " << m_latencyMax << " ms" << std::endl;
+    printHistogram(out, "Frame interval", m_intervals);
+    printHistogram(out, "Fence wait", m_waits);
+    printHistogram(out, "Input to swap", m_latencies);
+    out.unsetf(std::ios::floatfield);
+}
+
+void FramePacer::resetReport()
+{
+    std::fill(m_intervals.begin(), m_intervals.end(), 0);
+    std::fill(m_waits.begin(), m_waits.end(), 0);
+    std::fill(m_latencies.begin(), m_latencies.end(), 0);
+    m_intervalSum = m_intervalMax = m_waitSum = 0.0;
+    m_latencySum = m_latencyMax = 0.0;
+    m_frameCount = m_latencyCount = 0;
+}
+
+size_t FramePacer::getFrameCount() const
+{
+    return m_frameCount;
+}
+
+void FramePacer::clean()
+{
+    for ( size_t i = 0; i < m_fences.size(); ++i )
+        glDeleteSync(m_fences[i]);
+    m_fences.clear();
+}
+
+void FramePacer::waitOldest()
+{
+    GLsync fence = m_fences.front();
+    m_fences.pop_front();
+
+    if ( !GLState::waitFence(fence) )
+        std::cout << "Warning: Frame fence wait failed" << std::endl;
+}
+
+void FramePacer::printHistogram(std::ostream& out, const char* name, const std::vector<unsigned int>& buckets)
+{
+    const unsigned int most = *std::max_element(buckets.begin(), buckets.end());
+    if ( most == 0 )
+        return;
+
+    out << name << " (ms)" << std::endl;
+    for ( size_t i = 0; i < buckets.size(); ++i )
+    {
+        if ( buckets[i] == 0 )
+            continue;
+
+        out << std::setw(6) << i * BUCKET_WIDTH;
+        if ( i + 1 < buckets.size() )
+            out << " - " << std::setw(6) << (i + 1) * BUCKET_WIDTH;
+        else
+            out << " +       ";
+        out << " " << std::setw(7) << buckets[i] << " "
+            << std::string(std::max(1, static_cast<int>(BAR_WIDTH * buckets[i] / most)), '#') << std::endl;
+    }
+}
+
+double FramePacer::getPercentile(const std::vector<unsigned int>& buckets, double fraction)
+{
+    size_t total = 0;
+    for ( size_t i = 0; i < buckets.size(); ++i )
+        total += buckets[i];
+
+    // upper edge of the bucket holding the sample
+    size_t seen = 0;
+    for ( size_t i = 0; i < buckets.size(); ++i )
+    {
+        seen += buckets[i];
+        if ( seen > 0 && seen >= fraction * total )
+            return (i + 1) * BUCKET_WIDTH;
+    }
+    return buckets.size() * BUCKET_WIDTH;
+}
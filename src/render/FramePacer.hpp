@@ -0,0 +1,87 @@
+#ifndef FRAMEPACER_HPP
+#define FRAMEPACER_HPP
+
+#include <GL/glew.h>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+// Keeps the CPU from running ahead of the display. Frames are started as
+// soon as the last one was swapped, the swap interval (vsync) sets the pace,
+// and a fence after every swap caps how many frames the GPU may have queued
+// so input isn't sampled several frames before it's shown.
+//
+//   double dt = pacer.beginFrame();  // context current, before input/physics
+//   ...                              // update and draw
+//   swapBuffers();
+//   pacer.endFrame();
+//
+// The time between frames and the time spent waiting on fences go into
+// histograms, printReport shows how evenly frames were delivered. With
+// latency measuring on, the inputs applied to a frame (addInput) also get the
+// time from their arrival until the frame is swapped.
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // maxFramesInFlight 0 never waits
+    explicit FramePacer(int maxFramesInFlight = 2);
+
+    // the fences must be deleted with the context current
+    ~FramePacer();
+
+    // waits until fewer than the max frames are queued, returns the seconds
+    // since the last beginFrame (0 for the first)
+    double beginFrame();
+
+    // fence the frame that was just swapped
+    void endFrame();
+
+    // an input that arrived at stamp changes the frame being built
+    void addInput(Clock::time_point stamp);
+    void setMeasureLatency(bool measure);
+    bool isMeasuringLatency() const;
+
+    // frame interval, fence wait and input latency histograms since the last
+    // reset
+    void printReport(std::ostream& out = std::cout) const;
+    void resetReport();
+    size_t getFrameCount() const;
+
+    // delete the fences (context current)
+    void clean();
+protected:
+    // block until the oldest fence signaled
+    void waitOldest();
+
+    static void printHistogram(std::ostream& out, const char* name, const std::vector<unsigned int>& buckets);
+
+    // ms below which fraction of the samples fall
+    static double getPercentile(const std::vector<unsigned int>& buckets, double fraction);
+
+    std::deque<GLsync>  m_fences;
+    int                 m_maxFramesInFlight;
+
+    Clock::time_point   m_lastBegin;
+    bool                m_started;
+
+    // BUCKET_WIDTH ms buckets, the last one holds everything longer
+    std::vector<unsigned int> m_intervals;
+    std::vector<unsigned int> m_waits;
+    std::vector<unsigned int> m_latencies;
+    double              m_intervalSum;
+    double              m_intervalMax;
+    double              m_waitSum;
+    size_t              m_frameCount;
+
+    // inputs of the frame being built
+    bool                m_measureLatency;
+    std::vector<Clock::time_point> m_frameInputs;
+    double              m_latencySum;
+    double              m_latencyMax;
+    size_t              m_latencyCount;
+};
+
+#endif // FRAMEPACER_HPP
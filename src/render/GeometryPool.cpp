@@ -0,0 +1,104 @@
+#include "GeometryPool.hpp"
+
+#include "../interfaces/iGLRenderable.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+bool GeometryPool::isSupported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+GeometryPool::GeometryPool() :
+    m_vertexCount(0),
+    m_indexCount(0),
+    m_uploaded(false)
+{}
+
+GeometryPool::Range GeometryPool::add(const GLfloat* vertices, GLuint numVertices, const GLuint* indices, GLuint numIndices)
+{
+    Range range = {0, 0, 0};
+    if ( m_uploaded )
+    {
+        std::cout << "Warning: mesh added to the geometry pool after upload" << std::endl;
+        return range;
+    }
+
+    range.firstIndex = m_indexCount;
+    range.count = numIndices;
+    range.baseVertex = static_cast<GLint>(m_vertexCount);
+
+    m_vertices.insert(m_vertices.end(), vertices, vertices + numVertices*VERTEX_FLOATS);
+    m_indices.insert(m_indices.end(), indices, indices + numIndices);
+    m_vertexCount += numVertices;
+    m_indexCount += numIndices;
+
+    return range;
+}
+
+bool GeometryPool::upload()
+{
+    if ( m_uploaded || !m_buffers.generate(BUFFER_COUNT) )
+        return false;
+
+    // 0, 1, 2, ... read once per instance
+    std::vector<GLfloat> drawIds(MAX_INDIRECT_DRAWS);
+    for ( GLuint i = 0; i < MAX_INDIRECT_DRAWS; ++i )
+        drawIds[i] = static_cast<GLfloat>(i);
+
+    std::vector<GLfloat> positions(m_vertexCount * 3);
+    for ( GLuint i = 0; i < m_vertexCount; ++i )
+        std::copy(&m_vertices[i*VERTEX_FLOATS], &m_vertices[i*VERTEX_FLOATS] + 3, &positions[i*3]);
+
+    m_buffers.setData(m_vertices.data(), m_vertices.size(), GL_STATIC_DRAW, VERTEX_BUFFER);
+    m_buffers.setData(positions.data(), positions.size(), GL_STATIC_DRAW, POSITION_BUFFER);
+    m_buffers.setData(drawIds.data(), drawIds.size(), GL_STATIC_DRAW, DRAW_ID_BUFFER);
+    m_buffers.setData(m_indices.data(), m_indices.size(), GL_STATIC_DRAW, ELEMENT_BUFFER);
+
+    const GLuint vertexBuffer = m_buffers.getBufferIdx(VERTEX_BUFFER);
+    const GLsizei stride = sizeof(GLfloat)*VERTEX_FLOATS;
+    m_vao.create(1);
+    m_vao.setAttribute(V_POSITION, vertexBuffer, 3, GL_FLOAT, stride);
+    m_vao.setAttribute(V_NORMAL, vertexBuffer, 3, GL_FLOAT, stride, sizeof(GLfloat)*3);
+    m_vao.setAttribute(V_UVCOORD, vertexBuffer, 2, GL_FLOAT, stride, sizeof(GLfloat)*6);
+    m_vao.setAttribute(V_DRAW_ID, m_buffers.getBufferIdx(DRAW_ID_BUFFER), 1, GL_FLOAT, sizeof(GLfloat), 0, 1);
+    m_vao.setElementBuffer(m_buffers.getBufferIdx(ELEMENT_BUFFER));
+
+    m_depthVao.create(1);
+    m_depthVao.setAttribute(V_POSITION, m_buffers.getBufferIdx(POSITION_BUFFER), 3, GL_FLOAT, sizeof(GLfloat)*3);
+    m_depthVao.setAttribute(V_DRAW_ID, m_buffers.getBufferIdx(DRAW_ID_BUFFER), 1, GL_FLOAT, sizeof(GLfloat), 0, 1);
+    m_depthVao.setElementBuffer(m_buffers.getBufferIdx(ELEMENT_BUFFER));
+
+    // the GPU copy is all that's needed from now on
+    std::vector<GLfloat>().swap(m_vertices);
+    std::vector<GLuint>().swap(m_indices);
+
+    m_uploaded = true;
+    return true;
+}
+
+void GeometryPool::bind()
+{
+    m_vao.bind();
+}
+
+void GeometryPool::bindDepth()
+{
+    m_depthVao.bind();
+}
+
+bool GeometryPool::isUploaded() const
+{
+    return m_uploaded;
+}
+
+GLuint GeometryPool::getVertexCount() const
+{
+    return m_vertexCount;
+}
+
+GLuint GeometryPool::getIndexCount() const
+{
+    return m_indexCount;
+}
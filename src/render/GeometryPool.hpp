@@ -0,0 +1,79 @@
+#ifndef GEOMETRYPOOL_HPP
+#define GEOMETRYPOOL_HPP
+
+#include "../glwrappers/GLBuffer.hpp"
+#include "../glwrappers/GLVertexArray.hpp"
+
+#include <GL/glew.h>
+#include <vector>
+
+// max number of draws in one IndirectRenderer frame (size of the draw id stream)
+const GLuint MAX_INDIRECT_DRAWS = 4096;
+
+// Vertices and indices of every mesh in one vertex buffer, one element buffer
+// and one VAO so a single glMultiDrawElementsIndirect can draw any of them.
+//
+// Vertices are interleaved position (3), normal (3), uv (2). Meshes are added
+// at load time and the whole pool is sent to OpenGL once by upload().
+//
+// The VAO also holds a per-instance draw id stream (0, 1, 2, ...) at V_DRAW_ID,
+// a draw whose baseInstance is n reads n from it.
+//
+// A second VAO reads the positions from their own tightly packed stream for
+// the depth pre-pass, with the same element buffer and draw ids.
+class GeometryPool
+{
+public:
+    static const int VERTEX_FLOATS = 8;
+
+    // where a mesh lives in the pool
+    struct Range
+    {
+        GLuint firstIndex;
+        GLuint count;
+        GLint  baseVertex;
+    };
+
+    // true if the context can draw from the pool (multi draw indirect with
+    // base instance)
+    static bool isSupported();
+
+    GeometryPool();
+
+    // append a mesh, indices are relative to its own vertices. Must be called
+    // before upload().
+    Range add(const GLfloat* vertices, GLuint numVertices, const GLuint* indices, GLuint numIndices);
+
+    // create the buffers and VAO and release the CPU copy
+    bool upload();
+
+    void bind();
+
+    // bind the position only VAO
+    void bindDepth();
+
+    bool isUploaded() const;
+    GLuint getVertexCount() const;
+    GLuint getIndexCount() const;
+protected:
+    enum BufferIdx {
+        VERTEX_BUFFER  = 0,
+        ELEMENT_BUFFER = 1,
+        DRAW_ID_BUFFER = 2,
+        POSITION_BUFFER = 3,
+        BUFFER_COUNT   = 4
+    };
+
+    std::vector<GLfloat>  m_vertices;
+    std::vector<GLuint>   m_indices;
+
+    GLBuffer              m_buffers;
+    GLVertexArray         m_vao;
+    GLVertexArray         m_depthVao;
+
+    GLuint                m_vertexCount;
+    GLuint                m_indexCount;
+    bool                  m_uploaded;
+};
+
+#endif // GEOMETRYPOOL_HPP
@@ -0,0 +1,171 @@
+#include "IndirectRenderer.hpp"
+
+#include "../memory/FrameArena.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+IndirectRenderer::IndirectRenderer() :
+    m_submitted(FrameArena::get()),
+    m_unsortedData(FrameArena::get()),
+    m_drawData(FrameArena::get()),
+    m_commands(FrameArena::get()),
+    m_batches(FrameArena::get()),
+    m_warnedFull(false)
+{}
+
+bool IndirectRenderer::init(const std::shared_ptr<GeometryPool>& pool)
+{
+    if ( pool == nullptr || !pool->isUploaded() )
+        return false;
+    m_pool = pool;
+
+    if ( !m_commandBuffer.generate(1) || !m_drawDataBuffer.generate(1) || !m_drawDataTexture.generate(1, GL_TEXTURE_BUFFER) )
+        return false;
+
+    m_commandBuffer.setEmpty(sizeof(DrawElementsIndirectCommand) * 64, GL_STREAM_DRAW);
+
+    // the texture keeps pointing at the buffer when its storage is respecified
+    m_drawDataBuffer.setEmpty(sizeof(IndirectDrawData) * 64, GL_STREAM_DRAW);
+    GLTexture::setActiveUnit(GL_TEXTURE0 + DRAW_DATA_UNIT);
+    m_drawDataTexture.setBuffer(GL_RGBA32F, m_drawDataBuffer.getBufferIdx());
+    GLTexture::setActiveUnit(GL_TEXTURE0);
+
+    return true;
+}
+
+void IndirectRenderer::begin()
+{
+    m_submitted.clear();
+    m_unsortedData.clear();
+}
+
+void IndirectRenderer::submit(const GeometryPool::Range& range, const MatricesBlock& matrices, const MaterialBlock& material,
+                              DrawType type, GLTexture* texture, GLenum texTarget)
+{
+    if ( range.count == 0 )
+        return;
+
+    if ( m_submitted.size() >= MAX_INDIRECT_DRAWS )
+    {
+        if ( !m_warnedFull )
+            std::cout << "Warning: more than " << MAX_INDIRECT_DRAWS << " indirect draws, extra meshes skipped" << std::endl;
+        m_warnedFull = true;
+        return;
+    }
+
+    IndirectDrawData data;
+    data.mvpMatrix = matrices.mvpMatrix;
+    data.mvMatrix = matrices.mvMatrix;
+    data.normalMatrix = matrices.normalMatrix;
+    data.diffuse = glm::vec4(material.diffuse, material.shininess);
+    data.specular = glm::vec4(material.specular, material.texBlend);
+    data.ambient = glm::vec4(material.ambient, 0.0f);
+
+    const GLuint textureIdx = texture == nullptr ? 0 : texture->getTextureIdx();
+
+    Submitted submitted;
+    submitted.key = (static_cast<GLuint64>(type) << 32) | textureIdx;
+    submitted.index = m_unsortedData.size();
+    submitted.range = range;
+    submitted.texture = texture;
+    submitted.texTarget = texTarget;
+    submitted.type = type;
+
+    m_unsortedData.push_back(data);
+    m_submitted.push_back(submitted);
+}
+
+void IndirectRenderer::upload()
+{
+    const size_t count = m_submitted.size();
+    m_drawData.clear();
+    m_commands.clear();
+    m_batches.clear();
+    if ( count == 0 )
+        return;
+
+    // group draws sharing a program and texture, keeping submission order
+    Submitted* submitted = &m_submitted[0];
+    std::sort(submitted, submitted + count,
+        [](const Submitted& a, const Submitted& b) { return a.key < b.key || (a.key == b.key && a.index < b.index); });
+
+    m_drawData.reserve(count);
+    m_commands.reserve(count);
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const Submitted& s = submitted[i];
+
+        // the draw reads record i through baseInstance
+        DrawElementsIndirectCommand command;
+        command.count = s.range.count;
+        command.instanceCount = 1;
+        command.firstIndex = s.range.firstIndex;
+        command.baseVertex = s.range.baseVertex;
+        command.baseInstance = i;
+        m_commands.push_back(command);
+        m_drawData.push_back(m_unsortedData[s.index]);
+
+        if ( i == 0 || s.key != submitted[i-1].key )
+        {
+            Batch batch = {s.type, s.texture, s.texTarget, static_cast<GLuint>(i), 0};
+            m_batches.push_back(batch);
+        }
+        m_batches[m_batches.size()-1].count++;
+    }
+
+    // respecify the storage every view so the driver can orphan the old one
+    m_commandBuffer.setData(m_commands.data(), count, GL_STREAM_DRAW);
+    m_drawDataBuffer.setData(m_drawData.data(), count, GL_STREAM_DRAW);
+}
+
+void IndirectRenderer::draw(DrawType type)
+{
+    if ( m_pool == nullptr || m_batches.empty() )
+        return;
+
+    m_pool->bind();
+    m_commandBuffer.bind(GL_DRAW_INDIRECT_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0 + DRAW_DATA_UNIT);
+    m_drawDataTexture.bind(GL_TEXTURE_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0);
+
+    for ( size_t i = 0; i < m_batches.size(); ++i )
+    {
+        const Batch& batch = m_batches[i];
+        if ( batch.type != type )
+            continue;
+
+        if ( batch.texture != nullptr )
+            batch.texture->bind(batch.texTarget);
+
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(batch.first * sizeof(DrawElementsIndirectCommand)),
+                batch.count, 0);
+    }
+}
+
+void IndirectRenderer::drawDepth()
+{
+    if ( m_pool == nullptr || m_commands.empty() )
+        return;
+
+    m_pool->bindDepth();
+    m_commandBuffer.bind(GL_DRAW_INDIRECT_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0 + DRAW_DATA_UNIT);
+    m_drawDataTexture.bind(GL_TEXTURE_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0);
+
+    // textures don't matter for depth, all batches go in one call
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, m_commands.size(), 0);
+}
+
+GLuint IndirectRenderer::getDrawCount() const
+{
+    return m_commands.size();
+}
+
+GLuint IndirectRenderer::getBatchCount() const
+{
+    return m_batches.size();
+}
@@ -0,0 +1,122 @@
+#ifndef INDIRECTRENDERER_HPP
+#define INDIRECTRENDERER_HPP
+
+#include "GeometryPool.hpp"
+#include "../glwrappers/GLBuffer.hpp"
+#include "../glwrappers/GLTexture.hpp"
+#include "../interfaces/iGLRenderable.hpp"
+#include "../memory/ArenaArray.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <memory>
+
+// layout of a GL_DRAW_INDIRECT_BUFFER record
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// Everything the indirect shaders need for one draw, read from the u_drawData
+// texture buffer (one RGBA32F texel per vec4) at v_drawId * DRAW_DATA_TEXELS
+struct IndirectDrawData
+{
+    glm::mat4 mvpMatrix;
+    glm::mat4 mvMatrix;
+    glm::mat4 normalMatrix;
+    glm::vec4 diffuse;      // w = shininess
+    glm::vec4 specular;     // w = texBlend
+    glm::vec4 ambient;
+};
+
+const int DRAW_DATA_TEXELS = sizeof(IndirectDrawData)/sizeof(glm::vec4);
+
+// texture unit the draw data is bound to (u_drawData)
+const GLint DRAW_DATA_UNIT = 1;
+
+// Draws every mesh of a GeometryPool with one glMultiDrawElementsIndirect
+// per program (per texture for textured meshes).
+//
+// For each view:
+//   renderer.begin();
+//   model->submit(renderer, matrices);     // for every model, see TransformStage
+//   renderer.upload();
+//   materialProgram.use();
+//   renderer.draw(DRAW_MATERIAL);
+//   texturedProgram.use();
+//   renderer.draw(DRAW_TEXTURE_D);
+//
+// With a depth pre-pass, depthProgram.use() and renderer.drawDepth() go
+// between upload and the first draw.
+//
+// The per draw matrices and material go through a texture buffer and each
+// command's baseInstance selects its record, so the shaders only need GLSL
+// 4.10. The submitted draws live in the frame arena.
+class IndirectRenderer
+{
+public:
+    IndirectRenderer();
+
+    // create the buffers, the pool must already be uploaded
+    bool init(const std::shared_ptr<GeometryPool>& pool);
+
+    // start collecting draws for a view
+    void begin();
+
+    // queue a mesh with the matrices of its model in the view. texture is
+    // only used (and must stay alive until draw) for textured draw types.
+    void submit(const GeometryPool::Range& range, const MatricesBlock& matrices, const MaterialBlock& material,
+                DrawType type, GLTexture* texture = nullptr, GLenum texTarget = GL_TEXTURE_2D);
+
+    // sort the queued draws into batches and send commands and draw data
+    void upload();
+
+    // draw every batch of type with the program in use
+    void draw(DrawType type);
+
+    // draw everything uploaded with one call through the pool's position
+    // only VAO, for the depth pre-pass
+    void drawDepth();
+
+    GLuint getDrawCount() const;
+    GLuint getBatchCount() const;
+protected:
+    struct Submitted
+    {
+        GLuint64           key;     // draw type and texture, sorted on
+        GLuint             index;   // into m_unsortedData
+        GeometryPool::Range range;
+        GLTexture*         texture;
+        GLenum             texTarget;
+        DrawType           type;
+    };
+
+    struct Batch
+    {
+        DrawType   type;
+        GLTexture* texture;
+        GLenum     texTarget;
+        GLuint     first;   // first command
+        GLuint     count;
+    };
+
+    std::shared_ptr<GeometryPool> m_pool;
+
+    GLBuffer                      m_commandBuffer;
+    GLBuffer                      m_drawDataBuffer;
+    GLTexture                     m_drawDataTexture;
+
+    ArenaArray<Submitted>                   m_submitted;
+    ArenaArray<IndirectDrawData>            m_unsortedData;
+    ArenaArray<IndirectDrawData>            m_drawData;
+    ArenaArray<DrawElementsIndirectCommand> m_commands;
+    ArenaArray<Batch>                       m_batches;
+
+    bool                          m_warnedFull;
+};
+
+#endif // INDIRECTRENDERER_HPP
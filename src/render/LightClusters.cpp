@@ -0,0 +1,333 @@
+#include "LightClusters.hpp"
+
+#include "../glwrappers/GLUniform.hpp"
+#include "../threading/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// attenuation = 1/(x + y*d + z*d*d), same as the fragment shaders
+static const glm::vec3 ATTENUATION_COEF(0.1f, 0.0f, 0.98f);
+
+// froxels closer than this all fall in the first slice
+static const float MIN_CLUSTER_NEAR = 0.1f;
+
+static_assert(CLUSTER_TILES % 4 == 0, "tiles are tested four at a time");
+
+enum ClusterBuffer {
+    GRID_BUFFER    = 0,
+    INDEX_BUFFER   = 1,
+    LIGHTS_BUFFER  = 2,
+    CLUSTER_BUFFER_COUNT = 3
+};
+
+LightClusters::LightClusters() :
+    m_minX(CLUSTER_COUNT),
+    m_maxX(CLUSTER_COUNT),
+    m_minY(CLUSTER_COUNT),
+    m_maxY(CLUSTER_COUNT),
+    m_projectionScale(0.0f),
+    m_near(0.0f),
+    m_far(0.0f),
+    m_sliceParams(0.0f),
+    m_clusterCounts(CLUSTER_COUNT),
+    m_clusterLights(CLUSTER_COUNT * MAX_CLUSTER_LIGHTS),
+    m_overflow(false),
+    m_grid(CLUSTER_COUNT * 2),
+    m_warnedLights(false),
+    m_warnedOverflow(false)
+{
+    m_viewLights.reserve(MAX_CLUSTERED_LIGHTS);
+    m_lightData.reserve(MAX_CLUSTERED_LIGHTS * CLUSTER_LIGHT_TEXELS);
+    m_indices.reserve(CLUSTER_COUNT * 4);
+}
+
+bool LightClusters::init(size_t viewCount)
+{
+    const GLsizei count = CLUSTER_BUFFER_COUNT * viewCount;
+    if ( !m_buffers.generate(count) || !m_textures.generate(count, GL_TEXTURE_BUFFER) )
+        return false;
+
+    for ( GLsizei first = 0; first < count; first += CLUSTER_BUFFER_COUNT )
+    {
+        m_buffers.setEmpty(sizeof(GLuint) * m_grid.size(), GL_STREAM_DRAW, first + GRID_BUFFER);
+        m_buffers.setEmpty(sizeof(GLuint), GL_STREAM_DRAW, first + INDEX_BUFFER);
+        m_buffers.setEmpty(sizeof(glm::vec4) * CLUSTER_LIGHT_TEXELS, GL_STREAM_DRAW, first + LIGHTS_BUFFER);
+
+        // the textures keep pointing at the buffers when their storage is respecified
+        m_textures.setBuffer(GL_RG32UI, m_buffers.getBufferIdx(first + GRID_BUFFER), first + GRID_BUFFER);
+        m_textures.setBuffer(GL_R32UI, m_buffers.getBufferIdx(first + INDEX_BUFFER), first + INDEX_BUFFER);
+        m_textures.setBuffer(GL_RGBA32F, m_buffers.getBufferIdx(first + LIGHTS_BUFFER), first + LIGHTS_BUFFER);
+    }
+
+    ViewState state;
+    state.built = false;
+    m_views.assign(viewCount, state);
+    return true;
+}
+
+bool LightClusters::addProgram(GLProgram& program)
+{
+    GLUniform::setUniform(program, "u_clusterGrid", INT, CLUSTER_GRID_UNIT);
+    GLUniform::setUniform(program, "u_clusterIndices", INT, CLUSTER_INDEX_UNIT);
+    GLUniform::setUniform(program, "u_clusterLights", INT, CLUSTER_LIGHTS_UNIT);
+
+    std::shared_ptr<ProgramUniforms> uniforms(new ProgramUniforms);
+    if ( !uniforms->viewport.init(program, "u_clusterViewport") || !uniforms->slices.init(program, "u_clusterSlices") )
+        return false;
+    m_programs.push_back(uniforms);
+    return true;
+}
+
+float LightClusters::getRange(const LightInfo& light)
+{
+    const glm::vec3 total = light.diffuse + light.specular + light.ambient;
+    const float brightest = std::max(total.x, std::max(total.y, total.z));
+
+    // solve brightest / (x + y*d + z*d*d) = cutoff for d
+    const float a = ATTENUATION_COEF.z;
+    const float b = ATTENUATION_COEF.y;
+    const float c = ATTENUATION_COEF.x - brightest / CLUSTER_LIGHT_CUTOFF;
+    if ( c >= 0.0f )
+        return 0.0f;
+    return (-b + std::sqrt(b*b - 4.0f*a*c)) / (2.0f*a);
+}
+
+void LightClusters::updateGrid(const glm::mat4& projectionMatrix, float zNear, float zFar)
+{
+    const glm::vec2 scale(projectionMatrix[0][0], projectionMatrix[1][1]);
+    const float near = std::max(zNear, MIN_CLUSTER_NEAR);
+    if ( scale == m_projectionScale && near == m_near && zFar == m_far )
+        return;
+    m_projectionScale = scale;
+    m_near = near;
+    m_far = zFar;
+
+    const float logRatio = std::log(m_far / m_near);
+    m_sliceParams = glm::vec2(CLUSTER_Z / logRatio, -CLUSTER_Z * std::log(m_near) / logRatio);
+
+    for ( int z = 0; z < CLUSTER_Z; ++z )
+    {
+        // depths covered by the slice, the first one reaches the camera
+        const float depthNear = z == 0 ? 0.0f : m_near * std::pow(m_far / m_near, float(z) / CLUSTER_Z);
+        const float depthFar = m_near * std::pow(m_far / m_near, float(z + 1) / CLUSTER_Z);
+        m_sliceMinZ[z] = -depthFar;
+        m_sliceMaxZ[z] = -depthNear;
+
+        for ( int y = 0; y < CLUSTER_Y; ++y )
+        {
+            const float ndcY0 = -1.0f + 2.0f * y / CLUSTER_Y;
+            const float ndcY1 = -1.0f + 2.0f * (y + 1) / CLUSTER_Y;
+            for ( int x = 0; x < CLUSTER_X; ++x )
+            {
+                const float ndcX0 = -1.0f + 2.0f * x / CLUSTER_X;
+                const float ndcX1 = -1.0f + 2.0f * (x + 1) / CLUSTER_X;
+
+                // the tile's frustum widens with depth, bound both ends
+                const int cluster = z * CLUSTER_TILES + y * CLUSTER_X + x;
+                m_minX[cluster] = std::min(ndcX0 * depthNear, ndcX0 * depthFar) / scale.x;
+                m_maxX[cluster] = std::max(ndcX1 * depthNear, ndcX1 * depthFar) / scale.x;
+                m_minY[cluster] = std::min(ndcY0 * depthNear, ndcY0 * depthFar) / scale.y;
+                m_maxY[cluster] = std::max(ndcY1 * depthNear, ndcY1 * depthFar) / scale.y;
+            }
+        }
+    }
+}
+
+void LightClusters::build(size_t view, const Lights& allLights, const glm::mat4& viewMatrix,
+                          const glm::mat4& projectionMatrix, float zNear, float zFar, const glm::vec4& viewport)
+{
+    // the grid doesn't depend on the viewport, only the uniforms do
+    ViewState& state = m_views[view];
+    state.viewport = viewport;
+    if ( state.built && state.lightsVersion == allLights.getVersion() && state.viewMatrix == viewMatrix &&
+         state.projectionMatrix == projectionMatrix && state.zNear == zNear && state.zFar == zFar )
+        return;
+
+    this->updateGrid(projectionMatrix, zNear, zFar);
+
+    state.built = true;
+    state.lightsVersion = allLights.getVersion();
+    state.viewMatrix = viewMatrix;
+    state.projectionMatrix = projectionMatrix;
+    state.zNear = zNear;
+    state.zFar = zFar;
+    state.sliceParams = m_sliceParams;
+
+    const LightInfo* lights = allLights.getLights();
+    size_t count = allLights.getLightCount();
+
+    if ( count > MAX_CLUSTERED_LIGHTS )
+    {
+        if ( !m_warnedLights )
+            std::cout << "Warning: more than " << MAX_CLUSTERED_LIGHTS << " lights, extra lights ignored" << std::endl;
+        m_warnedLights = true;
+        count = MAX_CLUSTERED_LIGHTS;
+    }
+
+    // lights in view space and the slices they reach
+    m_viewLights.clear();
+    m_lightData.clear();
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const float range = getRange(lights[i]);
+        if ( range <= 0.0f )
+            continue;
+
+        const glm::vec3 position = (viewMatrix * glm::vec4(lights[i].position, 1.0f)).xyz();
+        const float depthNear = -position.z - range;
+        const float depthFar = -position.z + range;
+        if ( depthFar <= 0.0f || depthNear >= m_far )
+            continue;
+
+        ViewLight light;
+        light.positionRange = glm::vec4(position, range);
+        light.firstSlice = depthNear <= m_near ? 0 :
+            std::min(CLUSTER_Z - 1, int(std::log(depthNear) * m_sliceParams.x + m_sliceParams.y));
+        light.lastSlice = std::min(CLUSTER_Z - 1, std::max(0, int(std::log(depthFar) * m_sliceParams.x + m_sliceParams.y)));
+        m_viewLights.push_back(light);
+
+        // the shaders index lights by their position in m_viewLights
+        m_lightData.push_back(light.positionRange);
+        m_lightData.push_back(glm::vec4(lights[i].diffuse, 0.0f));
+        m_lightData.push_back(glm::vec4(lights[i].specular, 0.0f));
+        m_lightData.push_back(glm::vec4(lights[i].ambient, 0.0f));
+    }
+
+    // every slice is independent, split them over the threads
+    m_overflow = false;
+    ThreadPool::get().parallelFor(CLUSTER_Z, 1, [this](size_t begin, size_t end) {
+        this->assignSlices(begin, end);
+    });
+    if ( m_overflow && !m_warnedOverflow )
+    {
+        std::cout << "Warning: more than " << MAX_CLUSTER_LIGHTS << " lights in a cluster, extra lights dropped" << std::endl;
+        m_warnedOverflow = true;
+    }
+
+    // pack the per froxel lists
+    m_indices.clear();
+    for ( int cluster = 0; cluster < CLUSTER_COUNT; ++cluster )
+    {
+        const GLuint lightCount = m_clusterCounts[cluster];
+        const GLuint* clusterLights = &m_clusterLights[cluster * MAX_CLUSTER_LIGHTS];
+        m_grid[cluster*2] = m_indices.size();
+        m_grid[cluster*2 + 1] = lightCount;
+        m_indices.insert(m_indices.end(), clusterLights, clusterLights + lightCount);
+    }
+
+    // texture buffers can't be empty
+    if ( m_indices.empty() )
+        m_indices.push_back(0);
+    if ( m_lightData.empty() )
+        m_lightData.resize(CLUSTER_LIGHT_TEXELS, glm::vec4(0.0f));
+
+    // respecify the storage so the driver can orphan the old one
+    const GLsizei first = view * CLUSTER_BUFFER_COUNT;
+    m_buffers.setData(m_grid.data(), m_grid.size(), GL_STREAM_DRAW, first + GRID_BUFFER);
+    m_buffers.setData(m_indices.data(), m_indices.size(), GL_STREAM_DRAW, first + INDEX_BUFFER);
+    m_buffers.setData(m_lightData.data(), m_lightData.size(), GL_STREAM_DRAW, first + LIGHTS_BUFFER);
+}
+
+void LightClusters::assignSlices(size_t begin, size_t end)
+{
+    for ( size_t slice = begin; slice < end; ++slice )
+    {
+        const int firstCluster = slice * CLUSTER_TILES;
+        GLuint* counts = &m_clusterCounts[firstCluster];
+        std::fill(counts, counts + CLUSTER_TILES, 0);
+
+        for ( size_t light = 0; light < m_viewLights.size(); ++light )
+        {
+            const ViewLight& viewLight = m_viewLights[light];
+            if ( int(slice) < viewLight.firstSlice || int(slice) > viewLight.lastSlice )
+                continue;
+
+            // distance from the sphere center to a froxel's box, z is the same
+            // for the whole slice
+            const glm::vec4& sphere = viewLight.positionRange;
+            const float dz = std::max(0.0f, std::max(m_sliceMinZ[slice] - sphere.z, sphere.z - m_sliceMaxZ[slice]));
+            const float radius2 = sphere.w * sphere.w;
+            if ( dz*dz > radius2 )
+                continue;
+
+#ifdef __SSE__
+            const __m128 cx = _mm_set1_ps(sphere.x);
+            const __m128 cy = _mm_set1_ps(sphere.y);
+            const __m128 dz2 = _mm_set1_ps(dz*dz);
+            const __m128 r2 = _mm_set1_ps(radius2);
+            const __m128 zero = _mm_setzero_ps();
+            for ( int tile = 0; tile < CLUSTER_TILES; tile += 4 )
+            {
+                const int cluster = firstCluster + tile;
+                const __m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[cluster]), cx),
+                                                              _mm_sub_ps(cx, _mm_loadu_ps(&m_maxX[cluster]))));
+                const __m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[cluster]), cy),
+                                                              _mm_sub_ps(cy, _mm_loadu_ps(&m_maxY[cluster]))));
+                const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), dz2);
+                int hits = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+
+                for ( int i = 0; hits != 0; ++i, hits >>= 1 )
+                {
+                    if ( (hits & 1) == 0 )
+                        continue;
+                    GLuint& lightCount = counts[tile + i];
+                    if ( lightCount < MAX_CLUSTER_LIGHTS )
+                        m_clusterLights[(cluster + i) * MAX_CLUSTER_LIGHTS + lightCount++] = light;
+                    else
+                        m_overflow = true;
+                }
+            }
+#else
+            for ( int tile = 0; tile < CLUSTER_TILES; ++tile )
+            {
+                const int cluster = firstCluster + tile;
+                const float dx = std::max(0.0f, std::max(m_minX[cluster] - sphere.x, sphere.x - m_maxX[cluster]));
+                const float dy = std::max(0.0f, std::max(m_minY[cluster] - sphere.y, sphere.y - m_maxY[cluster]));
+                if ( dx*dx + dy*dy + dz*dz > radius2 )
+                    continue;
+
+                GLuint& lightCount = counts[tile];
+                if ( lightCount < MAX_CLUSTER_LIGHTS )
+                    m_clusterLights[cluster * MAX_CLUSTER_LIGHTS + lightCount++] = light;
+                else
+                    m_overflow = true;
+            }
+#endif
+        }
+    }
+}
+
+void LightClusters::bind(size_t view)
+{
+    const GLsizei first = view * CLUSTER_BUFFER_COUNT;
+    GLTexture::setActiveUnit(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+    m_textures.bind(GL_TEXTURE_BUFFER, first + GRID_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+    m_textures.bind(GL_TEXTURE_BUFFER, first + INDEX_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0 + CLUSTER_LIGHTS_UNIT);
+    m_textures.bind(GL_TEXTURE_BUFFER, first + LIGHTS_BUFFER);
+    GLTexture::setActiveUnit(GL_TEXTURE0);
+
+    const ViewState& state = m_views[view];
+    for ( size_t i = 0; i < m_programs.size(); ++i )
+    {
+        m_programs[i]->viewport.set(state.viewport);
+        m_programs[i]->slices.set(state.sliceParams);
+    }
+}
+
+GLuint LightClusters::getLightCount() const
+{
+    return m_viewLights.size();
+}
+
+GLuint LightClusters::getIndexCount() const
+{
+    return m_indices.size();
+}
@@ -0,0 +1,154 @@
+#ifndef LIGHTCLUSTERS_HPP
+#define LIGHTCLUSTERS_HPP
+
+#include "../glwrappers/GLBuffer.hpp"
+#include "../glwrappers/GLProgram.hpp"
+#include "../glwrappers/GLTexture.hpp"
+#include "../glwrappers/GLTypedUniform.hpp"
+#include "../objects/Lights.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// froxel grid, must match CLUSTER_DIM in fshader.glsl
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_TILES = CLUSTER_X * CLUSTER_Y;
+const int CLUSTER_COUNT = CLUSTER_TILES * CLUSTER_Z;
+
+// lights a single cluster can hold, the rest are dropped
+const int MAX_CLUSTER_LIGHTS = 64;
+
+// lights the grid is built from, the rest are ignored
+const GLuint MAX_CLUSTERED_LIGHTS = 1024;
+
+// a light stops at the distance its brightest channel drops below this
+const float CLUSTER_LIGHT_CUTOFF = 1.0f / 128.0f;
+
+// RGBA32F texels per light: view position and range, diffuse, specular, ambient
+const int CLUSTER_LIGHT_TEXELS = 4;
+
+// texture units of u_clusterGrid, u_clusterIndices and u_clusterLights
+const GLint CLUSTER_GRID_UNIT    = 2;
+const GLint CLUSTER_INDEX_UNIT   = 3;
+const GLint CLUSTER_LIGHTS_UNIT  = 4;
+
+// Clustered forward lighting. The view frustum is split into a grid of
+// froxels (screen tiles times exponential depth slices) and every light is
+// assigned to the froxels its sphere of influence touches, so a fragment only
+// loops over the lights of its own froxel.
+//
+// For each view:
+//   clusters.build(view, lights, viewMatrix, projectionMatrix, zNear, zFar, viewport);
+//   clusters.bind(view);
+//   clusteredProgram.use();
+//   ... draw ...
+//
+// Every view keeps its own grid, build() leaves it as it is if no light and
+// neither matrix changed since it was last built.
+//
+// The assignment runs on the ThreadPool, one depth slice per job, testing
+// four tiles at a time with SSE. The result goes to three texture buffers:
+// an (offset, count) pair per froxel, the packed light indices and the light
+// data itself. A light's range is where its brightest channel falls below
+// CLUSTER_LIGHT_CUTOFF with the shaders' attenuation, they fade it to zero
+// there.
+//
+// The projection is assumed to be symmetric (glm::perspective).
+class LightClusters
+{
+public:
+    LightClusters();
+
+    bool init(size_t viewCount = 1);
+
+    // set the sampler units of a clustered program and have build() keep its
+    // grid uniforms up to date
+    bool addProgram(GLProgram& program);
+
+    // assign lights to the froxels of a view and upload the result. viewport
+    // is x, y, width, height in pixels.
+    void build(size_t view, const Lights& lights, const glm::mat4& viewMatrix,
+               const glm::mat4& projectionMatrix, float zNear, float zFar, const glm::vec4& viewport);
+
+    // bind the texture buffers of view to their units and set the grid
+    // uniforms, leaves GL_TEXTURE0 active
+    void bind(size_t view);
+
+    // distance at which a light no longer contributes
+    static float getRange(const LightInfo& light);
+
+    GLuint getLightCount() const;
+    GLuint getIndexCount() const;
+protected:
+    struct ProgramUniforms
+    {
+        GLTypedUniform<glm::vec4> viewport;
+        GLTypedUniform<glm::vec2> slices;
+    };
+
+    // what the grid of a view was last built from
+    struct ViewState
+    {
+        bool         built;
+        unsigned int lightsVersion;
+        glm::mat4    viewMatrix;
+        glm::mat4    projectionMatrix;
+        float        zNear;
+        float        zFar;
+        glm::vec4    viewport;
+        glm::vec2    sliceParams;
+    };
+
+    // a light in view space
+    struct ViewLight
+    {
+        glm::vec4 positionRange;
+        int       firstSlice;
+        int       lastSlice;
+    };
+
+    // recompute the froxel bounds if the projection changed
+    void updateGrid(const glm::mat4& projectionMatrix, float zNear, float zFar);
+
+    // assign the lights to the froxels of slices [begin, end)
+    void assignSlices(size_t begin, size_t end);
+
+    // view space bounds of every froxel, tiles are stored slice by slice
+    std::vector<float>     m_minX;
+    std::vector<float>     m_maxX;
+    std::vector<float>     m_minY;
+    std::vector<float>     m_maxY;
+    float                  m_sliceMinZ[CLUSTER_Z];
+    float                  m_sliceMaxZ[CLUSTER_Z];
+
+    glm::vec2              m_projectionScale;   // of the grid in m_minX...
+    float                  m_near;
+    float                  m_far;
+    glm::vec2              m_sliceParams;       // slice = log(depth) * x + y
+
+    std::vector<ViewLight> m_viewLights;
+    std::vector<GLuint>    m_clusterCounts;
+    std::vector<GLuint>    m_clusterLights;     // MAX_CLUSTER_LIGHTS per froxel
+    std::atomic<bool>      m_overflow;
+
+    // what is sent to the texture buffers
+    std::vector<GLuint>    m_grid;
+    std::vector<GLuint>    m_indices;
+    std::vector<glm::vec4> m_lightData;
+
+    // CLUSTER_BUFFER_COUNT of each per view
+    GLBuffer               m_buffers;
+    GLTexture              m_textures;
+    std::vector<ViewState> m_views;
+    std::vector<std::shared_ptr<ProgramUniforms>> m_programs;
+
+    bool                   m_warnedLights;
+    bool                   m_warnedOverflow;
+};
+
+#endif // LIGHTCLUSTERS_HPP
@@ -0,0 +1,304 @@
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <unordered_map>
+
+// a level is only kept if it drops at least this fraction of the triangles
+// of the one before
+const float MIN_LEVEL_REDUCTION = 0.1f;
+
+// normal of the triangle a, b, c (not normalized)
+static void getNormal(const GLfloat* a, const GLfloat* b, const GLfloat* c, double* normal)
+{
+    const double u[] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const double v[] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    normal[0] = u[1] * v[2] - u[2] * v[1];
+    normal[1] = u[2] * v[0] - u[0] * v[2];
+    normal[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+void MeshSimplifier::Quadric::setPlane(double a, double b, double c, double d)
+{
+    m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+    m[4] = b * b; m[5] = b * c; m[6] = b * d;
+    m[7] = c * c; m[8] = c * d;
+    m[9] = d * d;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& other)
+{
+    for ( int i = 0; i < 10; ++i )
+        m[i] += other.m[i];
+}
+
+double MeshSimplifier::Quadric::evaluate(const GLfloat* p) const
+{
+    const double x = p[0], y = p[1], z = p[2];
+    return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+           m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+           m[7] * z * z + 2.0 * m[8] * z +
+           m[9];
+}
+
+bool MeshSimplifier::Collapse::operator<(const Collapse& other) const
+{
+    return cost > other.cost;
+}
+
+MeshSimplifier::MeshSimplifier(const GLfloat* vertices, size_t stride, GLuint numVertices, const GLuint* indices, GLuint numIndices) :
+    m_vertices(vertices),
+    m_stride(stride),
+    m_numVertices(numVertices),
+    m_triangleCount(0),
+    m_vertexTriangles(numVertices),
+    m_quadrics(numVertices),
+    m_locked(numVertices, false),
+    m_versions(numVertices, 0)
+{
+    for ( GLuint i = 0; i < numVertices; ++i )
+        m_quadrics[i].setPlane(0.0, 0.0, 0.0, 0.0);
+
+    // drop triangles that are already degenerate
+    m_triangles.reserve(numIndices);
+    for ( GLuint i = 0; i + 2 < numIndices; i += 3 )
+    {
+        const GLuint a = indices[i], b = indices[i+1], c = indices[i+2];
+        if ( a == b || b == c || a == c || a >= numVertices || b >= numVertices || c >= numVertices )
+            continue;
+        m_triangles.push_back(a);
+        m_triangles.push_back(b);
+        m_triangles.push_back(c);
+    }
+    m_triangleCount = m_triangles.size() / 3;
+    m_removed.assign(m_triangleCount, false);
+
+    // every vertex starts with the planes of its triangles, and the edges
+    // that don't have exactly two triangles lock their vertices
+    std::unordered_map<unsigned long long, int> edges;
+    edges.reserve(m_triangles.size());
+    for ( size_t t = 0; t < m_triangleCount; ++t )
+    {
+        const GLuint* tri = &m_triangles[t*3];
+
+        double normal[3];
+        getNormal(this->getPosition(tri[0]), this->getPosition(tri[1]), this->getPosition(tri[2]), normal);
+        const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        Quadric plane;
+        plane.setPlane(0.0, 0.0, 0.0, 0.0);
+        if ( length > 0.0 )
+        {
+            const GLfloat* p = this->getPosition(tri[0]);
+            const double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+            plane.setPlane(a, b, c, -(a * p[0] + b * p[1] + c * p[2]));
+        }
+
+        for ( int i = 0; i < 3; ++i )
+        {
+            m_quadrics[tri[i]].add(plane);
+            m_vertexTriangles[tri[i]].push_back(t);
+
+            const unsigned long long low = std::min(tri[i], tri[(i+1)%3]);
+            const unsigned long long high = std::max(tri[i], tri[(i+1)%3]);
+            ++edges[(high << 32) | low];
+        }
+    }
+
+    for ( std::unordered_map<unsigned long long, int>::const_iterator i = edges.begin(); i != edges.end(); ++i )
+    {
+        if ( i->second == 2 )
+            continue;
+        m_locked[i->first & 0xffffffffull] = true;
+        m_locked[i->first >> 32] = true;
+    }
+}
+
+std::vector<MeshSimplifier::Level> MeshSimplifier::build(size_t count, float ratio, float maxError)
+{
+    std::vector<Level> levels;
+
+    CollapseQueue queue;
+    std::vector<GLuint> neighbors;
+    for ( GLuint i = 0; i < m_numVertices; ++i )
+    {
+        if ( m_locked[i] )
+            continue;
+        this->getNeighbors(i, neighbors);
+        for ( size_t j = 0; j < neighbors.size(); ++j )
+            this->pushCollapse(queue, i, neighbors[j]);
+    }
+
+    const double maxCost = double(maxError) * double(maxError);
+    double reached = 0.0;
+    size_t target = m_triangleCount;
+    for ( size_t level = 0; level < count; ++level )
+    {
+        const size_t previous = m_triangleCount;
+        target = static_cast<size_t>(target * ratio);
+
+        while ( m_triangleCount > target && !queue.empty() && queue.top().cost <= maxCost )
+        {
+            const Collapse next = queue.top();
+            queue.pop();
+
+            // either end changed since it was queued, there is a newer one
+            if ( m_versions[next.from] != next.fromVersion || m_versions[next.to] != next.toVersion )
+                continue;
+            if ( !this->isValid(next.from, next.to) )
+                continue;
+
+            this->collapse(next.from, next.to);
+            reached = std::max(reached, next.cost);
+            this->pushEdges(queue, next.to);
+        }
+
+        if ( m_triangleCount > previous * (1.0f - MIN_LEVEL_REDUCTION) )
+            break;
+
+        Level result;
+        this->getIndices(result.indices);
+        result.error = static_cast<float>(std::sqrt(reached));
+        levels.push_back(result);
+
+        // out of collapses under maxError, the next level would be the same
+        if ( m_triangleCount > target )
+            break;
+    }
+    return levels;
+}
+
+const GLfloat* MeshSimplifier::getPosition(GLuint vertex) const
+{
+    return m_vertices + vertex * m_stride;
+}
+
+void MeshSimplifier::getNeighbors(GLuint vertex, std::vector<GLuint>& neighbors) const
+{
+    neighbors.clear();
+    const std::vector<GLuint>& triangles = m_vertexTriangles[vertex];
+    for ( size_t i = 0; i < triangles.size(); ++i )
+    {
+        if ( m_removed[triangles[i]] )
+            continue;
+        for ( int j = 0; j < 3; ++j )
+        {
+            const GLuint other = m_triangles[triangles[i]*3 + j];
+            if ( other != vertex )
+                neighbors.push_back(other);
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+void MeshSimplifier::pushEdges(CollapseQueue& queue, GLuint vertex)
+{
+    std::vector<GLuint> neighbors;
+    this->getNeighbors(vertex, neighbors);
+    for ( size_t i = 0; i < neighbors.size(); ++i )
+    {
+        this->pushCollapse(queue, vertex, neighbors[i]);
+        this->pushCollapse(queue, neighbors[i], vertex);
+    }
+}
+
+void MeshSimplifier::pushCollapse(CollapseQueue& queue, GLuint from, GLuint to)
+{
+    if ( m_locked[from] )
+        return;
+
+    const Collapse collapse = {this->getCost(from, to), from, to, m_versions[from], m_versions[to]};
+    queue.push(collapse);
+}
+
+double MeshSimplifier::getCost(GLuint from, GLuint to) const
+{
+    Quadric merged = m_quadrics[from];
+    merged.add(m_quadrics[to]);
+    return std::max(0.0, merged.evaluate(this->getPosition(to)));
+}
+
+bool MeshSimplifier::isValid(GLuint from, GLuint to) const
+{
+    // link condition: an inner edge has exactly the two vertices opposite it
+    // as common neighbors, any more and the collapse pinches the surface into
+    // a non-manifold fan
+    std::vector<GLuint> fromNeighbors, toNeighbors, shared;
+    this->getNeighbors(from, fromNeighbors);
+    this->getNeighbors(to, toNeighbors);
+    std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(), toNeighbors.begin(), toNeighbors.end(),
+                          std::back_inserter(shared));
+    if ( shared.size() > 2 )
+        return false;
+
+    const std::vector<GLuint>& triangles = m_vertexTriangles[from];
+    for ( size_t i = 0; i < triangles.size(); ++i )
+    {
+        if ( m_removed[triangles[i]] )
+            continue;
+
+        const GLuint* tri = &m_triangles[triangles[i]*3];
+        if ( tri[0] == to || tri[1] == to || tri[2] == to )
+            continue;
+
+        // the triangle with from moved onto to has to face the same way
+        const GLfloat* before[3];
+        const GLfloat* after[3];
+        for ( int j = 0; j < 3; ++j )
+        {
+            before[j] = this->getPosition(tri[j]);
+            after[j] = this->getPosition(tri[j] == from ? to : tri[j]);
+        }
+        double n0[3], n1[3];
+        getNormal(before[0], before[1], before[2], n0);
+        getNormal(after[0], after[1], after[2], n1);
+        if ( n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0 )
+            return false;
+    }
+    return true;
+}
+
+void MeshSimplifier::collapse(GLuint from, GLuint to)
+{
+    std::vector<GLuint>& triangles = m_vertexTriangles[from];
+    for ( size_t i = 0; i < triangles.size(); ++i )
+    {
+        const GLuint t = triangles[i];
+        if ( m_removed[t] )
+            continue;
+
+        GLuint* tri = &m_triangles[t*3];
+        if ( tri[0] == to || tri[1] == to || tri[2] == to )
+        {
+            // the edge itself, nothing left of it
+            m_removed[t] = true;
+            --m_triangleCount;
+            continue;
+        }
+
+        for ( int j = 0; j < 3; ++j )
+            if ( tri[j] == from )
+                tri[j] = to;
+        m_vertexTriangles[to].push_back(t);
+    }
+    triangles.clear();
+
+    // forget the triangles of to that just went away
+    std::vector<GLuint>& remaining = m_vertexTriangles[to];
+    remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+                                   [this](GLuint t) { return m_removed[t]; }), remaining.end());
+
+    m_quadrics[to].add(m_quadrics[from]);
+    ++m_versions[from];
+    ++m_versions[to];
+}
+
+void MeshSimplifier::getIndices(std::vector<GLuint>& indices) const
+{
+    indices.clear();
+    indices.reserve(m_triangleCount * 3);
+    for ( size_t t = 0; t < m_removed.size(); ++t )
+        if ( !m_removed[t] )
+            indices.insert(indices.end(), m_triangles.begin() + t*3, m_triangles.begin() + t*3 + 3);
+}
@@ -0,0 +1,100 @@
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <queue>
+#include <vector>
+
+// Quadric error mesh simplification for building detail levels at load time.
+//
+// Edges are collapsed one vertex onto the other, cheapest first, where the
+// cost is the squared distance of the merged vertex to the planes of every
+// triangle it came from (Garland and Heckbert). Vertices never move, a level
+// is just a shorter index list over the mesh's own vertices, so every level
+// shares one vertex buffer.
+//
+// Vertices on an open edge are never collapsed. Seams where the uvs or
+// normals split a vertex look like open edges to the indices, so they stay
+// closed. A collapse that would flip a triangle or fold the surface onto
+// itself (more than two common neighbors) is skipped.
+//
+// example:
+//   MeshSimplifier simplifier(vertices, 8, numVertices, indices, numIndices);
+//   std::vector<MeshSimplifier::Level> levels = simplifier.build(3, 0.5f, maxError);
+class MeshSimplifier
+{
+public:
+    struct Level
+    {
+        std::vector<GLuint> indices;
+        float error;        // max distance to the original surface, about
+    };
+
+    // stride is in floats, positions are the first 3 of each vertex. The
+    // arrays must outlive the simplifier.
+    MeshSimplifier(const GLfloat* vertices, size_t stride, GLuint numVertices, const GLuint* indices, GLuint numIndices);
+
+    // up to count levels, each with about ratio of the triangles of the one
+    // before, coarsest last. Stops at the first level that would need an
+    // error over maxError or doesn't get smaller.
+    std::vector<Level> build(size_t count, float ratio, float maxError);
+protected:
+    // symmetric 4x4 matrix summing squared plane distances
+    struct Quadric
+    {
+        double m[10];
+
+        void setPlane(double a, double b, double c, double d);
+        void add(const Quadric& other);
+        double evaluate(const GLfloat* p) const;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        GLuint from;
+        GLuint to;
+        unsigned int fromVersion;
+        unsigned int toVersion;
+
+        // the cheapest first in a std::priority_queue
+        bool operator<(const Collapse& other) const;
+    };
+
+    typedef std::priority_queue<Collapse> CollapseQueue;
+
+    const GLfloat* getPosition(GLuint vertex) const;
+
+    // the vertices sharing a triangle with vertex
+    void getNeighbors(GLuint vertex, std::vector<GLuint>& neighbors) const;
+
+    // collapse candidates of the edges around vertex, both directions
+    void pushEdges(CollapseQueue& queue, GLuint vertex);
+    void pushCollapse(CollapseQueue& queue, GLuint from, GLuint to);
+
+    double getCost(GLuint from, GLuint to) const;
+
+    // false if moving from onto to flips one of from's triangles or the two
+    // share more than the two neighbors opposite their edge
+    bool isValid(GLuint from, GLuint to) const;
+    void collapse(GLuint from, GLuint to);
+
+    // indices of the triangles that are left
+    void getIndices(std::vector<GLuint>& indices) const;
+
+    const GLfloat*             m_vertices;
+    size_t                     m_stride;
+    GLuint                     m_numVertices;
+
+    std::vector<GLuint>        m_triangles;     // 3 vertices each
+    std::vector<bool>          m_removed;       // per triangle
+    size_t                     m_triangleCount; // not removed
+
+    std::vector<std::vector<GLuint>> m_vertexTriangles;
+    std::vector<Quadric>       m_quadrics;
+    std::vector<bool>          m_locked;
+    std::vector<unsigned int>  m_versions;      // bumped when a quadric changes
+};
+
+#endif // MESHSIMPLIFIER_HPP
@@ -0,0 +1,120 @@
+#include "ResolutionScaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// weight of a new timing in the smoothed one, a single slow frame (a hitch,
+// a compile) shouldn't drop the resolution
+const double TIMING_SMOOTHING = 0.2;
+
+// fraction of the way to the fitting scale taken per timing
+const float SCALE_RATE = 0.25f;
+
+// differences smaller than this are left alone so the scale doesn't hunt
+const float SCALE_DEAD_BAND = 0.02f;
+
+ResolutionScaler::ResolutionScaler(double budgetMs, float minScale, float maxScale) :
+    m_budget(budgetMs),
+    m_minScale(minScale),
+    m_maxScale(maxScale)
+{}
+
+bool ResolutionScaler::isSupported()
+{
+    return (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) && (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object);
+}
+
+bool ResolutionScaler::init(size_t viewCount)
+{
+    if ( viewCount == 0 || !ResolutionScaler::isSupported() )
+        return false;
+
+    if ( !m_framebuffers.generate(viewCount) || !m_queries.generate(viewCount * RESOLUTION_QUERY_FRAMES) )
+        return false;
+
+    const View view = {m_maxScale, 0.0, 0};
+    m_views.assign(viewCount, view);
+    return true;
+}
+
+bool ResolutionScaler::resize(GLsizei width, GLsizei height)
+{
+    for ( size_t i = 0; i < m_views.size(); ++i )
+        if ( !m_framebuffers.setSize(width, height, i) )
+            return false;
+    return true;
+}
+
+glm::vec4 ResolutionScaler::begin(size_t view)
+{
+    View& info = m_views[view];
+
+    // the query issued RESOLUTION_QUERY_FRAMES ago, a result that isn't in
+    // yet is dropped
+    const GLsizei query = view * RESOLUTION_QUERY_FRAMES + info.nextQuery;
+    if ( m_queries.isAvailable(query) )
+        this->addTiming(view, m_queries.getResult(query) / 1000000.0);
+    info.nextQuery = (info.nextQuery + 1) % RESOLUTION_QUERY_FRAMES;
+
+    const glm::ivec2 size = this->getScaledSize(view);
+    m_framebuffers.bind(GL_FRAMEBUFFER, view);
+    glViewport(0, 0, size.x, size.y);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_queries.begin(GL_TIME_ELAPSED, query);
+    return glm::vec4(0.0f, 0.0f, size.x, size.y);
+}
+
+void ResolutionScaler::end()
+{
+    GLQuery::end(GL_TIME_ELAPSED);
+}
+
+void ResolutionScaler::present(size_t view, const glm::vec4& destination)
+{
+    const glm::ivec2 size = this->getScaledSize(view);
+    const GLint source[] = {0, 0, size.x, size.y};
+    const GLint target[] = {GLint(destination.x), GLint(destination.y), GLint(destination.z), GLint(destination.w)};
+
+    // nothing to filter at full scale
+    GLFramebuffer::unbindFramebuffers(GL_DRAW_FRAMEBUFFER);
+    m_framebuffers.blit(source, target, view, size.x == target[2] && size.y == target[3] ? GL_NEAREST : GL_LINEAR);
+    GLFramebuffer::unbindFramebuffers(GL_FRAMEBUFFER);
+}
+
+float ResolutionScaler::getScale(size_t view) const
+{
+    return m_views[view].scale;
+}
+
+double ResolutionScaler::getGpuTime(size_t view) const
+{
+    return m_views[view].gpuTime;
+}
+
+void ResolutionScaler::addTiming(size_t view, double ms)
+{
+    View& info = m_views[view];
+    if ( info.gpuTime <= 0.0 )
+        info.gpuTime = ms;
+    else
+        info.gpuTime += TIMING_SMOOTHING * (ms - info.gpuTime);
+    if ( info.gpuTime <= 0.0 )
+        return;
+
+    // the time goes with the pixel count, the square of the scale
+    const double budget = m_budget / m_views.size();
+    const float fit = info.scale * static_cast<float>(std::sqrt(budget / info.gpuTime));
+    const float target = std::min(std::max(fit, m_minScale), m_maxScale);
+    if ( std::fabs(target - info.scale) < SCALE_DEAD_BAND )
+        return;
+
+    info.scale += SCALE_RATE * (target - info.scale);
+}
+
+glm::ivec2 ResolutionScaler::getScaledSize(size_t view) const
+{
+    const float scale = m_views[view].scale;
+    return glm::ivec2(std::max(1, static_cast<int>(m_framebuffers.getWidth(view) * scale + 0.5f)),
+                      std::max(1, static_cast<int>(m_framebuffers.getHeight(view) * scale + 0.5f)));
+}
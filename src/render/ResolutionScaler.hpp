@@ -0,0 +1,81 @@
+#ifndef RESOLUTIONSCALER_HPP
+#define RESOLUTIONSCALER_HPP
+
+#include "../glwrappers/GLFramebuffer.hpp"
+#include "../glwrappers/GLQuery.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// timer queries per view, a result is read this many frames after it was
+// issued so nothing waits on the GPU
+const GLsizei RESOLUTION_QUERY_FRAMES = 3;
+
+// Dynamic resolution. Every view is drawn into its own framebuffer at a
+// fraction of its size on screen and scaled up into the window afterwards.
+// A GL_TIME_ELAPSED query around each view measures how long the GPU took,
+// the fraction is then moved towards what fits the view's share of the
+// budget. Shading time is mostly per pixel, so halving the time takes about
+// 0.7 of the width and height.
+//
+// For each view:
+//   glm::vec4 viewport = scaler.begin(view);   // bound, cleared, viewport set
+//   ... draw ...
+//   scaler.end();
+//   scaler.present(view, windowViewport);     // default framebuffer bound
+//
+// The framebuffers have the full size of a view, only their lower left
+// corner is drawn into, so a new scale doesn't reallocate anything.
+class ResolutionScaler
+{
+public:
+    // budgetMs is the GPU time all views together may take each frame
+    explicit ResolutionScaler(double budgetMs, float minScale = 0.5f, float maxScale = 1.0f);
+
+    // false if timer queries or framebuffer objects are unsupported
+    static bool isSupported();
+
+    bool init(size_t viewCount);
+
+    // full size of one view in the window, false if the framebuffers can't
+    // be allocated
+    bool resize(GLsizei width, GLsizei height);
+
+    // bind and clear the framebuffer of view and start timing it, returns
+    // the viewport (x, y, width, height) that is drawn
+    glm::vec4 begin(size_t view);
+    void end();
+
+    // scale the view up into destination (x, y, width, height) of the
+    // default framebuffer
+    void present(size_t view, const glm::vec4& destination);
+
+    float getScale(size_t view) const;
+
+    // smoothed GPU time of the view in ms, 0 before the first result
+    double getGpuTime(size_t view) const;
+protected:
+    // adjust the scale of view to a new timing
+    void addTiming(size_t view, double ms);
+
+    // drawn size of view at its current scale
+    glm::ivec2 getScaledSize(size_t view) const;
+
+    struct View
+    {
+        float  scale;
+        double gpuTime;     // ms
+        GLsizei nextQuery;  // of the view's RESOLUTION_QUERY_FRAMES
+    };
+
+    GLFramebuffer     m_framebuffers;   // one per view
+    GLQuery           m_queries;        // RESOLUTION_QUERY_FRAMES per view
+    std::vector<View> m_views;
+
+    double            m_budget;         // ms for all views
+    float             m_minScale;
+    float             m_maxScale;
+};
+
+#endif // RESOLUTIONSCALER_HPP
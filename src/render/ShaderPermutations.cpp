@@ -0,0 +1,297 @@
+#include "ShaderPermutations.hpp"
+
+#include <fstream>
+#include <sstream>
+
+// names of the feature bits in the generated source
+static const struct
+{
+    unsigned int bit;
+    const char*  name;
+} FEATURE_NAMES[] = {
+    {SHADER_TEXTURE_DIFFUSE, "TEXTURE_DIFFUSE"},
+    {SHADER_INDIRECT,        "INDIRECT"},
+    {SHADER_CLUSTERED,       "CLUSTERED"},
+    {SHADER_DEPTH_ONLY,      "DEPTH_ONLY"},
+    {SHADER_WIREFRAME,       "WIREFRAME"},
+    {SHADER_NORMALS,         "NORMALS"}
+};
+
+ShaderPermutations::ShaderPermutations() :
+    m_initializer(nullptr),
+    m_err("")
+{}
+
+bool ShaderPermutations::addStage(GLenum shaderType, const char* filename, unsigned int usedBits,
+                                  unsigned int requiredBits)
+{
+    std::ifstream fin(filename, std::ios::binary);
+    if ( !fin.good() )
+    {
+        std::ostringstream sout;
+        sout << "Unable to open file \"" << filename << "\"";
+        m_err = sout.str();
+        return false;
+    }
+
+    std::ostringstream source;
+    source << fin.rdbuf();
+
+    Stage stage;
+    stage.type = shaderType;
+    stage.filename = filename;
+    stage.source = source.str();
+    stage.usedBits = usedBits;
+    stage.requiredBits = requiredBits;
+    m_stages.push_back(stage);
+
+    return true;
+}
+
+void ShaderPermutations::setInitializer(const Initializer& initializer)
+{
+    m_initializer = initializer;
+}
+
+GLProgram* ShaderPermutations::get(unsigned int key, bool wait)
+{
+    std::map<unsigned int, std::shared_ptr<GLProgram>>::iterator it = m_variants.find(key);
+    if ( it != m_variants.end() )
+        return it->second.get();
+
+    std::map<unsigned int, Pending>::iterator pending = m_pending.find(key);
+    if ( pending == m_pending.end() )
+    {
+        this->submit(std::vector<unsigned int>(1, key));
+        it = m_variants.find(key);
+        if ( it != m_variants.end() )
+            return it->second.get();
+        pending = m_pending.find(key);
+    }
+
+    if ( !wait && !this->isReady(pending->second) )
+        return nullptr;
+
+    return this->finish(key);
+}
+
+void ShaderPermutations::submit(const std::vector<unsigned int>& keys)
+{
+    // compile everything before the first link so none of the links has to
+    // wait for a shader the others don't need
+    std::vector<unsigned int> submitted;
+    for ( size_t i = 0; i < keys.size(); ++i )
+    {
+        if ( m_variants.count(keys[i]) != 0 || m_pending.count(keys[i]) != 0 )
+            continue;
+
+        if ( this->submitVariant(keys[i]) )
+            submitted.push_back(keys[i]);
+        else
+            m_variants[keys[i]] = nullptr;  // a failure is only reported once
+    }
+
+    for ( size_t i = 0; i < submitted.size(); ++i )
+        m_pending[submitted[i]].program->submitLink();
+}
+
+bool ShaderPermutations::wait(const std::vector<unsigned int>& keys)
+{
+    bool good = true;
+    for ( size_t i = 0; i < keys.size(); ++i )
+        good = this->get(keys[i]) != nullptr && good;
+    return good;
+}
+
+bool ShaderPermutations::precompile(const std::vector<unsigned int>& keys)
+{
+    this->submit(keys);
+    return this->wait(keys);
+}
+
+bool ShaderPermutations::update()
+{
+    std::vector<unsigned int> ready;
+    for ( std::map<unsigned int, Pending>::const_iterator it = m_pending.begin(); it != m_pending.end(); ++it )
+        if ( this->isReady(it->second) )
+            ready.push_back(it->first);
+
+    bool good = true;
+    for ( size_t i = 0; i < ready.size(); ++i )
+        good = this->finish(ready[i]) != nullptr && good;
+    return good;
+}
+
+size_t ShaderPermutations::getPendingCount() const
+{
+    return m_pending.size();
+}
+
+bool ShaderPermutations::submitVariant(unsigned int key)
+{
+    Pending pending;
+    pending.program.reset(new GLProgram);
+    pending.program->init();
+    for ( size_t i = 0; i < m_stages.size(); ++i )
+    {
+        if ( m_stages[i].requiredBits != 0 && (m_stages[i].requiredBits & key) == 0 )
+            continue;
+
+        ShaderKey shaderKey;
+        const GLShader* shader = this->submitShader(i, key, shaderKey);
+        if ( shader == nullptr )
+            return false;
+        if ( !pending.program->attachShader(*shader) )
+        {
+            m_err = pending.program->getLastError();
+            return false;
+        }
+        pending.shaders.push_back(shaderKey);
+    }
+
+    m_pending[key] = pending;
+    return true;
+}
+
+GLShader* ShaderPermutations::submitShader(size_t stage, unsigned int key, ShaderKey& shaderKey)
+{
+    const Stage& info = m_stages[stage];
+    shaderKey = std::make_pair(stage, key & info.usedBits);
+
+    std::map<ShaderKey, GLShader>::iterator it = m_shaders.find(shaderKey);
+    if ( it != m_shaders.end() )
+    {
+        // failed for an earlier variant
+        if ( !it->second.getLastError().empty() )
+        {
+            std::ostringstream sout;
+            sout << it->second.getLastError() << std::endl << "with" << std::endl << getDefines(shaderKey.second);
+            m_err = sout.str();
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    GLShader& shader = m_shaders[shaderKey];
+    const std::string source = insertDefines(info.source, getDefines(shaderKey.second));
+    if ( !shader.submit(source, info.type, info.filename.c_str()) )
+    {
+        m_err = shader.getLastError();
+        m_shaders.erase(shaderKey);
+        return nullptr;
+    }
+
+    return &shader;
+}
+
+bool ShaderPermutations::isReady(const Pending& pending) const
+{
+    // the link can't be done before the shaders are
+    return pending.program->isLinkReady();
+}
+
+GLProgram* ShaderPermutations::finish(unsigned int key)
+{
+    Pending pending = m_pending[key];
+    m_pending.erase(key);
+
+    // a failure is only reported once
+    std::shared_ptr<GLProgram>& variant = m_variants[key];
+
+    // check the shaders first, their logs say more than the link's. A shader
+    // that failed keeps its error for every variant sharing it.
+    for ( size_t i = 0; i < pending.shaders.size(); ++i )
+    {
+        GLShader& shader = m_shaders[pending.shaders[i]];
+        if ( !shader.finish() )
+        {
+            std::ostringstream sout;
+            sout << shader.getLastError() << std::endl << "with" << std::endl << getDefines(pending.shaders[i].second);
+            m_err = sout.str();
+            return nullptr;
+        }
+    }
+
+    if ( !pending.program->finishLink() )
+    {
+        std::ostringstream sout;
+        sout << "Variant " << std::hex << key << " (" << getDefines(key) << ") : "
+             << pending.program->getLastError();
+        m_err = sout.str();
+        return nullptr;
+    }
+
+    if ( m_initializer != nullptr && !m_initializer(*pending.program, key) )
+    {
+        std::ostringstream sout;
+        sout << "Unable to initialize variant " << std::hex << key;
+        m_err = sout.str();
+        return nullptr;
+    }
+
+    variant = pending.program;
+    return variant.get();
+}
+
+unsigned int ShaderPermutations::getLightBucket(int count)
+{
+    // 0 lights is bucket 1, then one bucket per power of two
+    unsigned int bucket = 1;
+    for ( int lights = 0; lights < count; lights = lights == 0 ? 1 : lights * 2 )
+        ++bucket;
+
+    if ( bucket > (SHADER_LIGHT_MASK >> SHADER_LIGHT_SHIFT) )
+        bucket = SHADER_LIGHT_MASK >> SHADER_LIGHT_SHIFT;
+    return bucket << SHADER_LIGHT_SHIFT;
+}
+
+int ShaderPermutations::getBucketLightCount(unsigned int key)
+{
+    const unsigned int bucket = (key & SHADER_LIGHT_MASK) >> SHADER_LIGHT_SHIFT;
+    if ( bucket == 0 )
+        return -1;
+    return bucket == 1 ? 0 : 1 << (bucket - 2);
+}
+
+std::string ShaderPermutations::getDefines(unsigned int key)
+{
+    std::ostringstream sout;
+    for ( size_t i = 0; i < sizeof(FEATURE_NAMES) / sizeof(FEATURE_NAMES[0]); ++i )
+        if ( (key & FEATURE_NAMES[i].bit) != 0 )
+            sout << "#define " << FEATURE_NAMES[i].name << std::endl;
+
+    const int lightCount = getBucketLightCount(key);
+    if ( lightCount >= 0 )
+        sout << "#define LIGHT_COUNT " << lightCount << std::endl;
+
+    return sout.str();
+}
+
+std::string ShaderPermutations::insertDefines(const std::string& source, const std::string& defines)
+{
+    // #version has to stay the first thing in the source
+    size_t line = 0;
+    const size_t version = source.find("#version");
+    if ( version != std::string::npos )
+    {
+        line = source.find('\n', version);
+        line = line == std::string::npos ? source.size() : line + 1;
+    }
+
+    std::string result = source.substr(0, line);
+    if ( line > 0 && result[line - 1] != '\n' )
+        result += '\n';
+    result += defines;
+
+    // keep the line numbers of the compile errors matching the file
+    if ( line > 0 )
+        result += "#line 2\n";
+    result += source.substr(line);
+
+    return result;
+}
+
+const std::string& ShaderPermutations::getLastError() const
+{
+    return m_err;
+}
@@ -0,0 +1,149 @@
+#ifndef SHADERPERMUTATIONS_HPP
+#define SHADERPERMUTATIONS_HPP
+
+#include "../glwrappers/GLProgram.hpp"
+#include "../glwrappers/GLShader.hpp"
+
+#include <GL/glew.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// feature bits of a variant key, each one is #defined under its name in the
+// generated source. The texture bits match the DrawType ones, 0x02 and 0x04
+// are left for TEXTURE_SPECULAR and TEXTURE_BUMP.
+const unsigned int SHADER_TEXTURE_DIFFUSE = 0x01;   // same bit as TEXTURE_DIFFUSE
+const unsigned int SHADER_INDIRECT        = 0x08;   // matrices and material from u_drawData
+const unsigned int SHADER_CLUSTERED       = 0x10;   // lights from LightClusters
+const unsigned int SHADER_DEPTH_ONLY      = 0x20;   // position only, empty fragment shader
+const unsigned int SHADER_WIREFRAME       = 0x40;   // edges from a geometry shader
+const unsigned int SHADER_NORMALS         = 0x80;   // normals drawn as lines
+
+// light count bucket, 0 leaves the count to the Lights block. Bucket n > 0
+// defines LIGHT_COUNT as the n-th of 0, 1, 2, 4, 8... so the forward loop
+// has a constant bound.
+const unsigned int SHADER_LIGHT_SHIFT = 8;
+const unsigned int SHADER_LIGHT_MASK  = 0xf00;
+
+const unsigned int SHADER_ALL_FEATURES = ~0u;
+
+// Generates program variants from a single source per stage. The #defines of
+// a variant key are inserted after the #version line, so one file holds every
+// combination of features and the compiler drops what a variant doesn't use.
+//
+//   permutations.addStage(GL_VERTEX_SHADER, "shaders/vshader.glsl", SHADER_TEXTURE_DIFFUSE | ...);
+//   permutations.addStage(GL_FRAGMENT_SHADER, "shaders/fshader.glsl");
+//   permutations.setInitializer(...);   // uniform blocks, samplers...
+//   ...
+//   GLProgram* program = permutations.get(SHADER_TEXTURE_DIFFUSE | getLightBucket(count));
+//
+// Variants are compiled the first time they're asked for, precompile() does
+// it ahead of time. Stages that only read some of the bits share the compiled
+// shader between the variants that agree on them. A variant that fails is
+// remembered and not tried again.
+//
+// Building is batched: submit() starts every compile and then every link
+// without looking at a single result, so with parallel shader compile (see
+// GLState::hasParallelShaderCompile) the driver builds them all on its own
+// threads. Statuses and logs are only read once a variant is finished, by
+// get(), wait() or by update() as soon as the driver reports it done. Variants
+// that aren't needed right away can be submitted at startup and left to
+// update() while frames are drawn.
+class ShaderPermutations
+{
+public:
+    // called once for every new variant after it linked, returning false
+    // fails the variant
+    typedef std::function<bool(GLProgram& program, unsigned int key)> Initializer;
+
+    ShaderPermutations();
+
+    // Add a stage to the variants with any of requiredBits set (all of them if
+    // 0). usedBits are the bits the source looks at. Returns false if the file
+    // can't be read.
+    bool addStage(GLenum shaderType, const char* filename, unsigned int usedBits = SHADER_ALL_FEATURES,
+                  unsigned int requiredBits = 0);
+
+    void setInitializer(const Initializer& initializer);
+
+    // the variant of key, nullptr if it doesn't compile (see getLastError).
+    // Without wait, nullptr is also returned while the variant is still being
+    // built and a variant that wasn't submitted yet is.
+    GLProgram* get(unsigned int key, bool wait = true);
+
+    // start building the variants, all compiles then all links
+    void submit(const std::vector<unsigned int>& keys);
+
+    // finish building the variants, false if any of them fails
+    bool wait(const std::vector<unsigned int>& keys);
+
+    // submit and wait
+    bool precompile(const std::vector<unsigned int>& keys);
+
+    // finish the submitted variants the driver is done with, false if one of
+    // them failed
+    bool update();
+
+    // variants submitted and not finished yet
+    size_t getPendingCount() const;
+
+    // key bits of the smallest bucket holding count lights
+    static unsigned int getLightBucket(int count);
+
+    // lights the variants of a bucket loop over, -1 for bucket 0
+    static int getBucketLightCount(unsigned int key);
+
+    // the #define lines of key
+    static std::string getDefines(unsigned int key);
+
+    // source with defines inserted after the #version line
+    static std::string insertDefines(const std::string& source, const std::string& defines);
+
+    const std::string& getLastError() const;
+protected:
+    struct Stage
+    {
+        GLenum       type;
+        std::string  filename;
+        std::string  source;
+        unsigned int usedBits;
+        unsigned int requiredBits;
+    };
+
+    typedef std::pair<size_t, unsigned int> ShaderKey;     // stage, used bits of the key
+
+    struct Pending
+    {
+        std::shared_ptr<GLProgram> program;
+        std::vector<ShaderKey>     shaders;
+    };
+
+    // start compiling the stages of key and attach them, doesn't link
+    bool submitVariant(unsigned int key);
+
+    // the shader of stage for key, submitted if no variant needed it yet
+    GLShader* submitShader(size_t stage, unsigned int key, ShaderKey& shaderKey);
+
+    // true if finishing the variant won't wait
+    bool isReady(const Pending& pending) const;
+
+    // check the results of a pending variant and initialize it
+    GLProgram* finish(unsigned int key);
+
+    std::vector<Stage> m_stages;
+    Initializer        m_initializer;
+
+    // compiled shaders by stage and used bits of the key
+    std::map<ShaderKey, GLShader> m_shaders;
+
+    // null for variants that failed
+    std::map<unsigned int, std::shared_ptr<GLProgram>> m_variants;
+    std::map<unsigned int, Pending> m_pending;
+
+    std::string        m_err;
+};
+
+#endif // SHADERPERMUTATIONS_HPP
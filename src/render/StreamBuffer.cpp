@@ -0,0 +1,101 @@
+#include "StreamBuffer.hpp"
+#include "../glwrappers/GLState.hpp"
+
+#include <iostream>
+
+const GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+StreamBuffer::StreamBuffer() :
+    m_regionSize(0),
+    m_regionCount(0),
+    m_region(-1),
+    m_mapped(nullptr)
+{}
+
+StreamBuffer::~StreamBuffer()
+{
+    // the mapping goes away with the buffer
+    for ( size_t i = 0; i < m_fences.size(); ++i )
+        if ( m_fences[i] != 0 )
+            glDeleteSync(m_fences[i]);
+}
+
+bool StreamBuffer::isPersistentSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+bool StreamBuffer::init(GLsizeiptr regionSize, int regionCount)
+{
+    if ( regionSize <= 0 || regionCount <= 0 || !m_buffer.generate(1) )
+        return false;
+
+    m_regionSize = regionSize;
+    m_regionCount = regionCount;
+    m_region = -1;
+    m_fences.assign(regionCount, 0);
+    m_mapped = nullptr;
+
+    const GLsizeiptr size = regionSize * regionCount;
+    if ( StreamBuffer::isPersistentSupported() && m_buffer.setStorage(size, PERSISTENT_FLAGS) )
+        m_mapped = static_cast<char*>(m_buffer.mapRange(0, size, PERSISTENT_FLAGS));
+    if ( m_mapped != nullptr )
+        return true;
+
+    // write a copy and upload it
+    if ( !m_buffer.generate(1) || !m_buffer.setEmpty(size, GL_STREAM_DRAW) )
+        return false;
+    m_staging.resize(regionSize);
+    return true;
+}
+
+void* StreamBuffer::map()
+{
+    if ( m_regionCount == 0 )
+        return nullptr;
+
+    // everything reading the last region has been issued
+    if ( m_region >= 0 )
+        m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_region = (m_region + 1) % m_regionCount;
+    this->waitRegion(m_region);
+
+    if ( m_mapped != nullptr )
+        return m_mapped + m_region * m_regionSize;
+    return &m_staging[0];
+}
+
+GLintptr StreamBuffer::unmap(GLsizeiptr bytes)
+{
+    const GLintptr offset = m_region * m_regionSize;
+    if ( m_mapped == nullptr && bytes > 0 )
+        m_buffer.setSubData(&m_staging[0], offset, bytes);
+    return offset;
+}
+
+GLsizeiptr StreamBuffer::getRegionSize() const
+{
+    return m_regionSize;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+    return m_mapped != nullptr;
+}
+
+GLuint StreamBuffer::getBufferIdx()
+{
+    return m_buffer.getBufferIdx();
+}
+
+void StreamBuffer::waitRegion(int region)
+{
+    GLsync fence = m_fences[region];
+    if ( fence == 0 )
+        return;
+    m_fences[region] = 0;
+
+    if ( !GLState::waitFence(fence) )
+        std::cout << "Warning: Stream buffer fence wait failed" << std::endl;
+}
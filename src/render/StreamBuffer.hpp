@@ -0,0 +1,64 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+#include "../glwrappers/GLBuffer.hpp"
+
+#include <GL/glew.h>
+#include <vector>
+
+// regions the GPU may still be reading while the next one is written
+const int STREAM_REGIONS = 3;
+
+// Ring of regions in one buffer for data that is rewritten every frame.
+// With OpenGL 4.4 (or ARB_buffer_storage) the buffer is mapped once,
+// persistently and coherently, and written in place. Otherwise map hands out
+// a CPU copy that unmap sends with glBufferSubData.
+//
+//   GLfloat* lines = static_cast<GLfloat*>(stream.map());
+//   ...                                  // at most getRegionSize() bytes
+//   GLintptr offset = stream.unmap(bytes);
+//   ...                                  // draw from offset
+//
+// A region is fenced when the next one is mapped, so everything reading it
+// must have been issued by then. Mapping a region the GPU hasn't finished
+// with waits.
+class StreamBuffer
+{
+public:
+    StreamBuffer();
+
+    // deletes the fences, call with the context current
+    ~StreamBuffer();
+
+    // true if the buffer can be mapped persistently
+    static bool isPersistentSupported();
+
+    // regionSize in bytes
+    bool init(GLsizeiptr regionSize, int regionCount = STREAM_REGIONS);
+
+    // the next region to write
+    void* map();
+
+    // done writing bytes of the region, returns its offset in the buffer
+    GLintptr unmap(GLsizeiptr bytes);
+
+    GLsizeiptr getRegionSize() const;
+    bool isPersistent() const;
+    GLuint getBufferIdx();
+protected:
+    // block until the GPU is done with region
+    void waitRegion(int region);
+
+    GLBuffer             m_buffer;
+    GLsizeiptr           m_regionSize;
+    int                  m_regionCount;
+    int                  m_region;      // last mapped, -1 before the first
+    std::vector<GLsync>  m_fences;      // per region, 0 if not in flight
+
+    // the whole buffer when persistently mapped, otherwise the region is
+    // written to m_staging
+    char*                m_mapped;
+    std::vector<char>    m_staging;
+};
+
+#endif // STREAMBUFFER_HPP
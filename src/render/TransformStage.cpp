@@ -0,0 +1,220 @@
+#include "TransformStage.hpp"
+#include "../glwrappers/GLState.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// how far the squared column lengths may drift apart and still count as a
+// single scale
+const float UNIFORM_SCALE_EPSILON = 1e-4f;
+
+TransformStage::TransformStage() :
+    m_lanes(0),
+    m_stride(0),
+    m_viewCount(0),
+    m_uploadedSize(0)
+{}
+
+void TransformStage::clear()
+{
+    m_modelMatrices.clear();
+    m_uniformScale.clear();
+}
+
+size_t TransformStage::add(const glm::mat4& modelMatrix)
+{
+    m_modelMatrices.push_back(modelMatrix);
+    m_uniformScale.push_back(isUniformScale(modelMatrix));
+    return m_modelMatrices.size() - 1;
+}
+
+void TransformStage::compute(const glm::mat4& projectionMatrix, const glm::mat4* viewMatrices, size_t viewCount)
+{
+    // each block must start on a multiple of the offset alignment to be bound
+    // with bindRange
+    if ( m_stride == 0 )
+        m_stride = GLState::getUniformBlockStride(sizeof(MatricesBlock));
+
+    const size_t count = m_modelMatrices.size();
+    m_lanes = (count + 3) / 4 * 4;
+    m_viewCount = viewCount;
+    m_image.resize(viewCount * m_lanes * m_stride / sizeof(glm::vec4));
+
+    // SoA, the padding lanes hold identity matrices
+    m_lanesData.assign(16 * m_lanes, 0.0f);
+    for ( size_t e = 0; e < 16; e += 5 )
+        std::fill(m_lanesData.begin() + e * m_lanes + count, m_lanesData.begin() + (e + 1) * m_lanes, 1.0f);
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const float* m = &m_modelMatrices[i][0][0];
+        for ( size_t e = 0; e < 16; ++e )
+            m_lanesData[e * m_lanes + i] = m[e];
+    }
+
+    for ( size_t view = 0; view < viewCount; ++view )
+    {
+        const glm::mat4 viewProjection = projectionMatrix * viewMatrices[view];
+        const bool uniformView = isUniformScale(viewMatrices[view]);
+        for ( size_t first = 0; first < count; first += 4 )
+            this->computeLanes(view, first, viewMatrices[view], viewProjection, uniformView);
+
+        // uneven scale needs the real inverse
+        for ( size_t i = 0; i < count; ++i )
+        {
+            if ( uniformView && m_uniformScale[i] )
+                continue;
+            MatricesBlock& block = this->getBlock(view, i);
+            block.normalMatrix = glm::transpose(glm::inverse(block.mvMatrix));
+        }
+    }
+}
+
+void TransformStage::computeLanes(size_t view, size_t first, const glm::mat4& viewMatrix,
+                                  const glm::mat4& viewProjection, bool uniformView)
+{
+#ifdef __SSE__
+    const float* lanes = &m_lanesData[first];
+
+    // a = b * model for four models, b is the same for every lane
+    // a[c][r] = b[0][r]*m[c][0] + b[1][r]*m[c][1] + b[2][r]*m[c][2] + b[3][r]*m[c][3]
+    __m128 mv[16];
+    __m128 mvp[16];
+    for ( int c = 0; c < 4; ++c )
+    {
+        const __m128 m0 = _mm_loadu_ps(lanes + (c * 4 + 0) * m_lanes);
+        const __m128 m1 = _mm_loadu_ps(lanes + (c * 4 + 1) * m_lanes);
+        const __m128 m2 = _mm_loadu_ps(lanes + (c * 4 + 2) * m_lanes);
+        const __m128 m3 = _mm_loadu_ps(lanes + (c * 4 + 3) * m_lanes);
+        for ( int r = 0; r < 4; ++r )
+        {
+            mv[c * 4 + r] = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMatrix[0][r]), m0), _mm_mul_ps(_mm_set1_ps(viewMatrix[1][r]), m1)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMatrix[2][r]), m2), _mm_mul_ps(_mm_set1_ps(viewMatrix[3][r]), m3)));
+            mvp[c * 4 + r] = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewProjection[0][r]), m0), _mm_mul_ps(_mm_set1_ps(viewProjection[1][r]), m1)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewProjection[2][r]), m2), _mm_mul_ps(_mm_set1_ps(viewProjection[3][r]), m3)));
+        }
+    }
+
+    // with a single scale s, transpose(inverse(mv)) is the upper 3x3 over s^2
+    // and the bottom row -transpose(upper 3x3) * translation over s^2
+    __m128 normal[16];
+    if ( uniformView )
+    {
+        const __m128 s2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[0], mv[0]), _mm_mul_ps(mv[1], mv[1])),
+                                     _mm_mul_ps(mv[2], mv[2]));
+        const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), s2);
+        const __m128 negInv = _mm_sub_ps(_mm_setzero_ps(), inv);
+        for ( int c = 0; c < 3; ++c )
+        {
+            normal[c * 4 + 0] = _mm_mul_ps(mv[c * 4 + 0], inv);
+            normal[c * 4 + 1] = _mm_mul_ps(mv[c * 4 + 1], inv);
+            normal[c * 4 + 2] = _mm_mul_ps(mv[c * 4 + 2], inv);
+            const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[c * 4 + 0], mv[12]), _mm_mul_ps(mv[c * 4 + 1], mv[13])),
+                                          _mm_mul_ps(mv[c * 4 + 2], mv[14]));
+            normal[c * 4 + 3] = _mm_mul_ps(dot, negInv);
+        }
+        normal[12] = normal[13] = normal[14] = _mm_setzero_ps();
+        normal[15] = _mm_set1_ps(1.0f);
+    }
+
+    // back to one matrix per object, a 4x4 transpose turns element (c, r) of
+    // four objects into column c of each
+    MatricesBlock* blocks[4];
+    for ( int lane = 0; lane < 4; ++lane )
+        blocks[lane] = &this->getBlock(view, first + lane);
+
+    __m128* sources[] = {mvp, mv, normal};
+    const int matrixCount = uniformView ? 3 : 2;
+    for ( int matrix = 0; matrix < matrixCount; ++matrix )
+    {
+        for ( int c = 0; c < 4; ++c )
+        {
+            __m128 r0 = sources[matrix][c * 4 + 0];
+            __m128 r1 = sources[matrix][c * 4 + 1];
+            __m128 r2 = sources[matrix][c * 4 + 2];
+            __m128 r3 = sources[matrix][c * 4 + 3];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            const __m128 columns[] = {r0, r1, r2, r3};
+            for ( int lane = 0; lane < 4; ++lane )
+            {
+                glm::mat4& target = matrix == 0 ? blocks[lane]->mvpMatrix :
+                                    matrix == 1 ? blocks[lane]->mvMatrix : blocks[lane]->normalMatrix;
+                _mm_storeu_ps(&target[c][0], columns[lane]);
+            }
+        }
+    }
+#else
+    for ( size_t i = first; i < first + 4; ++i )
+    {
+        glm::mat4 model;
+        for ( size_t e = 0; e < 16; ++e )
+            (&model[0][0])[e] = m_lanesData[e * m_lanes + i];
+
+        MatricesBlock& block = this->getBlock(view, i);
+        block.mvMatrix = viewMatrix * model;
+        block.mvpMatrix = viewProjection * model;
+        if ( !uniformView )
+            continue;
+
+        // with a single scale s, transpose(inverse(mv)) is the upper 3x3 over
+        // s^2 and the bottom row -transpose(upper 3x3) * translation over s^2
+        const glm::mat4& mv = block.mvMatrix;
+        const float inv = 1.0f / glm::dot(mv[0].xyz(), mv[0].xyz());
+        for ( int c = 0; c < 3; ++c )
+            block.normalMatrix[c] = glm::vec4(mv[c].xyz() * inv, -glm::dot(mv[c].xyz(), mv[3].xyz()) * inv);
+        block.normalMatrix[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+#endif
+}
+
+void TransformStage::upload(GLBuffer& buffer, int bufferIdx)
+{
+    if ( m_image.empty() )
+        return;
+
+    if ( m_uploadedSize != m_image.size() )
+        buffer.setData(m_image.data(), m_image.size(), GL_DYNAMIC_DRAW, bufferIdx);
+    else
+        buffer.setSubData(m_image.data(), 0, m_image.size(), bufferIdx);
+    m_uploadedSize = m_image.size();
+}
+
+void TransformStage::bind(GLBuffer& buffer, int bufferIdx, size_t view, size_t object, GLuint bindingPoint) const
+{
+    if ( view < m_viewCount && object < m_modelMatrices.size() )
+        buffer.bindRange(bindingPoint, (view * m_lanes + object) * m_stride, sizeof(MatricesBlock), bufferIdx);
+}
+
+const MatricesBlock& TransformStage::getMatrices(size_t view, size_t object) const
+{
+    return *reinterpret_cast<const MatricesBlock*>(reinterpret_cast<const char*>(m_image.data()) +
+                                                   (view * m_lanes + object) * m_stride);
+}
+
+bool TransformStage::isUniformScale(const glm::mat4& matrix)
+{
+    if ( matrix[0][3] != 0.0f || matrix[1][3] != 0.0f || matrix[2][3] != 0.0f || matrix[3][3] != 1.0f )
+        return false;
+
+    const glm::vec3 c0 = matrix[0].xyz();
+    const glm::vec3 c1 = matrix[1].xyz();
+    const glm::vec3 c2 = matrix[2].xyz();
+    const float s2 = glm::dot(c0, c0);
+    const float epsilon = UNIFORM_SCALE_EPSILON * s2;
+    return s2 > 0.0f &&
+           std::abs(glm::dot(c1, c1) - s2) <= epsilon &&
+           std::abs(glm::dot(c2, c2) - s2) <= epsilon &&
+           std::abs(glm::dot(c0, c1)) <= epsilon &&
+           std::abs(glm::dot(c0, c2)) <= epsilon &&
+           std::abs(glm::dot(c1, c2)) <= epsilon;
+}
+
+MatricesBlock& TransformStage::getBlock(size_t view, size_t object)
+{
+    return *reinterpret_cast<MatricesBlock*>(reinterpret_cast<char*>(m_image.data()) + (view * m_lanes + object) * m_stride);
+}
@@ -0,0 +1,73 @@
+#ifndef TRANSFORMSTAGE_HPP
+#define TRANSFORMSTAGE_HPP
+
+#include "../glwrappers/GLBuffer.hpp"
+#include "../interfaces/iGLRenderable.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Computes the Matrices block of every object for every view once per frame,
+// after the physics sync, instead of once per draw.
+//
+//   transforms.clear();
+//   size_t idx = transforms.add(target.getModelMatrix());   // for every object
+//   transforms.compute(projectionMatrix, viewMatrices, viewCount);
+//   transforms.upload(buffer);
+//   ...
+//   transforms.bind(buffer, 0, view, idx, UB_MATRICES);     // before each draw
+//
+// The model matrices are transposed into SoA order (one array per matrix
+// element) and four objects go through the SSE kernel at a time. The normal
+// matrix only needs a division when the model and view matrices don't scale
+// unevenly, others get the full inverse. The blocks are written straight into
+// the image that is uploaded, padded so each one can be bound with bindRange.
+class TransformStage
+{
+public:
+    TransformStage();
+
+    // forget the objects of the last frame
+    void clear();
+
+    // add an object, returns its index
+    size_t add(const glm::mat4& modelMatrix);
+
+    // the blocks of every object for each view
+    void compute(const glm::mat4& projectionMatrix, const glm::mat4* viewMatrices, size_t viewCount);
+
+    // send every block at once
+    void upload(GLBuffer& buffer, int bufferIdx = 0);
+
+    // bind the block of object in view (after upload)
+    void bind(GLBuffer& buffer, int bufferIdx, size_t view, size_t object, GLuint bindingPoint) const;
+
+    const MatricesBlock& getMatrices(size_t view, size_t object) const;
+
+    // true if the upper 3x3 of matrix is a rotation times a single scale and
+    // the bottom row is (0, 0, 0, 1)
+    static bool isUniformScale(const glm::mat4& matrix);
+protected:
+    // objects of a view [first, first + 4)
+    void computeLanes(size_t view, size_t first, const glm::mat4& viewMatrix, const glm::mat4& viewProjection,
+                      bool uniformView);
+
+    MatricesBlock& getBlock(size_t view, size_t object);
+
+    std::vector<glm::mat4> m_modelMatrices;
+    std::vector<bool>      m_uniformScale;
+
+    // element e (column * 4 + row) of object i at e * m_lanes + i, padded to a
+    // multiple of 4 objects
+    std::vector<float>     m_lanesData;
+    size_t                 m_lanes;
+
+    // view major, m_stride bytes per block
+    std::vector<glm::vec4> m_image;
+    size_t                 m_stride;
+    size_t                 m_viewCount;
+    size_t                 m_uploadedSize;
+};
+
+#endif // TRANSFORMSTAGE_HPP
@@ -0,0 +1,122 @@
+#include "HeadlessReplay.hpp"
+
+#include "../bulletwrappers/TransformBuffer.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+HeadlessReplay::HeadlessReplay() :
+    m_tickCount(0),
+    m_firstMismatch(0),
+    m_mismatchCount(0),
+    m_seconds(0.0),
+    m_simulatedSeconds(0.0),
+    m_sameBuild(true),
+    m_err("")
+{}
+
+bool HeadlessReplay::run(const Recording& recording)
+{
+    m_tickCount = m_firstMismatch = m_mismatchCount = 0;
+    m_seconds = m_simulatedSeconds = 0.0;
+    m_sameBuild = recording.getBuildConfig() == Recording::currentBuildConfig();
+
+    PhysicsWorld world;
+    world.init(recording.getBackend(), recording.getThreads());
+
+    // the bodies go in in the order they were recorded, bullet's results
+    // depend on it
+    std::vector<std::shared_ptr<StaticMesh>> meshes;
+    for ( size_t i = 0; i < recording.getStaticMeshes().size(); ++i )
+    {
+        const StaticMesh::InitialParams& params = recording.getStaticMeshes()[i];
+        std::shared_ptr<StaticMesh> mesh(new StaticMesh);
+        if ( !mesh->initPhysics(world, params) )
+        {
+            m_err = "Unable to load \"" + params.filename + "\"";
+            return false;
+        }
+        meshes.push_back(mesh);
+    }
+
+    std::vector<std::shared_ptr<DynamicCylinder>> cylinders;
+    for ( size_t i = 0; i < recording.getCylinders().size(); ++i )
+    {
+        std::shared_ptr<DynamicCylinder> cylinder(new DynamicCylinder);
+        if ( !cylinder->initPhysics(world, recording.getCylinders()[i]) )
+        {
+            m_err = "Unable to create a recorded cylinder";
+            return false;
+        }
+        cylinders.push_back(cylinder);
+    }
+
+    // nobody reads the matrices, only keep the dirty list from growing
+    TransformBuffer& transformBuffer = *world.getTransformBuffer();
+
+    m_tickCount = recording.getTickCount();
+    m_firstMismatch = m_tickCount;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( size_t i = 0; i < m_tickCount; ++i )
+    {
+        const Recording::Tick& tick = recording.getTick(i);
+        world.tick(tick.dt);
+        transformBuffer.clearDirty();
+        m_simulatedSeconds += tick.dt;
+
+        if ( world.getStateHash() != tick.stateHash )
+        {
+            if ( m_mismatchCount == 0 )
+                m_firstMismatch = i;
+            ++m_mismatchCount;
+        }
+    }
+    m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return true;
+}
+
+size_t HeadlessReplay::getTickCount() const
+{
+    return m_tickCount;
+}
+
+double HeadlessReplay::getSeconds() const
+{
+    return m_seconds;
+}
+
+size_t HeadlessReplay::getFirstMismatch() const
+{
+    return m_firstMismatch;
+}
+
+bool HeadlessReplay::matched() const
+{
+    return m_mismatchCount == 0;
+}
+
+void HeadlessReplay::printReport(std::ostream& out) const
+{
+    out << "Replayed " << m_tickCount << " ticks (" << m_simulatedSeconds << " s of play) in "
+        << m_seconds * 1000.0 << " ms";
+    if ( m_tickCount > 0 && m_seconds > 0.0 )
+        out << ", " << m_seconds * 1.0e6 / m_tickCount << " us/tick, " << m_tickCount / m_seconds << " ticks/s";
+    out << std::endl;
+
+    if ( m_mismatchCount == 0 )
+        out << "Every state hash matched" << std::endl;
+    else
+        out << m_mismatchCount << " state hashes differ, diverged at tick " << m_firstMismatch << std::endl;
+
+    // a different compiler or flags is allowed to round differently
+    if ( !m_sameBuild )
+        out << "Warning: Recorded by a different build, hashes need not match" << std::endl;
+}
+
+const std::string& HeadlessReplay::getLastError() const
+{
+    return m_err;
+}
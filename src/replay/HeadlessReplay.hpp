@@ -0,0 +1,53 @@
+#ifndef HEADLESSREPLAY_HPP
+#define HEADLESSREPLAY_HPP
+
+#include "Recording.hpp"
+
+#include <iostream>
+#include <string>
+
+// Runs a Recording against a PhysicsWorld without a window: the scene of
+// the recording is built from its physics parameters and every recorded
+// tick is stepped back to back as fast as possible. Only physics runs, the
+// input of the ticks only ever moved the cameras.
+//
+// The state hash after each tick is compared with the recorded one, the
+// first tick that differs is where the runs diverged. The time spent
+// stepping is the benchmark, building the scene isn't counted.
+//
+// example:
+//   HeadlessReplay replay;
+//   if ( !replay.run(recording) )
+//       std::cout << replay.getLastError() << std::endl;
+//   replay.printReport();
+class HeadlessReplay
+{
+public:
+    HeadlessReplay();
+
+    // false if the scene can't be built, diverging isn't an error
+    bool run(const Recording& recording);
+
+    // ticks stepped and the seconds they took
+    size_t getTickCount() const;
+    double getSeconds() const;
+
+    // index of the first tick whose hash differs, getTickCount() if none
+    size_t getFirstMismatch() const;
+    bool matched() const;
+
+    void printReport(std::ostream& out = std::cout) const;
+
+    const std::string& getLastError() const;
+protected:
+    size_t      m_tickCount;
+    size_t      m_firstMismatch;
+    size_t      m_mismatchCount;
+    double      m_seconds;
+    double      m_simulatedSeconds;
+    bool        m_sameBuild;
+
+    std::string m_err;
+};
+
+#endif // HEADLESSREPLAY_HPP
@@ -0,0 +1,349 @@
+#include "Recording.hpp"
+
+#include <bullet/LinearMath/btScalar.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+const char     RECORDING_MAGIC[4] = {'A', 'H', 'R', 'C'};
+const uint32_t RECORDING_VERSION = 2;
+
+// plain values in the machine's byte order
+template <typename T>
+static void writeValue(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool readValue(std::istream& in, T& value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+static void writeString(std::ostream& out, const std::string& str)
+{
+    writeValue(out, static_cast<uint32_t>(str.size()));
+    out.write(str.data(), str.size());
+}
+
+static bool readString(std::istream& in, std::string& str)
+{
+    uint32_t size;
+    if ( !readValue(in, size) )
+        return false;
+    str.resize(size);
+    return size == 0 || static_cast<bool>(in.read(&str[0], size));
+}
+
+// bullet vectors as floats whatever btScalar is
+static void writeVector(std::ostream& out, const btVector3& vector)
+{
+    for ( int i = 0; i < 3; ++i )
+        writeValue(out, static_cast<float>(vector[i]));
+}
+
+static bool readVector(std::istream& in, btVector3& vector)
+{
+    float values[3];
+    for ( int i = 0; i < 3; ++i )
+        if ( !readValue(in, values[i]) )
+            return false;
+    vector.setValue(values[0], values[1], values[2]);
+    return true;
+}
+
+static void writeQuaternion(std::ostream& out, const btQuaternion& quaternion)
+{
+    writeValue(out, static_cast<float>(quaternion.x()));
+    writeValue(out, static_cast<float>(quaternion.y()));
+    writeValue(out, static_cast<float>(quaternion.z()));
+    writeValue(out, static_cast<float>(quaternion.w()));
+}
+
+static bool readQuaternion(std::istream& in, btQuaternion& quaternion)
+{
+    float values[4];
+    for ( int i = 0; i < 4; ++i )
+        if ( !readValue(in, values[i]) )
+            return false;
+    quaternion.setValue(values[0], values[1], values[2], values[3]);
+    return true;
+}
+
+static void writeScalar(std::ostream& out, btScalar value)
+{
+    writeValue(out, static_cast<float>(value));
+}
+
+static bool readScalar(std::istream& in, btScalar& value)
+{
+    float stored;
+    if ( !readValue(in, stored) )
+        return false;
+    value = stored;
+    return true;
+}
+
+Recording::Recording() :
+    m_backend(PhysicsWorld::BULLET_BACKEND),
+    m_threads(1),
+    m_buildConfig(Recording::currentBuildConfig()),
+    m_err("")
+{}
+
+void Recording::setConfig(PhysicsWorld::Backend backend, unsigned int threads)
+{
+    m_backend = static_cast<uint8_t>(backend);
+    m_threads = threads;
+}
+
+PhysicsWorld::Backend Recording::getBackend() const
+{
+    return static_cast<PhysicsWorld::Backend>(m_backend);
+}
+
+unsigned int Recording::getThreads() const
+{
+    return m_threads;
+}
+
+const std::string& Recording::getBuildConfig() const
+{
+    return m_buildConfig;
+}
+
+std::string Recording::currentBuildConfig()
+{
+    std::ostringstream sout;
+#ifdef __VERSION__
+    sout << "compiler " << __VERSION__ << ", ";
+#endif
+    sout << "bullet " << BT_BULLET_VERSION;
+#ifdef BT_USE_DOUBLE_PRECISION
+    sout << " double";
+#endif
+#ifdef __SSE2__
+    sout << ", sse2";
+#endif
+#ifdef PHYSICS_DEBUG
+    sout << ", PHYSICS_DEBUG";
+#endif
+#ifdef GRAPHICS_DEBUG
+    sout << ", GRAPHICS_DEBUG";
+#endif
+#ifdef NORMALS_DEBUG
+    sout << ", NORMALS_DEBUG";
+#endif
+#ifdef MESSAGES_DEBUG
+    sout << ", MESSAGES_DEBUG";
+#endif
+#ifdef MEMORY_DEBUG
+    sout << ", MEMORY_DEBUG";
+#endif
+#ifdef GLSTATE_DEBUG
+    sout << ", GLSTATE_DEBUG";
+#endif
+    return sout.str();
+}
+
+void Recording::addStaticMesh(const StaticMesh::InitialParams& params)
+{
+    m_staticMeshes.push_back(params);
+}
+
+void Recording::addCylinder(const DynamicCylinder::InitialParams& params)
+{
+    m_cylinders.push_back(params);
+}
+
+const std::vector<StaticMesh::InitialParams>& Recording::getStaticMeshes() const
+{
+    return m_staticMeshes;
+}
+
+const std::vector<DynamicCylinder::InitialParams>& Recording::getCylinders() const
+{
+    return m_cylinders;
+}
+
+void Recording::addTick(double dt, const std::vector<Event>& events, uint64_t stateHash)
+{
+    Tick tick;
+    tick.dt = dt;
+    tick.stateHash = stateHash;
+    tick.firstEvent = m_events.size();
+    tick.eventCount = events.size();
+    m_ticks.push_back(tick);
+    m_events.insert(m_events.end(), events.begin(), events.end());
+}
+
+size_t Recording::getTickCount() const
+{
+    return m_ticks.size();
+}
+
+const Recording::Tick& Recording::getTick(size_t idx) const
+{
+    return m_ticks[idx];
+}
+
+const Recording::Event& Recording::getEvent(size_t idx) const
+{
+    return m_events[idx];
+}
+
+bool Recording::save(const std::string& filename)
+{
+    std::ofstream fout(filename, std::ios::binary);
+    if ( !fout.good() )
+    {
+        m_err = "Unable to open file \"" + filename + "\"";
+        return false;
+    }
+
+    fout.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    writeValue(fout, RECORDING_VERSION);
+    writeValue(fout, m_backend);
+    writeValue(fout, m_threads);
+    writeString(fout, m_buildConfig);
+
+    writeValue(fout, static_cast<uint32_t>(m_staticMeshes.size()));
+    for ( size_t i = 0; i < m_staticMeshes.size(); ++i )
+    {
+        const StaticMesh::InitialParams& params = m_staticMeshes[i];
+        writeString(fout, params.filename);
+        writeVector(fout, params.position);
+        writeVector(fout, params.scale);
+        writeQuaternion(fout, params.rotation);
+        writeScalar(fout, params.friction);
+        writeScalar(fout, params.restitution);
+    }
+
+    writeValue(fout, static_cast<uint32_t>(m_cylinders.size()));
+    for ( size_t i = 0; i < m_cylinders.size(); ++i )
+    {
+        const DynamicCylinder::InitialParams& params = m_cylinders[i];
+        writeScalar(fout, params.radius);
+        writeScalar(fout, params.height);
+        writeScalar(fout, params.density);
+        writeScalar(fout, params.friction);
+        writeScalar(fout, params.restitution);
+        writeVector(fout, params.initialPosition);
+        writeQuaternion(fout, params.initialRotation);
+        writeValue(fout, static_cast<uint8_t>(params.planar));
+    }
+
+    // a tick is 20 bytes and 13 more per event, most ticks have none
+    writeValue(fout, static_cast<uint32_t>(m_ticks.size()));
+    for ( size_t i = 0; i < m_ticks.size(); ++i )
+    {
+        const Tick& tick = m_ticks[i];
+        writeValue(fout, tick.dt);
+        writeValue(fout, tick.stateHash);
+        writeValue(fout, tick.eventCount);
+        for ( uint32_t j = 0; j < tick.eventCount; ++j )
+        {
+            const Event& event = m_events[tick.firstEvent + j];
+            writeValue(fout, event.type);
+            writeValue(fout, event.key);
+            writeValue(fout, event.dx);
+            writeValue(fout, event.dy);
+        }
+    }
+
+    if ( !fout.good() )
+    {
+        m_err = "Unable to write file \"" + filename + "\"";
+        return false;
+    }
+    return true;
+}
+
+bool Recording::load(const std::string& filename)
+{
+    std::ifstream fin(filename, std::ios::binary);
+    if ( !fin.good() )
+    {
+        m_err = "Unable to open file \"" + filename + "\"";
+        return false;
+    }
+
+    char magic[sizeof(RECORDING_MAGIC)];
+    uint32_t version;
+    if ( !fin.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), RECORDING_MAGIC) ||
+         !readValue(fin, version) || version != RECORDING_VERSION )
+    {
+        m_err = "\"" + filename + "\" is not a recording of this version";
+        return false;
+    }
+
+    m_staticMeshes.clear();
+    m_cylinders.clear();
+    m_ticks.clear();
+    m_events.clear();
+
+    bool good = readValue(fin, m_backend) && readValue(fin, m_threads) && readString(fin, m_buildConfig);
+
+    uint32_t count = 0;
+    good = good && readValue(fin, count);
+    for ( uint32_t i = 0; good && i < count; ++i )
+    {
+        StaticMesh::InitialParams params;
+        good = readString(fin, params.filename) &&
+               readVector(fin, params.position) &&
+               readVector(fin, params.scale) &&
+               readQuaternion(fin, params.rotation) &&
+               readScalar(fin, params.friction) &&
+               readScalar(fin, params.restitution);
+        m_staticMeshes.push_back(params);
+    }
+
+    good = good && readValue(fin, count);
+    for ( uint32_t i = 0; good && i < count; ++i )
+    {
+        DynamicCylinder::InitialParams params;
+        uint8_t planar = 0;
+        good = readScalar(fin, params.radius) &&
+               readScalar(fin, params.height) &&
+               readScalar(fin, params.density) &&
+               readScalar(fin, params.friction) &&
+               readScalar(fin, params.restitution) &&
+               readVector(fin, params.initialPosition) &&
+               readQuaternion(fin, params.initialRotation) &&
+               readValue(fin, planar);
+        params.planar = planar != 0;
+        m_cylinders.push_back(params);
+    }
+
+    good = good && readValue(fin, count);
+    for ( uint32_t i = 0; good && i < count; ++i )
+    {
+        Tick tick;
+        uint32_t eventCount = 0;
+        good = readValue(fin, tick.dt) && readValue(fin, tick.stateHash) && readValue(fin, eventCount);
+        tick.firstEvent = m_events.size();
+        tick.eventCount = eventCount;
+        for ( uint32_t j = 0; good && j < eventCount; ++j )
+        {
+            Event event;
+            good = readValue(fin, event.type) && readValue(fin, event.key) &&
+                   readValue(fin, event.dx) && readValue(fin, event.dy);
+            m_events.push_back(event);
+        }
+        m_ticks.push_back(tick);
+    }
+
+    if ( !good )
+    {
+        m_err = "\"" + filename + "\" is truncated";
+        return false;
+    }
+    return true;
+}
+
+const std::string& Recording::getLastError() const
+{
+    return m_err;
+}
@@ -0,0 +1,88 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include "../bulletwrappers/PhysicsWorld.hpp"
+#include "../shapes/bullet/DynamicCylinder.hpp"
+#include "../shapes/bullet/StaticMesh.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One session of the game as a compact binary file: the physics scene, the
+// configuration it ran with and for every tick its time step, the input
+// applied before it and a hash of the physics state after it.
+//
+// The frame times drive the simulation, so replaying the same ticks on the
+// same build gives the same hashes. A hash that differs is the tick the
+// runs diverged. Files are in the byte order of the machine that wrote them.
+//
+// example:
+//   Recording recording;
+//   recording.setConfig(backend, threads);
+//   recording.addCylinder(puck.getPhysicsParams());
+//   recording.addTick(dt, events, hash);          // every tick
+//   if ( !recording.save("match.rec") )
+//       std::cout << recording.getLastError() << std::endl;
+class Recording
+{
+public:
+    // an InputEvent without the window events and the arrival time
+    struct Event
+    {
+        uint8_t type;       // InputEvent::Type
+        int32_t key;
+        float   dx;
+        float   dy;
+    };
+
+    struct Tick
+    {
+        double   dt;
+        uint64_t stateHash;     // PhysicsWorld::getStateHash after the tick
+        uint32_t firstEvent;
+        uint32_t eventCount;
+    };
+
+    Recording();
+
+    void setConfig(PhysicsWorld::Backend backend, unsigned int threads);
+    PhysicsWorld::Backend getBackend() const;
+    unsigned int getThreads() const;
+
+    // compiler, bullet and debug flags of the build that recorded
+    const std::string& getBuildConfig() const;
+
+    // the same for this build
+    static std::string currentBuildConfig();
+
+    // the bodies of the scene as they were created
+    void addStaticMesh(const StaticMesh::InitialParams& params);
+    void addCylinder(const DynamicCylinder::InitialParams& params);
+    const std::vector<StaticMesh::InitialParams>& getStaticMeshes() const;
+    const std::vector<DynamicCylinder::InitialParams>& getCylinders() const;
+
+    void addTick(double dt, const std::vector<Event>& events, uint64_t stateHash);
+    size_t getTickCount() const;
+    const Tick& getTick(size_t idx) const;
+    const Event& getEvent(size_t idx) const;
+
+    bool save(const std::string& filename);
+    bool load(const std::string& filename);
+
+    const std::string& getLastError() const;
+protected:
+    uint8_t                                     m_backend;
+    uint32_t                                    m_threads;
+    std::string                                 m_buildConfig;
+
+    std::vector<StaticMesh::InitialParams>      m_staticMeshes;
+    std::vector<DynamicCylinder::InitialParams> m_cylinders;
+
+    std::vector<Tick>                           m_ticks;
+    std::vector<Event>                          m_events;
+
+    std::string                                 m_err;
+};
+
+#endif // RECORDING_HPP
@@ -35,6 +35,9 @@ bool Puck::init(const PhysicsWorld& world, const glm::vec3& position, double rad
     btQuaternion q;
     q.setRotation(btVector3(0.0,0.0,1.0),0.0);
     params.initialRotation = q; 
+
+    // the puck slides on the table
+    params.planar = true;
     
     // update the model matrix (so origin of model is center bottom of puck)
     m_modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(fRadius, fRadius, fRadius)) * m_modelMatrix;
@@ -57,14 +60,8 @@ bool Puck::initPhysics(const PhysicsWorld& world, const InitialParams& params)
     if ( !DynamicCylinder::initPhysics(world, params) )
         return false;
 
-    // don't allow the puck to deactivate
-    m_rigidBody->setActivationState(DISABLE_DEACTIVATION);
-
-    // keep puck from moving in the Y direction at all
-    m_rigidBody->setLinearFactor(btVector3(1,0,1));
-
-    // puck can't rotation around x or z axis
-    m_rigidBody->setAngularFactor(btVector3(0,1,0));
+    // drawn as the model scaled around its center bottom
+    m_motionState->setLocalMatrix(m_centerScaleMatrix);
 
     return true;
 }
@@ -73,22 +70,7 @@ void Puck::updateTransform()
 {
     DynamicCylinder::updateTransform();
 
-    // transform model matrix using updated physics matrix
-    const btVector3 bAxis = m_transform.getRotation().getAxis();
-    const btVector3 bTranslation = m_transform.getOrigin();
-    GLfloat angle = static_cast<GLfloat>(m_transform.getRotation().getAngle());
-
-    const glm::vec3 translation(
-        static_cast<GLfloat>(bTranslation.x()),
-        static_cast<GLfloat>(bTranslation.y()),
-        static_cast<GLfloat>(bTranslation.z()));
-
-    const glm::vec3 axis(
-        static_cast<GLfloat>(bAxis.x()),
-        static_cast<GLfloat>(bAxis.y()),
-        static_cast<GLfloat>(bAxis.z()));
-
-    // encorporate translation and rotation of puck
-    m_modelMatrix = glm::translate(glm::mat4(1.0),translation) * glm::rotate(glm::mat4(1.0),static_cast<GLfloat>(180.0 * angle / M_PI),axis) * m_centerScaleMatrix;
+    // the motion state already put the center scale matrix behind the
+    // physics transform
+    m_modelMatrix = m_motionState->getMatrix();
 }
-
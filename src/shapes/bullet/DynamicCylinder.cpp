@@ -3,6 +3,16 @@
 #include <bullet/btBulletDynamicsCommon.h>
 #include <bullet/btBulletCollisionCommon.h>
 
+#include <algorithm>
+
+// continuous collision starts once a step moves the cylinder more than this
+// fraction of its radius
+const btScalar CCD_MOTION_FRACTION = 0.5;
+
+// the swept sphere is this fraction of the largest sphere inside the
+// cylinder, so it never touches what the cylinder rests on
+const btScalar CCD_SPHERE_FRACTION = 0.9;
+
 DynamicCylinder::DynamicCylinder()
 {}
 
@@ -17,7 +27,8 @@ DynamicCylinder::~DynamicCylinder()
 
 void DynamicCylinder::updateTransform()
 {
-    m_transform = m_rigidBody->getCenterOfMassTransform();
+    // what the motion state got from the last tick
+    m_motionState->getWorldTransform(m_transform);
 }
 
 bool DynamicCylinder::initPhysics(const PhysicsWorld& world, const InitialParams& params)
@@ -36,16 +47,28 @@ bool DynamicCylinder::initPhysics(const PhysicsWorld& world, const InitialParams
                     m_cylinderParams.radius)));
     m_collisionShape->calculateLocalInertia(m_mass, m_inertia);
     
-    // build motion state
+    // build motion state, it writes the transform into the world's buffer
     m_transform.setIdentity();
     m_transform.setOrigin(btVector3(0,0,0));
-    m_motionState = std::shared_ptr<btDefaultMotionState>(new btDefaultMotionState(m_transform));
+    m_motionState = std::shared_ptr<TransformMotionState>(new TransformMotionState(m_physicsWorld.getTransformBuffer(), this, m_transform));
     
     // finish construction of rigid body
     btRigidBody::btRigidBodyConstructionInfo constructionParams(m_mass, m_motionState.get(), m_collisionShape.get(), m_inertia);
     constructionParams.m_friction = m_cylinderParams.friction;
     constructionParams.m_restitution = m_cylinderParams.restitution;
     m_rigidBody = std::shared_ptr<btRigidBody>(new btRigidBody(constructionParams));
+
+    if ( m_cylinderParams.planar )
+    {
+        m_rigidBody->setActivationState(DISABLE_DEACTIVATION);
+        m_rigidBody->setLinearFactor(btVector3(1,0,1));
+        m_rigidBody->setAngularFactor(btVector3(0,1,0));
+    }
+
+    // fast shots are swept instead of tunneling through thin walls
+    m_rigidBody->setCcdMotionThreshold(m_cylinderParams.radius * CCD_MOTION_FRACTION);
+    m_rigidBody->setCcdSweptSphereRadius(
+            std::min(m_cylinderParams.radius, m_cylinderParams.height / 2) * CCD_SPHERE_FRACTION);
    
     // add body to world
     m_physicsWorld.addRigidBody(m_rigidBody.get());
@@ -55,10 +78,16 @@ bool DynamicCylinder::initPhysics(const PhysicsWorld& world, const InitialParams
     m_transform.setOrigin(m_cylinderParams.initialPosition);
     m_transform.setRotation(m_cylinderParams.initialRotation);
     m_rigidBody->setCenterOfMassTransform(m_transform);
+    m_motionState->setWorldTransform(m_transform);
     
     return true;
 }
 
+const DynamicCylinder::InitialParams& DynamicCylinder::getPhysicsParams() const
+{
+    return m_cylinderParams;
+}
+
 void DynamicCylinder::setVelocity(const glm::vec3 &velocity)
 {
     m_rigidBody->setLinearVelocity(btVector3(velocity.x, velocity.y, velocity.z));
@@ -3,13 +3,13 @@
 
 #include "../../interfaces/iPhysicsObject.hpp"
 #include "../../bulletwrappers/PhysicsWorld.hpp"
+#include "../../bulletwrappers/TransformMotionState.hpp"
 #include <bullet/LinearMath/btVector3.h>
 #include <bullet/LinearMath/btQuaternion.h>
 #include <bullet/LinearMath/btScalar.h>
 #include <bullet/LinearMath/btTransform.h>
 #include <glm/glm.hpp>
 
-class btDefaultMotionState;
 class btCollisionShape;
 class btRigidBody;
 class btGeneric6DofConstraint;
@@ -27,6 +27,10 @@ class DynamicCylinder : public iPhysicsObject
 
             btVector3 initialPosition;
             btQuaternion initialRotation;
+
+            // slides on the table: never sleeps, doesn't move along y and
+            // only spins about y
+            bool planar;
         };
 
         DynamicCylinder();
@@ -34,6 +38,7 @@ class DynamicCylinder : public iPhysicsObject
 
         virtual void updateTransform();
         bool initPhysics(const PhysicsWorld& world, const InitialParams& params);
+        const InitialParams& getPhysicsParams() const;
 
         // set the velocity of the cylinder (using glm vectors because most things in this program do)
         void setVelocity(const glm::vec3& velocity);
@@ -42,7 +47,7 @@ class DynamicCylinder : public iPhysicsObject
 
         PhysicsWorld m_physicsWorld;
         
-        std::shared_ptr<btDefaultMotionState>    m_motionState;
+        std::shared_ptr<TransformMotionState>    m_motionState;
         std::shared_ptr<btCollisionShape>        m_collisionShape;
         std::shared_ptr<btRigidBody>             m_rigidBody;
         std::shared_ptr<btGeneric6DofConstraint> m_constraint;
@@ -53,3 +53,7 @@ bool StaticMesh::initPhysics(const PhysicsWorld& world, const InitialParams& par
     return true;
 }
 
+const StaticMesh::InitialParams& StaticMesh::getPhysicsParams() const
+{
+    return m_meshParams;
+}
@@ -31,6 +31,7 @@ public:
 
     virtual void updateTransform();
     virtual bool initPhysics(const PhysicsWorld& world, const InitialParams& params);
+    const InitialParams& getPhysicsParams() const;
     void reset();
 protected:
     InitialParams m_meshParams;
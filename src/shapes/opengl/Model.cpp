@@ -1,5 +1,9 @@
 #include "Model.hpp"
 
+#include "../../memory/FrameArena.hpp"
+#include "../../render/IndirectRenderer.hpp"
+#include "../../render/MeshSimplifier.hpp"
+
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -17,6 +21,23 @@ const aiTextureType AI_TEXTURE_TYPES[] = {aiTextureType_DIFFUSE, aiTextureType_S
 const int TEXTURE_TYPE_COUNT = 1; // Just checking for DIFFUSE textures for now 
 //const int TEXTURE_TYPE_COUNT = sizeof(AI_TEXTURE_TYPES)/sizeof(aiTextureType);
 
+// detail levels built per mesh on top of the full one, each with about
+// LOD_RATIO of the triangles of the one before
+const size_t LOD_LEVELS = 3;
+const float LOD_RATIO = 0.5f;
+
+// meshes smaller than this aren't worth simplifying
+const size_t LOD_MIN_TRIANGLES = 256;
+
+// largest error a level may have, as a fraction of its mesh's bounding radius
+const float LOD_MAX_ERROR = 0.05f;
+
+// a level is drawn once its error covers at most this many pixels
+const float LOD_PIXEL_ERROR = 1.0f;
+
+// meshes whose sphere is closer than this are drawn at full detail
+const float LOD_MIN_DISTANCE = 0.01f;
+
 #ifdef MESSAGES_DEBUG
     #define DEBUG_MSG(a) a
 #else
@@ -63,16 +84,12 @@ void Model::loadMaterialTextures(int materialIdx, const aiMaterial& material)
         m_materials[materialIdx].drawType =
             static_cast<DrawType>(static_cast<unsigned int>(m_materials[materialIdx].drawType) | TEXTURE_DIFFUSE);
 
-        // activate texture 0 for the diffuse texture
-        glActiveTexture(GL_TEXTURE0);
-
         // create local path to texture
         bf::path texPath = m_modelDir / texImg.C_Str();
 
         // generate a texture (will be copied to array once sure it is valid)
         GLTexture tex2d;
-        tex2d.generate(1);
-        tex2d.bind(GL_TEXTURE_2D);
+        tex2d.generate(1, GL_TEXTURE_2D);
             
         // load the texture into opengl
         if ( !tex2d.loadImageData(texPath.c_str()) )
@@ -96,13 +113,17 @@ void Model::loadMaterialTextures(int materialIdx, const aiMaterial& material)
             // use textures
             m_materials[materialIdx].useTexture = true;
 
-            // generate mip maps to make rendering less intense
+            // generate mip maps to make rendering less intense, sampling is
+            // part of the texture object so it only has to be set once
             tex2d.generateMipMap(GL_TEXTURE_2D);
+            tex2d.setSampling(GL_TEXTURE_2D,
+                    GL_LINEAR_MIPMAP_LINEAR,
+                    GL_LINEAR,
+                    GL_MIRRORED_REPEAT,
+                    GL_MIRRORED_REPEAT);
             m_materials[materialIdx].texture = tex2d;
             m_materials[materialIdx].texTarget = GL_TEXTURE_2D;
         }
-       
-        tex2d.unbindTextures(GL_TEXTURE_2D);
     }
     else // no textures
     {
@@ -111,7 +132,7 @@ void Model::loadMaterialTextures(int materialIdx, const aiMaterial& material)
     DEBUG_MSG(std::cout << "FINAL TEXTURE TYPE : " << m_materials[materialIdx].drawType << std::endl);
 
     // reset active texture to default
-    glActiveTexture(GL_TEXTURE0);
+    GLTexture::setActiveUnit(GL_TEXTURE0);
 }
 
 void Model::loadMaterials(aiMaterial** materials, unsigned int numMaterials)
@@ -154,23 +175,31 @@ void Model::loadMaterials(aiMaterial** materials, unsigned int numMaterials)
         m_materials[i].emissive = glm::vec3(emissive.r, emissive.g, emissive.b);
         m_materials[i].transparent = glm::vec3(transparent.r, transparent.g, transparent.b);
 
+        MaterialBlock& block = m_materials[i].block;
+        block.diffuse = m_materials[i].diffuse;
+        block.specular = m_materials[i].specular;
+        block.ambient = m_materials[i].ambient;
+        block.shininess = m_materials[i].shininess;
+        block.texBlend = m_materials[i].texBlend;
+
         // set texture info
         this->loadMaterialTextures(i, material);
     }
 }
 
-void Model::loadVertices(const aiMesh& mesh, GLsizei bufferIdx, bool firstQuery)
+void Model::loadVertices(const aiMesh& mesh, GLsizei bufferIdx, GLsizei positionBufferIdx, bool firstQuery)
 {
     const aiVector3D* positions = mesh.mVertices;
     const aiVector3D* normals = mesh.mNormals;
     unsigned int numVertices = mesh.mNumVertices;
 
     // interleave the positions and normals
-    GLfloat *vertices = new GLfloat[numVertices*6];
+    ArenaScope scope(FrameArena::scratch());
+    GLfloat *vertices = FrameArena::scratch().allocate<GLfloat>(numVertices*6);
+    GLfloat *positionsOnly = FrameArena::scratch().allocate<GLfloat>(numVertices*3);
    
-    if ( firstQuery )
-        m_minVertex = m_maxVertex =
-            glm::vec3(positions[0].x, positions[0].y, positions[0].z);
+    if ( firstQuery && positions != nullptr )
+        this->updateBounds(glm::vec3(positions[0].x, positions[0].y, positions[0].z), true);
 
     // copy positions and normals into single, interleaved array
     for ( unsigned int i = 0; i < numVertices*6; i+=6 )
@@ -198,22 +227,125 @@ void Model::loadVertices(const aiMesh& mesh, GLsizei bufferIdx, bool firstQuery)
             vertices[i+5] = 1.0;
         }
 
+        // tightly packed copy for the depth pre-pass
+        positionsOnly[i/2]   = vertices[i];
+        positionsOnly[i/2+1] = vertices[i+1];
+        positionsOnly[i/2+2] = vertices[i+2];
+
         // while loading, determine bounding box
-        m_minVertex = glm::vec3(
-            std::min(vertices[i  ], m_minVertex.x),
-            std::min(vertices[i+1], m_minVertex.y),
-            std::min(vertices[i+2], m_minVertex.z));
-        m_maxVertex = glm::vec3(
-            std::max(vertices[i  ], m_maxVertex.x),
-            std::max(vertices[i+1], m_maxVertex.y),
-            std::max(vertices[i+2], m_maxVertex.z));
+        this->updateBounds(glm::vec3(vertices[i], vertices[i+1], vertices[i+2]), false);
     }
 
     // load vertices into an array buffer
-    m_vertexBuffer.bind(GL_ARRAY_BUFFER, bufferIdx);
-    m_vertexBuffer.setData<GLfloat>(vertices, numVertices*6, GL_STATIC_DRAW, 0);
-    m_vertexBuffer.unbindBuffers(GL_ARRAY_BUFFER);
-    delete [] vertices;
+    m_vertexBuffer.setData<GLfloat>(vertices, numVertices*6, GL_STATIC_DRAW, bufferIdx);
+    m_vertexBuffer.setData<GLfloat>(positionsOnly, numVertices*3, GL_STATIC_DRAW, positionBufferIdx);
+}
+
+void Model::updateBounds(const glm::vec3& vertex, bool first)
+{
+    if ( first )
+    {
+        m_minVertex = m_maxVertex = vertex;
+        return;
+    }
+    m_minVertex = glm::min(m_minVertex, vertex);
+    m_maxVertex = glm::max(m_maxVertex, vertex);
+}
+
+void Model::loadToPool(const aiMesh& mesh, size_t meshIdx, bool firstQuery)
+{
+    const aiVector3D* positions = mesh.mVertices;
+    const aiVector3D* normals = mesh.mNormals;
+    const aiVector3D* uvs = mesh.mTextureCoords[0];
+    const unsigned int numVertices = mesh.mNumVertices;
+    const unsigned int numElements = mesh.mNumFaces * 3;
+    const int stride = GeometryPool::VERTEX_FLOATS;
+
+    ArenaScope scope(FrameArena::scratch());
+    GLfloat *vertices = FrameArena::scratch().allocate<GLfloat>(numVertices*stride);
+    std::vector<GLuint> elements(numElements);
+
+    // interleave positions, normals and uvs (missing ones are zeroed)
+    for ( unsigned int i = 0; i < numVertices; ++i )
+    {
+        GLfloat *vertex = vertices + i*stride;
+        const glm::vec3 position = positions == nullptr ? glm::vec3(0.0f) :
+            glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+        const glm::vec3 normal = normals == nullptr ? glm::vec3(0.0f, 0.0f, 1.0f) :
+            glm::vec3(normals[i].x, normals[i].y, normals[i].z);
+
+        vertex[0] = position.x;
+        vertex[1] = position.y;
+        vertex[2] = position.z;
+        vertex[3] = normal.x;
+        vertex[4] = normal.y;
+        vertex[5] = normal.z;
+        vertex[6] = uvs == nullptr ? 0.0f : uvs[i].x;
+        vertex[7] = uvs == nullptr ? 0.0f : uvs[i].y;
+
+        this->updateBounds(position, firstQuery && i == 0);
+    }
+
+    for ( unsigned int j = 0; j < numElements; ++j )
+        elements[j] = mesh.mFaces[j/3].mIndices[j%3];
+    this->loadLods(mesh, meshIdx, elements);
+
+    // the levels were laid out from index 0, move them to where the pool put
+    // the mesh
+    const GeometryPool::Range range = m_geometryPool->add(vertices, numVertices, elements.data(), elements.size());
+    std::vector<MeshLod>& lods = m_meshInfo[meshIdx].lods;
+    for ( size_t i = 0; i < lods.size(); ++i )
+    {
+        lods[i].range.firstIndex += range.firstIndex;
+        lods[i].range.baseVertex = range.baseVertex;
+    }
+}
+
+void Model::loadLods(const aiMesh& mesh, size_t meshIdx, std::vector<GLuint>& elements)
+{
+    const MeshLod full = {{0, static_cast<GLuint>(elements.size()), 0}, 0.0f};
+    MeshInfo& info = m_meshInfo[meshIdx];
+    std::vector<MeshLod>& lods = info.lods;
+    lods.assign(1, full);
+    info.center = glm::vec3(0.0f);
+    info.radius = 0.0f;
+    info.lodLevel = 0;
+
+    if ( mesh.mVertices == nullptr || mesh.mNumVertices == 0 )
+        return;
+
+    // each mesh picks its level from its own sphere, and the error allowed
+    // goes with its size
+    glm::vec3 minVertex(mesh.mVertices[0].x, mesh.mVertices[0].y, mesh.mVertices[0].z);
+    glm::vec3 maxVertex = minVertex;
+    for ( unsigned int i = 1; i < mesh.mNumVertices; ++i )
+    {
+        const glm::vec3 vertex(mesh.mVertices[i].x, mesh.mVertices[i].y, mesh.mVertices[i].z);
+        minVertex = glm::min(minVertex, vertex);
+        maxVertex = glm::max(maxVertex, vertex);
+    }
+    info.center = (minVertex + maxVertex) * 0.5f;
+    info.radius = glm::length(maxVertex - minVertex) * 0.5f;
+    const float radius = info.radius;
+
+    if ( elements.size() / 3 < LOD_MIN_TRIANGLES )
+        return;
+
+    // aiVector3D is three packed floats
+    MeshSimplifier simplifier(reinterpret_cast<const GLfloat*>(mesh.mVertices), 3, mesh.mNumVertices,
+                              elements.data(), elements.size());
+    const std::vector<MeshSimplifier::Level> levels = simplifier.build(LOD_LEVELS, LOD_RATIO, LOD_MAX_ERROR * radius);
+
+    // after the full mesh in the same element buffer
+    for ( size_t i = 0; i < levels.size(); ++i )
+    {
+        const MeshLod lod = {{static_cast<GLuint>(elements.size()), static_cast<GLuint>(levels[i].indices.size()), 0},
+                             levels[i].error};
+        elements.insert(elements.end(), levels[i].indices.begin(), levels[i].indices.end());
+        lods.push_back(lod);
+    }
+
+    DEBUG_MSG(std::cout << "Mesh " << meshIdx << " : " << lods.size() << " detail levels" << std::endl);
 }
 
 void Model::loadUvs(aiMesh &mesh, GLsizei bufferIdx)
@@ -222,7 +354,8 @@ void Model::loadUvs(aiMesh &mesh, GLsizei bufferIdx)
 
     unsigned int numVertices = mesh.mNumVertices;
 
-    GLfloat *uvCoords = new GLfloat[numVertices*2];
+    ArenaScope scope(FrameArena::scratch());
+    GLfloat *uvCoords = FrameArena::scratch().allocate<GLfloat>(numVertices*2);
 
     for ( unsigned int i = 0; i < numVertices*2; i+=2 )
     {
@@ -230,29 +363,25 @@ void Model::loadUvs(aiMesh &mesh, GLsizei bufferIdx)
         uvCoords[i+1] = mesh.mTextureCoords[0][i/2].y;
     }
 
-    m_vertexBuffer.bind(GL_ARRAY_BUFFER, bufferIdx);
-    m_vertexBuffer.setData<GLfloat>(uvCoords, numVertices*2, GL_STATIC_DRAW, 0);
-    m_vertexBuffer.unbindBuffers(GL_ARRAY_BUFFER);
-    delete [] uvCoords;
+    m_vertexBuffer.setData<GLfloat>(uvCoords, numVertices*2, GL_STATIC_DRAW, bufferIdx);
 }
 
-void Model::loadFaces(aiFace* faces, unsigned int numFaces, GLsizei bufferIdx)
+void Model::loadFaces(const aiMesh& mesh, size_t meshIdx, GLsizei bufferIdx)
 {
     // guarenteed 3 elements per face
-    unsigned int numElements = numFaces * 3;
+    unsigned int numElements = mesh.mNumFaces * 3;
     
-    // using GLuints because meshes may be very large (FYI Ui just means unsigned int)
-    GLuint *facesUi = new GLuint[numElements];
+    // using GLuints because meshes may be very large (FYI Ui just means
+    // unsigned int), the detail levels go after the full mesh
+    std::vector<GLuint> facesUi(numElements);
 
     // copy elements from faces to facesUi
     for ( unsigned int j = 0; j < numElements; ++j )
-        facesUi[j] = faces[j/3].mIndices[j%3];
+        facesUi[j] = mesh.mFaces[j/3].mIndices[j%3];
+    this->loadLods(mesh, meshIdx, facesUi);
 
-    // load elements into buffer
-    m_vertexBuffer.bind(GL_ELEMENT_ARRAY_BUFFER, bufferIdx);
-    m_vertexBuffer.setData(facesUi, numFaces*3, GL_STATIC_DRAW, bufferIdx);
-    m_vertexBuffer.unbindBuffers(GL_ELEMENT_ARRAY_BUFFER);
-    delete [] facesUi;
+    // load elements into buffer, attached to the VAO in loadMeshes
+    m_vertexBuffer.setData(facesUi.data(), facesUi.size(), GL_STATIC_DRAW, bufferIdx);
 }
 
 void Model::loadTangents(const aiMesh &mesh, GLsizei bufferIdx)
@@ -262,7 +391,8 @@ void Model::loadTangents(const aiMesh &mesh, GLsizei bufferIdx)
     unsigned int numVertices = mesh.mNumVertices;
 
     // interleave the positions and normals
-    GLfloat *vertices = new GLfloat[numVertices*6];
+    ArenaScope scope(FrameArena::scratch());
+    GLfloat *vertices = FrameArena::scratch().allocate<GLfloat>(numVertices*6);
 
     // copy positions and normals into single, interleaved array
     for ( unsigned int i = 0; i < numVertices*6; i+=6 )
@@ -276,10 +406,7 @@ void Model::loadTangents(const aiMesh &mesh, GLsizei bufferIdx)
     }
 
     // load vertices into an array buffer
-    m_vertexBuffer.bind(GL_ARRAY_BUFFER, bufferIdx);
     m_vertexBuffer.setData<GLfloat>(vertices, numVertices*6, GL_STATIC_DRAW, bufferIdx);
-    m_vertexBuffer.unbindBuffers(GL_ARRAY_BUFFER);
-    delete [] vertices;
 }
 
 void Model::loadMeshes(aiMesh** meshes, unsigned int numMeshes)
@@ -287,19 +414,29 @@ void Model::loadMeshes(aiMesh** meshes, unsigned int numMeshes)
     unsigned int vertexBufferIdx;
     unsigned int uvBufferIdx;
     unsigned int elementBufferIdx;
+    unsigned int positionBufferIdx;
     unsigned int nextBuffer = 0;
     bool initMinMaxSearch = true;
 
-    // attributes
-    GLAttribute vPosition(V_POSITION);
-    GLAttribute vNormal(V_NORMAL);
-    GLAttribute vUvCoord(V_UVCOORD);
-
     // resize the mesh information vectors
     m_meshInfo.resize(numMeshes);
 
+    // everything goes into the shared pool, no per mesh buffers or VAOs
+    if ( m_geometryPool != nullptr )
+    {
+        for ( unsigned int i = 0; i < numMeshes; ++i )
+        {
+            aiMesh& mesh = *(meshes[i]);
+            m_meshInfo[i].name = mesh.mName.C_Str();
+            m_meshInfo[i].materialIdx = mesh.mMaterialIndex;
+            this->loadToPool(mesh, i, i == 0);
+        }
+        return;
+    }
+
     // one VAO for each mesh
     m_vao.create(numMeshes);
+    m_depthVao.create(numMeshes);
 
     // determine number of buffers needed
     unsigned int bufferCount = 0;
@@ -312,7 +449,7 @@ void Model::loadMeshes(aiMesh** meshes, unsigned int numMeshes)
 
         if ( m_materials[mesh.mMaterialIndex].drawType != DRAW_MATERIAL )
             bufferCount++; // uv buffer
-        bufferCount+=2; // vertex and element buffers
+        bufferCount+=3; // vertex, position and element buffers
     }
 
     // generate the required number of buffers
@@ -328,50 +465,32 @@ void Model::loadMeshes(aiMesh** meshes, unsigned int numMeshes)
 
         vertexBufferIdx = nextBuffer++;
         elementBufferIdx = nextBuffer++;
+        positionBufferIdx = nextBuffer++;
         if ( useTexture )
             uvBufferIdx = nextBuffer++;
 
-        // enable the VAO for this mesh and enable the necessary attributes
-        // using braces/indentation to show what code applies to this vao
-        m_vao.bind(i);
-        {
-            // Load vertices and faces into buffers
-            this->loadVertices(mesh, vertexBufferIdx, initMinMaxSearch);
-            this->loadFaces(mesh.mFaces, mesh.mNumFaces, elementBufferIdx);
-            if ( useTexture )
-            {
-                this->loadUvs(mesh, uvBufferIdx);
-                vUvCoord.enable();
-            }
-
-            // enable the attributes for the VAO
-            vPosition.enable();
-            vNormal.enable();
-
-            // bind and point data to the array buffer. The 3 is because vec3 is 3
-            // elements (GL_FLOAT implied). Step size is 2*sizeof(vec3) because the
-            // data is interleaved. The normals has an offset of sizeof(vec3) because
-            // of interleaving.
-            m_vertexBuffer.bind(GL_ARRAY_BUFFER, vertexBufferIdx);
-            vPosition.loadBufferData(3, sizeof(GLfloat)*6);
-            vNormal.loadBufferData(3, sizeof(GLfloat)*6, sizeof(GLfloat)*3);
-            if ( useTexture )
-            {
-                vUvCoord.enable();
-                m_vertexBuffer.bind(GL_ARRAY_BUFFER, uvBufferIdx);
-                vUvCoord.loadBufferData(2, sizeof(GLfloat)*2);
-            }
+        // Load vertices and faces into buffers
+        this->loadVertices(mesh, vertexBufferIdx, positionBufferIdx, initMinMaxSearch);
+        this->loadFaces(mesh, i, elementBufferIdx);
+        if ( useTexture )
+            this->loadUvs(mesh, uvBufferIdx);
+
+        // point the attributes of this mesh's VAO at the buffers. The 3 is
+        // because vec3 is 3 elements. Step size is 2*sizeof(vec3) because the
+        // data is interleaved. The normals has an offset of sizeof(vec3) because
+        // of interleaving.
+        const GLuint vertexBuffer = m_vertexBuffer.getBufferIdx(vertexBufferIdx);
+        m_vao.setAttribute(V_POSITION, vertexBuffer, 3, GL_FLOAT, sizeof(GLfloat)*6, 0, 0, i);
+        m_vao.setAttribute(V_NORMAL, vertexBuffer, 3, GL_FLOAT, sizeof(GLfloat)*6, sizeof(GLfloat)*3, 0, i);
+        if ( useTexture )
+            m_vao.setAttribute(V_UVCOORD, m_vertexBuffer.getBufferIdx(uvBufferIdx), 2, GL_FLOAT, sizeof(GLfloat)*2, 0, 0, i);
+        m_vao.setElementBuffer(m_vertexBuffer.getBufferIdx(elementBufferIdx), i);
 
-            // bind the element array buffer for the VAO
-            // (note here that GL_ARRAY_BUFFERS are NOT stored by the VAO) but attribute enables are
-            m_vertexBuffer.bind(GL_ELEMENT_ARRAY_BUFFER, elementBufferIdx);
-        }
-        // unbind the VAO so that no further changes will affect it
-        m_vao.unbindAll();
+        m_depthVao.setAttribute(V_POSITION, m_vertexBuffer.getBufferIdx(positionBufferIdx), 3, GL_FLOAT, sizeof(GLfloat)*3, 0, 0, i);
+        m_depthVao.setElementBuffer(m_vertexBuffer.getBufferIdx(elementBufferIdx), i);
 
-        // store material idx and number of faces
+        // store material idx
         m_meshInfo[i].materialIdx = mesh.mMaterialIndex;
-        m_meshInfo[i].numElements = 3 * mesh.mNumFaces;
 
         // only valid first time through the loop
         initMinMaxSearch = false;
@@ -418,6 +537,11 @@ bool Model::init(const std::string& filename, bool flipUvs)
     return true;
 }
 
+void Model::setGeometryPool(const std::shared_ptr<GeometryPool>& pool)
+{
+    m_geometryPool = pool;
+}
+
 const glm::mat4& Model::getModelMatrix()
 {
     return m_modelMatrix;
@@ -452,6 +576,10 @@ void Model::setUniforms(GLBuffer &ubo, UniformType type)
 
 void Model::draw(DrawType type)
 {
+    // pooled meshes have no VAOs of their own
+    if ( m_geometryPool != nullptr )
+        return;
+
     switch (type)
     {
         case DrawType::DRAW_MATERIAL:
@@ -471,19 +599,27 @@ void Model::draw(DrawType type)
                     continue;
                 
                 // bind the correct texture
-                glActiveTexture(GL_TEXTURE0);
-                material.texture.setSampling(material.texTarget,
-                        GL_LINEAR_MIPMAP_LINEAR,
-                        GL_LINEAR,
-                        GL_MIRRORED_REPEAT,
-                        GL_MIRRORED_REPEAT);
-                material.texture.generateMipMap(material.texTarget);
+                GLTexture::setActiveUnit(GL_TEXTURE0);
                 material.texture.bind(material.texTarget);
                 
                 this->drawCommon(i);
             }
             break;
         }
+        case DrawType::DRAW_DEPTH:
+        {
+            // only what the lit passes draw, or it would hide them
+            for ( size_t i = 0; i < m_meshInfo.size(); ++i )
+            {
+                const DrawType litType = m_materials[m_meshInfo[i].materialIdx].drawType;
+                if ( this->isHidden(i) || (litType != DRAW_MATERIAL && litType != DRAW_TEXTURE_D) )
+                    continue;
+                const MeshLod& lod = this->getLod(i);
+                m_depthVao.bind(i);
+                glDrawElements(GL_TRIANGLES, lod.range.count, GL_UNSIGNED_INT, (void*)(lod.range.firstIndex * sizeof(GLuint)));
+            }
+            break;
+        }
         default:
         {
             std::cout << "Warning: Draw type not handeled" << std::endl;
@@ -491,32 +627,85 @@ void Model::draw(DrawType type)
     }
 }
 
-void Model::drawCommon(size_t idx)
+bool Model::submit(IndirectRenderer& renderer, const MatricesBlock& matrices)
+{
+    if ( m_geometryPool == nullptr )
+        return false;
+
+    for ( size_t i = 0; i < m_meshInfo.size(); ++i )
+    {
+        if ( this->isHidden(i) )
+            continue;
+
+        Material& material = m_materials[m_meshInfo[i].materialIdx];
+        const GeometryPool::Range& range = this->getLod(i).range;
+        if ( material.drawType == DRAW_MATERIAL )
+            renderer.submit(range, matrices, material.block, DRAW_MATERIAL);
+        else if ( material.drawType == DRAW_TEXTURE_D )
+            renderer.submit(range, matrices, material.block, DRAW_TEXTURE_D, &material.texture, material.texTarget);
+    }
+    return true;
+}
+
+void Model::selectLod(const MatricesBlock& matrices, float pixelScale)
+{
+    // the model matrix scales uniformly
+    const glm::mat4& mvMatrix = matrices.mvMatrix;
+    const float scale = glm::length(mvMatrix[0].xyz());
+
+    for ( size_t i = 0; i < m_meshInfo.size(); ++i )
+    {
+        MeshInfo& info = m_meshInfo[i];
+        info.lodLevel = 0;
+        if ( info.lods.size() < 2 )
+            continue;
+
+        // nearest point of the mesh's bounding sphere in view space
+        const float distance = -(mvMatrix * glm::vec4(info.center, 1.0f)).z - info.radius * scale;
+        if ( distance <= LOD_MIN_DISTANCE )
+            continue;
+
+        // the coarsest level whose error stays under LOD_PIXEL_ERROR on screen
+        const float pixelsPerUnit = pixelScale * scale / distance;
+        while ( info.lodLevel + 1 < info.lods.size() &&
+                info.lods[info.lodLevel + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR )
+            ++info.lodLevel;
+    }
+}
+
+const MeshLod& Model::getLod(size_t idx) const
+{
+    const MeshInfo& info = m_meshInfo[idx];
+    return info.lods[info.lodLevel];
+}
+
+bool Model::isHidden(size_t idx) const
 {
     // don't draw wires/bones in models
     //if ( this->isWire(m_materials[m_meshInfo[idx].materialIdx].name) )
-    //    return;
+    //    return true;
 
 #if 1
     // make elexis nude
-    std::string name = m_materials[m_meshInfo[idx].materialIdx].name;
+    const std::string& name = m_materials[m_meshInfo[idx].materialIdx].name;
     if ( name == "NudeEL_Nude__Elexis_reference_s0" )
-        return;
+        return true;
     if ( name == "NudeEL_Nude__Elexis_reference_s" )
-        return;
+        return true;
 #endif
+    return false;
+}
+
+void Model::drawCommon(size_t idx)
+{
+    if ( this->isHidden(idx) )
+        return;
 
     // set the materials UBO
-    m_materialUbo.bind(GL_UNIFORM_BUFFER);
-    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].diffuse), MATERIAL_DIFFUSE_OFFSET);
-    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].specular), MATERIAL_SPECULAR_OFFSET);
-    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].ambient), MATERIAL_AMBIENT_OFFSET);
-    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].shininess), MATERIAL_SHININESS_OFFSET);
-    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].texBlend), MATERIAL_TEXBLEND_OFFSET);
-    GLBuffer::unbindBuffers(GL_UNIFORM_BUFFER);
+    m_materialUbo.setSubData(&(m_materials[m_meshInfo[idx].materialIdx].block));
 
+    const MeshLod& lod = this->getLod(idx);
     m_vao.bind(idx);
-    glDrawElements(GL_TRIANGLES, m_meshInfo[idx].numElements, GL_UNSIGNED_INT, (void*)(0));
-    m_vao.unbindAll();
+    glDrawElements(GL_TRIANGLES, lod.range.count, GL_UNSIGNED_INT, (void*)(lod.range.firstIndex * sizeof(GLuint)));
 }
 
@@ -8,6 +8,7 @@
 #include "../../glwrappers/GLVertexArray.hpp"
 #include "../../glwrappers/GLBuffer.hpp"
 #include "../../glwrappers/GLTexture.hpp"
+#include "../../render/GeometryPool.hpp"
 
 #include <boost/filesystem.hpp>
 #include <assimp/scene.h>
@@ -26,6 +27,9 @@ struct Material
     float     shininess;
     float     texBlend;
 
+    // the fields above as uploaded to the Material uniform block
+    MaterialBlock block;
+
     // texture info
     DrawType    drawType;
     GLTexture   texture;
@@ -33,13 +37,24 @@ struct Material
     bool        useTexture;
 };
 
+// a detail level of a mesh, all levels share the mesh's vertices
+struct MeshLod
+{
+    GeometryPool::Range range;  // in the geometry pool, or in the mesh's own
+                                // element buffer (baseVertex 0)
+    float error;                // model space distance to the full mesh, about
+};
+
 struct MeshInfo
 {
     std::string name;
-    GLsizei numElements;    // number of elements (3 per triangle)
     size_t materialIdx;     // which material to use
     bool useTexture;
     GLTexture   texture;    // usually texture stored in material, but sometimes not
+    std::vector<MeshLod> lods;  // finest first, lods[0] is the full mesh
+    glm::vec3 center;       // bounding sphere in model space (loadLods)
+    float radius;
+    size_t lodLevel;        // the level selectLod picked
 };
 
 class Model : public iGLRenderable
@@ -48,14 +63,24 @@ public:
     Model();
     ~Model();
 
+    // meshes loaded by init go into the pool instead of their own buffers,
+    // they can then only be drawn through submit
+    void setGeometryPool(const std::shared_ptr<GeometryPool>& pool);
+
     bool init(const std::string& filename, bool flipUvs = false);
     
     // inherited virtual functions
     virtual const glm::mat4& getModelMatrix();
     void draw(DrawType type);
     void setUniforms(GLBuffer& ubo, UniformType type = MATERIALS);
+    bool submit(IndirectRenderer& renderer, const MatricesBlock& matrices);
+    void selectLod(const MatricesBlock& matrices, float pixelScale);
 protected:
+    // the level of mesh idx that selectLod picked
+    const MeshLod& getLod(size_t idx) const;
+
     void drawCommon(size_t idx);
+    bool isHidden(size_t idx) const;
     void centerScaleModel();
     
     static bool isWire(const std::string& name);
@@ -63,9 +88,15 @@ protected:
     void loadMaterials(aiMaterial** materials, unsigned int numMaterials);
     void loadMeshes(aiMesh** meshes, unsigned int numMeshes);
     void loadTangents(const aiMesh& mesh, GLsizei bufferIdx);
-    void loadVertices(const aiMesh& mesh, GLsizei bufferIdx, bool firstQuery);
-    void loadFaces(aiFace* faces, unsigned int numFaces, GLsizei bufferIdx);
+    void loadVertices(const aiMesh& mesh, GLsizei bufferIdx, GLsizei positionBufferIdx, bool firstQuery);
+    void loadFaces(const aiMesh& mesh, size_t meshIdx, GLsizei bufferIdx);
+
+    // simplify the mesh and append the coarser levels to elements (which
+    // hold the full mesh), filling m_meshInfo[meshIdx].lods
+    void loadLods(const aiMesh& mesh, size_t meshIdx, std::vector<GLuint>& elements);
     void loadUvs(aiMesh &mesh, GLsizei bufferIdx);
+    void loadToPool(const aiMesh& mesh, size_t meshIdx, bool firstQuery);
+    void updateBounds(const glm::vec3& vertex, bool first);
 
     // vertex buffer kept around so that buffers aren't deallocated
     GLBuffer              m_vertexBuffer;
@@ -73,8 +104,11 @@ protected:
     GLBuffer              m_materialUbo;
     GLBuffer              m_texBlendUbo;
 
-    // one vao per mesh (m_meshInfo.size() == number of meshes)
+    // one vao per mesh (m_meshInfo.size() == number of meshes), the depth
+    // ones only read the positions
     GLVertexArray         m_vao;
+    GLVertexArray         m_depthVao;
+    std::shared_ptr<GeometryPool> m_geometryPool;
     std::vector<Material> m_materials;
     std::vector<MeshInfo> m_meshInfo;
 
@@ -0,0 +1,77 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded queue for exactly one producer thread and one consumer thread,
+// neither ever blocks or locks. push fails when the queue is full, pop when
+// it is empty.
+//
+// The producer only writes m_tail and the consumer only m_head, each slot
+// is handed over by the release store of the index that covers it.
+template <typename T>
+class SpscQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity = 1024) :
+        m_head(0),
+        m_tail(0)
+    {
+        size_t size = 1;
+        while ( size < capacity )
+            size *= 2;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    // producer only
+    bool push(const T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if ( tail - m_head.load(std::memory_order_acquire) > m_mask )
+            return false;
+
+        m_slots[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T& value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if ( head == m_tail.load(std::memory_order_acquire) )
+            return false;
+
+        value = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only a hint while the other thread is running
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return m_slots.size();
+    }
+protected:
+    std::vector<T>      m_slots;
+    size_t              m_mask;
+
+    // keep the indices on their own cache lines so the two threads don't
+    // invalidate each other's
+    char                m_pad0[64];
+    std::atomic<size_t> m_head;     // next slot to pop
+    char                m_pad1[64];
+    std::atomic<size_t> m_tail;     // next slot to push
+    char                m_pad2[64];
+};
+
+#endif // SPSCQUEUE_HPP
@@ -0,0 +1,100 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads) :
+    m_job(nullptr),
+    m_count(0),
+    m_grain(1),
+    m_next(0),
+    m_generation(0),
+    m_busy(0),
+    m_stop(false)
+{
+    if ( threads == 0 )
+    {
+        const unsigned int cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 0;
+    }
+
+    for ( unsigned int i = 0; i < threads; ++i )
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for ( size_t i = 0; i < m_workers.size(); ++i )
+        m_workers[i].join();
+}
+
+ThreadPool& ThreadPool::get()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const Job& job)
+{
+    if ( count == 0 )
+        return;
+    grain = std::max<size_t>(grain, 1);
+
+    // not worth waking anyone for a single chunk
+    if ( m_workers.empty() || count <= grain )
+    {
+        job(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_grain = grain;
+        m_next = 0;
+        m_busy = m_workers.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    this->runChunks();
+
+    // the job is on our stack, wait until no worker can touch it
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busy == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned long generation = 0;
+    while ( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+            if ( m_stop )
+                return;
+            generation = m_generation;
+        }
+
+        this->runChunks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ( --m_busy == 0 )
+            m_done.notify_one();
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    size_t begin;
+    while ( (begin = m_next.fetch_add(m_grain)) < m_count )
+        (*m_job)(begin, std::min(begin + m_grain, m_count));
+}
@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting a loop over the cores.
+//
+// parallelFor hands out chunks of [0, count) to the workers and the calling
+// thread, and returns once every chunk has run. Only one parallelFor runs at
+// a time, jobs must not call parallelFor themselves.
+//
+// example:
+//   ThreadPool::get().parallelFor(count, 16, [&](size_t begin, size_t end) {
+//       for ( size_t i = begin; i < end; ++i )
+//           work(i);
+//   });
+class ThreadPool
+{
+public:
+    typedef std::function<void(size_t, size_t)> Job;
+
+    // threads is the number of workers, 0 uses one less than the number of
+    // cores (the caller is the last one)
+    explicit ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    // pool shared by everything that doesn't need its own
+    static ThreadPool& get();
+
+    // run job(begin, end) over [0, count) in chunks of grain indices
+    void parallelFor(size_t count, size_t grain, const Job& job);
+protected:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+
+    // take chunks until none are left
+    void runChunks();
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex               m_mutex;
+    std::condition_variable  m_wake;
+    std::condition_variable  m_done;
+
+    // the job being run, only valid while m_busy > 0 or in parallelFor
+    const Job*               m_job;
+    size_t                   m_count;
+    size_t                   m_grain;
+    std::atomic<size_t>      m_next;
+
+    unsigned long            m_generation;   // bumped for every job
+    unsigned int             m_busy;         // workers still on the job
+    bool                     m_stop;
+};
+
+#endif // THREADPOOL_HPP